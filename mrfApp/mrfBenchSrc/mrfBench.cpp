@@ -0,0 +1,657 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <getopt.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+#include <MrfConsistentAsynchronousMemoryAccess.h>
+#include <MrfMmapMemoryAccess.h>
+#include <MrfSimulatedMemoryAccess.h>
+#include <MrfTime.h>
+#include <MrfUdpIpMemoryAccess.h>
+
+// This program measures the throughput and latency of a memory access. All
+// operations are issued through an MrfConsistentAsynchronousMemoryAccess (like
+// it is done by the device support), so that the numbers reflect what the
+// records see. The program is intended for comparing the effect of changes to
+// the memory access implementations, so it only prints the results and does
+// not try to interpret them.
+
+using namespace anka::mrf;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Type of an operation issued by the benchmark.
+ */
+enum class OperationKind {
+  read, write, update
+};
+
+/**
+ * Settings of the benchmark.
+ */
+struct Settings {
+  std::string target;
+  bool evr = false;
+  std::uint32_t memorySize = 0;
+  unsigned long numberOfOperations = 10000;
+  unsigned long concurrency = 16;
+  bool use32Bit = true;
+  bool randomPattern = false;
+  unsigned long readWeight = 100;
+  unsigned long writeWeight = 0;
+  unsigned long updateWeight = 0;
+  std::uint32_t rangeStart = 0x8000;
+  std::uint32_t rangeEnd = 0x10000;
+  bool writeCombining = false;
+  long udpPacketsInFlight = -1;
+  bool udpPipelinedWrites = false;
+  unsigned long simulatedLatency = 0;
+  unsigned long simulatedJitter = 0;
+  unsigned long seed = 0;
+  bool seedSpecified = false;
+};
+
+/**
+ * State shared between the thread issuing the operations and the threads
+ * calling the callbacks.
+ */
+class Benchmark {
+
+public:
+
+  Benchmark(std::size_t numberOfOperations, std::size_t concurrency) :
+      concurrency(concurrency), latencies(numberOfOperations), inFlight(0),
+      completed(0), failed(0) {
+  }
+
+  /**
+   * Waits until another operation may be issued and reserves a slot for it.
+   */
+  void acquireSlot() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() {return inFlight < concurrency;});
+    ++inFlight;
+  }
+
+  /**
+   * Records the completion of an operation.
+   */
+  void complete(std::size_t index, Clock::time_point startTime,
+      bool success) {
+    Clock::time_point endTime = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    latencies[index] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        endTime - startTime).count();
+    --inFlight;
+    ++completed;
+    if (!success) {
+      ++failed;
+    }
+    condition.notify_all();
+  }
+
+  /**
+   * Waits until all operations have completed.
+   */
+  void waitForCompletion() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() {return completed == latencies.size();});
+  }
+
+  std::size_t getNumberOfFailures() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+  }
+
+  /**
+   * Returns the latencies of all operations (in nanoseconds). Must only be
+   * called after all operations have completed.
+   */
+  const std::vector<std::int64_t> &getLatencies() const {
+    return latencies;
+  }
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  Benchmark(const Benchmark &) = delete;
+  Benchmark(Benchmark &&) = delete;
+  Benchmark &operator=(const Benchmark &) = delete;
+  Benchmark &operator=(Benchmark &&) = delete;
+
+  std::size_t concurrency;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::vector<std::int64_t> latencies;
+  std::size_t inFlight;
+  std::size_t completed;
+  std::size_t failed;
+
+};
+
+/**
+ * Callback that reports the completion of an operation to the benchmark.
+ */
+template<typename T>
+class BenchmarkCallback: public MrfMemoryAccess::Callback<T> {
+
+public:
+
+  BenchmarkCallback(Benchmark &benchmark, std::size_t index) :
+      benchmark(benchmark), index(index), startTime(Clock::now()) {
+  }
+
+  void success(std::uint32_t, T) override {
+    benchmark.complete(index, startTime, true);
+  }
+
+  void failure(std::uint32_t, MrfMemoryAccess::ErrorCode,
+      const std::string &) override {
+    benchmark.complete(index, startTime, false);
+  }
+
+private:
+
+  Benchmark &benchmark;
+  std::size_t index;
+  Clock::time_point startTime;
+
+};
+
+void printUsage(const char *programName) {
+  std::fprintf(stderr,
+      "Usage: %s --target TARGET [options]\n"
+      "\n"
+      "Measures the throughput and latency of a memory access.\n"
+      "\n"
+      "Targets:\n"
+      "  udp:HOST                     MRF VME device (or mrfUdpSim) accessed "
+      "over UDP/IP\n"
+      "  mmap:PATH                    device node (or file) accessed through "
+      "mmap\n"
+      "  memfd                        anonymous memory accessed through mmap\n"
+      "  sim                          simulated device\n"
+      "\n"
+      "Options:\n"
+      "  -t, --target TARGET          memory access that is benchmarked\n"
+      "      --device-type evg|evr    type of the device (default evg)\n"
+      "      --memory-size BYTES      size of the memory (default depends on "
+      "the device\n"
+      "                               type)\n"
+      "  -n, --operations N           number of operations (default 10000)\n"
+      "  -c, --concurrency N          max. number of operations in flight "
+      "(default 16)\n"
+      "  -w, --width 16|32            register width (default 32)\n"
+      "  -p, --pattern sequential|random\n"
+      "                               order of the addresses (default "
+      "sequential)\n"
+      "  -m, --mix READ:WRITE:UPDATE  relative weights of reads, writes and "
+      "masked\n"
+      "                               writes (default 100:0:0)\n"
+      "  -r, --range START:END        address range (default 0x8000:0x10000)\n"
+      "      --write-combining        enable write combining\n"
+      "      --udp-packets-in-flight N\n"
+      "                               max. number of UDP packets in flight "
+      "(default 0)\n"
+      "      --udp-pipelined-writes   enable pipelined 32-bit writes\n"
+      "      --sim-latency US         latency of the simulated device "
+      "(microseconds)\n"
+      "      --sim-jitter US          jitter of the simulated device "
+      "(microseconds)\n"
+      "  -s, --seed N                 seed for the random number generator\n"
+      "  -h, --help                   show this help\n"
+      "\n"
+      "Write and masked write operations modify the registers in the address "
+      "range,\nso they must only be used with devices that are not in "
+      "operation.\n",
+      programName);
+}
+
+unsigned long parseUnsigned(const char *optionName, const char *value) {
+  char *endPtr;
+  errno = 0;
+  unsigned long number = std::strtoul(value, &endPtr, 0);
+  if (errno || *endPtr || !*value || *value == '-') {
+    throw std::invalid_argument(
+        std::string("The value of ") + optionName
+            + " must be a non-negative integer.");
+  }
+  return number;
+}
+
+/**
+ * Splits a string of the form "A:B:C" into its parts.
+ */
+std::vector<std::string> splitAtColons(const std::string &value) {
+  std::vector<std::string> parts;
+  std::string::size_type start = 0;
+  for (;;) {
+    std::string::size_type end = value.find(':', start);
+    if (end == std::string::npos) {
+      parts.push_back(value.substr(start));
+      return parts;
+    }
+    parts.push_back(value.substr(start, end - start));
+    start = end + 1;
+  }
+}
+
+/**
+ * Parses the command-line arguments. Returns false if the program shall
+ * terminate without running the benchmark (because the usage information has
+ * been requested). Throws an exception if the arguments are invalid.
+ */
+bool parseArguments(int argc, char **argv, Settings &settings) {
+  enum {
+    deviceTypeOption = 256,
+    memorySizeOption,
+    writeCombiningOption,
+    udpPacketsInFlightOption,
+    udpPipelinedWritesOption,
+    simLatencyOption,
+    simJitterOption
+  };
+  static const ::option longOptions[] = {
+    { "target", required_argument, nullptr, 't' },
+    { "device-type", required_argument, nullptr, deviceTypeOption },
+    { "memory-size", required_argument, nullptr, memorySizeOption },
+    { "operations", required_argument, nullptr, 'n' },
+    { "concurrency", required_argument, nullptr, 'c' },
+    { "width", required_argument, nullptr, 'w' },
+    { "pattern", required_argument, nullptr, 'p' },
+    { "mix", required_argument, nullptr, 'm' },
+    { "range", required_argument, nullptr, 'r' },
+    { "write-combining", no_argument, nullptr, writeCombiningOption },
+    { "udp-packets-in-flight", required_argument, nullptr,
+        udpPacketsInFlightOption },
+    { "udp-pipelined-writes", no_argument, nullptr, udpPipelinedWritesOption },
+    { "sim-latency", required_argument, nullptr, simLatencyOption },
+    { "sim-jitter", required_argument, nullptr, simJitterOption },
+    { "seed", required_argument, nullptr, 's' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 }
+  };
+  int option;
+  while ((option = ::getopt_long(argc, argv, "t:n:c:w:p:m:r:s:h", longOptions,
+      nullptr)) != -1) {
+    switch (option) {
+    case 't':
+      settings.target = optarg;
+      break;
+    case deviceTypeOption:
+      if (std::strcmp(optarg, "evg") == 0) {
+        settings.evr = false;
+      } else if (std::strcmp(optarg, "evr") == 0) {
+        settings.evr = true;
+      } else {
+        throw std::invalid_argument(
+            "The device type must be either \"evg\" or \"evr\".");
+      }
+      break;
+    case memorySizeOption:
+      settings.memorySize = parseUnsigned("--memory-size", optarg);
+      break;
+    case 'n':
+      settings.numberOfOperations = parseUnsigned("--operations", optarg);
+      break;
+    case 'c':
+      settings.concurrency = parseUnsigned("--concurrency", optarg);
+      if (settings.concurrency == 0) {
+        throw std::invalid_argument("The concurrency must be at least one.");
+      }
+      break;
+    case 'w':
+      if (std::strcmp(optarg, "16") == 0) {
+        settings.use32Bit = false;
+      } else if (std::strcmp(optarg, "32") == 0) {
+        settings.use32Bit = true;
+      } else {
+        throw std::invalid_argument("The width must be either 16 or 32.");
+      }
+      break;
+    case 'p':
+      if (std::strcmp(optarg, "sequential") == 0) {
+        settings.randomPattern = false;
+      } else if (std::strcmp(optarg, "random") == 0) {
+        settings.randomPattern = true;
+      } else {
+        throw std::invalid_argument(
+            "The pattern must be either \"sequential\" or \"random\".");
+      }
+      break;
+    case 'm': {
+      std::vector<std::string> parts = splitAtColons(optarg);
+      if (parts.size() != 3) {
+        throw std::invalid_argument(
+            "The mix must be specified as READ:WRITE:UPDATE.");
+      }
+      settings.readWeight = parseUnsigned("--mix", parts[0].c_str());
+      settings.writeWeight = parseUnsigned("--mix", parts[1].c_str());
+      settings.updateWeight = parseUnsigned("--mix", parts[2].c_str());
+      if (settings.readWeight + settings.writeWeight + settings.updateWeight
+          == 0) {
+        throw std::invalid_argument(
+            "At least one of the weights in the mix must be positive.");
+      }
+      break;
+    }
+    case 'r': {
+      std::vector<std::string> parts = splitAtColons(optarg);
+      if (parts.size() != 2) {
+        throw std::invalid_argument(
+            "The range must be specified as START:END.");
+      }
+      settings.rangeStart = parseUnsigned("--range", parts[0].c_str());
+      settings.rangeEnd = parseUnsigned("--range", parts[1].c_str());
+      break;
+    }
+    case writeCombiningOption:
+      settings.writeCombining = true;
+      break;
+    case udpPacketsInFlightOption:
+      settings.udpPacketsInFlight = parseUnsigned("--udp-packets-in-flight",
+          optarg);
+      break;
+    case udpPipelinedWritesOption:
+      settings.udpPipelinedWrites = true;
+      break;
+    case simLatencyOption:
+      settings.simulatedLatency = parseUnsigned("--sim-latency", optarg);
+      break;
+    case simJitterOption:
+      settings.simulatedJitter = parseUnsigned("--sim-jitter", optarg);
+      break;
+    case 's':
+      settings.seed = parseUnsigned("--seed", optarg);
+      settings.seedSpecified = true;
+      break;
+    case 'h':
+      printUsage(argv[0]);
+      return false;
+    default:
+      throw std::invalid_argument("Invalid command-line arguments.");
+    }
+  }
+  if (optind < argc) {
+    throw std::invalid_argument("Unexpected command-line argument.");
+  }
+  if (settings.target.empty()) {
+    throw std::invalid_argument("The target must be specified.");
+  }
+  if (settings.memorySize == 0) {
+    settings.memorySize =
+        settings.evr ?
+            MrfSimulatedMemoryAccess::memorySizeVmeEvr230Rf :
+            MrfSimulatedMemoryAccess::memorySizeVmeEvg230;
+  }
+  std::uint32_t width = settings.use32Bit ? 4 : 2;
+  if (settings.rangeStart % width != 0 || settings.rangeEnd % width != 0
+      || settings.rangeEnd <= settings.rangeStart) {
+    throw std::invalid_argument(
+        "The range must not be empty and its limits must be aligned to the register width.");
+  }
+  return true;
+}
+
+/**
+ * Converts a number of microseconds to an {@link MrfTime}.
+ */
+MrfTime microsecondsToTime(unsigned long microseconds) {
+  return MrfTime(microseconds / 1000000, (microseconds % 1000000) * 1000);
+}
+
+/**
+ * Creates the memory access that is specified by the settings.
+ */
+std::shared_ptr<MrfMemoryAccess> createMemoryAccess(
+    const Settings &settings) {
+  const std::string &target = settings.target;
+  if (target.compare(0, 4, "udp:") == 0) {
+    std::shared_ptr<MrfUdpIpMemoryAccess> device = std::make_shared<
+        MrfUdpIpMemoryAccess>(target.substr(4),
+        settings.evr ?
+            MrfUdpIpMemoryAccess::baseAddressVmeEvrRegister :
+            MrfUdpIpMemoryAccess::baseAddressVmeEvgRegister);
+    if (settings.udpPacketsInFlight >= 0) {
+      device->setMaximumPacketsInFlight(settings.udpPacketsInFlight);
+    }
+    device->setPipelinedWrites(settings.udpPipelinedWrites);
+    return device;
+  } else if (target.compare(0, 5, "mmap:") == 0) {
+    MrfMmapMemoryAccess::registerSignalHandler();
+    // The benchmark does not use interrupts, so we do not enable them. This
+    // way, the target does not have to be a device node of the MRF kernel
+    // module.
+    return std::make_shared<MrfMmapMemoryAccess>(target.substr(5),
+        settings.memorySize, false);
+  } else if (target == "memfd") {
+#ifdef SYS_memfd_create
+    int fileDescriptor = ::syscall(SYS_memfd_create, "mrfBench", 0);
+    if (fileDescriptor == -1) {
+      throw std::runtime_error(
+          std::string("Could not create memory file: ")
+              + std::strerror(errno));
+    }
+    if (::ftruncate(fileDescriptor, settings.memorySize) == -1) {
+      throw std::runtime_error(
+          std::string("Could not resize memory file: ")
+              + std::strerror(errno));
+    }
+    // We intentionally keep the file descriptor open, so that the file
+    // continues to exist while the memory access opens it.
+    MrfMmapMemoryAccess::registerSignalHandler();
+    return std::make_shared<MrfMmapMemoryAccess>(
+        "/proc/self/fd/" + std::to_string(fileDescriptor),
+        settings.memorySize, false);
+#else // SYS_memfd_create
+    throw std::runtime_error("memfd_create is not supported on this system.");
+#endif // SYS_memfd_create
+  } else if (target == "sim") {
+    std::shared_ptr<MrfSimulatedMemoryAccess> device = std::make_shared<
+        MrfSimulatedMemoryAccess>(settings.memorySize);
+    device->setLatency(microsecondsToTime(settings.simulatedLatency),
+        microsecondsToTime(settings.simulatedJitter));
+    return device;
+  } else {
+    throw std::invalid_argument("Invalid target: " + target);
+  }
+}
+
+/**
+ * Prints the throughput and the latency distribution.
+ */
+void printResults(const Settings &settings, Benchmark &benchmark,
+    double elapsedSeconds) {
+  std::vector<std::int64_t> latencies = benchmark.getLatencies();
+  std::sort(latencies.begin(), latencies.end());
+  std::size_t count = latencies.size();
+  std::size_t failures = benchmark.getNumberOfFailures();
+  std::printf("Target:      %s\n", settings.target.c_str());
+  std::printf("Operations:  %zu (%zu failed)\n", count, failures);
+  std::printf("Concurrency: %lu\n", settings.concurrency);
+  std::printf("Elapsed:     %.3f s\n", elapsedSeconds);
+  std::printf("Throughput:  %.1f ops/s\n",
+      elapsedSeconds > 0.0 ? count / elapsedSeconds : 0.0);
+  if (count == 0) {
+    return;
+  }
+  auto percentile = [&latencies, count](double fraction) {
+    std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * count));
+    return latencies[std::min(count - 1, rank > 0 ? rank - 1 : 0)] / 1000.0;
+  };
+  double sum = 0.0;
+  for (auto latency : latencies) {
+    sum += latency;
+  }
+  std::printf(
+      "Latency:     min %.1f us, mean %.1f us, p50 %.1f us, p99 %.1f us, "
+      "p999 %.1f us, max %.1f us\n", latencies.front() / 1000.0,
+      sum / count / 1000.0, percentile(0.5), percentile(0.99),
+      percentile(0.999), latencies.back() / 1000.0);
+  // We use buckets that double in size, which gives a useful overview for
+  // latencies that range from microseconds to seconds.
+  std::vector<std::size_t> buckets;
+  for (auto latency : latencies) {
+    std::size_t bucket = 0;
+    for (std::int64_t limit = 1000; latency >= limit && bucket < 40;
+        limit *= 2) {
+      ++bucket;
+    }
+    if (buckets.size() <= bucket) {
+      buckets.resize(bucket + 1);
+    }
+    ++buckets[bucket];
+  }
+  std::printf("Histogram:\n");
+  std::size_t firstBucket = 0;
+  while (buckets[firstBucket] == 0) {
+    ++firstBucket;
+  }
+  for (std::size_t bucket = firstBucket; bucket < buckets.size(); ++bucket) {
+    unsigned long long limit = 1ULL << bucket;
+    int barLength = static_cast<int>(buckets[bucket] * 50 / count);
+    std::printf("  < %8llu us: %8zu %s\n", limit, buckets[bucket],
+        std::string(barLength, '#').c_str());
+  }
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  Settings settings;
+  try {
+    if (!parseArguments(argc, argv, settings)) {
+      return 0;
+    }
+  } catch (std::exception &e) {
+    std::fprintf(stderr, "%s\n\n", e.what());
+    printUsage(argv[0]);
+    return 2;
+  }
+  try {
+    std::shared_ptr<MrfConsistentAsynchronousMemoryAccess> memoryAccess =
+        std::make_shared<MrfConsistentAsynchronousMemoryAccess>(
+            createMemoryAccess(settings));
+    memoryAccess->setWriteCombining(settings.writeCombining);
+    std::mt19937 randomGenerator;
+    if (settings.seedSpecified) {
+      randomGenerator.seed(settings.seed);
+    } else {
+      randomGenerator.seed(std::random_device()());
+    }
+    std::uint32_t width = settings.use32Bit ? 4 : 2;
+    std::uint32_t numberOfRegisters = (settings.rangeEnd - settings.rangeStart)
+        / width;
+    std::uniform_int_distribution<std::uint32_t> registerDistribution(0,
+        numberOfRegisters - 1);
+    std::uniform_int_distribution<unsigned long> kindDistribution(0,
+        settings.readWeight + settings.writeWeight + settings.updateWeight
+            - 1);
+    std::uniform_int_distribution<std::uint32_t> valueDistribution;
+    Benchmark benchmark(settings.numberOfOperations, settings.concurrency);
+    Clock::time_point startTime = Clock::now();
+    for (std::size_t i = 0; i < settings.numberOfOperations; ++i) {
+      std::uint32_t registerIndex =
+          settings.randomPattern ?
+              registerDistribution(randomGenerator) : i % numberOfRegisters;
+      std::uint32_t address = settings.rangeStart + registerIndex * width;
+      unsigned long kindNumber = kindDistribution(randomGenerator);
+      OperationKind kind =
+          kindNumber < settings.readWeight ? OperationKind::read :
+          kindNumber < settings.readWeight + settings.writeWeight ?
+              OperationKind::write : OperationKind::update;
+      std::uint32_t value = valueDistribution(randomGenerator);
+      std::uint32_t mask = valueDistribution(randomGenerator);
+      benchmark.acquireSlot();
+      if (settings.use32Bit) {
+        auto callback = std::make_shared<BenchmarkCallback<std::uint32_t>>(
+            benchmark, i);
+        switch (kind) {
+        case OperationKind::read:
+          memoryAccess->readUInt32(address, callback);
+          break;
+        case OperationKind::write:
+          memoryAccess->writeUInt32(address, value, callback);
+          break;
+        case OperationKind::update:
+          memoryAccess->writeUInt32(address, value, mask, callback);
+          break;
+        }
+      } else {
+        auto callback = std::make_shared<BenchmarkCallback<std::uint16_t>>(
+            benchmark, i);
+        switch (kind) {
+        case OperationKind::read:
+          memoryAccess->readUInt16(address, callback);
+          break;
+        case OperationKind::write:
+          memoryAccess->writeUInt16(address,
+              static_cast<std::uint16_t>(value), callback);
+          break;
+        case OperationKind::update:
+          memoryAccess->writeUInt16(address,
+              static_cast<std::uint16_t>(value),
+              static_cast<std::uint16_t>(mask), callback);
+          break;
+        }
+      }
+    }
+    benchmark.waitForCompletion();
+    double elapsedSeconds = std::chrono::duration<double>(
+        Clock::now() - startTime).count();
+    printResults(settings, benchmark, elapsedSeconds);
+  } catch (std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
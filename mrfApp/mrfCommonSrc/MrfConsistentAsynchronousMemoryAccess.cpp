@@ -27,6 +27,8 @@
  * of the GNU LGPL version 3 or newer.
  */
 
+#include <thread>
+
 #include "MrfConsistentAsynchronousMemoryAccess.h"
 
 namespace anka {
@@ -34,12 +36,80 @@ namespace mrf {
 
 MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::Impl(
     MrfMemoryAccess &delegate) :
-    delegate(delegate) {
+    delegate(delegate), shadowMirror(false) {
 }
 
 MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::Impl(
     std::shared_ptr<MrfMemoryAccess> delegate) :
-    delegate(*delegate), delegatePtr(delegate) {
+    delegate(*delegate), delegatePtr(delegate), shadowMirror(false) {
+}
+
+std::uint16_t MrfConsistentAsynchronousMemoryAccess::Impl::readUInt16(
+    std::uint32_t address) {
+  reads.increment();
+  if (!shadowMirror) {
+    return delegate.readUInt16(address);
+  }
+  ShadowSnapshot snapshot;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    snapshot = takeShadowSnapshot(address, 2);
+  }
+  std::uint16_t value = delegate.readUInt16(address);
+  recordShadowIfUnchanged(address, 2, value, snapshot);
+  return value;
+}
+
+std::uint32_t MrfConsistentAsynchronousMemoryAccess::Impl::readUInt32(
+    std::uint32_t address) {
+  reads.increment();
+  if (!shadowMirror) {
+    return delegate.readUInt32(address);
+  }
+  ShadowSnapshot snapshot;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    snapshot = takeShadowSnapshot(address, 4);
+  }
+  std::uint32_t value = delegate.readUInt32(address);
+  recordShadowIfUnchanged(address, 4, value, snapshot);
+  return value;
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::readUInt16(
+    std::uint32_t address, std::shared_ptr<CallbackUInt16> callback) {
+  reads.increment();
+  if (!shadowMirror) {
+    delegate.readUInt16(address, callback);
+    return;
+  }
+  std::shared_ptr<ShadowReadCallback<std::uint16_t>> wrappingCallback =
+      std::make_shared<ShadowReadCallback<std::uint16_t>>();
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    wrappingCallback->snapshot = takeShadowSnapshot(address, 2);
+  }
+  wrappingCallback->impl = shared_from_this();
+  wrappingCallback->delegate = callback;
+  delegate.readUInt16(address, wrappingCallback);
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::readUInt32(
+    std::uint32_t address, std::shared_ptr<CallbackUInt32> callback) {
+  reads.increment();
+  if (!shadowMirror) {
+    delegate.readUInt32(address, callback);
+    return;
+  }
+  std::shared_ptr<ShadowReadCallback<std::uint32_t>> wrappingCallback =
+      std::make_shared<ShadowReadCallback<std::uint32_t>>();
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    wrappingCallback->snapshot = takeShadowSnapshot(address, 4);
+  }
+  wrappingCallback->impl = shared_from_this();
+  wrappingCallback->delegate = callback;
+  delegate.readUInt32(address, wrappingCallback);
 }
 
 void MrfConsistentAsynchronousMemoryAccess::Impl::writeUInt16(
@@ -47,11 +117,24 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::writeUInt16(
     std::shared_ptr<CallbackUInt16> callback) {
   bool canRun;
   OperationInfo info;
+  writes.increment();
   info.type = OperationType::writeUInt16;
+  info.startTime = std::chrono::steady_clock::now();
   info.address = address;
   // We have to hold the mutex while operating on the internal data structures.
   {
     std::lock_guard<std::recursive_mutex> lock(mutex);
+    // If there is a write to the same register that is still waiting, we
+    // replace its value instead of queuing another write.
+    unsigned long pendingId;
+    if (writeCombining && findCombinableWrite(info, pendingId)) {
+      auto &callbackAndValue = writeUInt16CallbacksAndValues.at(pendingId);
+      std::static_pointer_cast<WriteCallback<std::uint16_t>>(
+          callbackAndValue.first)->combinedDelegates.push_back(callback);
+      callbackAndValue.second = value;
+      combinedWrites.increment();
+      return;
+    }
     info.id = nextId;
     ++nextId;
     std::shared_ptr<WriteCallback<std::uint16_t>> wrappingCallback =
@@ -80,11 +163,24 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::writeUInt32(
     std::shared_ptr<CallbackUInt32> callback) {
   bool canRun;
   OperationInfo info;
+  writes.increment();
   info.type = OperationType::writeUInt32;
+  info.startTime = std::chrono::steady_clock::now();
   info.address = address;
   // We have to hold the mutex while operating on the internal data structures.
   {
     std::lock_guard<std::recursive_mutex> lock(mutex);
+    // If there is a write to the same register that is still waiting, we
+    // replace its value instead of queuing another write.
+    unsigned long pendingId;
+    if (writeCombining && findCombinableWrite(info, pendingId)) {
+      auto &callbackAndValue = writeUInt32CallbacksAndValues.at(pendingId);
+      std::static_pointer_cast<WriteCallback<std::uint32_t>>(
+          callbackAndValue.first)->combinedDelegates.push_back(callback);
+      callbackAndValue.second = value;
+      combinedWrites.increment();
+      return;
+    }
     info.id = nextId;
     ++nextId;
     std::shared_ptr<WriteCallback<std::uint32_t>> wrappingCallback =
@@ -112,11 +208,24 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::updateUInt16(
     std::uint32_t address, std::shared_ptr<UpdatingCallbackUInt16> callback) {
   bool canRun;
   OperationInfo info;
+  updates.increment();
   info.type = OperationType::updateUInt16;
+  info.startTime = std::chrono::steady_clock::now();
   info.address = address;
   // We have to hold the mutex while operating on the internal data structures.
   {
     std::lock_guard<std::recursive_mutex> lock(mutex);
+    // If there is an update of the same register that is still waiting, we
+    // add our callback to it, so that both updates are applied with a single
+    // read and write.
+    unsigned long pendingId;
+    if (writeCombining && findCombinableWrite(info, pendingId)) {
+      std::static_pointer_cast<UpdateCallback<std::uint16_t>>(
+          updateUInt16Callbacks.at(pendingId))->combinedDelegates.push_back(
+          callback);
+      combinedUpdates.increment();
+      return;
+    }
     info.id = nextId;
     ++nextId;
     std::shared_ptr<UpdateCallback<std::uint16_t>> wrappingCallback =
@@ -143,11 +252,24 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::updateUInt32(
     std::uint32_t address, std::shared_ptr<UpdatingCallbackUInt32> callback) {
   bool canRun;
   OperationInfo info;
+  updates.increment();
   info.type = OperationType::updateUInt32;
+  info.startTime = std::chrono::steady_clock::now();
   info.address = address;
   // We have to hold the mutex while operating on the internal data structures.
   {
     std::lock_guard<std::recursive_mutex> lock(mutex);
+    // If there is an update of the same register that is still waiting, we
+    // add our callback to it, so that both updates are applied with a single
+    // read and write.
+    unsigned long pendingId;
+    if (writeCombining && findCombinableWrite(info, pendingId)) {
+      std::static_pointer_cast<UpdateCallback<std::uint32_t>>(
+          updateUInt32Callbacks.at(pendingId))->combinedDelegates.push_back(
+          callback);
+      combinedUpdates.increment();
+      return;
+    }
     info.id = nextId;
     ++nextId;
     std::shared_ptr<UpdateCallback<std::uint32_t>> wrappingCallback =
@@ -170,22 +292,209 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::updateUInt32(
   }
 }
 
+void MrfConsistentAsynchronousMemoryAccess::Impl::writeUInt16Block(
+    std::uint32_t address, std::vector<std::uint16_t> &&values,
+    std::uint32_t stride, std::shared_ptr<BlockCallbackUInt16> callback) {
+  bool canRun;
+  OperationInfo info;
+  blockWrites.increment();
+  info.type = OperationType::writeUInt16Block;
+  info.startTime = std::chrono::steady_clock::now();
+  info.address = address;
+  info.count = values.size();
+  info.stride = stride;
+  // We have to hold the mutex while operating on the internal data structures.
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    info.id = nextId;
+    ++nextId;
+    std::shared_ptr<BlockWriteCallback<std::uint16_t>> wrappingCallback =
+        std::make_shared<BlockWriteCallback<std::uint16_t>>();
+    wrappingCallback->operationInfo = info;
+    wrappingCallback->impl = shared_from_this();
+    wrappingCallback->delegate = callback;
+    writeUInt16BlockCallbacksAndValues.insert(
+        std::make_pair(info.id,
+            std::make_pair(wrappingCallback, std::move(values))));
+    canRun = canRunOperation(info);
+    if (canRun) {
+      markRunOperation(info);
+    } else {
+      insertOperationInfo(info);
+    }
+  }
+  // We do not want to hold the mutex when processing the operations because we
+  // want to avoid possible dead locks.
+  if (canRun) {
+    runOperation(info);
+  }
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::writeUInt32Block(
+    std::uint32_t address, std::vector<std::uint32_t> &&values,
+    std::uint32_t stride, std::shared_ptr<BlockCallbackUInt32> callback) {
+  bool canRun;
+  OperationInfo info;
+  blockWrites.increment();
+  info.type = OperationType::writeUInt32Block;
+  info.startTime = std::chrono::steady_clock::now();
+  info.address = address;
+  info.count = values.size();
+  info.stride = stride;
+  // We have to hold the mutex while operating on the internal data structures.
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    info.id = nextId;
+    ++nextId;
+    std::shared_ptr<BlockWriteCallback<std::uint32_t>> wrappingCallback =
+        std::make_shared<BlockWriteCallback<std::uint32_t>>();
+    wrappingCallback->operationInfo = info;
+    wrappingCallback->impl = shared_from_this();
+    wrappingCallback->delegate = callback;
+    writeUInt32BlockCallbacksAndValues.insert(
+        std::make_pair(info.id,
+            std::make_pair(wrappingCallback, std::move(values))));
+    canRun = canRunOperation(info);
+    if (canRun) {
+      markRunOperation(info);
+    } else {
+      insertOperationInfo(info);
+    }
+  }
+  // We do not want to hold the mutex when processing the operations because we
+  // want to avoid possible dead locks.
+  if (canRun) {
+    runOperation(info);
+  }
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::setWriteCombining(
+    bool enabled) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  writeCombining = enabled;
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::setShadowMirror(
+    bool enabled) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if (enabled == shadowMirror) {
+    return;
+  }
+  // Read operations that were started before the shadow mirror was disabled
+  // and finish after it has been enabled again must not put their values into
+  // the shadow mirror because the generations have not been maintained in
+  // between. Incrementing the epoch invalidates their snapshots.
+  ++shadowEpoch;
+  shadow.clear();
+  shadowGenerations.clear();
+  shadowMirror = enabled;
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::excludeFromShadowMirror(
+    std::uint32_t address) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  shadowExcluded.insert(address);
+  shadow.erase(address);
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::setShadowRevalidationInterval(
+    std::chrono::steady_clock::duration interval) {
+  std::lock_guard<std::mutex> lock(revalidationMutex);
+  if (interval < std::chrono::steady_clock::duration::zero()) {
+    interval = std::chrono::steady_clock::duration::zero();
+  }
+  revalidationInterval = interval;
+  // The thread is only started when it is needed for the first time. It keeps
+  // this object alive until it is stopped, so it is detached instead of being
+  // joined.
+  if (!revalidationThreadRunning && !revalidationStopped
+      && interval != std::chrono::steady_clock::duration::zero()) {
+    std::shared_ptr<Impl> impl = shared_from_this();
+    std::thread([impl]() {impl->runShadowRevalidation();}).detach();
+    revalidationThreadRunning = true;
+  }
+  revalidationCondition.notify_all();
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::stopShadowRevalidation() {
+  std::lock_guard<std::mutex> lock(revalidationMutex);
+  revalidationStopped = true;
+  revalidationCondition.notify_all();
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::collectStatistics(
+    MrfStatistics &statistics) {
+  statistics.addCounter("consistent.reads", reads.get());
+  statistics.addCounter("consistent.writes", writes.get());
+  statistics.addCounter("consistent.updates", updates.get());
+  statistics.addCounter("consistent.blockReads", blockReads.get());
+  statistics.addCounter("consistent.blockWrites", blockWrites.get());
+  statistics.addCounter("consistent.combinedWrites", combinedWrites.get());
+  statistics.addCounter("consistent.combinedUpdates", combinedUpdates.get());
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    statistics.addCounter("consistent.waitingOperations", waitingOperations);
+  }
+  statistics.addCounter("consistent.waitingOperationsHighWater",
+      waitingOperationsHighWater.get());
+  statistics.addHistogram("consistent.writeLatency", writeLatency);
+  statistics.addHistogram("consistent.updateLatency", updateLatency);
+  statistics.addCounter("consistent.shadowHits", shadowHits.get());
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    statistics.addCounter("consistent.shadowRegisters", shadow.size());
+  }
+  statistics.addCounter("consistent.shadowRevalidations",
+      shadowRevalidations.get());
+  statistics.addCounter("consistent.shadowMismatches",
+      shadowMismatches.get());
+  delegate.collectStatistics(statistics);
+}
+
+bool MrfConsistentAsynchronousMemoryAccess::Impl::findCombinableWrite(
+    const OperationInfo &operationInfo, unsigned long &pendingId) {
+  // A write (or update) can only be combined with a waiting operation of the
+  // same type and address, and only if that write is the most recent operation waiting for
+  // each of the affected bytes. Otherwise, we would change the order of the
+  // operations affecting these bytes.
+  bool found = false;
+  return operationInfo.forEachByte(
+      [this, &operationInfo, &pendingId, &found](std::uint32_t address) {
+        auto range = pendingOperations.equal_range(address);
+        const OperationInfo *mostRecent = nullptr;
+        for (auto iterator = range.first; iterator != range.second;
+            ++iterator) {
+          if (!mostRecent || iterator->second.id > mostRecent->id) {
+            mostRecent = &iterator->second;
+          }
+        }
+        if (!mostRecent || mostRecent->type != operationInfo.type
+            || mostRecent->address != operationInfo.address) {
+          return false;
+        }
+        if (found) {
+          return mostRecent->id == pendingId;
+        }
+        pendingId = mostRecent->id;
+        found = true;
+        return true;
+      });
+}
+
 void MrfConsistentAsynchronousMemoryAccess::Impl::insertOperationInfo(
     const OperationInfo &operationInfo) {
-  std::uint32_t address = operationInfo.address;
-  std::uint32_t width = operationInfo.width();
-  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
-    pendingOperations.insert(
-        std::make_pair(address + byteIndex, operationInfo));
-  }
+  operationInfo.forEachByte([this, &operationInfo](std::uint32_t address) {
+    pendingOperations.insert(std::make_pair(address, operationInfo));
+    return true;
+  });
+  ++waitingOperations;
+  waitingOperationsHighWater.updateMaximum(waitingOperations);
 }
 
 void MrfConsistentAsynchronousMemoryAccess::Impl::removeOperationInfo(
     const OperationInfo &operationInfo) {
-  std::uint32_t address = operationInfo.address;
-  std::uint32_t width = operationInfo.width();
-  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
-    auto range = pendingOperations.equal_range(address + byteIndex);
+  operationInfo.forEachByte([this, &operationInfo](std::uint32_t address) {
+    auto range = pendingOperations.equal_range(address);
     for (auto iterator = range.first; iterator != range.second; iterator++) {
       if (iterator->second.id == operationInfo.id) {
         pendingOperations.erase(iterator);
@@ -194,30 +503,43 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::removeOperationInfo(
         break;
       }
     }
-  }
+    return true;
+  });
+  --waitingOperations;
 }
 
 std::forward_list<MrfConsistentAsynchronousMemoryAccess::Impl::OperationInfo> MrfConsistentAsynchronousMemoryAccess::Impl::prepareNextOperations(
     const OperationInfo &operationInfo) {
   std::forward_list<OperationInfo> runnableOperations;
-  std::uint32_t address = operationInfo.address;
-  std::uint32_t width = operationInfo.width();
-  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
-    auto range = pendingOperations.equal_range(address + byteIndex);
-    for (auto operationIterator = range.first;
-        operationIterator != range.second; ++operationIterator) {
-      OperationInfo &pendingOperationInfo = operationIterator->second;
-      if (canRunOperation(pendingOperationInfo)) {
-        markRunOperation(pendingOperationInfo);
-        runnableOperations.push_front(pendingOperationInfo);
-        removeOperationInfo(pendingOperationInfo);
-        // We can stop looking for pending operations at the current address
-        // because we know that the current address is now in use. Due to the
-        // remove operation, the operationIterator has become invalid anyway.
-        break;
-      }
-    }
-  }
+  operationInfo.forEachByte(
+      [this, &runnableOperations](std::uint32_t address) {
+        // The operations waiting for the same address have to be run in the
+        // order in which they were queued. The multimap does not preserve
+        // this order, so we look for the operation with the lowest ID. If
+        // this operation cannot run yet, the operations queued after it have
+        // to wait as well.
+        auto range = pendingOperations.equal_range(address);
+        auto oldestIterator = range.second;
+        for (auto operationIterator = range.first;
+            operationIterator != range.second; ++operationIterator) {
+          if (oldestIterator == range.second
+              || operationIterator->second.id < oldestIterator->second.id) {
+            oldestIterator = operationIterator;
+          }
+        }
+        if (oldestIterator == range.second) {
+          return true;
+        }
+        // We have to copy the operation info because the remove operation
+        // invalidates the iterator.
+        OperationInfo pendingOperationInfo = oldestIterator->second;
+        if (canRunOperation(pendingOperationInfo)) {
+          markRunOperation(pendingOperationInfo);
+          runnableOperations.push_front(pendingOperationInfo);
+          removeOperationInfo(pendingOperationInfo);
+        }
+        return true;
+      });
   return runnableOperations;
 }
 
@@ -227,8 +549,12 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::runOperation(
   case OperationType::writeUInt16: {
     std::shared_ptr<CallbackUInt16> callback;
     std::uint16_t value;
-    std::tie(callback, value) = writeUInt16CallbacksAndValues.at(
-        operationInfo.id);
+    // We have to hold the mutex while accessing the map.
+    {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      std::tie(callback, value) = writeUInt16CallbacksAndValues.at(
+          operationInfo.id);
+    }
     // We have to catch exceptions and call the failure callback to make sure
     // that things get cleaned up.
     try {
@@ -255,8 +581,12 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::runOperation(
   case OperationType::writeUInt32: {
     std::shared_ptr<CallbackUInt32> callback;
     std::uint32_t value;
-    std::tie(callback, value) = writeUInt32CallbacksAndValues.at(
-        operationInfo.id);
+    // We have to hold the mutex while accessing the map.
+    {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      std::tie(callback, value) = writeUInt32CallbacksAndValues.at(
+          operationInfo.id);
+    }
     // We have to catch exceptions and call the failure callback to make sure
     // that things get cleaned up.
     try {
@@ -281,8 +611,20 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::runOperation(
     break;
   }
   case OperationType::updateUInt16: {
-    std::shared_ptr<CallbackUInt16> callback = updateUInt16Callbacks.at(
-        operationInfo.id);
+    std::shared_ptr<CallbackUInt16> callback;
+    // We have to hold the mutex while accessing the map.
+    {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      callback = updateUInt16Callbacks.at(operationInfo.id);
+    }
+    // If the register's value is known from the shadow mirror, we can skip the
+    // read. The callback catches all exceptions, so we do not have to.
+    std::uint32_t shadowValue;
+    if (lookupShadow(operationInfo.address, 2, shadowValue)) {
+      callback->success(operationInfo.address,
+          static_cast<std::uint16_t>(shadowValue));
+      break;
+    }
     // We have to catch exceptions and call the failure callback to make sure
     // that things get cleaned up.
     try {
@@ -307,8 +649,20 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::runOperation(
     break;
   }
   case OperationType::updateUInt32: {
-    std::shared_ptr<CallbackUInt32> callback = updateUInt32Callbacks.at(
-        operationInfo.id);
+    std::shared_ptr<CallbackUInt32> callback;
+    // We have to hold the mutex while accessing the map.
+    {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      callback = updateUInt32Callbacks.at(operationInfo.id);
+    }
+    // If the register's value is known from the shadow mirror, we can skip the
+    // read. The callback catches all exceptions, so we do not have to.
+    std::uint32_t shadowValue;
+    if (lookupShadow(operationInfo.address, 4, shadowValue)) {
+      callback->success(operationInfo.address,
+          static_cast<std::uint32_t>(shadowValue));
+      break;
+    }
     // We have to catch exceptions and call the failure callback to make sure
     // that things get cleaned up.
     try {
@@ -332,39 +686,114 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::runOperation(
     }
     break;
   }
+  case OperationType::writeUInt16Block: {
+    std::shared_ptr<BlockCallbackUInt16> callback;
+    std::vector<std::uint16_t> values;
+    // The values are not needed any longer after starting the operation, so we
+    // move them instead of copying them. We have to hold the mutex while
+    // accessing the map.
+    {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      auto &callbackAndValues = writeUInt16BlockCallbacksAndValues.at(
+          operationInfo.id);
+      callback = callbackAndValues.first;
+      values = std::move(callbackAndValues.second);
+    }
+    // We have to catch exceptions and call the failure callback to make sure
+    // that things get cleaned up.
+    try {
+      delegate.writeUInt16Block(operationInfo.address, std::move(values),
+          operationInfo.stride, callback);
+    } catch (std::exception &e) {
+      try {
+        callback->failure(operationInfo.address, ErrorCode::unknown,
+            std::string("The write operation failed: ") + e.what());
+      } catch (...) {
+        // The callback itself might also throw. We simply ignore such an
+        // exception
+      }
+    } catch (...) {
+      try {
+        callback->failure(operationInfo.address, ErrorCode::unknown,
+            std::string("The write operation failed."));
+      } catch (...) {
+        // The callback itself might also throw. We simply ignore such an
+        // exception
+      }
+    }
+    break;
+  }
+  case OperationType::writeUInt32Block: {
+    std::shared_ptr<BlockCallbackUInt32> callback;
+    std::vector<std::uint32_t> values;
+    // The values are not needed any longer after starting the operation, so we
+    // move them instead of copying them. We have to hold the mutex while
+    // accessing the map.
+    {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      auto &callbackAndValues = writeUInt32BlockCallbacksAndValues.at(
+          operationInfo.id);
+      callback = callbackAndValues.first;
+      values = std::move(callbackAndValues.second);
+    }
+    // We have to catch exceptions and call the failure callback to make sure
+    // that things get cleaned up.
+    try {
+      delegate.writeUInt32Block(operationInfo.address, std::move(values),
+          operationInfo.stride, callback);
+    } catch (std::exception &e) {
+      try {
+        callback->failure(operationInfo.address, ErrorCode::unknown,
+            std::string("The write operation failed: ") + e.what());
+      } catch (...) {
+        // The callback itself might also throw. We simply ignore such an
+        // exception
+      }
+    } catch (...) {
+      try {
+        callback->failure(operationInfo.address, ErrorCode::unknown,
+            std::string("The write operation failed."));
+      } catch (...) {
+        // The callback itself might also throw. We simply ignore such an
+        // exception
+      }
+    }
+    break;
+  }
   }
 }
 
 bool MrfConsistentAsynchronousMemoryAccess::Impl::canRunOperation(
     const OperationInfo &operationInfo) {
-  std::uint32_t address = operationInfo.address;
-  std::uint32_t width = operationInfo.width();
-  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
-    if (operationRunning.count(address + byteIndex)) {
-      // There is another operation running that overlaps with the
-      // requested operation.
-      return false;
-    }
-  }
-  return true;
+  // If there is another operation running that overlaps with the requested
+  // operation, the iteration is stopped and false is returned.
+  return operationInfo.forEachByte([this](std::uint32_t address) {
+    return operationRunning.count(address) == 0;
+  });
 }
 
 void MrfConsistentAsynchronousMemoryAccess::Impl::markRunOperation(
     const OperationInfo &operationInfo) {
-  std::uint32_t address = operationInfo.address;
-  std::uint32_t width = operationInfo.width();
-  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
-    operationRunning.insert(address + byteIndex);
-  }
+  bool shadowEnabled = shadowMirror;
+  operationInfo.forEachByte([this, shadowEnabled](std::uint32_t address) {
+    operationRunning.insert(address);
+    if (shadowEnabled) {
+      ++shadowGenerations[address];
+    }
+    return true;
+  });
 }
 
 void MrfConsistentAsynchronousMemoryAccess::Impl::unmarkRunOperation(
     const OperationInfo &operationInfo) {
-  std::uint32_t address = operationInfo.address;
-  std::uint32_t width = operationInfo.width();
-  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
-    operationRunning.erase(address + byteIndex);
-  }
+  bool shadowEnabled = shadowMirror;
+  operationInfo.forEachByte([this, shadowEnabled](std::uint32_t address) {
+    operationRunning.erase(address);
+    if (shadowEnabled) {
+      ++shadowGenerations[address];
+    }
+    return true;
+  });
 }
 
 void MrfConsistentAsynchronousMemoryAccess::Impl::operationFinished(
@@ -374,6 +803,13 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::operationFinished(
   {
     std::lock_guard<std::recursive_mutex> lock(mutex);
     unmarkRunOperation(operationInfo);
+    auto latency = std::chrono::steady_clock::now() - operationInfo.startTime;
+    if (operationInfo.type == OperationType::updateUInt16
+        || operationInfo.type == OperationType::updateUInt32) {
+      updateLatency.record(latency);
+    } else {
+      writeLatency.record(latency);
+    }
     switch (operationInfo.type) {
     case OperationType::writeUInt16:
       writeUInt16CallbacksAndValues.erase(operationInfo.id);
@@ -387,6 +823,12 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::operationFinished(
     case OperationType::updateUInt32:
       updateUInt32Callbacks.erase(operationInfo.id);
       break;
+    case OperationType::writeUInt16Block:
+      writeUInt16BlockCallbacksAndValues.erase(operationInfo.id);
+      break;
+    case OperationType::writeUInt32Block:
+      writeUInt32BlockCallbacksAndValues.erase(operationInfo.id);
+      break;
     }
     runnableOperations = prepareNextOperations(operationInfo);
   }
@@ -398,5 +840,190 @@ void MrfConsistentAsynchronousMemoryAccess::Impl::operationFinished(
   }
 }
 
+bool MrfConsistentAsynchronousMemoryAccess::Impl::lookupShadow(
+    std::uint32_t address, std::uint32_t width, std::uint32_t &value) {
+  if (!shadowMirror) {
+    return false;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  auto entry = shadow.find(address);
+  if (entry == shadow.end() || entry->second.width != width) {
+    return false;
+  }
+  value = entry->second.value;
+  shadowHits.increment();
+  return true;
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::recordShadow(
+    std::uint32_t address, std::uint32_t width, std::uint32_t value) {
+  if (!shadowMirror) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  storeShadow(address, width, value);
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::recordShadowIfUnchanged(
+    std::uint32_t address, std::uint32_t width, std::uint32_t value,
+    const ShadowSnapshot &snapshot) {
+  if (!shadowMirror) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if (isShadowSnapshotValid(snapshot, address, width)) {
+    storeShadow(address, width, value);
+  }
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::forgetShadow(
+    const OperationInfo &operationInfo) {
+  if (!shadowMirror) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  for (std::size_t index = 0; index < operationInfo.count; ++index) {
+    eraseShadow(operationInfo.address + index * operationInfo.stride,
+        operationInfo.width());
+  }
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::storeShadow(
+    std::uint32_t address, std::uint32_t width, std::uint32_t value) {
+  if (!shadowMirror || shadowExcluded.count(address)) {
+    return;
+  }
+  // An entry for a register of a different width that overlaps with this
+  // register would be stale now.
+  eraseShadow(address, width);
+  shadow[address] = ShadowEntry {value, width};
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::eraseShadow(
+    std::uint32_t address, std::uint32_t width) {
+  // Registers are at most four bytes wide, so an entry that overlaps with the
+  // specified register cannot start more than three bytes before it.
+  std::uint32_t firstAddress = (address < 3) ? 0 : (address - 3);
+  for (std::uint32_t entryAddress = firstAddress;
+      entryAddress < address + width; ++entryAddress) {
+    auto entry = shadow.find(entryAddress);
+    if (entry != shadow.end()
+        && entryAddress + entry->second.width > address) {
+      shadow.erase(entry);
+    }
+  }
+}
+
+MrfConsistentAsynchronousMemoryAccess::Impl::ShadowSnapshot MrfConsistentAsynchronousMemoryAccess::Impl::takeShadowSnapshot(
+    std::uint32_t address, std::uint32_t width) {
+  // The generations only ever increase, so their sum only stays the same if
+  // none of them has changed.
+  ShadowSnapshot snapshot;
+  snapshot.epoch = shadowEpoch;
+  snapshot.generation = 0;
+  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
+    auto generation = shadowGenerations.find(address + byteIndex);
+    if (generation != shadowGenerations.end()) {
+      snapshot.generation += generation->second;
+    }
+  }
+  return snapshot;
+}
+
+bool MrfConsistentAsynchronousMemoryAccess::Impl::isShadowSnapshotValid(
+    const ShadowSnapshot &snapshot, std::uint32_t address,
+    std::uint32_t width) {
+  if (!shadowMirror) {
+    return false;
+  }
+  // If a write or update operation is running, the value read might be the
+  // one from before or after that operation, so we cannot use it.
+  for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
+    if (operationRunning.count(address + byteIndex)) {
+      return false;
+    }
+  }
+  ShadowSnapshot currentSnapshot = takeShadowSnapshot(address, width);
+  return snapshot.epoch == currentSnapshot.epoch
+      && snapshot.generation == currentSnapshot.generation;
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::runShadowRevalidation() {
+  std::unique_lock<std::mutex> lock(revalidationMutex);
+  auto lastRun = std::chrono::steady_clock::now();
+  while (!revalidationStopped) {
+    if (revalidationInterval == std::chrono::steady_clock::duration::zero()) {
+      revalidationCondition.wait(lock);
+      lastRun = std::chrono::steady_clock::now();
+      continue;
+    }
+    auto nextRun = lastRun + revalidationInterval;
+    if (std::chrono::steady_clock::now() < nextRun) {
+      revalidationCondition.wait_until(lock, nextRun);
+      continue;
+    }
+    lock.unlock();
+    try {
+      revalidateShadow();
+    } catch (...) {
+      // We do not want the thread to terminate because of an exception. The
+      // next run might succeed.
+    }
+    lock.lock();
+    lastRun = std::chrono::steady_clock::now();
+  }
+  revalidationThreadRunning = false;
+}
+
+void MrfConsistentAsynchronousMemoryAccess::Impl::revalidateShadow() {
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> registers;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    registers.reserve(shadow.size());
+    for (auto &entry : shadow) {
+      registers.push_back(std::make_pair(entry.first, entry.second.width));
+    }
+  }
+  for (auto &addressAndWidth : registers) {
+    std::uint32_t address = addressAndWidth.first;
+    std::uint32_t width = addressAndWidth.second;
+    ShadowSnapshot snapshot;
+    {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      snapshot = takeShadowSnapshot(address, width);
+    }
+    std::uint32_t value;
+    bool readSucceeded = true;
+    try {
+      if (width == 2) {
+        value = delegate.readUInt16(address);
+      } else {
+        value = delegate.readUInt32(address);
+      }
+    } catch (...) {
+      readSucceeded = false;
+    }
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (!isShadowSnapshotValid(snapshot, address, width)) {
+      continue;
+    }
+    auto entry = shadow.find(address);
+    if (entry == shadow.end() || entry->second.width != width) {
+      continue;
+    }
+    // If the register cannot be read, we cannot be sure that the value in the
+    // shadow mirror is still correct.
+    if (!readSucceeded) {
+      shadow.erase(entry);
+      continue;
+    }
+    shadowRevalidations.increment();
+    if (entry->second.value != value) {
+      shadowMismatches.increment();
+      entry->second.value = value;
+    }
+  }
+}
+
 }
 }
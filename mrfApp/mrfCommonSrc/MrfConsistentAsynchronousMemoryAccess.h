@@ -30,11 +30,15 @@
 #ifndef ANKA_MRF_CONSISTENT_ASYNCHRONOUS_MEMORY_ACCESS_H
 #define ANKA_MRF_CONSISTENT_ASYNCHRONOUS_MEMORY_ACCESS_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <forward_list>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "MrfConsistentMemoryAccess.h"
 
@@ -50,6 +54,11 @@ namespace mrf {
  * implementations where a write operation might block. It can also be used with
  * synchronous memory-access implementations, but a different implementation
  * might be more efficient.
+ *
+ * Optionally, this memory access keeps a shadow mirror of the registers that it
+ * has read or written, so that update operations (which are used for masked
+ * writes) can be processed without reading the register first (see
+ * {@link setShadowMirror(bool)}).
  */
 class MrfConsistentAsynchronousMemoryAccess: public MrfConsistentMemoryAccess {
 
@@ -76,6 +85,15 @@ public:
       impl(std::make_shared<Impl>(delegate)) {
   }
 
+  /**
+   * Destroys this memory access. Operations that are still queued are finished
+   * asynchronously. The background re-validation of the shadow mirror (if
+   * enabled) is stopped.
+   */
+  ~MrfConsistentAsynchronousMemoryAccess() {
+    impl->stopShadowRevalidation();
+  }
+
   /**
    * Reads from an unsigned 16-bit register. The method blocks until the
    * operation has finished (either successfully or unsuccessfully). On success,
@@ -84,7 +102,7 @@ public:
    * memory access which has been passed to the constructor.
    */
   inline std::uint16_t readUInt16(std::uint32_t address) {
-    return impl->delegate.readUInt16(address);
+    return impl->readUInt16(address);
   }
 
   /**
@@ -112,7 +130,7 @@ public:
    */
   inline void readUInt16(std::uint32_t address,
       std::shared_ptr<CallbackUInt16> callback) {
-    impl->delegate.readUInt16(address, callback);
+    impl->readUInt16(address, callback);
   }
 
   /**
@@ -138,7 +156,7 @@ public:
    * memory access which has been passed to the constructor.
    */
   inline std::uint32_t readUInt32(std::uint32_t address) {
-    return impl->delegate.readUInt32(address);
+    return impl->readUInt32(address);
   }
 
   /**
@@ -166,7 +184,7 @@ public:
    */
   inline void readUInt32(std::uint32_t address,
       std::shared_ptr<CallbackUInt32> callback) {
-    impl->delegate.readUInt32(address, callback);
+    impl->readUInt32(address, callback);
   }
 
   /**
@@ -189,7 +207,9 @@ public:
    * value is read, then the callback's update method is called, and finally
    * the updated value is written to the register. Other write or update
    * operations to the same register are blocked until this process has
-   * finished. This method does not block.
+   * finished. This method does not block. If the shadow mirror is enabled and
+   * has an entry for the register, the value from the shadow mirror is used
+   * instead of reading the register.
    */
   inline void updateUInt16(std::uint32_t address,
       std::shared_ptr<UpdatingCallbackUInt16> callback) {
@@ -201,17 +221,146 @@ public:
    * value is read, then the callback's update method is called, and finally
    * the updated value is written to the register. Other write or update
    * operations to the same register are blocked until this process has
-   * finished. This method does not block.
+   * finished. This method does not block. If the shadow mirror is enabled and
+   * has an entry for the register, the value from the shadow mirror is used
+   * instead of reading the register.
    */
   inline void updateUInt32(std::uint32_t address,
       std::shared_ptr<UpdatingCallbackUInt32> callback) {
     return impl->updateUInt32(address, callback);
   }
 
+  /**
+   * Reads from a block of unsigned 16-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been read, the specified callback is called.
+   * This method delegates the read operation to the memory access which has
+   * been passed to the constructor.
+   */
+  inline void readUInt16Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt16> callback) {
+    impl->blockReads.increment();
+    impl->delegate.readUInt16Block(address, count, stride, callback);
+  }
+
+  /**
+   * Writes to a block of unsigned 16-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been written, the specified callback is
+   * called. This method delegates the write operation to the memory access
+   * which has been passed to the constructor. However, the operation is
+   * delayed automatically, if a concurrent update operation to one of the
+   * registers in the block is in progress.
+   */
+  inline void writeUInt16Block(std::uint32_t address,
+      std::vector<std::uint16_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt16> callback) {
+    impl->writeUInt16Block(address, std::move(values), stride, callback);
+  }
+
+  /**
+   * Reads from a block of unsigned 32-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been read, the specified callback is called.
+   * This method delegates the read operation to the memory access which has
+   * been passed to the constructor.
+   */
+  inline void readUInt32Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt32> callback) {
+    impl->blockReads.increment();
+    impl->delegate.readUInt32Block(address, count, stride, callback);
+  }
+
+  /**
+   * Writes to a block of unsigned 32-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been written, the specified callback is
+   * called. This method delegates the write operation to the memory access
+   * which has been passed to the constructor. However, the operation is
+   * delayed automatically, if a concurrent update operation to one of the
+   * registers in the block is in progress.
+   */
+  inline void writeUInt32Block(std::uint32_t address,
+      std::vector<std::uint32_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt32> callback) {
+    impl->writeUInt32Block(address, std::move(values), stride, callback);
+  }
+
+  /**
+   * Enables or disables write combining. When enabled, a write operation that
+   * has to wait for another operation on the same register is combined with a
+   * write of the same size to the same register that is already waiting,
+   * unless another operation affecting that register has been queued in
+   * between. In this case, only the most recent value is written and the
+   * callbacks of all combined operations are notified with the result of that
+   * write. This limits the number of queued operations when a register is
+   * written at a high rate (e.g. by an operator dragging a slider). In the same
+   * way, an update operation (e.g. a masked write) that has to wait is combined
+   * with an update of the same register that is already waiting. The register
+   * is read and written only once, the update methods of the combined
+   * operations being applied in the order in which the operations were queued.
+   * This way, records that write different bits of the same register (e.g.
+   * when restoring settings) only need a single read and write. Write combining
+   * must not be enabled if every single write to a register matters (e.g. for a
+   * register that pushes the written value into a FIFO). Write combining is
+   * disabled by default. This method may be called at any time and is thread
+   * safe.
+   */
+  inline void setWriteCombining(bool enabled) {
+    impl->setWriteCombining(enabled);
+  }
+
+  /**
+   * Enables or disables the shadow mirror. When enabled, this memory access
+   * remembers the last value that it has read from or written to each
+   * register (as reported by the backing memory access). An update operation
+   * (and thus a masked write) for a register that is in the shadow mirror uses
+   * the remembered value instead of reading the register first, saving one
+   * round trip to the device. Values read by concurrent read operations are
+   * only remembered if no write or update operation affecting the register
+   * has run while the read operation was in progress. The shadow mirror must
+   * not be used for registers that are changed by the device itself (e.g.
+   * status registers or registers with self-clearing bits), unless these
+   * registers are excluded by calling {@link excludeFromShadowMirror(
+   * std::uint32_t)}. The shadow mirror is disabled by default. Disabling it
+   * discards all remembered values. This method may be called at any time and
+   * is thread safe.
+   */
+  inline void setShadowMirror(bool enabled) {
+    impl->setShadowMirror(enabled);
+  }
+
+  /**
+   * Excludes the register at the specified address from the shadow mirror.
+   * Update operations for this register always read the register first. The
+   * address must be the one used for accessing the register. This method may
+   * be called at any time and is thread safe.
+   */
+  inline void excludeFromShadowMirror(std::uint32_t address) {
+    impl->excludeFromShadowMirror(address);
+  }
+
+  /**
+   * Sets the interval at which the registers in the shadow mirror are read
+   * again in the background. If a register's value differs from the value in
+   * the shadow mirror, the shadow mirror is corrected and the mismatch is
+   * counted in the "consistent.shadowMismatches" statistic. A zero interval
+   * (the default) disables the background re-validation. This method may be
+   * called at any time and is thread safe.
+   */
+  inline void setShadowRevalidationInterval(
+      std::chrono::steady_clock::duration interval) {
+    impl->setShadowRevalidationInterval(interval);
+  }
+
   // We want the methods from the base class to participate in overload
   // resolution.
+  using MrfConsistentMemoryAccess::readUInt16Block;
+  using MrfConsistentMemoryAccess::readUInt32Block;
   using MrfConsistentMemoryAccess::writeUInt16;
+  using MrfConsistentMemoryAccess::writeUInt16Block;
   using MrfConsistentMemoryAccess::writeUInt32;
+  using MrfConsistentMemoryAccess::writeUInt32Block;
 
   /**
    * Tells whether this memory access supports interrupts. If the memory access
@@ -259,6 +408,35 @@ public:
     return impl->delegate.removeInterruptListener(interruptListener);
   }
 
+  /**
+   * Adds the runtime statistics of this memory access to the specified
+   * statistics object. The names of the statistics added by this memory access
+   * start with "consistent.". The statistics of the backing memory access are
+   * added as well.
+   */
+  void collectStatistics(MrfStatistics &statistics) {
+    impl->collectStatistics(statistics);
+  }
+
+  /**
+   * Tells whether this memory access can record a trace of its operations.
+   * This memory access supports tracing if (and only if) the backing memory
+   * access supports tracing.
+   */
+  inline bool supportsTracing() const {
+    return impl->delegate.supportsTracing();
+  }
+
+  /**
+   * Sets the ring buffer to which the backing memory access adds an entry for
+   * each operation that finishes. The entries describe the operations of the
+   * backing memory access, so the time that an operation waits for a
+   * conflicting operation in this memory access is not included.
+   */
+  inline void setTraceRing(std::shared_ptr<MrfTraceRing> traceRing) {
+    impl->delegate.setTraceRing(traceRing);
+  }
+
 private:
 
   /**
@@ -277,6 +455,16 @@ private:
     MrfMemoryAccess &delegate;
     std::shared_ptr<MrfMemoryAccess> delegatePtr;
 
+    std::uint16_t readUInt16(std::uint32_t address);
+
+    std::uint32_t readUInt32(std::uint32_t address);
+
+    void readUInt16(std::uint32_t address,
+        std::shared_ptr<CallbackUInt16> callback);
+
+    void readUInt32(std::uint32_t address,
+        std::shared_ptr<CallbackUInt32> callback);
+
     void writeUInt16(std::uint32_t address, std::uint16_t value,
         std::shared_ptr<CallbackUInt16> callback);
 
@@ -289,6 +477,31 @@ private:
     void updateUInt32(std::uint32_t address,
         std::shared_ptr<UpdatingCallbackUInt32> callback);
 
+    void writeUInt16Block(std::uint32_t address,
+        std::vector<std::uint16_t> &&values, std::uint32_t stride,
+        std::shared_ptr<BlockCallbackUInt16> callback);
+
+    void writeUInt32Block(std::uint32_t address,
+        std::vector<std::uint32_t> &&values, std::uint32_t stride,
+        std::shared_ptr<BlockCallbackUInt32> callback);
+
+    void setWriteCombining(bool enabled);
+
+    void setShadowMirror(bool enabled);
+
+    void excludeFromShadowMirror(std::uint32_t address);
+
+    void setShadowRevalidationInterval(
+        std::chrono::steady_clock::duration interval);
+
+    void stopShadowRevalidation();
+
+    void collectStatistics(MrfStatistics &statistics);
+
+    // The counter for block read operations is incremented by the surrounding
+    // class because block read operations are passed to the delegate directly.
+    MrfStatisticsCounter blockReads;
+
   private:
 
     /**
@@ -296,52 +509,104 @@ private:
      * do not interfere with update operations.
      */
     enum class OperationType {
-      writeUInt16, writeUInt32, updateUInt16, updateUInt32
+      writeUInt16,
+      writeUInt32,
+      updateUInt16,
+      updateUInt32,
+      writeUInt16Block,
+      writeUInt32Block
     };
 
     /**
      * Structure holding information about an operation. This structure
      * (combined with the callback and write value that is stored separately)
      * stores all the information that is needed to process the operation at a
-     * later point in time.
+     * later point in time. For operations that only affect a single register,
+     * the count is one and the stride is not used.
      */
     struct OperationInfo {
       unsigned long id;
       OperationType type;
       std::uint32_t address;
+      std::size_t count = 1;
+      std::uint32_t stride = 0;
+      std::chrono::steady_clock::time_point startTime;
 
       inline std::uint32_t width() const {
         switch (type) {
         case OperationType::writeUInt16:
         case OperationType::updateUInt16:
+        case OperationType::writeUInt16Block:
           return 2;
         case OperationType::writeUInt32:
         case OperationType::updateUInt32:
+        case OperationType::writeUInt32Block:
           return 4;
         default:
           // This should never happen as we handle all operation types.
           return 0;
         }
       }
+
+      /**
+       * Calls the specified function for each byte address that is affected
+       * by this operation. If the function returns false, the iteration stops
+       * and false is returned. Otherwise, true is returned.
+       */
+      template<typename Function>
+      inline bool forEachByte(Function function) const {
+        std::uint32_t width = this->width();
+        for (std::size_t index = 0; index < count; ++index) {
+          std::uint32_t elementAddress = address + index * stride;
+          for (std::uint32_t byteIndex = 0; byteIndex < width; ++byteIndex) {
+            if (!function(elementAddress + byteIndex)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      }
     };
 
     /**
-     * Internal callback for write operations.
+     * Internal callback for write operations. When write operations have been
+     * combined with this operation, their callbacks are notified together
+     * with the delegate.
      */
     template<typename T>
     struct WriteCallback: MrfMemoryAccess::Callback<T> {
       OperationInfo operationInfo;
       std::shared_ptr<Impl> impl;
       std::shared_ptr<MrfMemoryAccess::Callback<T>> delegate;
+      std::vector<std::shared_ptr<MrfMemoryAccess::Callback<T>>>
+          combinedDelegates;
 
       void success(std::uint32_t address, T value);
       void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
           const std::string &details);
     };
 
+    /**
+     * Internal callback for block write operations.
+     */
+    template<typename T>
+    struct BlockWriteCallback: MrfMemoryAccess::BlockCallback<T> {
+      OperationInfo operationInfo;
+      std::shared_ptr<Impl> impl;
+      std::shared_ptr<MrfMemoryAccess::BlockCallback<T>> delegate;
+
+      void success(std::uint32_t address, const std::vector<T> &values);
+      void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
+          const std::string &details);
+    };
+
     /**
      * Internal callback for update operations. It is used for both stages of
-     * the update operation (read and write).
+     * the update operation (read and write). When update operations have been
+     * combined with this operation, the update methods of their callbacks are
+     * applied after the one of the delegate (in the order in which the
+     * operations were queued) and their callbacks are notified together with
+     * the delegate.
      */
     template<typename T>
     class UpdateCallback: public MrfMemoryAccess::Callback<T>,
@@ -351,17 +616,95 @@ private:
       bool readFinished = false;
       std::shared_ptr<Impl> impl;
       std::shared_ptr<MrfConsistentMemoryAccess::UpdatingCallback<T>> delegate;
+      std::vector<std::shared_ptr<MrfConsistentMemoryAccess::UpdatingCallback<T>>>
+          combinedDelegates;
 
       void success(std::uint32_t address, T value);
       void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
           const std::string &details);
 
     private:
+      // Error messages of the update methods that threw an exception. The
+      // first element belongs to the delegate, the following ones belong to
+      // the combined delegates. An empty string means that the update method
+      // did not throw.
+      std::vector<std::string> updateErrors;
+
+      bool applyUpdate(
+          MrfConsistentMemoryAccess::UpdatingCallback<T> &updatingCallback,
+          std::uint32_t address, T &value);
+      void notify(std::uint32_t address, bool succeeded, T value,
+          MrfMemoryAccess::ErrorCode errorCode, const std::string &details);
       void write(T newValue);
     };
 
+    /**
+     * Entry of the shadow mirror. The width is the register width in bytes.
+     */
+    struct ShadowEntry {
+      std::uint32_t value;
+      std::uint32_t width;
+    };
+
+    /**
+     * State of the shadow mirror for a register at the time when a read
+     * operation was started. The value read is only put into the shadow
+     * mirror if the state has not changed when the read operation finishes.
+     */
+    struct ShadowSnapshot {
+      unsigned long epoch;
+      unsigned long generation;
+    };
+
+    /**
+     * Internal callback for read operations while the shadow mirror is
+     * enabled. It puts the value read into the shadow mirror before notifying
+     * the delegate.
+     */
+    template<typename T>
+    struct ShadowReadCallback: MrfMemoryAccess::Callback<T> {
+      ShadowSnapshot snapshot;
+      std::shared_ptr<Impl> impl;
+      std::shared_ptr<MrfMemoryAccess::Callback<T>> delegate;
+
+      void success(std::uint32_t address, T value);
+      void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
+          const std::string &details);
+    };
+
     std::recursive_mutex mutex;
     unsigned long nextId = 0;
+    bool writeCombining = false;
+    std::size_t waitingOperations = 0;
+    MrfStatisticsCounter writes;
+    MrfStatisticsCounter updates;
+    MrfStatisticsCounter blockWrites;
+    MrfStatisticsCounter combinedWrites;
+    MrfStatisticsCounter combinedUpdates;
+    MrfStatisticsCounter waitingOperationsHighWater;
+    MrfLatencyHistogram writeLatency;
+    MrfLatencyHistogram updateLatency;
+    MrfStatisticsCounter reads;
+    MrfStatisticsCounter shadowHits;
+    MrfStatisticsCounter shadowRevalidations;
+    MrfStatisticsCounter shadowMismatches;
+    // The flag is only changed while holding the mutex, but it is atomic so
+    // that read operations can check it without acquiring the mutex.
+    std::atomic<bool> shadowMirror;
+    unsigned long shadowEpoch = 0;
+    std::unordered_map<std::uint32_t, ShadowEntry> shadow;
+    std::unordered_set<std::uint32_t> shadowExcluded;
+    // Number of times a write or update operation affecting a byte has been
+    // started or finished. Only maintained while the shadow mirror is enabled.
+    std::unordered_map<std::uint32_t, unsigned long> shadowGenerations;
+    // The background re-validation uses its own mutex because it must not
+    // hold the main mutex while waiting.
+    std::mutex revalidationMutex;
+    std::condition_variable revalidationCondition;
+    std::chrono::steady_clock::duration revalidationInterval =
+        std::chrono::steady_clock::duration::zero();
+    bool revalidationThreadRunning = false;
+    bool revalidationStopped = false;
     std::unordered_multimap<std::uint32_t, OperationInfo> pendingOperations;
     std::unordered_set<std::uint32_t> operationRunning;
     std::unordered_map<unsigned long,
@@ -370,7 +713,15 @@ private:
         std::pair<std::shared_ptr<CallbackUInt32>, std::uint32_t>> writeUInt32CallbacksAndValues;
     std::unordered_map<unsigned long, std::shared_ptr<CallbackUInt16>> updateUInt16Callbacks;
     std::unordered_map<unsigned long, std::shared_ptr<CallbackUInt32>> updateUInt32Callbacks;
+    std::unordered_map<unsigned long,
+        std::pair<std::shared_ptr<BlockCallbackUInt16>,
+            std::vector<std::uint16_t>>> writeUInt16BlockCallbacksAndValues;
+    std::unordered_map<unsigned long,
+        std::pair<std::shared_ptr<BlockCallbackUInt32>,
+            std::vector<std::uint32_t>>> writeUInt32BlockCallbacksAndValues;
 
+    bool findCombinableWrite(const OperationInfo &operationInfo,
+        unsigned long &pendingId);
     void insertOperationInfo(const OperationInfo &operationInfo);
     void removeOperationInfo(const OperationInfo &operationInfo);
     std::forward_list<OperationInfo> prepareNextOperations(
@@ -380,6 +731,25 @@ private:
     void markRunOperation(const OperationInfo &operationInfo);
     void unmarkRunOperation(const OperationInfo &operationInfo);
     void operationFinished(const OperationInfo &operationInfo);
+    bool lookupShadow(std::uint32_t address, std::uint32_t width,
+        std::uint32_t &value);
+    void recordShadow(std::uint32_t address, std::uint32_t width,
+        std::uint32_t value);
+    template<typename T>
+    void recordShadow(const OperationInfo &operationInfo,
+        const std::vector<T> &values);
+    void recordShadowIfUnchanged(std::uint32_t address, std::uint32_t width,
+        std::uint32_t value, const ShadowSnapshot &snapshot);
+    void forgetShadow(const OperationInfo &operationInfo);
+    void storeShadow(std::uint32_t address, std::uint32_t width,
+        std::uint32_t value);
+    void eraseShadow(std::uint32_t address, std::uint32_t width);
+    ShadowSnapshot takeShadowSnapshot(std::uint32_t address,
+        std::uint32_t width);
+    bool isShadowSnapshotValid(const ShadowSnapshot &snapshot,
+        std::uint32_t address, std::uint32_t width);
+    void runShadowRevalidation();
+    void revalidateShadow();
 
   };
 
@@ -401,6 +771,9 @@ template<typename T>
 void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::WriteCallback<
     T>::success(std::uint32_t address, T value) {
   try {
+    // The shadow mirror has to be updated before the next operation for the
+    // same register can run.
+    impl->recordShadow(address, sizeof(T), value);
     impl->operationFinished(operationInfo);
   } catch (...) {
     // The code should not throw, but if it does, we still want to call the
@@ -410,6 +783,14 @@ void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAcces
   if (delegate) {
     delegate->success(address, value);
   }
+  for (auto &combinedDelegate : combinedDelegates) {
+    try {
+      combinedDelegate->success(address, value);
+    } catch (...) {
+      // An exception thrown by one callback must not keep the other callbacks
+      // from being notified.
+    }
+  }
 }
 
 template<typename T>
@@ -417,6 +798,49 @@ void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAcces
     T>::failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
     const std::string &details) {
   try {
+    // We do not know the register's value after a failed write.
+    impl->forgetShadow(operationInfo);
+    impl->operationFinished(operationInfo);
+  } catch (...) {
+    // The code should not throw, but if it does, we still want to call the
+    // delegate's method. We do not rethrow the exception because it would be
+    // discarded by the calling code anyway.
+  }
+  if (delegate) {
+    delegate->failure(address, errorCode, details);
+  }
+  for (auto &combinedDelegate : combinedDelegates) {
+    try {
+      combinedDelegate->failure(address, errorCode, details);
+    } catch (...) {
+      // An exception thrown by one callback must not keep the other callbacks
+      // from being notified.
+    }
+  }
+}
+
+template<typename T>
+void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::BlockWriteCallback<
+    T>::success(std::uint32_t address, const std::vector<T> &values) {
+  try {
+    impl->recordShadow(operationInfo, values);
+    impl->operationFinished(operationInfo);
+  } catch (...) {
+    // The code should not throw, but if it does, we still want to call the
+    // delegate's method. We do not rethrow the exception because it would be
+    // discarded by the calling code anyway.
+  }
+  if (delegate) {
+    delegate->success(address, values);
+  }
+}
+
+template<typename T>
+void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::BlockWriteCallback<
+    T>::failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
+    const std::string &details) {
+  try {
+    impl->forgetShadow(operationInfo);
     impl->operationFinished(operationInfo);
   } catch (...) {
     // The code should not throw, but if it does, we still want to call the
@@ -433,31 +857,42 @@ void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAcces
     T>::success(std::uint32_t address, T value) {
   if (readFinished) {
     try {
+      impl->recordShadow(address, sizeof(T), value);
       impl->operationFinished(operationInfo);
     } catch (...) {
       // The code should not throw, but if it does, we still want to call the
       // delegate's method. We do not rethrow the exception because it would be
       // discarded by the calling code anyway.
     }
-    delegate->success(address, value);
+    notify(address, true, value, ErrorCode::unknown, std::string());
   } else {
     readFinished = true;
+    // Each update method is applied to the value returned by the previous one,
+    // so the result is the same as if the operations had been run one after
+    // the other.
+    T newValue = value;
+    bool updated = applyUpdate(*delegate, address, newValue);
+    for (auto &combinedDelegate : combinedDelegates) {
+      updated = applyUpdate(*combinedDelegate, address, newValue) || updated;
+    }
+    // If all update methods threw, there is nothing to write. The failure
+    // method notifies each callback with the error of its update method.
+    if (!updated) {
+      failure(address, ErrorCode::unknown, std::string());
+      return;
+    }
     try {
-      T newValue = delegate->update(address, value);
       write(newValue);
     } catch (std::exception &e) {
-      // If the update or the write method throws an exception, we have to make
-      // sure that all resources get cleaned up.
+      // If the write method throws an exception, we have to make sure that all
+      // resources get cleaned up.
       failure(address, ErrorCode::unknown,
-          std::string("The callback's update method threw an exception: ")
-              + e.what());
-      return;
+          std::string("The write operation failed: ") + e.what());
     } catch (...) {
-      // If the update or the write method throws an exception, we have to make
-      // sure that all resources get cleaned up.
+      // If the write method throws an exception, we have to make sure that all
+      // resources get cleaned up.
       failure(address, ErrorCode::unknown,
-          std::string("The callback's update method threw an exception."));
-      return;
+          std::string("The write operation failed."));
     }
   }
 }
@@ -467,15 +902,93 @@ void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAcces
     T>::failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
     const std::string &details) {
   try {
+    impl->forgetShadow(operationInfo);
     impl->operationFinished(operationInfo);
   } catch (...) {
     // The code should not throw, but if it does, we still want to call the
     // delegate's method. We do not rethrow the exception because it would be
     // discarded by the calling code anyway.
   }
+  notify(address, false, 0, errorCode, details);
+}
+
+template<typename T>
+bool MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::UpdateCallback<
+    T>::applyUpdate(
+    MrfConsistentMemoryAccess::UpdatingCallback<T> &updatingCallback,
+    std::uint32_t address, T &value) {
+  try {
+    value = updatingCallback.update(address, value);
+    updateErrors.push_back(std::string());
+    return true;
+  } catch (std::exception &e) {
+    updateErrors.push_back(
+        std::string("The callback's update method threw an exception: ")
+            + e.what());
+  } catch (...) {
+    updateErrors.push_back(
+        std::string("The callback's update method threw an exception."));
+  }
+  return false;
+}
+
+template<typename T>
+void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::UpdateCallback<
+    T>::notify(std::uint32_t address, bool succeeded, T value,
+    MrfMemoryAccess::ErrorCode errorCode, const std::string &details) {
+  for (std::size_t index = 0; index <= combinedDelegates.size(); ++index) {
+    auto &updatingCallback =
+        (index == 0) ? delegate : combinedDelegates[index - 1];
+    try {
+      // A callback whose update method threw is notified of that error, even
+      // if the value computed by the other callbacks has been written.
+      if (index < updateErrors.size() && !updateErrors[index].empty()) {
+        updatingCallback->failure(address, ErrorCode::unknown,
+            updateErrors[index]);
+      } else if (succeeded) {
+        updatingCallback->success(address, value);
+      } else {
+        updatingCallback->failure(address, errorCode, details);
+      }
+    } catch (...) {
+      // An exception thrown by one callback must not keep the other callbacks
+      // from being notified.
+    }
+  }
+}
+
+template<typename T>
+void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::ShadowReadCallback<
+    T>::success(std::uint32_t address, T value) {
+  try {
+    impl->recordShadowIfUnchanged(address, sizeof(T), value, snapshot);
+  } catch (...) {
+    // The code should not throw, but if it does, we still want to call the
+    // delegate's method.
+  }
+  delegate->success(address, value);
+}
+
+template<typename T>
+void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::ShadowReadCallback<
+    T>::failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
+    const std::string &details) {
   delegate->failure(address, errorCode, details);
 }
 
+template<typename T>
+void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::recordShadow(
+    const OperationInfo &operationInfo, const std::vector<T> &values) {
+  if (!shadowMirror) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  for (std::size_t index = 0; index < values.size(); ++index) {
+    storeShadow(operationInfo.address + index * operationInfo.stride,
+        sizeof(T), values[index]);
+  }
+}
+
 template<>
 inline void MrfConsistentAsynchronousMemoryAccess::MrfConsistentAsynchronousMemoryAccess::Impl::UpdateCallback<
     std::uint16_t>::write(std::uint16_t newValue) {
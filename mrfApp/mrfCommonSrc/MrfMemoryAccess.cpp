@@ -98,6 +98,187 @@ public:
 
 };
 
+template<typename T>
+class BlockCallbackImpl: public MrfMemoryAccess::BlockCallback<T> {
+private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool finished = false;
+  std::vector<T> values;
+  bool successful = false;
+  std::uint32_t address;
+  MrfMemoryAccess::ErrorCode errorCode;
+  std::string details;
+
+public:
+  BlockCallbackImpl() :
+      address(0), errorCode(MrfMemoryAccess::ErrorCode::unknown) {
+  }
+
+  void success(std::uint32_t, const std::vector<T> &values) {
+    std::unique_lock<std::mutex> lock(mutex);
+    this->finished = true;
+    this->values = values;
+    this->successful = true;
+    cv.notify_all();
+  }
+
+  void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
+      const std::string &details) {
+    std::unique_lock<std::mutex> lock(mutex);
+    this->finished = true;
+    this->successful = false;
+    this->address = address;
+    this->errorCode = errorCode;
+    this->details = details;
+    cv.notify_all();
+  }
+
+  std::vector<T> getResult() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!finished) {
+      cv.wait(lock);
+    }
+    if (!successful) {
+      throw std::runtime_error(
+          std::string("Memory access operation for address ")
+              + mrfMemoryAddressToString(address) + " failed: "
+              + (details.empty() ? mrfErrorCodeToString(errorCode) : details));
+    }
+    return std::move(values);
+  }
+
+};
+
+/**
+ * Callback that is used for all the single-register operations that make up
+ * a block operation. We use a single callback object for all registers
+ * because this is cheaper than allocating one object for each register. The
+ * index of a register is calculated from the address that is passed to the
+ * callback methods.
+ */
+template<typename T>
+class BlockOperation: public MrfMemoryAccess::Callback<T> {
+private:
+  std::mutex mutex;
+  std::uint32_t address;
+  std::uint32_t stride;
+  std::size_t remaining;
+  bool failed = false;
+  std::uint32_t failedAddress;
+  MrfMemoryAccess::ErrorCode errorCode;
+  std::string details;
+  std::shared_ptr<MrfMemoryAccess::BlockCallback<T>> callback;
+
+  void finish() {
+    // When this method is called, all operations have finished, so there is
+    // no need to hold the mutex any longer.
+    if (failed) {
+      callback->failure(failedAddress, errorCode, details);
+    } else {
+      callback->success(address, values);
+    }
+  }
+
+public:
+  std::vector<T> values;
+
+  BlockOperation(std::uint32_t address, std::uint32_t stride,
+      std::vector<T> &&values,
+      std::shared_ptr<MrfMemoryAccess::BlockCallback<T>> callback) :
+      address(address), stride(stride), remaining(values.size()), failedAddress(
+          0), errorCode(MrfMemoryAccess::ErrorCode::unknown), callback(
+          callback), values(std::move(values)) {
+  }
+
+  void success(std::uint32_t address, T value) {
+    bool finished;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      values[(address - this->address) / stride] = value;
+      --remaining;
+      finished = (remaining == 0);
+    }
+    if (finished) {
+      finish();
+    }
+  }
+
+  void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
+      const std::string &details) {
+    bool finished;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      // We report the failure for the lowest address, so that the result does
+      // not depend on the order in which the operations finish.
+      if (!failed || address < failedAddress) {
+        failed = true;
+        failedAddress = address;
+        this->errorCode = errorCode;
+        this->details = details;
+      }
+      --remaining;
+      finished = (remaining == 0);
+    }
+    if (finished) {
+      finish();
+    }
+  }
+
+};
+
+/**
+ * Checks the parameters of a block operation. If the parameters are invalid,
+ * the callback's failure method is called and false is returned. If the block
+ * is empty, the callback's success method is called and false is returned.
+ * Otherwise, true is returned.
+ */
+template<typename T>
+bool checkBlockOperation(std::uint32_t address, std::size_t count,
+    std::uint32_t stride,
+    const std::shared_ptr<MrfMemoryAccess::BlockCallback<T>> &callback) {
+  if (count == 0) {
+    callback->success(address, std::vector<T>());
+    return false;
+  }
+  if (stride < sizeof(T)) {
+    callback->failure(address, MrfMemoryAccess::ErrorCode::invalidAddress,
+        "The stride must not be less than the size of a register.");
+    return false;
+  }
+  std::uint64_t endAddress = address
+      + static_cast<std::uint64_t>(count - 1) * stride + sizeof(T);
+  if (endAddress > (static_cast<std::uint64_t>(1) << 32)) {
+    callback->failure(address, MrfMemoryAccess::ErrorCode::invalidAddress,
+        "The block exceeds the address space.");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Runs a block operation by calling the specified function for each register.
+ * If the function throws an exception, the operation for the respective
+ * register is treated as failed.
+ */
+template<typename T, typename Function>
+void runBlockOperation(std::uint32_t address, std::uint32_t stride,
+    std::shared_ptr<BlockOperation<T>> operation, Function function) {
+  std::size_t count = operation->values.size();
+  for (std::size_t index = 0; index < count; ++index) {
+    std::uint32_t elementAddress = address + index * stride;
+    try {
+      function(elementAddress, index);
+    } catch (std::exception &e) {
+      operation->failure(elementAddress, MrfMemoryAccess::ErrorCode::unknown,
+          std::string("The operation failed: ") + e.what());
+    } catch (...) {
+      operation->failure(elementAddress, MrfMemoryAccess::ErrorCode::unknown,
+          "The operation failed.");
+    }
+  }
+}
+
 }
 
 std::uint16_t MrfMemoryAccess::readUInt16(std::uint32_t address) {
@@ -126,6 +307,94 @@ std::uint32_t MrfMemoryAccess::writeUInt32(std::uint32_t address,
   return callback->getResult();
 }
 
+std::vector<std::uint16_t> MrfMemoryAccess::readUInt16Block(
+    std::uint32_t address, std::size_t count, std::uint32_t stride) {
+  auto callback = std::make_shared<BlockCallbackImpl<std::uint16_t>>();
+  this->readUInt16Block(address, count, stride, callback);
+  return callback->getResult();
+}
+
+std::vector<std::uint16_t> MrfMemoryAccess::writeUInt16Block(
+    std::uint32_t address, const std::vector<std::uint16_t> &values,
+    std::uint32_t stride) {
+  auto callback = std::make_shared<BlockCallbackImpl<std::uint16_t>>();
+  this->writeUInt16Block(address, values, stride, callback);
+  return callback->getResult();
+}
+
+void MrfMemoryAccess::readUInt16Block(std::uint32_t address, std::size_t count,
+    std::uint32_t stride, std::shared_ptr<BlockCallbackUInt16> callback) {
+  if (!checkBlockOperation(address, count, stride, callback)) {
+    return;
+  }
+  auto operation = std::make_shared<BlockOperation<std::uint16_t>>(address,
+      stride, std::vector<std::uint16_t>(count), callback);
+  runBlockOperation(address, stride, operation,
+      [this, &operation](std::uint32_t elementAddress, std::size_t) {
+        this->readUInt16(elementAddress, operation);
+      });
+}
+
+void MrfMemoryAccess::writeUInt16Block(std::uint32_t address,
+    std::vector<std::uint16_t> values, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt16> callback) {
+  if (!checkBlockOperation(address, values.size(), stride, callback)) {
+    return;
+  }
+  auto operation = std::make_shared<BlockOperation<std::uint16_t>>(address,
+      stride, std::move(values), callback);
+  // The callback for an element only modifies the value of that element, so we
+  // can safely read the value of an element before queuing its operation.
+  runBlockOperation(address, stride, operation,
+      [this, &operation](std::uint32_t elementAddress, std::size_t index) {
+        this->writeUInt16(elementAddress, operation->values[index], operation);
+      });
+}
+
+std::vector<std::uint32_t> MrfMemoryAccess::readUInt32Block(
+    std::uint32_t address, std::size_t count, std::uint32_t stride) {
+  auto callback = std::make_shared<BlockCallbackImpl<std::uint32_t>>();
+  this->readUInt32Block(address, count, stride, callback);
+  return callback->getResult();
+}
+
+std::vector<std::uint32_t> MrfMemoryAccess::writeUInt32Block(
+    std::uint32_t address, const std::vector<std::uint32_t> &values,
+    std::uint32_t stride) {
+  auto callback = std::make_shared<BlockCallbackImpl<std::uint32_t>>();
+  this->writeUInt32Block(address, values, stride, callback);
+  return callback->getResult();
+}
+
+void MrfMemoryAccess::readUInt32Block(std::uint32_t address, std::size_t count,
+    std::uint32_t stride, std::shared_ptr<BlockCallbackUInt32> callback) {
+  if (!checkBlockOperation(address, count, stride, callback)) {
+    return;
+  }
+  auto operation = std::make_shared<BlockOperation<std::uint32_t>>(address,
+      stride, std::vector<std::uint32_t>(count), callback);
+  runBlockOperation(address, stride, operation,
+      [this, &operation](std::uint32_t elementAddress, std::size_t) {
+        this->readUInt32(elementAddress, operation);
+      });
+}
+
+void MrfMemoryAccess::writeUInt32Block(std::uint32_t address,
+    std::vector<std::uint32_t> values, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt32> callback) {
+  if (!checkBlockOperation(address, values.size(), stride, callback)) {
+    return;
+  }
+  auto operation = std::make_shared<BlockOperation<std::uint32_t>>(address,
+      stride, std::move(values), callback);
+  // The callback for an element only modifies the value of that element, so we
+  // can safely read the value of an element before queuing its operation.
+  runBlockOperation(address, stride, operation,
+      [this, &operation](std::uint32_t elementAddress, std::size_t index) {
+        this->writeUInt32(elementAddress, operation->values[index], operation);
+      });
+}
+
 bool MrfMemoryAccess::supportsInterrupts() const {
   return false;
 }
@@ -139,6 +408,17 @@ void MrfMemoryAccess::removeInterruptListener(
   throw std::runtime_error("This memory access does not support interrupts.");
 }
 
+void MrfMemoryAccess::collectStatistics(MrfStatistics &) {
+}
+
+bool MrfMemoryAccess::supportsTracing() const {
+  return false;
+}
+
+void MrfMemoryAccess::setTraceRing(std::shared_ptr<MrfTraceRing>) {
+  throw std::runtime_error("This memory access does not support tracing.");
+}
+
 std::string mrfMemoryAddressToString(std::uint32_t address) {
   char buffer[11];
   if (std::snprintf(buffer, 11, "0x%08x", address) < 0) {
@@ -30,9 +30,14 @@
 #ifndef ANKA_MRF_MEMORY_ACCESS_H
 #define ANKA_MRF_MEMORY_ACCESS_H
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "MrfStatistics.h"
+#include "MrfTraceRing.h"
 
 namespace anka {
 namespace mrf {
@@ -125,6 +130,59 @@ public:
 
   };
 
+  /**
+   * Interface for a memory-access callback for block operations. A block
+   * operation reads or writes a number of registers that are placed in memory
+   * at a fixed distance (stride) from each other. The callback is only called
+   * once, after all registers of the block have been processed.
+   */
+  template<typename T>
+  class BlockCallback {
+
+  public:
+
+    /**
+     * Called when all read or write operations of a block operation succeed.
+     * The address passed is the start address specified in the read or write
+     * request. The vector contains one value for each register of the block
+     * (in the order of increasing addresses) and holds the values read from
+     * the device memory (even for write operations).
+     */
+    virtual void success(std::uint32_t address,
+        const std::vector<T> &values) = 0;
+
+    /**
+     * Called when a block operation fails finally. The address passed is the
+     * address of the first register for which the operation failed. The error
+     * code gives information about the cause of the failure. The optional
+     * string may give additional information about the cause of the error
+     * (e.g. the system call that failed), but it may also be empty. When a
+     * block operation fails, some of the registers might still have been
+     * written.
+     */
+    virtual void failure(std::uint32_t address, ErrorCode errorCode,
+        const std::string &details) =0;
+
+    /**
+     * Default constructor.
+     */
+    BlockCallback() {
+    }
+
+    /**
+     * Destructor. Virtual classes should have a virtual destructor.
+     */
+    virtual ~BlockCallback() {
+    }
+
+    // We do not want to allow copy or move construction or assignment.
+    BlockCallback(const BlockCallback &) = delete;
+    BlockCallback(BlockCallback &&) = delete;
+    BlockCallback &operator=(const BlockCallback &) = delete;
+    BlockCallback &operator=(BlockCallback &&) = delete;
+
+  };
+
   /**
    * Listener that is notified when a device generates an interrupt. Such a
    * listener can be registered with an {@link MrfMemoryAccess} that supports
@@ -174,6 +232,18 @@ public:
    */
   using CallbackUInt32 = Callback<std::uint32_t>;
 
+  /**
+   * Callback for reading from or writing to a block of unsigned 16-bit
+   * registers.
+   */
+  using BlockCallbackUInt16 = BlockCallback<std::uint16_t>;
+
+  /**
+   * Callback for reading from or writing to a block of unsigned 32-bit
+   * registers.
+   */
+  using BlockCallbackUInt32 = BlockCallback<std::uint32_t>;
+
   /**
    * Default constructor.
    */
@@ -247,6 +317,102 @@ public:
   virtual void writeUInt32(std::uint32_t address, std::uint32_t value,
       std::shared_ptr<CallbackUInt32> callback) = 0;
 
+  /**
+   * Reads from a block of unsigned 16-bit registers. The block starts at the
+   * specified address and consists of the specified number of registers. The
+   * stride is the distance (in bytes) between the start addresses of two
+   * consecutive registers and must not be less than the size of a register.
+   * The method blocks until the operation has finished (either successfully or
+   * unsuccessfully). On success, the values read from the registers are
+   * returned. On failure, an exception is thrown.
+   */
+  virtual std::vector<std::uint16_t> readUInt16Block(std::uint32_t address,
+      std::size_t count, std::uint32_t stride);
+
+  /**
+   * Writes to a block of unsigned 16-bit registers. The block starts at the
+   * specified address and consists of one register for each of the specified
+   * values. The stride is the distance (in bytes) between the start addresses
+   * of two consecutive registers and must not be less than the size of a
+   * register. The method blocks until the operation has finished (either
+   * successfully or unsuccessfully). On success, the values read from the
+   * memory (after writing to it) are returned. On failure, an exception is
+   * thrown.
+   */
+  virtual std::vector<std::uint16_t> writeUInt16Block(std::uint32_t address,
+      const std::vector<std::uint16_t> &values, std::uint32_t stride);
+
+  /**
+   * Reads from a block of unsigned 16-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been read, the specified callback is called
+   * once. The default implementation issues a separate read operation for each
+   * register. Child classes may override this method in order to provide a
+   * more efficient implementation.
+   */
+  virtual void readUInt16Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt16> callback);
+
+  /**
+   * Writes to a block of unsigned 16-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been written, the specified callback is called
+   * once. The default implementation issues a separate write operation for
+   * each register. Child classes may override this method in order to provide
+   * a more efficient implementation.
+   */
+  virtual void writeUInt16Block(std::uint32_t address,
+      std::vector<std::uint16_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt16> callback);
+
+  /**
+   * Reads from a block of unsigned 32-bit registers. The block starts at the
+   * specified address and consists of the specified number of registers. The
+   * stride is the distance (in bytes) between the start addresses of two
+   * consecutive registers and must not be less than the size of a register.
+   * The method blocks until the operation has finished (either successfully or
+   * unsuccessfully). On success, the values read from the registers are
+   * returned. On failure, an exception is thrown.
+   */
+  virtual std::vector<std::uint32_t> readUInt32Block(std::uint32_t address,
+      std::size_t count, std::uint32_t stride);
+
+  /**
+   * Writes to a block of unsigned 32-bit registers. The block starts at the
+   * specified address and consists of one register for each of the specified
+   * values. The stride is the distance (in bytes) between the start addresses
+   * of two consecutive registers and must not be less than the size of a
+   * register. The method blocks until the operation has finished (either
+   * successfully or unsuccessfully). On success, the values read from the
+   * memory (after writing to it) are returned. On failure, an exception is
+   * thrown.
+   */
+  virtual std::vector<std::uint32_t> writeUInt32Block(std::uint32_t address,
+      const std::vector<std::uint32_t> &values, std::uint32_t stride);
+
+  /**
+   * Reads from a block of unsigned 32-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been read, the specified callback is called
+   * once. The default implementation issues a separate read operation for each
+   * register. Child classes may override this method in order to provide a
+   * more efficient implementation.
+   */
+  virtual void readUInt32Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt32> callback);
+
+  /**
+   * Writes to a block of unsigned 32-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. When all
+   * registers of the block have been written, the specified callback is called
+   * once. The default implementation issues a separate write operation for
+   * each register. Child classes may override this method in order to provide
+   * a more efficient implementation.
+   */
+  virtual void writeUInt32Block(std::uint32_t address,
+      std::vector<std::uint32_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt32> callback);
+
   /**
    * Tells whether this memory access supports interrupts. If the memory access
    * is able to intercept interrupts generated by the device, this method
@@ -297,6 +463,44 @@ public:
   virtual void removeInterruptListener(
       std::shared_ptr<InterruptListener> interruptListener);
 
+  /**
+   * Adds the runtime statistics of this memory access to the specified
+   * statistics object. If this memory access wraps another memory access, the
+   * statistics of the wrapped memory access are added as well.
+   *
+   * The default implementation does not add any statistics. Subclasses that
+   * collect statistics should override this method. This method is thread
+   * safe, but the returned counters are not guaranteed to be consistent with
+   * each other because operations might complete while the statistics are
+   * being collected.
+   */
+  virtual void collectStatistics(MrfStatistics &statistics);
+
+  /**
+   * Tells whether this memory access can record a trace of the operations
+   * that it processes. If it can, this method returns {@code true}, otherwise
+   * it returns {@code false}.
+   *
+   * Subclasses that support tracing must override this method along with the
+   * {@link setTraceRing(std::shared_ptr<MrfTraceRing> traceRing)} method.
+   */
+  virtual bool supportsTracing() const;
+
+  /**
+   * Sets the ring buffer to which this memory access adds an entry for each
+   * operation that finishes. Tracing is disabled when a null pointer is
+   * passed. Tracing is disabled by default.
+   *
+   * This method may only be called if this memory access supports tracing
+   * ({@link supportsTracing()} returns {@code true}). Calling this method on a
+   * memory access that does not support tracing results in an exception being
+   * thrown.
+   *
+   * Subclasses that support tracing must override this method along with the
+   * {@link supportsTracing()} method.
+   */
+  virtual void setTraceRing(std::shared_ptr<MrfTraceRing> traceRing);
+
 protected:
 
   /**
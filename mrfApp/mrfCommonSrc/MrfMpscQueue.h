@@ -0,0 +1,195 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_MPSC_QUEUE_H
+#define ANKA_MRF_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace anka {
+namespace mrf {
+
+/**
+ * Bounded queue that can be used by multiple producers and a single consumer
+ * without any locks. All slots are allocated when the queue is created, so
+ * adding or removing an element never allocates memory (as long as moving the
+ * element does not allocate memory).
+ *
+ * The implementation is based on the well-known bounded queue by Dmitry
+ * Vyukov: Each slot has a sequence number that tells whether the slot is
+ * ready for being written by a producer or for being read by the consumer.
+ * Producers claim a slot by incrementing the enqueue position through a
+ * compare-and-swap operation. As there is only a single consumer, the dequeue
+ * position does not have to be updated atomically.
+ *
+ * The {@link tryPush(T &&)} method may be called by any thread, but the
+ * {@link tryPop(T &)} and {@link isEmpty()} methods must only be called by a
+ * single thread (the consumer).
+ */
+template<typename T>
+class MrfMpscQueue {
+
+public:
+
+  /**
+   * Creates a queue that can hold the specified number of elements. The
+   * capacity is rounded up to the next power of two. Throws an exception if
+   * the capacity is zero.
+   */
+  explicit MrfMpscQueue(std::size_t capacity) :
+      enqueuePosition(0), dequeuePosition(0) {
+    if (capacity == 0) {
+      throw std::invalid_argument("The capacity must not be zero.");
+    }
+    std::size_t roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+      roundedCapacity <<= 1;
+    }
+    this->mask = roundedCapacity - 1;
+    this->slots.reset(new Slot[roundedCapacity]);
+    for (std::size_t index = 0; index < roundedCapacity; ++index) {
+      slots[index].sequence.store(index, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Returns the number of elements that this queue can hold.
+   */
+  inline std::size_t getCapacity() const {
+    return mask + 1;
+  }
+
+  /**
+   * Adds an element to the end of the queue. Returns {@code true} if the
+   * element has been added and {@code false} if the queue is full. If the
+   * queue is full, the passed element is not modified.
+   */
+  bool tryPush(T &&element) {
+    std::size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &slots[position & mask];
+      std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      std::intptr_t difference = static_cast<std::intptr_t>(sequence)
+          - static_cast<std::intptr_t>(position);
+      if (difference == 0) {
+        // The slot is free, so we try to claim it. If another producer was
+        // faster, position is updated with the current value and we try
+        // again.
+        if (enqueuePosition.compare_exchange_weak(position, position + 1,
+            std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // The slot still holds an element that has not been consumed yet, so
+        // the queue is full.
+        return false;
+      } else {
+        // Another producer has claimed the slot, so we have to try again with
+        // the new position.
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+    slot->element = std::move(element);
+    // Publishing the new sequence number makes the element visible to the
+    // consumer.
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Removes the element at the head of the queue. Returns {@code true} if an
+   * element has been removed and {@code false} if the queue is empty. This
+   * method must only be called by the consumer thread.
+   */
+  bool tryPop(T &element) {
+    Slot &slot = slots[dequeuePosition & mask];
+    std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != dequeuePosition + 1) {
+      // The slot has not been written yet (or a producer has claimed it but
+      // not finished writing to it yet).
+      return false;
+    }
+    element = std::move(slot.element);
+    // We reset the element stored in the slot, so that resources held by it
+    // (e.g. shared pointers) are released now and not when the slot is reused.
+    slot.element = T();
+    // The slot can be used again when the enqueue position has wrapped around.
+    slot.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+    ++dequeuePosition;
+    return true;
+  }
+
+  /**
+   * Tells whether the queue is empty. Like {@link tryPop(T &)}, this method
+   * must only be called by the consumer thread. An element that is currently
+   * being added by a producer might not be seen.
+   */
+  bool isEmpty() const {
+    const Slot &slot = slots[dequeuePosition & mask];
+    return slot.sequence.load(std::memory_order_acquire)
+        != dequeuePosition + 1;
+  }
+
+private:
+
+  /**
+   * Slot holding a single element and the corresponding sequence number.
+   */
+  struct Slot {
+    std::atomic<std::size_t> sequence;
+    T element;
+  };
+
+  // We do not want to allow copy or move construction or assignment.
+  MrfMpscQueue(const MrfMpscQueue &) = delete;
+  MrfMpscQueue(MrfMpscQueue &&) = delete;
+  MrfMpscQueue &operator=(const MrfMpscQueue &) = delete;
+  MrfMpscQueue &operator=(MrfMpscQueue &&) = delete;
+
+  std::unique_ptr<Slot[]> slots;
+  std::size_t mask;
+
+  // The enqueue position is modified by all producers while the dequeue
+  // position is only modified by the consumer. We put some padding between
+  // them so that they do not share a cache line.
+  std::atomic<std::size_t> enqueuePosition;
+  char padding[64];
+  std::size_t dequeuePosition;
+
+};
+
+} // namespace mrf
+} // namespace anka
+
+#endif // ANKA_MRF_MPSC_QUEUE_H
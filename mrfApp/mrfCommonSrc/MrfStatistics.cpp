@@ -0,0 +1,88 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include "MrfStatistics.h"
+
+namespace anka {
+namespace mrf {
+
+constexpr std::size_t MrfLatencyHistogram::numberOfBuckets;
+
+MrfLatencyHistogram::MrfLatencyHistogram() {
+  for (auto &bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void MrfLatencyHistogram::record(std::chrono::steady_clock::duration latency) {
+  auto microseconds =
+      std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+  // The index of the bucket is the number of significant bits of the latency
+  // in microseconds, so a latency of less than one microsecond ends up in the
+  // first bucket.
+  std::size_t index = 0;
+  while (microseconds > 0 && index < numberOfBuckets - 1) {
+    microseconds >>= 1;
+    ++index;
+  }
+  buckets[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<std::uint64_t> MrfLatencyHistogram::getBuckets() const {
+  std::vector<std::uint64_t> result;
+  result.reserve(numberOfBuckets);
+  for (auto &bucket : buckets) {
+    result.push_back(bucket.load(std::memory_order_relaxed));
+  }
+  return result;
+}
+
+bool MrfStatistics::findCounter(const std::string &name,
+    std::uint64_t &value) const {
+  for (auto &counter : counters) {
+    if (counter.first == name) {
+      value = counter.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+const std::vector<std::uint64_t> *MrfStatistics::findHistogram(
+    const std::string &name) const {
+  for (auto &histogram : histograms) {
+    if (histogram.first == name) {
+      return &histogram.second;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace mrf
+} // namespace anka
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_STATISTICS_H
+#define ANKA_MRF_STATISTICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MrfTime.h"
+
+namespace anka {
+namespace mrf {
+
+/**
+ * Counter for runtime statistics. The counter can be incremented from any
+ * thread without any locking. It does not establish any ordering with other
+ * memory operations, so it must only be used for statistics.
+ */
+class MrfStatisticsCounter {
+
+public:
+
+  /**
+   * Creates a counter that is initialized with zero.
+   */
+  MrfStatisticsCounter() : value(0) {
+  }
+
+  /**
+   * Increments the counter by the specified amount.
+   */
+  inline void increment(std::uint64_t amount = 1) {
+    value.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  /**
+   * Sets the counter to the specified value if it is greater than the current
+   * value. This is used for tracking high-water marks.
+   */
+  inline void updateMaximum(std::uint64_t newValue) {
+    std::uint64_t oldValue = value.load(std::memory_order_relaxed);
+    while (newValue > oldValue
+        && !value.compare_exchange_weak(oldValue, newValue,
+            std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * Returns the current value of the counter.
+   */
+  inline std::uint64_t get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  MrfStatisticsCounter(const MrfStatisticsCounter &) = delete;
+  MrfStatisticsCounter(MrfStatisticsCounter &&) = delete;
+  MrfStatisticsCounter &operator=(const MrfStatisticsCounter &) = delete;
+  MrfStatisticsCounter &operator=(MrfStatisticsCounter &&) = delete;
+
+  std::atomic<std::uint64_t> value;
+
+};
+
+/**
+ * Histogram of latencies. The histogram uses buckets whose limits are powers
+ * of two: The first bucket counts latencies of less than one microsecond and
+ * bucket n counts latencies of at least 2^(n-1) and less than 2^n
+ * microseconds. The last bucket also counts all latencies that are even
+ * greater. Like {@link MrfStatisticsCounter}, the histogram can be updated
+ * from any thread without any locking.
+ */
+class MrfLatencyHistogram {
+
+public:
+
+  /**
+   * Number of buckets. The last bucket starts at about 18 minutes, which is
+   * more than any operation should ever take.
+   */
+  static constexpr std::size_t numberOfBuckets = 32;
+
+  /**
+   * Creates an empty histogram.
+   */
+  MrfLatencyHistogram();
+
+  /**
+   * Adds the specified latency to the histogram.
+   */
+  void record(std::chrono::steady_clock::duration latency);
+
+  /**
+   * Adds the specified latency to the histogram. This overload is provided for
+   * code that measures time intervals with {@link MrfTime}.
+   */
+  void record(const MrfTime &latency) {
+    record(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::seconds(latency.getSeconds())
+                + std::chrono::nanoseconds(latency.getNanoseconds())));
+  }
+
+  /**
+   * Returns the current number of samples in each bucket.
+   */
+  std::vector<std::uint64_t> getBuckets() const;
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  MrfLatencyHistogram(const MrfLatencyHistogram &) = delete;
+  MrfLatencyHistogram(MrfLatencyHistogram &&) = delete;
+  MrfLatencyHistogram &operator=(const MrfLatencyHistogram &) = delete;
+  MrfLatencyHistogram &operator=(MrfLatencyHistogram &&) = delete;
+
+  std::array<std::atomic<std::uint64_t>, numberOfBuckets> buckets;
+
+};
+
+/**
+ * Snapshot of the runtime statistics of a memory access. The statistics
+ * consist of named counters and named latency histograms. The names of the
+ * statistics that are provided by a specific memory-access implementation
+ * start with a prefix identifying the implementation (e.g. "udp."), so that
+ * the statistics of a memory access and the memory access wrapped by it can be
+ * collected into the same snapshot.
+ */
+class MrfStatistics {
+
+public:
+
+  /**
+   * Adds a counter with the specified name and value.
+   */
+  void addCounter(const std::string &name, std::uint64_t value) {
+    counters.emplace_back(name, value);
+  }
+
+  /**
+   * Adds a histogram with the specified name. The current contents of the
+   * histogram are copied into the snapshot.
+   */
+  void addHistogram(const std::string &name,
+      const MrfLatencyHistogram &histogram) {
+    histograms.emplace_back(name, histogram.getBuckets());
+  }
+
+  /**
+   * Returns the counters in the order in which they have been added.
+   */
+  const std::vector<std::pair<std::string, std::uint64_t>> &getCounters() const {
+    return counters;
+  }
+
+  /**
+   * Returns the histograms in the order in which they have been added. Each
+   * histogram is represented by the number of samples in each of its buckets.
+   */
+  const std::vector<std::pair<std::string, std::vector<std::uint64_t>>> &getHistograms() const {
+    return histograms;
+  }
+
+  /**
+   * Looks for the counter with the specified name. Returns {@code true} and
+   * stores the counter's value in {@code value} if the counter exists.
+   * Returns {@code false} otherwise.
+   */
+  bool findCounter(const std::string &name, std::uint64_t &value) const;
+
+  /**
+   * Looks for the histogram with the specified name. Returns a pointer to the
+   * histogram's buckets if the histogram exists. Returns null otherwise. The
+   * pointer is only valid as long as this object exists.
+   */
+  const std::vector<std::uint64_t> *findHistogram(
+      const std::string &name) const;
+
+private:
+
+  std::vector<std::pair<std::string, std::uint64_t>> counters;
+  std::vector<std::pair<std::string, std::vector<std::uint64_t>>> histograms;
+
+};
+
+} // namespace mrf
+} // namespace anka
+
+#endif // ANKA_MRF_STATISTICS_H
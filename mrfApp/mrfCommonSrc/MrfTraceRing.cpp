@@ -0,0 +1,253 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+
+#include "MrfMemoryAccess.h"
+
+#include "MrfTraceRing.h"
+
+namespace anka {
+namespace mrf {
+
+namespace {
+
+const char *operationTypeToString(MrfTraceRing::OperationType type) {
+  switch (type) {
+  case MrfTraceRing::OperationType::readUInt16:
+    return "readUInt16";
+  case MrfTraceRing::OperationType::writeUInt16:
+    return "writeUInt16";
+  case MrfTraceRing::OperationType::readUInt32:
+    return "readUInt32";
+  case MrfTraceRing::OperationType::writeUInt32:
+    return "writeUInt32";
+  case MrfTraceRing::OperationType::readUInt16Block:
+    return "readUInt16Block";
+  case MrfTraceRing::OperationType::writeUInt16Block:
+    return "writeUInt16Block";
+  case MrfTraceRing::OperationType::readUInt32Block:
+    return "readUInt32Block";
+  case MrfTraceRing::OperationType::writeUInt32Block:
+    return "writeUInt32Block";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ * Writes a timestamp in microseconds (relative to the specified base) as
+ * expected by the trace-event format.
+ */
+void writeTimestamp(std::ostream &stream, std::int64_t time,
+    std::int64_t baseTime) {
+  char buffer[32];
+  std::int64_t relativeTime = time - baseTime;
+  std::snprintf(buffer, sizeof(buffer), "%" PRId64 ".%03" PRId64,
+      relativeTime / 1000, relativeTime % 1000);
+  stream << buffer;
+}
+
+void writeJsonString(std::ostream &stream, const std::string &value) {
+  stream << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      stream << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      stream << buffer;
+    } else {
+      stream << c;
+    }
+  }
+  stream << '"';
+}
+
+/**
+ * Writes a pair of begin and end events. The events are only written if both
+ * times are known. As the events are always preceded by the metadata event,
+ * each event is preceded by a separator.
+ */
+void writeAsyncSlice(std::ostream &stream, const char *name,
+    std::size_t id, std::int64_t beginTime, std::int64_t endTime,
+    std::int64_t baseTime, const std::string &args) {
+  if (beginTime == 0 || endTime == 0 || endTime < beginTime) {
+    return;
+  }
+  for (int phase = 0; phase < 2; ++phase) {
+    stream << ",\n{\"name\":\"" << name << "\",\"cat\":\"mrf\",\"ph\":\""
+        << (phase == 0 ? 'b' : 'e') << "\",\"id\":" << id
+        << ",\"pid\":1,\"tid\":1,\"ts\":";
+    writeTimestamp(stream, phase == 0 ? beginTime : endTime, baseTime);
+    if (phase == 0 && !args.empty()) {
+      stream << ",\"args\":{" << args << "}";
+    }
+    stream << "}";
+  }
+}
+
+} // anonymous namespace
+
+constexpr std::size_t MrfTraceRing::wordsPerEntry;
+
+MrfTraceRing::MrfTraceRing(std::size_t capacity) : nextPosition(0) {
+  if (capacity == 0) {
+    throw std::invalid_argument("The capacity must not be zero.");
+  }
+  std::size_t roundedCapacity = 1;
+  while (roundedCapacity < capacity) {
+    roundedCapacity <<= 1;
+  }
+  this->mask = roundedCapacity - 1;
+  this->slots.reset(new Slot[roundedCapacity]);
+  for (std::size_t index = 0; index < roundedCapacity; ++index) {
+    slots[index].sequence.store(0, std::memory_order_relaxed);
+    for (auto &word : slots[index].words) {
+      word.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void MrfTraceRing::add(const Entry &entry) {
+  std::uint64_t position = nextPosition.fetch_add(1,
+      std::memory_order_relaxed);
+  Slot &slot = slots[position & mask];
+  // We mark the slot as being written before writing the data. The fence
+  // ensures that a reader that sees any of the new data also sees the odd
+  // sequence number when it checks the sequence number again.
+  slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.words[0].store(
+      (static_cast<std::uint64_t>(entry.address) << 32)
+          | (static_cast<std::uint64_t>(entry.type) << 24)
+          | (static_cast<std::uint64_t>(entry.success ? 1 : 0) << 16)
+          | entry.numberOfTries, std::memory_order_relaxed);
+  slot.words[1].store(static_cast<std::uint64_t>(entry.queueTime),
+      std::memory_order_relaxed);
+  slot.words[2].store(static_cast<std::uint64_t>(entry.firstSendTime),
+      std::memory_order_relaxed);
+  slot.words[3].store(static_cast<std::uint64_t>(entry.lastSendTime),
+      std::memory_order_relaxed);
+  slot.words[4].store(static_cast<std::uint64_t>(entry.responseTime),
+      std::memory_order_relaxed);
+  slot.words[5].store(static_cast<std::uint64_t>(entry.completionTime),
+      std::memory_order_relaxed);
+  slot.sequence.store(2 * position + 2, std::memory_order_release);
+}
+
+std::vector<MrfTraceRing::Entry> MrfTraceRing::getEntries() const {
+  std::uint64_t endPosition = nextPosition.load(std::memory_order_relaxed);
+  std::uint64_t capacity = mask + 1;
+  std::uint64_t startPosition =
+      (endPosition > capacity) ? endPosition - capacity : 0;
+  std::vector<Entry> entries;
+  entries.reserve(endPosition - startPosition);
+  for (std::uint64_t position = startPosition; position < endPosition;
+      ++position) {
+    const Slot &slot = slots[position & mask];
+    std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * position + 2) {
+      // The entry is still being written or has already been overwritten.
+      continue;
+    }
+    std::uint64_t words[wordsPerEntry];
+    for (std::size_t i = 0; i < wordsPerEntry; ++i) {
+      words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    // If the sequence number has changed while we were reading the data, the
+    // data might be inconsistent, so we have to skip the entry.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    Entry entry;
+    entry.address = static_cast<std::uint32_t>(words[0] >> 32);
+    entry.type = static_cast<OperationType>((words[0] >> 24) & 0xff);
+    entry.success = ((words[0] >> 16) & 1) != 0;
+    entry.numberOfTries = static_cast<std::uint16_t>(words[0] & 0xffff);
+    entry.queueTime = static_cast<std::int64_t>(words[1]);
+    entry.firstSendTime = static_cast<std::int64_t>(words[2]);
+    entry.lastSendTime = static_cast<std::int64_t>(words[3]);
+    entry.responseTime = static_cast<std::int64_t>(words[4]);
+    entry.completionTime = static_cast<std::int64_t>(words[5]);
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+void MrfTraceRing::writeChromeTrace(std::ostream &stream,
+    const std::string &processName) const {
+  std::vector<Entry> entries = getEntries();
+  // The trace viewer does not need the timestamps to start at zero, but
+  // relative timestamps are much easier to read.
+  std::int64_t baseTime = std::numeric_limits<std::int64_t>::max();
+  for (auto &entry : entries) {
+    baseTime = std::min(baseTime, entry.queueTime);
+  }
+  stream << "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+      "\"args\":{\"name\":";
+  writeJsonString(stream, processName);
+  stream << "}}";
+  std::size_t id = 0;
+  for (auto &entry : entries) {
+    ++id;
+    char args[160];
+    std::snprintf(args, sizeof(args),
+        "\"address\":\"%s\",\"success\":%s,\"tries\":%u",
+        mrfMemoryAddressToString(entry.address).c_str(),
+        entry.success ? "true" : "false",
+        static_cast<unsigned>(entry.numberOfTries));
+    const char *name = operationTypeToString(entry.type);
+    writeAsyncSlice(stream, name, id, entry.queueTime,
+        entry.completionTime, baseTime, args);
+    writeAsyncSlice(stream, "queued", id, entry.queueTime,
+        entry.firstSendTime, baseTime, std::string());
+    writeAsyncSlice(stream, "device", id, entry.firstSendTime,
+        entry.responseTime, baseTime, std::string());
+    writeAsyncSlice(stream, "callback", id, entry.responseTime,
+        entry.completionTime, baseTime, std::string());
+    // Requests that had to be sent more than once are marked with an instant
+    // event at the time of the last try.
+    if (entry.numberOfTries > 1 && entry.lastSendTime != 0) {
+      stream << ",\n{\"name\":\"retry\",\"cat\":\"mrf\",\"ph\":\"n\",\"id\":"
+          << id << ",\"pid\":1,\"tid\":1,\"ts\":";
+      writeTimestamp(stream, entry.lastSendTime, baseTime);
+      stream << "}";
+    }
+  }
+  stream << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+} // namespace mrf
+} // namespace anka
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_TRACE_RING_H
+#define ANKA_MRF_TRACE_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "MrfTime.h"
+
+namespace anka {
+namespace mrf {
+
+/**
+ * Ring buffer holding a trace of the most recent operations of a memory
+ * access. Each entry describes one finished operation: its type and address,
+ * whether it was successful, how often a request had to be sent, and the
+ * times at which it was queued, sent, answered, and at which its callback
+ * returned.
+ *
+ * Entries are added without any locks: A writer claims a slot by incrementing
+ * a shared position and protects the slot with a sequence number while it
+ * writes the entry, so that a reader can detect (and skip) entries that are
+ * being written while it reads them. When the ring is full, the oldest
+ * entries are overwritten. If a writer is so slow that another writer wraps
+ * around the whole ring while the first one is still writing, the affected
+ * entry is lost, so the capacity should be chosen large enough.
+ *
+ * Times are stored in nanoseconds. The epoch of the times depends on the
+ * memory access, so only times stored by the same memory access can be
+ * compared with each other. A time of zero means that the corresponding event
+ * did not happen (e.g. no response was received).
+ */
+class MrfTraceRing {
+
+public:
+
+  /**
+   * Type of a traced operation.
+   */
+  enum class OperationType : std::uint8_t {
+    readUInt16,
+    writeUInt16,
+    readUInt32,
+    writeUInt32,
+    readUInt16Block,
+    writeUInt16Block,
+    readUInt32Block,
+    writeUInt32Block
+  };
+
+  /**
+   * Entry describing a single operation.
+   */
+  struct Entry {
+
+    /**
+     * Type of the operation.
+     */
+    OperationType type = OperationType::readUInt16;
+
+    /**
+     * Memory address that was accessed by the operation.
+     */
+    std::uint32_t address = 0;
+
+    /**
+     * Tells whether the operation was successful.
+     */
+    bool success = false;
+
+    /**
+     * Number of times a request was sent for this operation. For operations
+     * that need more than one request, this is the total for all requests.
+     */
+    std::uint16_t numberOfTries = 0;
+
+    /**
+     * Time when the operation was queued.
+     */
+    std::int64_t queueTime = 0;
+
+    /**
+     * Time when the first request for the operation was sent to the device.
+     */
+    std::int64_t firstSendTime = 0;
+
+    /**
+     * Time when the last request for the operation was sent to the device. If
+     * no request had to be sent again, this is the same as the first send
+     * time.
+     */
+    std::int64_t lastSendTime = 0;
+
+    /**
+     * Time when the last response for the operation was received from the
+     * device.
+     */
+    std::int64_t responseTime = 0;
+
+    /**
+     * Time when the callback of the operation returned.
+     */
+    std::int64_t completionTime = 0;
+
+  };
+
+  /**
+   * Creates a trace ring that can hold the specified number of entries. The
+   * capacity is rounded up to the next power of two. Throws an exception if
+   * the capacity is zero.
+   */
+  explicit MrfTraceRing(std::size_t capacity);
+
+  /**
+   * Adds an entry to the ring, overwriting the oldest entry if the ring is
+   * full. This method may be called by any thread.
+   */
+  void add(const Entry &entry);
+
+  /**
+   * Returns the entries that are currently stored in the ring, oldest first.
+   * Entries that are being written while this method runs are skipped. This
+   * method may be called by any thread.
+   */
+  std::vector<Entry> getEntries() const;
+
+  /**
+   * Writes the entries that are currently stored in the ring to the specified
+   * stream, using the JSON format of the Chrome trace-event viewer (which is
+   * also understood by Perfetto). Each operation is shown as an asynchronous
+   * event with nested events for the time spent in the queue, the time
+   * waiting for the device, and the time spent in the callback. The name of
+   * the process is shown as the name of the track.
+   */
+  void writeChromeTrace(std::ostream &stream,
+      const std::string &processName) const;
+
+  /**
+   * Converts a time to a timestamp for an entry.
+   */
+  inline static std::int64_t toTimestamp(const MrfTime &time) {
+    return static_cast<std::int64_t>(time.getSeconds()) * 1000000000
+        + time.getNanoseconds();
+  }
+
+  /**
+   * Converts a time to a timestamp for an entry.
+   */
+  inline static std::int64_t toTimestamp(
+      const std::chrono::steady_clock::time_point &time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        time.time_since_epoch()).count();
+  }
+
+private:
+
+  /**
+   * Number of 64-bit words needed for storing an entry.
+   */
+  static constexpr std::size_t wordsPerEntry = 6;
+
+  /**
+   * Slot in the ring. The entry is stored in atomic words, so that a reader
+   * and a writer accessing the same slot do not cause a data race. The
+   * sequence number is odd while the slot is being written. When the slot has
+   * been written, the sequence number is two times the position plus two.
+   */
+  struct Slot {
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint64_t> words[wordsPerEntry];
+  };
+
+  // We do not want to allow copy or move construction or assignment.
+  MrfTraceRing(const MrfTraceRing &) = delete;
+  MrfTraceRing(MrfTraceRing &&) = delete;
+  MrfTraceRing &operator=(const MrfTraceRing &) = delete;
+  MrfTraceRing &operator=(MrfTraceRing &&) = delete;
+
+  std::unique_ptr<Slot[]> slots;
+  std::size_t mask;
+  std::atomic<std::uint64_t> nextPosition;
+
+};
+
+} // namespace mrf
+} // namespace anka
+
+#endif // ANKA_MRF_TRACE_RING_H
@@ -0,0 +1,375 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <epicsExport.h>
+#include <epicsVersion.h>
+#include <iocsh.h>
+
+#include <MrfConsistentAsynchronousMemoryAccess.h>
+#include <MrfDeviceRegistry.h>
+#include <MrfSimulatedMemoryAccess.h>
+#include <MrfTime.h>
+#include <mrfEpicsError.h>
+
+using namespace anka::mrf;
+using namespace anka::mrf::epics;
+
+namespace {
+
+/**
+ * Mutex protecting the map of simulated devices.
+ */
+std::mutex simDevicesMutex;
+
+/**
+ * Simulated devices by device ID. The device registry only stores the
+ * consistent memory access that wraps the simulated memory access, so we have
+ * to keep track of the latter ourselves, in order to inject failures and
+ * trigger interrupts.
+ */
+std::unordered_map<std::string, std::shared_ptr<MrfSimulatedMemoryAccess>> simDevices;
+
+/**
+ * Returns the simulated device with the specified ID. Returns null if there is
+ * no such device.
+ */
+std::shared_ptr<MrfSimulatedMemoryAccess> findSimDevice(
+    const std::string &deviceId) {
+  std::lock_guard<std::mutex> lock(simDevicesMutex);
+  auto deviceIterator = simDevices.find(deviceId);
+  if (deviceIterator == simDevices.end()) {
+    return std::shared_ptr<MrfSimulatedMemoryAccess>();
+  }
+  return deviceIterator->second;
+}
+
+/**
+ * Converts a time interval specified in seconds to an {@link MrfTime}.
+ */
+MrfTime secondsToTime(double seconds) {
+  double fullSeconds = std::floor(seconds);
+  return MrfTime(static_cast<std::int_fast64_t>(fullSeconds),
+      static_cast<std::int_fast32_t>(std::min(
+          std::round((seconds - fullSeconds) * 1000000000.0), 999999999.0)));
+}
+
+/**
+ * Creates (and registers) a simulated device. EVG and EVR devices only differ
+ * in the size of their memory.
+ */
+void createSimDevice(const std::string& deviceId, std::uint32_t memorySize,
+    const MrfTime &latency, const MrfTime &jitter) {
+  std::shared_ptr<MrfSimulatedMemoryAccess> rawDevice = std::make_shared<
+      MrfSimulatedMemoryAccess>(memorySize);
+  rawDevice->setLatency(latency, jitter);
+  std::shared_ptr<MrfConsistentAsynchronousMemoryAccess> consistentDevice =
+      std::make_shared<MrfConsistentAsynchronousMemoryAccess>(rawDevice);
+  MrfDeviceRegistry::getInstance().registerDevice(std::string(deviceId),
+      consistentDevice);
+  std::lock_guard<std::mutex> lock(simDevicesMutex);
+  simDevices[deviceId] = rawDevice;
+}
+
+} // anonymous namespace
+
+extern "C" {
+
+// Data structures needed for the iocsh mrfSimEvgDevice and mrfSimEvrDevice
+// functions.
+static const iocshArg iocshMrfSimDeviceArg0 = { "device ID", iocshArgString };
+static const iocshArg iocshMrfSimDeviceArg1 = { "latency (seconds)",
+    iocshArgDouble };
+static const iocshArg iocshMrfSimDeviceArg2 = { "max. jitter (seconds)",
+    iocshArgDouble };
+static const iocshArg * const iocshMrfSimDeviceArgs[] = {
+    &iocshMrfSimDeviceArg0, &iocshMrfSimDeviceArg1, &iocshMrfSimDeviceArg2 };
+static const iocshFuncDef iocshMrfSimEvgDeviceFuncDef = {
+  "mrfSimEvgDevice",
+  3,
+  iocshMrfSimDeviceArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Define a simulated VME-EVG-230.\n\n"
+  "The registers of the device are kept in memory. Each operation is delayed "
+  "by the\nspecified latency plus a random jitter.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+static const iocshFuncDef iocshMrfSimEvrDeviceFuncDef = {
+  "mrfSimEvrDevice",
+  3,
+  iocshMrfSimDeviceArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Define a simulated VME-EVR-230RF.\n\n"
+  "The registers of the device are kept in memory. Each operation is delayed "
+  "by the\nspecified latency plus a random jitter.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+/**
+ * Common implementation of the iocsh mrfSimEvgDevice and mrfSimEvrDevice
+ * functions.
+ */
+static int iocshMrfSimDeviceFunc(const iocshArgBuf *args, bool evr) noexcept {
+  char *deviceId = args[0].sval;
+  double latencyDouble = args[1].dval;
+  double jitterDouble = args[2].dval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Could not create device: Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Could not create device: Device ID must not be empty.");
+    return 1;
+  }
+  // Until here our code does not throw. We put the rest of the function into a
+  // try-catch statement, so that we handle all other exceptions.
+  try {
+    if (!std::isfinite(latencyDouble) || !std::isfinite(jitterDouble)) {
+      throw std::invalid_argument("Latency and jitter must be finite values.");
+    }
+    if (latencyDouble < 0.0) {
+      latencyDouble = 0.0;
+    }
+    if (jitterDouble < 0.0) {
+      jitterDouble = 0.0;
+    }
+    // We have to set an upper limit because the values have to be converted to
+    // integers. We could allow larger values, but such values would not make
+    // sense anyway.
+    if (latencyDouble > 3600.0 || jitterDouble > 3600.0) {
+      throw std::invalid_argument(
+          "Latency and jitter must not be greater than 3600 seconds.");
+    }
+    createSimDevice(deviceId,
+        evr ?
+            MrfSimulatedMemoryAccess::memorySizeVmeEvr230Rf :
+            MrfSimulatedMemoryAccess::memorySizeVmeEvg230,
+        secondsToTime(latencyDouble), secondsToTime(jitterDouble));
+  } catch (std::exception &e) {
+    errorPrintf("Could not create device %s: %s", deviceId, e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not create device %s: Unknown error.", deviceId);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfSimEvgDevice function.
+ */
+static void iocshMrfSimEvgDeviceFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfSimDeviceFunc(args, false));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfSimDeviceFunc(args, false);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+/**
+ * Implementation of the iocsh mrfSimEvrDevice function.
+ */
+static void iocshMrfSimEvrDeviceFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfSimDeviceFunc(args, true));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfSimDeviceFunc(args, true);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfSimInjectFailures function.
+static const iocshArg iocshMrfSimInjectFailuresArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfSimInjectFailuresArg1 = {
+    "FPGA timeout probability", iocshArgDouble };
+static const iocshArg iocshMrfSimInjectFailuresArg2 = {
+    "invalid address probability", iocshArgDouble };
+static const iocshArg * const iocshMrfSimInjectFailuresArgs[] = {
+    &iocshMrfSimInjectFailuresArg0, &iocshMrfSimInjectFailuresArg1,
+    &iocshMrfSimInjectFailuresArg2 };
+static const iocshFuncDef iocshMrfSimInjectFailuresFuncDef = {
+  "mrfSimInjectFailures",
+  3,
+  iocshMrfSimInjectFailuresArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Make operations on a simulated device fail randomly.\n\n"
+  "Each operation fails with an FPGA timeout or an invalid address error with "
+  "the\nspecified probabilities (between 0 and 1). Use 0 for both "
+  "probabilities in order\nto stop injecting failures.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfSimInjectFailuresFuncInternal(const iocshArgBuf *args)
+    noexcept {
+  char *deviceId = args[0].sval;
+  double fpgaTimeoutProbability = args[1].dval;
+  double invalidAddressProbability = args[2].dval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfSimulatedMemoryAccess> device = findSimDevice(deviceId);
+    if (!device) {
+      errorPrintf("Could not find simulated device with ID \"%s\".", deviceId);
+      return 1;
+    }
+    // We reset both probabilities first, so that the check for the sum of the
+    // probabilities does not depend on the previous settings.
+    device->setInjectedFailureProbability(
+        MrfMemoryAccess::ErrorCode::fpgaTimeout, 0.0);
+    device->setInjectedFailureProbability(
+        MrfMemoryAccess::ErrorCode::invalidAddress, 0.0);
+    device->setInjectedFailureProbability(
+        MrfMemoryAccess::ErrorCode::fpgaTimeout, fpgaTimeoutProbability);
+    device->setInjectedFailureProbability(
+        MrfMemoryAccess::ErrorCode::invalidAddress,
+        invalidAddressProbability);
+  } catch (std::exception &e) {
+    errorPrintf("Could not inject failures: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not inject failures: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfSimInjectFailures function.
+ */
+static void iocshMrfSimInjectFailuresFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfSimInjectFailuresFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfSimInjectFailuresFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfSimTriggerInterrupt function.
+static const iocshArg iocshMrfSimTriggerInterruptArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfSimTriggerInterruptArg1 = {
+    "interrupt flags (e.g. 0x20)", iocshArgString };
+static const iocshArg * const iocshMrfSimTriggerInterruptArgs[] = {
+    &iocshMrfSimTriggerInterruptArg0, &iocshMrfSimTriggerInterruptArg1 };
+static const iocshFuncDef iocshMrfSimTriggerInterruptFuncDef = {
+  "mrfSimTriggerInterrupt",
+  2,
+  iocshMrfSimTriggerInterruptArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Trigger an interrupt on a simulated device.\n\n"
+  "The flags are set in the interrupt flag register and the interrupt "
+  "listeners are\nnotified of those flags that are enabled in the interrupt "
+  "enable register.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfSimTriggerInterruptFuncInternal(const iocshArgBuf *args)
+    noexcept {
+  char *deviceId = args[0].sval;
+  char *flagsString = args[1].sval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  if (!flagsString || !std::strlen(flagsString)) {
+    errorPrintf("Interrupt flags must be specified.");
+    return 1;
+  }
+  char *endPtr;
+  errno = 0;
+  unsigned long flags = std::strtoul(flagsString, &endPtr, 0);
+  if (errno || *endPtr || flags > 0xffffffffUL) {
+    errorPrintf("Invalid interrupt flags: %s", flagsString);
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfSimulatedMemoryAccess> device = findSimDevice(deviceId);
+    if (!device) {
+      errorPrintf("Could not find simulated device with ID \"%s\".", deviceId);
+      return 1;
+    }
+    device->triggerInterrupt(static_cast<std::uint32_t>(flags));
+  } catch (std::exception &e) {
+    errorPrintf("Could not trigger interrupt: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not trigger interrupt: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfSimTriggerInterrupt function.
+ */
+static void iocshMrfSimTriggerInterruptFunc(const iocshArgBuf *args)
+    noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfSimTriggerInterruptFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfSimTriggerInterruptFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+/*
+ * Registrar that registers the iocsh commands.
+ */
+static void mrfRegistrarSim() {
+  iocshRegister(&iocshMrfSimEvgDeviceFuncDef, iocshMrfSimEvgDeviceFunc);
+  iocshRegister(&iocshMrfSimEvrDeviceFuncDef, iocshMrfSimEvrDeviceFunc);
+  iocshRegister(&iocshMrfSimInjectFailuresFuncDef,
+      iocshMrfSimInjectFailuresFunc);
+  iocshRegister(&iocshMrfSimTriggerInterruptFuncDef,
+      iocshMrfSimTriggerInterruptFunc);
+}
+
+epicsExportRegistrar(mrfRegistrarSim);
+
+}
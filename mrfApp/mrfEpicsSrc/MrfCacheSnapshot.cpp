@@ -0,0 +1,238 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include "mrfCachePreheat.h"
+
+#include "MrfCacheSnapshot.h"
+
+namespace anka {
+namespace mrf {
+namespace epics {
+
+// We use an anonymous namespace for the functions and constants that we only
+// use internally. This way, we can avoid accidental name collisions.
+namespace {
+
+/**
+ * Signature at the start of each snapshot file. The last character is the
+ * version of the file format.
+ */
+const char fileSignature[8] = {'M', 'R', 'F', 'C', 'A', 'C', 'H', '1'};
+
+void writeUInt16(std::ostream &stream, std::uint16_t value) {
+  char bytes[2] = {static_cast<char>(value), static_cast<char>(value >> 8)};
+  stream.write(bytes, sizeof(bytes));
+}
+
+void writeUInt32(std::ostream &stream, std::uint32_t value) {
+  char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+      static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+  stream.write(bytes, sizeof(bytes));
+}
+
+std::uint16_t readUInt16(std::istream &stream) {
+  unsigned char bytes[2];
+  if (!stream.read(reinterpret_cast<char *>(bytes), sizeof(bytes))) {
+    throw std::runtime_error("Unexpected end of snapshot file.");
+  }
+  return static_cast<std::uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+std::uint32_t readUInt32(std::istream &stream) {
+  unsigned char bytes[4];
+  if (!stream.read(reinterpret_cast<char *>(bytes), sizeof(bytes))) {
+    throw std::runtime_error("Unexpected end of snapshot file.");
+  }
+  return static_cast<std::uint32_t>(bytes[0])
+      | (static_cast<std::uint32_t>(bytes[1]) << 8)
+      | (static_cast<std::uint32_t>(bytes[2]) << 16)
+      | (static_cast<std::uint32_t>(bytes[3]) << 24);
+}
+
+template<typename T>
+void writeSection(std::ostream &stream,
+    const std::map<std::uint32_t, T> &values,
+    void (*writeValue)(std::ostream &, T)) {
+  writeUInt32(stream, values.size());
+  for (auto &addressAndValue : values) {
+    writeUInt32(stream, addressAndValue.first);
+    writeValue(stream, addressAndValue.second);
+  }
+}
+
+template<typename T>
+void readSection(std::istream &stream, std::map<std::uint32_t, T> &values,
+    T (*readValue)(std::istream &)) {
+  std::uint32_t count = readUInt32(stream);
+  for (std::uint32_t index = 0; index < count; ++index) {
+    std::uint32_t address = readUInt32(stream);
+    values[address] = readValue(stream);
+  }
+}
+
+} // anonymous namespace
+
+MrfCacheSnapshot MrfCacheSnapshot::capture(MrfMemoryAccess &memoryAccess,
+    const MrfMemoryCache &cache,
+    const std::vector<std::uint32_t> &identityAddresses) {
+  MrfCacheSnapshot snapshot;
+  for (auto address : identityAddresses) {
+    snapshot.identity[address] = memoryAccess.readUInt32(address);
+  }
+  // We read the registers through a separate cache, so that we can use the
+  // pipelined reads of the preheat function.
+  for (auto &addressAndValue : cache.getCacheUInt16()) {
+    snapshot.valuesUInt16[addressAndValue.first] = 0;
+  }
+  for (auto &addressAndValue : cache.getCacheUInt32()) {
+    snapshot.valuesUInt32[addressAndValue.first] = 0;
+  }
+  MrfMemoryCache currentValues(memoryAccess);
+  currentValues.preheat(snapshot.getRanges());
+  snapshot.valuesUInt16 = currentValues.getCacheUInt16();
+  snapshot.valuesUInt32 = currentValues.getCacheUInt32();
+  return snapshot;
+}
+
+MrfCacheSnapshot MrfCacheSnapshot::readFile(const std::string &fileName) {
+  std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+  if (!stream) {
+    throw std::runtime_error(
+        std::string("Could not open file ") + fileName + ".");
+  }
+  char signature[sizeof(fileSignature)];
+  if (!stream.read(signature, sizeof(signature))
+      || !std::equal(signature, signature + sizeof(signature),
+          fileSignature)) {
+    throw std::runtime_error(
+        std::string("File ") + fileName + " is not a cache snapshot.");
+  }
+  MrfCacheSnapshot snapshot;
+  readSection(stream, snapshot.identity, readUInt32);
+  readSection(stream, snapshot.valuesUInt16, readUInt16);
+  readSection(stream, snapshot.valuesUInt32, readUInt32);
+  if (stream.peek() != std::ifstream::traits_type::eof()) {
+    throw std::runtime_error(
+        std::string("Unexpected data at the end of file ") + fileName + ".");
+  }
+  return snapshot;
+}
+
+void MrfCacheSnapshot::writeFile(const std::string &fileName) const {
+  std::string temporaryFileName = fileName + ".tmp";
+  std::ofstream stream(temporaryFileName,
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    throw std::runtime_error(
+        std::string("Could not open file ") + temporaryFileName + ".");
+  }
+  stream.write(fileSignature, sizeof(fileSignature));
+  writeSection(stream, identity, writeUInt32);
+  writeSection(stream, valuesUInt16, writeUInt16);
+  writeSection(stream, valuesUInt32, writeUInt32);
+  stream.close();
+  if (!stream) {
+    std::remove(temporaryFileName.c_str());
+    throw std::runtime_error(
+        std::string("Could not write file ") + temporaryFileName + ".");
+  }
+  if (std::rename(temporaryFileName.c_str(), fileName.c_str())) {
+    std::remove(temporaryFileName.c_str());
+    throw std::runtime_error(
+        std::string("Could not replace file ") + fileName + ".");
+  }
+}
+
+bool MrfCacheSnapshot::matches(MrfMemoryAccess &memoryAccess) const {
+  for (auto &addressAndValue : identity) {
+    if (memoryAccess.readUInt32(addressAndValue.first)
+        != addressAndValue.second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MrfCacheSnapshot::loadInto(MrfMemoryCache &cache) const {
+  for (auto &addressAndValue : valuesUInt16) {
+    cache.insertUInt16(addressAndValue.first, addressAndValue.second);
+  }
+  for (auto &addressAndValue : valuesUInt32) {
+    cache.insertUInt32(addressAndValue.first, addressAndValue.second);
+  }
+}
+
+std::vector<std::uint32_t> MrfCacheSnapshot::verify(
+    MrfMemoryAccess &memoryAccess, MrfMemoryCache &cache) const {
+  MrfMemoryCache currentValues(memoryAccess);
+  currentValues.preheat(getRanges());
+  std::vector<std::uint32_t> mismatches;
+  auto currentValuesUInt16 = currentValues.getCacheUInt16();
+  for (auto &addressAndValue : valuesUInt16) {
+    auto current = currentValuesUInt16.find(addressAndValue.first);
+    if (current != currentValuesUInt16.end()
+        && current->second != addressAndValue.second) {
+      cache.correctUInt16(addressAndValue.first, current->second);
+      mismatches.push_back(addressAndValue.first);
+    }
+  }
+  auto currentValuesUInt32 = currentValues.getCacheUInt32();
+  for (auto &addressAndValue : valuesUInt32) {
+    auto current = currentValuesUInt32.find(addressAndValue.first);
+    if (current != currentValuesUInt32.end()
+        && current->second != addressAndValue.second) {
+      cache.correctUInt32(addressAndValue.first, current->second);
+      mismatches.push_back(addressAndValue.first);
+    }
+  }
+  return mismatches;
+}
+
+std::vector<MrfMemoryCache::PreheatRange> MrfCacheSnapshot::getRanges() const {
+  std::vector<MrfMemoryCache::PreheatRange> ranges;
+  for (auto &addressAndValue : valuesUInt16) {
+    ranges.push_back(
+        {MrfMemoryCache::RegisterWidth::uInt16, addressAndValue.first, 1});
+  }
+  for (auto &addressAndValue : valuesUInt32) {
+    ranges.push_back(
+        {MrfMemoryCache::RegisterWidth::uInt32, addressAndValue.first, 1});
+  }
+  return coalescePreheatRanges(std::move(ranges));
+}
+
+}
+}
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_EPICS_CACHE_SNAPSHOT_H
+#define ANKA_MRF_EPICS_CACHE_SNAPSHOT_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <MrfMemoryAccess.h>
+
+#include "MrfMemoryCache.h"
+
+namespace anka {
+namespace mrf {
+namespace epics {
+
+/**
+ * Snapshot of the registers in a {@link MrfMemoryCache}. A snapshot can be
+ * written to a file when the IOC is shut down and loaded into the cache when
+ * the IOC is started again, so that the output records can be initialized
+ * without reading all registers from the device.
+ *
+ * Each snapshot contains the values of a few identity registers (e.g. the
+ * firmware version). A snapshot is only used when these registers still have
+ * the same values, so that a snapshot is not used for a different device (or
+ * a device that has been reprogrammed).
+ *
+ * The file format is compact and platform independent: After an eight byte
+ * signature, the file contains the identity registers, the 16-bit registers,
+ * and the 32-bit registers. Each of these three sections starts with the number
+ * of entries, followed by the address and value of each entry. All numbers are
+ * stored in little-endian byte order, using four bytes (two bytes for the
+ * values of 16-bit registers).
+ */
+class MrfCacheSnapshot {
+
+public:
+
+  /**
+   * Creates a snapshot of the registers that are in the specified cache. The
+   * registers are read again, so that the snapshot represents the current
+   * state of the device and not the state at the time when the registers were
+   * cached. Registers that cannot be read are not included in the snapshot.
+   * The identity registers are read as well. Throws an exception if one of
+   * them cannot be read.
+   */
+  static MrfCacheSnapshot capture(MrfMemoryAccess &memoryAccess,
+      const MrfMemoryCache &cache,
+      const std::vector<std::uint32_t> &identityAddresses);
+
+  /**
+   * Reads a snapshot from the specified file. Throws an exception if the file
+   * cannot be read or is not a valid snapshot file.
+   */
+  static MrfCacheSnapshot readFile(const std::string &fileName);
+
+  /**
+   * Writes this snapshot to the specified file. The snapshot is written to a
+   * temporary file first, which then replaces the specified file, so that an
+   * interrupted write does not leave a damaged file behind. Throws an
+   * exception if the file cannot be written.
+   */
+  void writeFile(const std::string &fileName) const;
+
+  /**
+   * Tells whether the identity registers of this snapshot have the same values
+   * in the device. The identity registers are read from the device, so this
+   * method blocks until they have been read. Throws an exception if one of
+   * them cannot be read.
+   */
+  bool matches(MrfMemoryAccess &memoryAccess) const;
+
+  /**
+   * Stores the values of the registers in this snapshot in the specified
+   * cache.
+   */
+  void loadInto(MrfMemoryCache &cache) const;
+
+  /**
+   * Reads the registers in this snapshot from the device and returns the
+   * addresses of those registers that have a different value in the device.
+   * The values of these registers are corrected in the specified cache, which
+   * also marks them as out of date (see
+   * {@link MrfMemoryCache::isOutOfDate(std::uint32_t)}). Registers that cannot
+   * be read are not included in the returned list.
+   */
+  std::vector<std::uint32_t> verify(MrfMemoryAccess &memoryAccess,
+      MrfMemoryCache &cache) const;
+
+  /**
+   * Returns the number of (16-bit and 32-bit) registers in this snapshot. The
+   * identity registers are not included.
+   */
+  inline std::size_t size() const {
+    return valuesUInt16.size() + valuesUInt32.size();
+  }
+
+private:
+
+  std::map<std::uint32_t, std::uint32_t> identity;
+  std::map<std::uint32_t, std::uint16_t> valuesUInt16;
+  std::map<std::uint32_t, std::uint32_t> valuesUInt32;
+
+  std::vector<MrfMemoryCache::PreheatRange> getRanges() const;
+
+};
+
+}
+}
+}
+
+#endif // ANKA_MRF_EPICS_CACHE_SNAPSHOT_H
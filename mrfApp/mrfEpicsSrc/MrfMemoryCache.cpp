@@ -27,12 +27,84 @@
  * of the GNU LGPL version 3 or newer.
  */
 
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
 #include "MrfMemoryCache.h"
 
 namespace anka {
 namespace mrf {
 namespace epics {
 
+struct MrfMemoryCache::PreheatState {
+  std::mutex mutex;
+  std::condition_variable operationFinished;
+  std::deque<PreheatRange> pendingRanges;
+  std::size_t operationsInFlight = 0;
+  std::size_t registersCached = 0;
+};
+
+template<typename T>
+class MrfMemoryCache::PreheatCallback: public MrfMemoryAccess::BlockCallback<T> {
+
+public:
+
+  PreheatCallback(MrfMemoryCache &cache, Shard<T> (&shards)[numberOfShards],
+      std::shared_ptr<PreheatState> state, const PreheatRange &range) :
+      cache(cache), shards(shards), state(std::move(state)), range(range) {
+  }
+
+  void success(std::uint32_t address, const std::vector<T> &values) {
+    for (std::size_t index = 0; index < values.size(); ++index) {
+      insert(shards, address + index * sizeof(T), values[index]);
+    }
+    cache.preheatRegistersCached.increment(values.size());
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->registersCached += values.size();
+    --state->operationsInFlight;
+    state->operationFinished.notify_all();
+  }
+
+  void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
+      const std::string &details) {
+    if (range.count == 1) {
+      // We use the same message that the synchronous read methods of the
+      // memory access use, so that the user cannot tell the difference.
+      insertError(shards, range.address,
+          std::string("Memory access operation for address ")
+              + mrfMemoryAddressToString(address) + " failed: "
+              + (details.empty() ?
+                  mrfErrorCodeToString(errorCode) : details));
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (range.count > 1) {
+      // We retry the registers one by one, so that a single register that
+      // cannot be read does not keep the other registers from being cached.
+      for (std::size_t index = 0; index < range.count; ++index) {
+        state->pendingRanges.push_back(
+            {range.width, static_cast<std::uint32_t>(
+                range.address + index * sizeof(T)), 1});
+      }
+    } else {
+      cache.preheatRegistersFailed.increment();
+    }
+    --state->operationsInFlight;
+    state->operationFinished.notify_all();
+  }
+
+private:
+
+  MrfMemoryCache &cache;
+  Shard<T> (&shards)[numberOfShards];
+  std::shared_ptr<PreheatState> state;
+  PreheatRange range;
+
+};
+
+constexpr std::size_t MrfMemoryCache::defaultPreheatOperationsInFlight;
+constexpr std::size_t MrfMemoryCache::preheatBlockSize;
+
 MrfMemoryCache::MrfMemoryCache(MrfMemoryAccess &memoryAccess) :
     memoryAccess(memoryAccess) {
 }
@@ -41,70 +113,83 @@ MrfMemoryCache::MrfMemoryCache(std::shared_ptr<MrfMemoryAccess> memoryAccess) :
     memoryAccess(*memoryAccess), memoryAccessPtr(memoryAccess) {
 }
 
+constexpr std::size_t MrfMemoryCache::numberOfShards;
+
 std::map<std::uint32_t, std::uint16_t> MrfMemoryCache::getCacheUInt16() const {
-  // Access to the hash map has to be protected by a mutex.
-  std::lock_guard<std::recursive_mutex> lock(mutex);
-  return std::map<std::uint32_t, std::uint16_t>(
-    cacheUInt16.begin(), cacheUInt16.end());
+  return getCache(shardsUInt16);
 }
 
 std::map<std::uint32_t, std::uint32_t> MrfMemoryCache::getCacheUInt32() const {
-  // Access to the hash map has to be protected by a mutex.
-  std::lock_guard<std::recursive_mutex> lock(mutex);
-  return std::map<std::uint32_t, std::uint32_t>(
-    cacheUInt32.begin(), cacheUInt32.end());
+  return getCache(shardsUInt32);
 }
 
 std::uint16_t MrfMemoryCache::readUInt16(std::uint32_t address) {
-  {
-    // Access to the hash map has to be protected by a mutex.
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto iterator = cacheUInt16.find(address);
-    if (iterator != cacheUInt16.end()) {
-      return iterator->second;
-    }
-  }
-  // If the register is not in the cache yet, we read it from the memory access.
-  // We do this without holding the mutex because the read operation might take
-  // a lot of time and we do not want to block other read operations in the
-  // meantime. This means that the same register might be read more than once,
-  // if multiple read attempt are made before the first one is finished.
-  // However, this is still better than the alternative.
-  std::uint16_t value = memoryAccess.readUInt16(address);
-  {
-    // Access to the hash map has to be protected by a mutex.
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    // If the value has already been cached, we prefer the cached value. This
-    // way, the behavior is independent concurrency timings.
-    return cacheUInt16.emplace(address, value).first->second;
-  }
+  return read(shardsUInt16, address, [this](std::uint32_t address) {
+    return memoryAccess.readUInt16(address);
+  });
 }
 
 std::uint32_t MrfMemoryCache::readUInt32(std::uint32_t address) {
+  return read(shardsUInt32, address, [this](std::uint32_t address) {
+    return memoryAccess.readUInt32(address);
+  });
+}
+
+void MrfMemoryCache::insertUInt16(std::uint32_t address, std::uint16_t value) {
+  insert(shardsUInt16, address, value);
+}
+
+void MrfMemoryCache::insertUInt32(std::uint32_t address, std::uint32_t value) {
+  insert(shardsUInt32, address, value);
+}
+
+void MrfMemoryCache::correctUInt16(std::uint32_t address,
+    std::uint16_t value) {
+  replace(shardsUInt16, address, value);
+  std::lock_guard<std::mutex> lock(verificationMutex);
+  outOfDateAddresses.insert(address);
+}
+
+void MrfMemoryCache::correctUInt32(std::uint32_t address,
+    std::uint32_t value) {
+  replace(shardsUInt32, address, value);
+  std::lock_guard<std::mutex> lock(verificationMutex);
+  outOfDateAddresses.insert(address);
+}
+
+bool MrfMemoryCache::isOutOfDate(std::uint32_t address) const {
+  std::lock_guard<std::mutex> lock(verificationMutex);
+  return outOfDateAddresses.count(address) != 0;
+}
+
+void MrfMemoryCache::beginVerification() {
+  std::lock_guard<std::mutex> lock(verificationMutex);
+  verificationPending = true;
+}
+
+void MrfMemoryCache::finishVerification() {
+  std::vector<std::function<void()>> callbacks;
   {
-    // Access to the hash map has to be protected by a mutex.
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto iterator = cacheUInt32.find(address);
-    if (iterator != cacheUInt32.end()) {
-      return iterator->second;
-    }
+    std::lock_guard<std::mutex> lock(verificationMutex);
+    verificationPending = false;
+    callbacks.swap(verificationCallbacks);
   }
-  // If the register is not in the cache yet, we read it from the memory access.
-  // We do this without holding the mutex because the read operation might take
-  // a lot of time and we do not want to block other read operations in the
-  // meantime. This means that the same register might be read more than once,
-  // if multiple read attempt are made before the first one is finished.
-  // However, this is still better than the alternative.
-  std::uint32_t value = memoryAccess.readUInt32(address);
-  {
-    // Access to the hash map has to be protected by a mutex.
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    // If the value has already been cached, we prefer the cached value. This
-    // way, the behavior is independent concurrency timings.
-    return cacheUInt32.emplace(address, value).first->second;
+  // We run the callbacks without holding the mutex, so that they can use the
+  // cache.
+  for (auto &callback : callbacks) {
+    callback();
   }
 }
 
+bool MrfMemoryCache::notifyWhenVerified(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(verificationMutex);
+  if (!verificationPending) {
+    return false;
+  }
+  verificationCallbacks.push_back(std::move(callback));
+  return true;
+}
+
 void MrfMemoryCache::tryCacheUInt16(std::uint32_t address) {
   try {
     readUInt16(address);
@@ -121,6 +206,263 @@ void MrfMemoryCache::tryCacheUInt32(std::uint32_t address) {
   }
 }
 
+void MrfMemoryCache::tryCacheUInt16Block(std::uint32_t address,
+    std::size_t count) {
+  std::vector<std::uint16_t> values;
+  try {
+    values = memoryAccess.readUInt16Block(address, count, 2);
+  } catch (...) {
+    // If the block operation failed, we try to read the registers one by one.
+    for (std::size_t index = 0; index < count; ++index) {
+      tryCacheUInt16(address + index * 2);
+    }
+    return;
+  }
+  for (std::size_t index = 0; index < values.size(); ++index) {
+    insert(shardsUInt16, address + index * 2, values[index]);
+  }
+}
+
+void MrfMemoryCache::tryCacheUInt32Block(std::uint32_t address,
+    std::size_t count) {
+  std::vector<std::uint32_t> values;
+  try {
+    values = memoryAccess.readUInt32Block(address, count, 4);
+  } catch (...) {
+    // If the block operation failed, we try to read the registers one by one.
+    for (std::size_t index = 0; index < count; ++index) {
+      tryCacheUInt32(address + index * 4);
+    }
+    return;
+  }
+  for (std::size_t index = 0; index < values.size(); ++index) {
+    insert(shardsUInt32, address + index * 4, values[index]);
+  }
+}
+
+MrfMemoryCache::PreheatResult MrfMemoryCache::preheat(
+    const std::vector<PreheatRange> &ranges,
+    std::size_t maximumOperationsInFlight) {
+  if (maximumOperationsInFlight == 0) {
+    throw std::invalid_argument(
+        "The maximum number of operations in flight must not be zero.");
+  }
+  auto startTime = std::chrono::steady_clock::now();
+  auto state = std::make_shared<PreheatState>();
+  std::size_t registersRequested = 0;
+  // We split the ranges into smaller blocks, so that a long range can be read
+  // by several operations in parallel and a failure only affects a small
+  // number of registers. Registers that are already in the cache (e.g.
+  // because they have been loaded from a snapshot) are skipped.
+  for (auto &range : ranges) {
+    std::uint32_t stride = (range.width == RegisterWidth::uInt16) ? 2 : 4;
+    PreheatRange block {range.width, range.address, 0};
+    for (std::size_t index = 0; index < range.count; ++index) {
+      std::uint32_t address = range.address + index * stride;
+      bool cached = (range.width == RegisterWidth::uInt16) ?
+          contains(shardsUInt16, address) : contains(shardsUInt32, address);
+      if (!cached) {
+        if (block.count == 0) {
+          block.address = address;
+        }
+        ++block.count;
+        ++registersRequested;
+      }
+      if (block.count != 0 && (cached || block.count == preheatBlockSize)) {
+        state->pendingRanges.push_back(block);
+        block.count = 0;
+      }
+    }
+    if (block.count != 0) {
+      state->pendingRanges.push_back(block);
+    }
+  }
+  preheatRegisters.increment(registersRequested);
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (!state->pendingRanges.empty() || state->operationsInFlight) {
+    if (!state->pendingRanges.empty()
+        && state->operationsInFlight < maximumOperationsInFlight) {
+      PreheatRange range = state->pendingRanges.front();
+      state->pendingRanges.pop_front();
+      ++state->operationsInFlight;
+      // The callback might be called before the operation has been started
+      // completely (e.g. when the address is invalid), so we must not hold
+      // the mutex while starting it.
+      lock.unlock();
+      startPreheatOperation(state, range);
+      lock.lock();
+    } else {
+      state->operationFinished.wait(lock);
+    }
+  }
+  auto duration = std::chrono::steady_clock::now() - startTime;
+  preheatTime.increment(
+      std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+  return PreheatResult {registersRequested, state->registersCached, duration};
+}
+
+void MrfMemoryCache::collectStatistics(MrfStatistics &statistics) const {
+  statistics.addCounter("cache.hits", hits.get());
+  statistics.addCounter("cache.misses", misses.get());
+  statistics.addCounter("cache.suppressedDuplicates",
+      suppressedDuplicates.get());
+  statistics.addCounter("cache.cachedErrors", cachedErrors.get());
+  statistics.addCounter("cache.preheatRegisters", preheatRegisters.get());
+  statistics.addCounter("cache.preheatRegistersCached",
+      preheatRegistersCached.get());
+  statistics.addCounter("cache.preheatRegistersFailed",
+      preheatRegistersFailed.get());
+  statistics.addCounter("cache.preheatTimeUs", preheatTime.get());
+}
+
+void MrfMemoryCache::startPreheatOperation(
+    const std::shared_ptr<PreheatState> &state, const PreheatRange &range) {
+  if (range.width == RegisterWidth::uInt16) {
+    auto callback = std::make_shared<PreheatCallback<std::uint16_t>>(*this,
+        shardsUInt16, state, range);
+    try {
+      memoryAccess.readUInt16Block(range.address, range.count, 2, callback);
+    } catch (std::exception &e) {
+      callback->failure(range.address, MrfMemoryAccess::ErrorCode::unknown,
+          e.what());
+    }
+  } else {
+    auto callback = std::make_shared<PreheatCallback<std::uint32_t>>(*this,
+        shardsUInt32, state, range);
+    try {
+      memoryAccess.readUInt32Block(range.address, range.count, 4, callback);
+    } catch (std::exception &e) {
+      callback->failure(range.address, MrfMemoryAccess::ErrorCode::unknown,
+          e.what());
+    }
+  }
+}
+
+template<typename T>
+std::map<std::uint32_t, T> MrfMemoryCache::getCache(
+    Shard<T> (&shards)[numberOfShards]) {
+  std::map<std::uint32_t, T> cache;
+  for (auto &shard : shards) {
+    // Access to the hash map has to be protected by the shard's mutex.
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    cache.insert(shard.values.begin(), shard.values.end());
+  }
+  return cache;
+}
+
+template<typename T, typename ReadFunction>
+T MrfMemoryCache::read(Shard<T> (&shards)[numberOfShards],
+    std::uint32_t address, ReadFunction readFunction) {
+  Shard<T> &shard = getShard(shards, address);
+  std::shared_ptr<Flight<T>> flight;
+  {
+    // Access to the hash maps has to be protected by the shard's mutex.
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    auto valueIterator = shard.values.find(address);
+    if (valueIterator != shard.values.end()) {
+      hits.increment();
+      return valueIterator->second;
+    }
+    // If the register could not be read when preheating the cache, we do not
+    // try again because this would most likely fail again after waiting for
+    // the timeout.
+    auto errorIterator = shard.errors.find(address);
+    if (errorIterator != shard.errors.end()) {
+      cachedErrors.increment();
+      throw std::runtime_error(errorIterator->second);
+    }
+    // If another thread is already reading the register, we wait for its
+    // result instead of reading the register again.
+    auto flightIterator = shard.flights.find(address);
+    if (flightIterator != shard.flights.end()) {
+      suppressedDuplicates.increment();
+      // We have to keep a reference to the flight because it is removed from
+      // the map when it finishes.
+      flight = flightIterator->second;
+      while (!flight->finished) {
+        shard.flightFinished.wait(lock);
+      }
+      if (!flight->successful) {
+        throw std::runtime_error(flight->errorMessage);
+      }
+      return flight->value;
+    }
+    misses.increment();
+    flight = std::make_shared<Flight<T>>();
+    shard.flights.emplace(address, flight);
+  }
+  // We read the register without holding the mutex because the read
+  // operation might take a lot of time and we do not want to block access to
+  // other registers in the meantime.
+  T value;
+  try {
+    value = readFunction(address);
+  } catch (std::exception &e) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    flight->finished = true;
+    flight->errorMessage = e.what();
+    shard.flights.erase(address);
+    shard.flightFinished.notify_all();
+    throw;
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    flight->finished = true;
+    flight->errorMessage = "Unknown error.";
+    shard.flights.erase(address);
+    shard.flightFinished.notify_all();
+    throw;
+  }
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  // If the value has been cached in the meantime (by one of the block
+  // methods), we prefer the cached value. This way, the behavior is
+  // independent of concurrency timings.
+  value = shard.values.emplace(address, value).first->second;
+  flight->finished = true;
+  flight->successful = true;
+  flight->value = value;
+  shard.flights.erase(address);
+  shard.flightFinished.notify_all();
+  return value;
+}
+
+template<typename T>
+void MrfMemoryCache::insert(Shard<T> (&shards)[numberOfShards],
+    std::uint32_t address, T value) {
+  Shard<T> &shard = getShard(shards, address);
+  // Access to the hash map has to be protected by the shard's mutex.
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  // Like in read, we prefer a value that has already been cached.
+  shard.values.emplace(address, value);
+}
+
+template<typename T>
+void MrfMemoryCache::replace(Shard<T> (&shards)[numberOfShards],
+    std::uint32_t address, T value) {
+  Shard<T> &shard = getShard(shards, address);
+  // Access to the hash maps has to be protected by the shard's mutex.
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.values[address] = value;
+  shard.errors.erase(address);
+}
+
+template<typename T>
+bool MrfMemoryCache::contains(Shard<T> (&shards)[numberOfShards],
+    std::uint32_t address) {
+  Shard<T> &shard = getShard(shards, address);
+  // Access to the hash maps has to be protected by the shard's mutex.
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.values.count(address) || shard.errors.count(address);
+}
+
+template<typename T>
+void MrfMemoryCache::insertError(Shard<T> (&shards)[numberOfShards],
+    std::uint32_t address, const std::string &errorMessage) {
+  Shard<T> &shard = getShard(shards, address);
+  // Access to the hash map has to be protected by the shard's mutex.
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.errors.emplace(address, errorMessage);
+}
+
 }
 }
 }
@@ -30,12 +30,21 @@
 #ifndef ANKA_MRF_EPICS_MEMORY_CACHE_H
 #define ANKA_MRF_EPICS_MEMORY_CACHE_H
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <MrfMemoryAccess.h>
+#include <MrfStatistics.h>
 
 namespace anka {
 namespace mrf {
@@ -54,11 +63,64 @@ namespace epics {
  * access (e.g. one using the UDP/IP protocol) does not slow down the
  * initialization of many records that refer to the same register (e.g. a
  * register that acts as a bit field).
+ *
+ * When a register that is not in the cache yet is requested by several
+ * threads at the same time, only the first thread reads it from the memory
+ * access and the other threads wait for the result of that read. The entries
+ * are distributed over several shards (based on their address), each with
+ * its own mutex, so that threads accessing different registers rarely have to
+ * wait for each other.
  */
 class MrfMemoryCache {
 
 public:
 
+  /**
+   * Width of the registers in a {@link PreheatRange}.
+   */
+  enum class RegisterWidth {
+
+    /**
+     * Unsigned 16-bit registers.
+     */
+    uInt16,
+
+    /**
+     * Unsigned 32-bit registers.
+     */
+    uInt32
+
+  };
+
+  /**
+   * Range of consecutive registers that is read when preheating the cache.
+   * The range starts at the specified address and contains the specified
+   * number of registers of the specified width.
+   */
+  struct PreheatRange {
+    RegisterWidth width;
+    std::uint32_t address;
+    std::size_t count;
+  };
+
+  /**
+   * Result of preheating the cache. The result contains the number of
+   * registers that were requested, the number of registers that could actually
+   * be read (and thus have been cached), and the time it took to process all
+   * requests.
+   */
+  struct PreheatResult {
+    std::size_t registersRequested;
+    std::size_t registersCached;
+    std::chrono::steady_clock::duration duration;
+  };
+
+  /**
+   * Default number of read operations that {@link preheat} keeps in flight at
+   * the same time.
+   */
+  static constexpr std::size_t defaultPreheatOperationsInFlight = 16;
+
   /**
    * Creates a cache using the specified memory-access. The wrapped memory
    * access must be kept alive until this cache is not used any longer.
@@ -111,6 +173,73 @@ public:
    */
   std::uint32_t readUInt32(std::uint32_t address);
 
+  /**
+   * Stores the specified value for an unsigned 16-bit register in the cache,
+   * without reading the register. If there already is a value for the
+   * register in the cache, that value is kept. This is used for loading the
+   * cache from a snapshot.
+   */
+  void insertUInt16(std::uint32_t address, std::uint16_t value);
+
+  /**
+   * Stores the specified value for an unsigned 32-bit register in the cache,
+   * without reading the register. If there already is a value for the
+   * register in the cache, that value is kept. This is used for loading the
+   * cache from a snapshot.
+   */
+  void insertUInt32(std::uint32_t address, std::uint32_t value);
+
+  /**
+   * Replaces the value of an unsigned 16-bit register in the cache with the
+   * specified value and marks the register as out of date (see
+   * {@link isOutOfDate(std::uint32_t)}). This is used when a value that has
+   * been loaded from a snapshot turns out to differ from the value in the
+   * device.
+   */
+  void correctUInt16(std::uint32_t address, std::uint16_t value);
+
+  /**
+   * Replaces the value of an unsigned 32-bit register in the cache with the
+   * specified value and marks the register as out of date (see
+   * {@link isOutOfDate(std::uint32_t)}). This is used when a value that has
+   * been loaded from a snapshot turns out to differ from the value in the
+   * device.
+   */
+  void correctUInt32(std::uint32_t address, std::uint32_t value);
+
+  /**
+   * Tells whether the value of the register at the specified address has been
+   * replaced by {@link correctUInt16(std::uint32_t, std::uint16_t)} or
+   * {@link correctUInt32(std::uint32_t, std::uint32_t)}. Records that have
+   * been initialized with the old value use this to avoid writing that value
+   * back to the device.
+   */
+  bool isOutOfDate(std::uint32_t address) const;
+
+  /**
+   * Marks the values in this cache as unverified. This is used when values
+   * have been loaded from a snapshot that is verified in the background. Until
+   * {@link finishVerification()} is called,
+   * {@link notifyWhenVerified(std::function<void()>)} defers callbacks.
+   */
+  void beginVerification();
+
+  /**
+   * Marks the verification that has been started by
+   * {@link beginVerification()} as finished and runs the callbacks that have
+   * been registered with {@link notifyWhenVerified(std::function<void()>)}.
+   * The callbacks are run in the calling thread.
+   */
+  void finishVerification();
+
+  /**
+   * Registers a callback that is run when the verification of the cached
+   * values has finished. Returns true if the callback has been registered.
+   * If no verification is in progress, the callback is not registered and
+   * false is returned, so that the caller can continue right away.
+   */
+  bool notifyWhenVerified(std::function<void()> callback);
+
   /**
    * Tries to read an unsigned 16-bit register. If the read attempt fails, the
    * error is silently ignored. This method is intended to warm up the cache, so
@@ -127,8 +256,128 @@ public:
    */
   void tryCacheUInt32(std::uint32_t address);
 
+  /**
+   * Tries to read a block of consecutive unsigned 16-bit registers, starting
+   * at the specified address. This method works like
+   * {@link tryCacheUInt16(std::uint32_t)}, but uses a single block operation,
+   * so that the memory access can treat the requests as bulk requests. If the
+   * block operation fails, the registers are read one by one, so that a single
+   * register that cannot be read does not keep the other registers from being
+   * cached.
+   */
+  void tryCacheUInt16Block(std::uint32_t address, std::size_t count);
+
+  /**
+   * Tries to read a block of consecutive unsigned 32-bit registers, starting
+   * at the specified address. This method works like
+   * {@link tryCacheUInt32(std::uint32_t)}, but uses a single block operation,
+   * so that the memory access can treat the requests as bulk requests. If the
+   * block operation fails, the registers are read one by one, so that a single
+   * register that cannot be read does not keep the other registers from being
+   * cached.
+   */
+  void tryCacheUInt32Block(std::uint32_t address, std::size_t count);
+
+  /**
+   * Reads the specified register ranges and stores the values in the cache.
+   * Unlike the {@code tryCache} methods, this method uses the asynchronous
+   * API of the memory access, so that read operations for different parts of
+   * the ranges are in flight at the same time instead of one being started
+   * only after the previous one has finished. Each range is split into blocks
+   * of at most 32 registers, and at most the specified number of these blocks
+   * is read at the same time. If a block cannot be read, its registers are
+   * read one by one, so that a single register that cannot be read does not
+   * keep the other registers from being cached. Errors are not reported
+   * otherwise. Registers that already are in the cache are not read again, and
+   * they are not included in the number of requested registers in the
+   * returned result.
+   *
+   * If a register cannot be read, the error is cached as well: subsequent
+   * calls to {@link readUInt16} or {@link readUInt32} for the register throw
+   * an exception with the same error message instead of trying to read the
+   * register again. This way, the records that use registers of a device that
+   * is not reachable fail immediately during initialization instead of each
+   * of them waiting for the timeout one after another.
+   *
+   * This method blocks until all read operations have finished. While it is
+   * running, its progress is available through the statistics reported by
+   * {@link collectStatistics}. Throws an exception if
+   * {@code maximumOperationsInFlight} is zero.
+   */
+  PreheatResult preheat(const std::vector<PreheatRange> &ranges,
+      std::size_t maximumOperationsInFlight = defaultPreheatOperationsInFlight);
+
+  /**
+   * Adds the statistics of this cache to the specified statistics object. The
+   * statistics count the read requests that were served from the cache
+   * ("cache.hits"), the ones that had to be delegated to the memory access
+   * ("cache.misses"), and the ones that waited for a read of the same register
+   * that was already in progress ("cache.suppressedDuplicates"), and the ones
+   * that failed because of an error cached by {@link preheat}
+   * ("cache.cachedErrors"). In addition
+   * to that, they contain the number of registers that have been requested
+   * ("cache.preheatRegisters"), read ("cache.preheatRegistersCached"), and not
+   * read because of an error ("cache.preheatRegistersFailed") by
+   * {@link preheat}, and the total time spent in that method in microseconds
+   * ("cache.preheatTimeUs").
+   */
+  void collectStatistics(MrfStatistics &statistics) const;
+
 private:
 
+  /**
+   * Number of shards. This must be a power of two.
+   */
+  static constexpr std::size_t numberOfShards = 16;
+
+  /**
+   * Maximum number of registers read by a single block operation when
+   * preheating the cache.
+   */
+  static constexpr std::size_t preheatBlockSize = 32;
+
+  /**
+   * State shared between {@link preheat} and the callbacks of the read
+   * operations that it starts.
+   */
+  struct PreheatState;
+
+  /**
+   * Callback for the block read operations started by {@link preheat}.
+   */
+  template<typename T>
+  class PreheatCallback;
+
+  /**
+   * Read operation that is in progress. Threads that request the same
+   * register while the read operation is in progress wait for it to finish
+   * instead of reading the register again.
+   */
+  template<typename T>
+  struct Flight {
+    bool finished = false;
+    bool successful = false;
+    T value = 0;
+    std::string errorMessage;
+  };
+
+  /**
+   * Part of the cache holding the registers of one width for a subset of the
+   * addresses. The mutex protects the maps, and the condition variable is
+   * notified when one of the read operations of this shard finishes. The
+   * errors map contains the error messages for registers that could not be
+   * read when preheating the cache.
+   */
+  template<typename T>
+  struct Shard {
+    std::mutex mutex;
+    std::condition_variable flightFinished;
+    std::unordered_map<std::uint32_t, T> values;
+    std::unordered_map<std::uint32_t, std::string> errors;
+    std::unordered_map<std::uint32_t, std::shared_ptr<Flight<T>>> flights;
+  };
+
+
   // We do not want to allow copy or move construction or assignment.
   MrfMemoryCache(const MrfMemoryCache &) = delete;
   MrfMemoryCache(MrfMemoryCache &&) = delete;
@@ -138,10 +387,58 @@ private:
   MrfMemoryAccess &memoryAccess;
   std::shared_ptr<MrfMemoryAccess> memoryAccessPtr;
 
-  mutable std::recursive_mutex mutex;
+  mutable Shard<std::uint16_t> shardsUInt16[numberOfShards];
+  mutable Shard<std::uint32_t> shardsUInt32[numberOfShards];
+
+  MrfStatisticsCounter hits;
+  MrfStatisticsCounter misses;
+  MrfStatisticsCounter suppressedDuplicates;
+  MrfStatisticsCounter cachedErrors;
+  MrfStatisticsCounter preheatRegisters;
+  MrfStatisticsCounter preheatRegistersCached;
+  MrfStatisticsCounter preheatRegistersFailed;
+  MrfStatisticsCounter preheatTime;
+  // The set of out-of-date addresses and the verification state are
+  // protected by the verification mutex.
+  mutable std::mutex verificationMutex;
+  std::unordered_set<std::uint32_t> outOfDateAddresses;
+  bool verificationPending = false;
+  std::vector<std::function<void()>> verificationCallbacks;
+
+  template<typename T>
+  static Shard<T> &getShard(Shard<T> (&shards)[numberOfShards],
+      std::uint32_t address) {
+    // The lowest two bits of the address are the same for most registers, so
+    // we do not use them for selecting the shard.
+    return shards[(address >> 2) & (numberOfShards - 1)];
+  }
+
+  template<typename T>
+  static std::map<std::uint32_t, T> getCache(
+      Shard<T> (&shards)[numberOfShards]);
+
+  template<typename T, typename ReadFunction>
+  T read(Shard<T> (&shards)[numberOfShards], std::uint32_t address,
+      ReadFunction readFunction);
+
+  void startPreheatOperation(const std::shared_ptr<PreheatState> &state,
+      const PreheatRange &range);
+
+  template<typename T>
+  static void insert(Shard<T> (&shards)[numberOfShards],
+      std::uint32_t address, T value);
+
+  template<typename T>
+  static void replace(Shard<T> (&shards)[numberOfShards],
+      std::uint32_t address, T value);
+
+  template<typename T>
+  static bool contains(Shard<T> (&shards)[numberOfShards],
+      std::uint32_t address);
 
-  std::unordered_map<std::uint32_t, std::uint16_t> cacheUInt16;
-  std::unordered_map<std::uint32_t, std::uint32_t> cacheUInt32;
+  template<typename T>
+  static void insertError(Shard<T> (&shards)[numberOfShards],
+      std::uint32_t address, const std::string &errorMessage);
 
 };
 
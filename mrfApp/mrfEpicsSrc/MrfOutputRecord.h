@@ -101,13 +101,21 @@ private:
   std::uint32_t writeRequestValue;
   std::uint32_t writeReplyValue;
   std::string writeErrorMessage;
+  bool initialValuePending;
+  std::uint32_t initialDeviceValue;
+  bool writeSkipped;
+
+  bool isInitialValueOutOfDate();
+  void finishInitialValueCheck() noexcept;
+  void startWrite();
 
 };
 
 template<typename RecordType>
 MrfOutputRecord<RecordType>::MrfOutputRecord(RecordType *record) :
     MrfRecord<RecordType>(record, record->out), writeSuccessful(false), writeRequestValue(
-        0), writeReplyValue(0) {
+        0), writeReplyValue(0), initialValuePending(false), initialDeviceValue(
+        0), writeSkipped(false) {
 }
 
 template<typename RecordType>
@@ -123,18 +131,19 @@ void MrfOutputRecord<RecordType>::initializeValue() {
     }
     switch (this->getRecordAddress().getDataType()) {
     case MrfRecordAddress::DataType::uInt16:
-      this->writeRecordValue(
-          this->convertFromDevice(
-              deviceCache->readUInt16(
-                  this->getRecordAddress().getMemoryAddress())));
+      initialDeviceValue = deviceCache->readUInt16(
+          this->getRecordAddress().getMemoryAddress());
       break;
     case MrfRecordAddress::DataType::uInt32:
-      this->writeRecordValue(
-          this->convertFromDevice(
-              deviceCache->readUInt32(
-                  this->getRecordAddress().getMemoryAddress())));
+      initialDeviceValue = deviceCache->readUInt32(
+          this->getRecordAddress().getMemoryAddress());
       break;
     }
+    this->writeRecordValue(this->convertFromDevice(initialDeviceValue));
+    // The value might have been loaded from a cache snapshot that is still
+    // being verified, so we check it when the record is processed for the
+    // first time.
+    initialValuePending = true;
     // The record's value has been initialized, therefore it is not undefined
     // any longer.
     this->getRecord()->udf = false;
@@ -152,6 +161,59 @@ void MrfOutputRecord<RecordType>::initializeValue() {
 template<typename RecordType>
 void MrfOutputRecord<RecordType>::processPrepare() {
   this->writeRequestValue = this->convertToDevice(this->readRecordValue());
+  // If the record is processed for the first time and still has the value it
+  // was initialized with, but this value was taken from a cache snapshot that
+  // turned out to be out of date, we must not write it. Doing so would
+  // overwrite the device's actual setting with a stale one.
+  if (initialValuePending) {
+    initialValuePending = false;
+    if ((this->writeRequestValue & this->getMask())
+        == (initialDeviceValue & this->getMask())) {
+      // If the snapshot is still being verified, we cannot tell yet whether
+      // the value is out of date, so we delay the write until the
+      // verification has finished. The record stays active in the meantime.
+      std::shared_ptr<MrfMemoryCache> deviceCache =
+          MrfDeviceRegistry::getInstance().getDeviceCache(
+              this->getRecordAddress().getDeviceId());
+      if (deviceCache
+          && deviceCache->notifyWhenVerified(
+              [this]() {this->finishInitialValueCheck();})) {
+        return;
+      }
+      if (isInitialValueOutOfDate()) {
+        writeSkipped = true;
+        this->scheduleProcessing();
+        return;
+      }
+    }
+  }
+  startWrite();
+}
+
+template<typename RecordType>
+void MrfOutputRecord<RecordType>::finishInitialValueCheck() noexcept {
+  // This method is called by the thread verifying the cache snapshot while the
+  // record is active, so no other thread touches the record's write state.
+  try {
+    if (isInitialValueOutOfDate()) {
+      writeSkipped = true;
+      this->scheduleProcessing();
+    } else {
+      startWrite();
+    }
+  } catch (std::exception &e) {
+    writeSuccessful = false;
+    writeErrorMessage = e.what();
+    this->scheduleProcessing();
+  } catch (...) {
+    writeSuccessful = false;
+    writeErrorMessage = "Unknown error.";
+    this->scheduleProcessing();
+  }
+}
+
+template<typename RecordType>
+void MrfOutputRecord<RecordType>::startWrite() {
   switch (this->getRecordAddress().getDataType()) {
   case MrfRecordAddress::DataType::uInt16: {
     auto callback = std::make_shared<CallbackImpl<std::uint16_t>>(*this);
@@ -182,11 +244,16 @@ void MrfOutputRecord<RecordType>::processPrepare() {
     break;
   }
   }
-
 }
 
 template<typename RecordType>
 void MrfOutputRecord<RecordType>::processComplete() {
+  if (writeSkipped) {
+    writeSkipped = false;
+    recGblSetSevr(this->getRecord(), UDF_ALARM, INVALID_ALARM);
+    throw std::runtime_error(
+        "The value has not been written because it was initialized from an out-of-date cache snapshot.");
+  }
   if (writeSuccessful) {
     if (this->getRecordAddress().isVerify()) {
       if ((writeReplyValue & this->getMask())
@@ -202,6 +269,32 @@ void MrfOutputRecord<RecordType>::processComplete() {
   }
 }
 
+template<typename RecordType>
+bool MrfOutputRecord<RecordType>::isInitialValueOutOfDate() {
+  std::shared_ptr<MrfMemoryCache> deviceCache =
+      MrfDeviceRegistry::getInstance().getDeviceCache(
+          this->getRecordAddress().getDeviceId());
+  std::uint32_t address = this->getRecordAddress().getMemoryAddress();
+  if (!deviceCache || !deviceCache->isOutOfDate(address)) {
+    return false;
+  }
+  // The cache holds the value read from the device when the snapshot was
+  // verified. If the bits used by this record did not change, the initial
+  // value is fine.
+  std::uint32_t currentDeviceValue;
+  switch (this->getRecordAddress().getDataType()) {
+  case MrfRecordAddress::DataType::uInt16:
+    currentDeviceValue = deviceCache->readUInt16(address);
+    break;
+  case MrfRecordAddress::DataType::uInt32:
+  default:
+    currentDeviceValue = deviceCache->readUInt32(address);
+    break;
+  }
+  return (currentDeviceValue & this->getMask())
+      != (initialDeviceValue & this->getMask());
+}
+
 template<typename RecordType>
 template<typename T>
 MrfOutputRecord<RecordType>::CallbackImpl<T>::CallbackImpl(
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <dbFldTypes.h>
+
+#include "MrfDeviceRegistry.h"
+
+#include "MrfStatisticsRecord.h"
+
+namespace anka {
+namespace mrf {
+namespace epics {
+
+MrfStatisticsRecord::MrfStatisticsRecord(const ::DBLINK &addressField,
+    bool histogram) {
+  if (addressField.type != INST_IO) {
+    throw std::runtime_error(
+        "Invalid device address. Maybe mixed up INP/OUT or forgot '@'?");
+  }
+  std::istringstream addressStream(
+      addressField.value.instio.string == nullptr ?
+          "" : addressField.value.instio.string);
+  std::string deviceId;
+  std::string extraToken;
+  addressStream >> deviceId >> statisticName;
+  if (deviceId.empty() || statisticName.empty()) {
+    throw std::runtime_error(
+        "Invalid device address. The address must specify a device ID and the name of a statistic.");
+  }
+  if (addressStream >> extraToken) {
+    throw std::runtime_error(
+        std::string("Invalid device address. Unexpected token: ")
+            + extraToken);
+  }
+  this->device = MrfDeviceRegistry::getInstance().getDevice(deviceId);
+  if (!this->device) {
+    throw std::runtime_error(
+        std::string("Could not find device ") + deviceId + ".");
+  }
+  // We check that the statistic exists now, so that a typo in the address is
+  // detected when the IOC starts.
+  MrfStatistics statistics;
+  this->device->collectStatistics(statistics);
+  std::uint64_t counter;
+  if (histogram && !statistics.findHistogram(statisticName)) {
+    throw std::runtime_error(
+        std::string("Device ") + deviceId
+            + " does not provide a histogram with the name " + statisticName
+            + ".");
+  } else if (!histogram && !statistics.findCounter(statisticName, counter)) {
+    throw std::runtime_error(
+        std::string("Device ") + deviceId
+            + " does not provide a counter with the name " + statisticName
+            + ".");
+  }
+}
+
+std::uint64_t MrfStatisticsRecord::getCounter() {
+  MrfStatistics statistics;
+  this->device->collectStatistics(statistics);
+  std::uint64_t counter;
+  if (!statistics.findCounter(statisticName, counter)) {
+    throw std::runtime_error(
+        std::string("Could not find counter ") + statisticName + ".");
+  }
+  return counter;
+}
+
+std::vector<std::uint64_t> MrfStatisticsRecord::getHistogram() {
+  MrfStatistics statistics;
+  this->device->collectStatistics(statistics);
+  auto histogram = statistics.findHistogram(statisticName);
+  if (!histogram) {
+    throw std::runtime_error(
+        std::string("Could not find histogram ") + statisticName + ".");
+  }
+  return *histogram;
+}
+
+MrfAiStatisticsRecord::MrfAiStatisticsRecord(::aiRecord *record) :
+    MrfStatisticsRecord(record->inp, false), record(record) {
+}
+
+void MrfAiStatisticsRecord::processRecord() {
+  this->record->val = static_cast<double>(getCounter());
+  this->record->udf = false;
+}
+
+MrfLonginStatisticsRecord::MrfLonginStatisticsRecord(::longinRecord *record) :
+    MrfStatisticsRecord(record->inp, false), record(record) {
+}
+
+void MrfLonginStatisticsRecord::processRecord() {
+  std::uint64_t counter = getCounter();
+  this->record->val = static_cast<epicsInt32>(std::min(counter,
+      static_cast<std::uint64_t>(std::numeric_limits<epicsInt32>::max())));
+  this->record->udf = false;
+}
+
+MrfWaveformStatisticsRecord::MrfWaveformStatisticsRecord(
+    ::waveformRecord *record) :
+    MrfStatisticsRecord(record->inp, true), record(record) {
+  if (this->record->ftvl != DBF_DOUBLE && this->record->ftvl != DBF_LONG
+      && this->record->ftvl != DBF_ULONG) {
+    throw std::runtime_error(
+        "Invalid FTVL. The histogram can only be stored as DOUBLE, LONG, or ULONG.");
+  }
+}
+
+void MrfWaveformStatisticsRecord::processRecord() {
+  std::vector<std::uint64_t> histogram = getHistogram();
+  epicsUInt32 numberOfElements = static_cast<epicsUInt32>(std::min(
+      histogram.size(), static_cast<std::size_t>(this->record->nelm)));
+  for (epicsUInt32 i = 0; i < numberOfElements; ++i) {
+    switch (this->record->ftvl) {
+    case DBF_DOUBLE:
+      static_cast<epicsFloat64 *>(this->record->bptr)[i] =
+          static_cast<epicsFloat64>(histogram[i]);
+      break;
+    case DBF_LONG:
+      static_cast<epicsInt32 *>(this->record->bptr)[i] =
+          static_cast<epicsInt32>(std::min(histogram[i],
+              static_cast<std::uint64_t>(
+                  std::numeric_limits<epicsInt32>::max())));
+      break;
+    case DBF_ULONG:
+      static_cast<epicsUInt32 *>(this->record->bptr)[i] =
+          static_cast<epicsUInt32>(std::min(histogram[i],
+              static_cast<std::uint64_t>(
+                  std::numeric_limits<epicsUInt32>::max())));
+      break;
+    default:
+      // The FTVL has been checked when initializing the record.
+      break;
+    }
+  }
+  this->record->nord = numberOfElements;
+  this->record->udf = false;
+}
+
+}
+}
+}
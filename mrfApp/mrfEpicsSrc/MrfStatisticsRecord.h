@@ -0,0 +1,212 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_EPICS_STATISTICS_RECORD_H
+#define ANKA_MRF_EPICS_STATISTICS_RECORD_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <aiRecord.h>
+#include <longinRecord.h>
+#include <waveformRecord.h>
+
+#include <MrfConsistentMemoryAccess.h>
+#include <MrfStatistics.h>
+
+namespace anka {
+namespace mrf {
+namespace epics {
+
+/**
+ * Base class for the device supports that provide the runtime statistics of a
+ * device. The address of such a record has the form
+ * "@<device ID> <statistic name>", where the statistic name is one of the
+ * names printed by the {@code mrfStats} IOC shell command.
+ *
+ * The statistics are collected synchronously when the record is processed.
+ * Collecting the statistics is cheap, so the records can be processed
+ * periodically without affecting the performance of the device.
+ */
+class MrfStatisticsRecord {
+
+protected:
+
+  /**
+   * Creates the device support for a record with the specified address
+   * field. If {@code histogram} is {@code true}, the specified statistic must
+   * be a histogram, otherwise it must be a counter. Throws an exception if the
+   * address is invalid, the device does not exist, or the device does not
+   * provide the specified statistic.
+   */
+  MrfStatisticsRecord(const ::DBLINK &addressField, bool histogram);
+
+  /**
+   * Returns the current value of the counter specified in the record address.
+   * Throws an exception if the device does not provide the counter any longer.
+   */
+  std::uint64_t getCounter();
+
+  /**
+   * Returns the current contents of the histogram specified in the record
+   * address. Throws an exception if the device does not provide the histogram
+   * any longer.
+   */
+  std::vector<std::uint64_t> getHistogram();
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  MrfStatisticsRecord(const MrfStatisticsRecord &) = delete;
+  MrfStatisticsRecord(MrfStatisticsRecord &&) = delete;
+  MrfStatisticsRecord &operator=(const MrfStatisticsRecord &) = delete;
+  MrfStatisticsRecord &operator=(MrfStatisticsRecord &&) = delete;
+
+  /**
+   * Pointer to the underlying device.
+   */
+  std::shared_ptr<MrfConsistentMemoryAccess> device;
+
+  /**
+   * Name of the statistic specified in the record address.
+   */
+  std::string statisticName;
+
+};
+
+/**
+ * Device support class for the ai record providing the value of a counter.
+ * The value is written to the VAL field directly, so no conversion is
+ * applied.
+ */
+class MrfAiStatisticsRecord: public MrfStatisticsRecord {
+
+public:
+
+  /**
+   * Type of data structure used by the supported record.
+   */
+  using RecordType = ::aiRecord;
+
+  /**
+   * Creates an instance of the device support for the specified record.
+   */
+  MrfAiStatisticsRecord(::aiRecord *record);
+
+  /**
+   * Called each time the record is processed. Copies the current value of the
+   * counter into the record's VAL field.
+   */
+  void processRecord();
+
+private:
+
+  /**
+   * Record this device support has been instantiated for.
+   */
+  ::aiRecord *record;
+
+};
+
+/**
+ * Device support class for the longin record providing the value of a
+ * counter. Values that do not fit into the VAL field are saturated.
+ */
+class MrfLonginStatisticsRecord: public MrfStatisticsRecord {
+
+public:
+
+  /**
+   * Type of data structure used by the supported record.
+   */
+  using RecordType = ::longinRecord;
+
+  /**
+   * Creates an instance of the device support for the specified record.
+   */
+  MrfLonginStatisticsRecord(::longinRecord *record);
+
+  /**
+   * Called each time the record is processed. Copies the current value of the
+   * counter into the record's VAL field.
+   */
+  void processRecord();
+
+private:
+
+  /**
+   * Record this device support has been instantiated for.
+   */
+  ::longinRecord *record;
+
+};
+
+/**
+ * Device support class for the waveform record providing the contents of a
+ * latency histogram. Element n of the waveform is the number of samples in
+ * bucket n of the histogram (see {@link MrfLatencyHistogram}). The FTVL field
+ * must be set to DOUBLE, LONG, or ULONG. Buckets that do not fit into the
+ * record are not copied.
+ */
+class MrfWaveformStatisticsRecord: public MrfStatisticsRecord {
+
+public:
+
+  /**
+   * Type of data structure used by the supported record.
+   */
+  using RecordType = ::waveformRecord;
+
+  /**
+   * Creates an instance of the device support for the specified record.
+   */
+  MrfWaveformStatisticsRecord(::waveformRecord *record);
+
+  /**
+   * Called each time the record is processed. Copies the current contents of
+   * the histogram into the record's value buffer.
+   */
+  void processRecord();
+
+private:
+
+  /**
+   * Record this device support has been instantiated for.
+   */
+  ::waveformRecord *record;
+
+};
+
+}
+}
+}
+
+#endif // ANKA_MRF_EPICS_STATISTICS_RECORD_H
@@ -27,6 +27,7 @@
  * of the GNU LGPL version 3 or newer.
  */
 
+#include <algorithm>
 #include <cstring>
 
 #include <alarm.h>
@@ -55,18 +56,16 @@ MrfRecordAddress readRecordAddress(const ::DBLINK &addressField) {
 
 } // End of anonymous namespace
 
-void MrfWaveformInRecord::CallbackImpl::success(uint32_t address,
-    uint32_t value) {
+void MrfWaveformInRecord::CallbackImpl::success(uint32_t,
+    const std::vector<std::uint32_t> &values) {
   std::unique_lock<std::recursive_mutex> lock(deviceSupport.mutex);
   try {
-    std::uint32_t arrayIndex = (address
-        - deviceSupport.address.getMemoryAddress())
-        / (sizeof(std::uint32_t) + deviceSupport.address.getElementDistance());
-    // The address might come from the network, so we should not trust the value
-    // but make a sanity check.
-    if (arrayIndex < deviceSupport.lastValueRead.size()) {
-      deviceSupport.lastValueRead[arrayIndex] = value;
-    }
+    // The number of values should always match, but we do not want to risk
+    // a buffer overrun if it does not.
+    std::size_t count = std::min(values.size(),
+        deviceSupport.lastValueRead.size());
+    std::copy(values.begin(), values.begin() + count,
+        deviceSupport.lastValueRead.begin());
   } catch (...) {
     // If there is any error, we still want to decrement the
     // pendingReadRequests counter and process the record again.
@@ -192,14 +191,11 @@ void MrfWaveformInRecord::processRecord() {
     // ensures that the callback does not trigger actions prematurely if it is
     // called within the same thread.
     pendingReadRequests = 1;
-    for (std::uint32_t arrayIndex = 0; arrayIndex < record->nelm;
-        ++arrayIndex) {
-      ++pendingReadRequests;
-      device->readUInt32(
-          address.getMemoryAddress()
-              + (sizeof(std::uint32_t) + address.getElementDistance())
-                  * arrayIndex, readCallback);
-    }
+    // We read all elements with a single block operation, so that the memory
+    // access can process them efficiently.
+    ++pendingReadRequests;
+    device->readUInt32Block(address.getMemoryAddress(), record->nelm,
+        sizeof(std::uint32_t) + address.getElementDistance(), readCallback);
     // Now we can decrement the number of pending read requests so that it
     // matches the actual number. If the remaining number is zero, we are
     // already finished.
@@ -80,12 +80,13 @@ private:
   /**
    * Callback implementation used for reading array elements.
    */
-  struct CallbackImpl: MrfMemoryAccess::CallbackUInt32 {
+  struct CallbackImpl: MrfMemoryAccess::BlockCallbackUInt32 {
     MrfWaveformInRecord &deviceSupport;
     CallbackImpl(MrfWaveformInRecord &deviceSupport) :
         deviceSupport(deviceSupport) {
     }
-    void success(std::uint32_t address, std::uint32_t value);
+    void success(std::uint32_t address,
+        const std::vector<std::uint32_t> &values);
     void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
         const std::string &details);
   };
@@ -30,6 +30,7 @@
 #include <cstring>
 
 #include <alarm.h>
+#include <dbAccess.h>
 #include <dbFldTypes.h>
 #include <recGbl.h>
 
@@ -56,15 +57,21 @@ MrfRecordAddress readRecordAddress(const ::DBLINK &addressField) {
 } // End of anonymous namespace
 
 void MrfWaveformOutRecord::CallbackImpl::success(uint32_t address,
-    uint32_t value) {
+    const std::vector<std::uint32_t> &values) {
   std::unique_lock<std::recursive_mutex> lock(deviceSupport.mutex);
   try {
-    std::uint32_t arrayIndex = (address
+    std::uint32_t firstArrayIndex = (address
         - deviceSupport.address.getMemoryAddress())
         / (sizeof(std::uint32_t) + deviceSupport.address.getElementDistance());
-    // The address might come from the network, so we should not trust the value
-    // but make a sanity check.
-    if (arrayIndex < deviceSupport.lastValueWritten.size()) {
+    for (std::size_t valueIndex = 0; valueIndex < values.size();
+        ++valueIndex) {
+      std::size_t arrayIndex = firstArrayIndex + valueIndex;
+      std::uint32_t value = values[valueIndex];
+      // We make a sanity check so that we never write beyond the end of the
+      // array.
+      if (arrayIndex >= deviceSupport.lastValueWritten.size()) {
+        break;
+      }
       if (!deviceSupport.address.isVerify()
           || deviceSupport.lastValueWritten[arrayIndex] == value) {
         deviceSupport.lastValueWrittenValid[arrayIndex] = true;
@@ -114,7 +121,8 @@ MrfWaveformOutRecord::MrfWaveformOutRecord(::waveformRecord *record) :
     address(readRecordAddress(record->inp)), record(record), writeCallback(
         std::make_shared<CallbackImpl>(*this)), writeSuccessful(false), pendingWriteRequests(
         0), lastValueWritten(record->nelm), lastValueWrittenValid(record->nelm,
-        false) {
+        false), initialValuePending(false), elementSkipped(record->nelm,
+        false), writeSkipped(false) {
   if (this->record->ftvl != DBF_CHAR && this->record->ftvl != DBF_UCHAR
       && this->record->ftvl != DBF_SHORT && this->record->ftvl != DBF_USHORT
       && this->record->ftvl != DBF_LONG && this->record->ftvl != DBF_ULONG) {
@@ -180,6 +188,11 @@ MrfWaveformOutRecord::MrfWaveformOutRecord(::waveformRecord *record) :
         break;
       }
     }
+    // The value might have been loaded from a cache snapshot that is still
+    // being verified, so we check it when the record is processed for the
+    // first time.
+    initialValue = lastValueWritten;
+    initialValuePending = true;
     // The record's value has been initialized, thus it is not undefined any
     // longer.
     this->record->udf = false;
@@ -217,14 +230,7 @@ void MrfWaveformOutRecord::processRecord() {
   this->record->nord = this->record->nelm;
   if (this->record->pact) {
     this->record->pact = false;
-    if (!writeSuccessful) {
-      recGblSetSevr(this->record, WRITE_ALARM, INVALID_ALARM);
-      throw std::runtime_error(writeErrorMessage);
-    } else {
-      // The value has been written successfully, thus the record is not
-      // undefined any longer.
-      this->record->udf = false;
-    }
+    completeWrite();
   } else {
     // We have to hold the mutex in this block. That ensures that callbacks,
     // that are triggered asynchronously are not processed before we finish.
@@ -232,71 +238,177 @@ void MrfWaveformOutRecord::processRecord() {
     // We set the writeSuccessful flag. If one of the write requests fails, it
     // is cleared by the callback.
     writeSuccessful = true;
-    std::uint8_t *recordValueBufferUInt8 =
-        reinterpret_cast<std::uint8_t *>(this->record->bptr);
-    std::uint16_t *recordValueBufferUInt16 =
-        reinterpret_cast<std::uint16_t *>(this->record->bptr);
-    std::uint32_t *recordValueBufferUInt32 =
-        reinterpret_cast<std::uint32_t *>(this->record->bptr);
-    // We start with a non-zero value for the pending write requests. This
-    // ensures that the callback does not trigger actions prematurely if it is
-    // called within the same thread.
-    pendingWriteRequests = 1;
-    for (std::uint32_t arrayIndex = 0; arrayIndex < record->nelm;
-        ++arrayIndex) {
-      std::uint32_t value;
-      switch (record->ftvl) {
-      case DBF_CHAR:
-      case DBF_UCHAR:
-        value = recordValueBufferUInt8[arrayIndex];
-        break;
-      case DBF_SHORT:
-      case DBF_USHORT:
-        value = recordValueBufferUInt16[arrayIndex];
-        break;
-      case DBF_LONG:
-      case DBF_ULONG:
-        value = recordValueBufferUInt32[arrayIndex];
-        break;
-      default:
-        // The default case can never happen because we ensure earlier that we
-        // have a supported type, but the compiler complains about use of an
-        // uninitialized value if we do not have this branch.
-        value = 0;
-        break;
+    if (initialValuePending) {
+      initialValuePending = false;
+      // If the snapshot is still being verified, we cannot tell yet whether
+      // the initial value is out of date, so we delay the write until the
+      // verification has finished. The record stays active in the meantime.
+      std::shared_ptr<MrfMemoryCache> deviceCache =
+          MrfDeviceRegistry::getInstance().getDeviceCache(
+              this->address.getDeviceId());
+      if (deviceCache
+          && deviceCache->notifyWhenVerified(
+              [this]() {this->finishInitialValueCheck();})) {
+        this->record->pact = true;
+        return;
       }
-      if (!address.isChangedElementsOnly() || !lastValueWrittenValid[arrayIndex]
-          || lastValueWritten[arrayIndex] != value) {
-        // We set the valid flag to false. This ensures that the element will
-        // be written again the next time if the write attempt is not
-        // successful. If it is successful, the flag will be set again by the
-        // callback.
-        lastValueWrittenValid[arrayIndex] = false;
-        lastValueWritten[arrayIndex] = value;
-        ++pendingWriteRequests;
-        device->writeUInt32(
-            address.getMemoryAddress()
-                + (sizeof(std::uint32_t) + address.getElementDistance())
-                    * arrayIndex, value, writeCallback);
+      writeSkipped = checkInitialValues();
+    }
+    if (startWrite()) {
+      this->record->pact = true;
+    } else {
+      completeWrite();
+    }
+  }
+}
+
+void MrfWaveformOutRecord::completeWrite() {
+  bool skipped = writeSkipped;
+  writeSkipped = false;
+  if (!writeSuccessful) {
+    recGblSetSevr(this->record, WRITE_ALARM, INVALID_ALARM);
+    throw std::runtime_error(writeErrorMessage);
+  } else if (skipped) {
+    recGblSetSevr(this->record, UDF_ALARM, INVALID_ALARM);
+    throw std::runtime_error(
+        "Some elements have not been written because they were initialized from an out-of-date cache snapshot.");
+  } else {
+    // The value has been written successfully, thus the record is not
+    // undefined any longer.
+    this->record->udf = false;
+  }
+}
+
+bool MrfWaveformOutRecord::checkInitialValues() {
+  std::shared_ptr<MrfMemoryCache> deviceCache =
+      MrfDeviceRegistry::getInstance().getDeviceCache(
+          this->address.getDeviceId());
+  if (!deviceCache) {
+    return false;
+  }
+  std::uint32_t stride = sizeof(std::uint32_t) + address.getElementDistance();
+  bool anySkipped = false;
+  for (std::uint32_t arrayIndex = 0; arrayIndex < record->nelm;
+      ++arrayIndex) {
+    std::uint32_t elementAddress = address.getMemoryAddress()
+        + stride * arrayIndex;
+    if (!deviceCache->isOutOfDate(elementAddress)) {
+      continue;
+    }
+    // The cache holds the value read from the device when the snapshot was
+    // verified. From now on, we compare against this value when only changed
+    // elements are written.
+    std::uint32_t currentValue = deviceCache->readUInt32(elementAddress);
+    if (currentValue != initialValue[arrayIndex]
+        && getElementValue(arrayIndex) == initialValue[arrayIndex]) {
+      elementSkipped[arrayIndex] = true;
+      anySkipped = true;
+    }
+    lastValueWritten[arrayIndex] = currentValue;
+    lastValueWrittenValid[arrayIndex] = true;
+  }
+  // The initial value is only needed once, so we can release its memory.
+  std::vector<std::uint32_t>().swap(initialValue);
+  return anySkipped;
+}
+
+void MrfWaveformOutRecord::finishInitialValueCheck() noexcept {
+  // This method is called by the thread verifying the cache snapshot. We have
+  // to lock the record because its value might be changed while it is active.
+  ::dbScanLock(reinterpret_cast<::dbCommon *>(this->record));
+  {
+    std::unique_lock<std::recursive_mutex> lock(mutex);
+    try {
+      writeSkipped = checkInitialValues();
+      if (startWrite()) {
+        // The write callback processes the record when the last request has
+        // finished.
+        lock.unlock();
+        ::dbScanUnlock(reinterpret_cast<::dbCommon *>(this->record));
+        return;
       }
+    } catch (std::exception &e) {
+      writeSuccessful = false;
+      writeErrorMessage = e.what();
+    } catch (...) {
+      writeSuccessful = false;
+      writeErrorMessage = "Unknown error.";
     }
-    // Now we can decrement the number of pending write requests so that it
-    // matches the actual number. If the remaining number is zero, we are
-    // already finished.
-    --pendingWriteRequests;
-    if (pendingWriteRequests == 0) {
-      if (!writeSuccessful) {
-        recGblSetSevr(this->record, WRITE_ALARM, INVALID_ALARM);
-        throw std::runtime_error(writeErrorMessage);
-      } else {
-        // The value has been written successfully, thus the record is not
-        // undefined any longer.
-        this->record->udf = false;
+  }
+  ::dbScanUnlock(reinterpret_cast<::dbCommon *>(this->record));
+  ::callbackRequestProcessCallback(&processCallback, priorityMedium, record);
+}
+
+std::uint32_t MrfWaveformOutRecord::getElementValue(std::uint32_t arrayIndex) {
+  switch (record->ftvl) {
+  case DBF_CHAR:
+  case DBF_UCHAR:
+    return reinterpret_cast<std::uint8_t *>(this->record->bptr)[arrayIndex];
+  case DBF_SHORT:
+  case DBF_USHORT:
+    return reinterpret_cast<std::uint16_t *>(this->record->bptr)[arrayIndex];
+  case DBF_LONG:
+  case DBF_ULONG:
+    return reinterpret_cast<std::uint32_t *>(this->record->bptr)[arrayIndex];
+  default:
+    // The default case can never happen because we ensure earlier that we
+    // have a supported type, but the compiler complains about a missing return
+    // value if we do not have this branch.
+    return 0;
+  }
+}
+
+bool MrfWaveformOutRecord::startWrite() {
+  // We start with a non-zero value for the pending write requests. This
+  // ensures that the callback does not trigger actions prematurely if it is
+  // called within the same thread.
+  pendingWriteRequests = 1;
+  // Consecutive elements that have to be written are combined into a single
+  // block operation. When only changed elements are written, there might be
+  // several blocks.
+  std::uint32_t stride = sizeof(std::uint32_t) + address.getElementDistance();
+  std::uint32_t blockStartIndex = 0;
+  std::vector<std::uint32_t> blockValues;
+  for (std::uint32_t arrayIndex = 0; arrayIndex < record->nelm; ++arrayIndex) {
+    std::uint32_t value = getElementValue(arrayIndex);
+    if (elementSkipped[arrayIndex]) {
+      // An element is only skipped once. The next time, it is written like
+      // any other element.
+      elementSkipped[arrayIndex] = false;
+    } else if (!address.isChangedElementsOnly()
+        || !lastValueWrittenValid[arrayIndex]
+        || lastValueWritten[arrayIndex] != value) {
+      // We set the valid flag to false. This ensures that the element will
+      // be written again the next time if the write attempt is not
+      // successful. If it is successful, the flag will be set again by the
+      // callback.
+      lastValueWrittenValid[arrayIndex] = false;
+      lastValueWritten[arrayIndex] = value;
+      if (blockValues.empty()) {
+        blockStartIndex = arrayIndex;
       }
-    } else {
-      this->record->pact = true;
+      blockValues.push_back(value);
+      continue;
     }
+    if (!blockValues.empty()) {
+      ++pendingWriteRequests;
+      device->writeUInt32Block(
+          address.getMemoryAddress() + stride * blockStartIndex,
+          std::move(blockValues), stride, writeCallback);
+      blockValues.clear();
+    }
+  }
+  if (!blockValues.empty()) {
+    ++pendingWriteRequests;
+    device->writeUInt32Block(
+        address.getMemoryAddress() + stride * blockStartIndex,
+        std::move(blockValues), stride, writeCallback);
   }
+  // Now we can decrement the number of pending write requests so that it
+  // matches the actual number. If the remaining number is zero, we are
+  // already finished.
+  --pendingWriteRequests;
+  return pendingWriteRequests != 0;
 }
 
 }
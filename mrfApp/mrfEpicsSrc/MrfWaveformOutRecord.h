@@ -80,12 +80,13 @@ private:
   /**
    * Callback implementation used for writing array elements.
    */
-  struct CallbackImpl: MrfMemoryAccess::CallbackUInt32 {
+  struct CallbackImpl: MrfMemoryAccess::BlockCallbackUInt32 {
     MrfWaveformOutRecord &deviceSupport;
     CallbackImpl(MrfWaveformOutRecord &deviceSupport) :
         deviceSupport(deviceSupport) {
     }
-    void success(std::uint32_t address, std::uint32_t value);
+    void success(std::uint32_t address,
+        const std::vector<std::uint32_t> &values);
     void failure(std::uint32_t address, MrfMemoryAccess::ErrorCode errorCode,
         const std::string &details);
   };
@@ -96,6 +97,41 @@ private:
   MrfWaveformOutRecord &operator=(const MrfWaveformOutRecord &) = delete;
   MrfWaveformOutRecord &operator=(MrfWaveformOutRecord &&) = delete;
 
+  /**
+   * Checks the elements that still have the value read on initialization
+   * against the device cache. Elements whose register has been corrected after
+   * verifying the cache snapshot and whose initial value differs from the
+   * value in the device are marked as skipped, and their last value written is
+   * replaced with the value in the device. Returns true if any element is
+   * skipped. The mutex must be held when calling this method.
+   */
+  bool checkInitialValues();
+
+  /**
+   * Finishes the processing that has been delayed until the cache snapshot
+   * was verified. This is called by the thread verifying the snapshot.
+   */
+  void finishInitialValueCheck() noexcept;
+
+  /**
+   * Queues the write requests for the elements that have to be written and
+   * returns true if a request is pending. If no request is pending, the write
+   * has already finished. The mutex must be held when calling this method.
+   */
+  bool startWrite();
+
+  /**
+   * Sets the record's alarm state according to the result of the write that
+   * has finished. Throws an exception if the write failed or elements have
+   * been skipped.
+   */
+  void completeWrite();
+
+  /**
+   * Returns the value of the specified element of the record's value array.
+   */
+  std::uint32_t getElementValue(std::uint32_t arrayIndex);
+
   /**
    * Mutex that must be hold when processing the record or callbacks. The mutex
    * has to be recursive because callbacks might be triggered from within the
@@ -162,6 +198,29 @@ private:
    */
   std::vector<bool> lastValueWrittenValid;
 
+  /**
+   * Tells whether the record has not been processed since its value has been
+   * initialized from the device cache. In this case, the initial value has to
+   * be checked against the verified cache before it is written.
+   */
+  bool initialValuePending;
+
+  /**
+   * Value of each element when the record was initialized.
+   */
+  std::vector<std::uint32_t> initialValue;
+
+  /**
+   * Tells whether an element must not be written because it has been
+   * initialized from an out-of-date cache snapshot.
+   */
+  std::vector<bool> elementSkipped;
+
+  /**
+   * Tells whether elements have been skipped during the current write.
+   */
+  bool writeSkipped;
+
 };
 
 }
@@ -0,0 +1,223 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "MrfDeviceRegistry.h"
+#include "MrfRecordAddress.h"
+
+#include "mrfCachePreheat.h"
+
+namespace anka {
+namespace mrf {
+namespace epics {
+
+// We use an anonymous namespace for the functions that we only use
+// internally. This way, we can avoid accidental name collisions.
+namespace {
+
+/**
+ * Tells whether records of the specified record type that use the specified
+ * device type read their initial value through the device cache. These are
+ * the output records that use the MRF memory device support.
+ */
+bool isReadOnInitDeviceSupport(const std::string &recordType,
+    const std::string &deviceType) {
+  if (deviceType == "MRF Memory") {
+    return recordType == "ao" || recordType == "bo"
+        || recordType == "longout" || recordType == "mbbo"
+        || recordType == "mbboDirect";
+  } else if (deviceType == "MRF Memory Output") {
+    return recordType == "waveform";
+  } else {
+    return false;
+  }
+}
+
+/**
+ * Returns the value of a record's field as a string. If the field does not
+ * exist, the empty string is returned.
+ */
+std::string getFieldString(::DBENTRY &entry, const char *fieldName) {
+  if (::dbFindField(&entry, fieldName)) {
+    return std::string();
+  }
+  const char *value = ::dbGetString(&entry);
+  return value ? value : "";
+}
+
+/**
+ * Adds the ranges read by the record that the specified entry points to.
+ */
+void addRecordRanges(::DBENTRY &entry, const std::string &recordType,
+    std::map<std::string, std::vector<MrfMemoryCache::PreheatRange>> &rangesByDevice) {
+  std::string link = getFieldString(entry,
+      recordType == "waveform" ? "INP" : "OUT");
+  // In the database, the link is stored with the leading "@" that marks an
+  // INST_IO link, but the record address expects the string without it.
+  std::size_t start = link.find_first_not_of(" \t");
+  if (start == std::string::npos || link[start] != '@') {
+    return;
+  }
+  MrfRecordAddress address(link.substr(start + 1));
+  if (!address.isReadOnInit()) {
+    return;
+  }
+  auto &ranges = rangesByDevice[address.getDeviceId()];
+  if (address.getDataType() == MrfRecordAddress::DataType::uInt16) {
+    ranges.push_back({MrfMemoryCache::RegisterWidth::uInt16,
+        address.getMemoryAddress(), 1});
+    return;
+  }
+  std::size_t count = 1;
+  if (recordType == "waveform") {
+    count = std::stoul(getFieldString(entry, "NELM"));
+  }
+  if (address.getElementDistance() == 0) {
+    ranges.push_back({MrfMemoryCache::RegisterWidth::uInt32,
+        address.getMemoryAddress(), count});
+  } else {
+    // If there are gaps between the elements, we must not read the registers
+    // in between, so we add each element separately.
+    for (std::size_t index = 0; index < count; ++index) {
+      ranges.push_back({MrfMemoryCache::RegisterWidth::uInt32,
+          static_cast<std::uint32_t>(address.getMemoryAddress()
+              + (4 + address.getElementDistance()) * index), 1});
+    }
+  }
+}
+
+} // anonymous namespace
+
+std::map<std::string, std::vector<MrfMemoryCache::PreheatRange>> collectPreheatRanges(
+    ::DBBASE *database) {
+  std::map<std::string, std::vector<MrfMemoryCache::PreheatRange>> rangesByDevice;
+  if (!database) {
+    return rangesByDevice;
+  }
+  ::DBENTRY entry;
+  ::dbInitEntry(database, &entry);
+  for (long status = ::dbFirstRecordType(&entry); !status;
+      status = ::dbNextRecordType(&entry)) {
+    std::string recordType = ::dbGetRecordTypeName(&entry);
+    for (status = ::dbFirstRecord(&entry); !status;
+        status = ::dbNextRecord(&entry)) {
+      if (::dbIsAlias(&entry)) {
+        continue;
+      }
+      if (!isReadOnInitDeviceSupport(recordType,
+          getFieldString(entry, "DTYP"))) {
+        continue;
+      }
+      try {
+        addRecordRanges(entry, recordType, rangesByDevice);
+      } catch (std::exception &) {
+        // An invalid address is reported when the record is initialized, so
+        // we simply skip the record here.
+      }
+    }
+  }
+  ::dbFinishEntry(&entry);
+  for (auto &deviceAndRanges : rangesByDevice) {
+    deviceAndRanges.second = coalescePreheatRanges(
+        std::move(deviceAndRanges.second));
+  }
+  return rangesByDevice;
+}
+
+std::vector<MrfMemoryCache::PreheatRange> coalescePreheatRanges(
+    std::vector<MrfMemoryCache::PreheatRange> ranges) {
+  std::sort(ranges.begin(), ranges.end(),
+      [](const MrfMemoryCache::PreheatRange &left,
+          const MrfMemoryCache::PreheatRange &right) {
+        return left.width < right.width
+            || (left.width == right.width && left.address < right.address);
+      });
+  std::vector<MrfMemoryCache::PreheatRange> coalescedRanges;
+  // We calculate the end addresses with 64 bits, so that a range at the end of
+  // the address space does not cause an overflow.
+  std::uint64_t currentEnd = 0;
+  for (auto &range : ranges) {
+    if (range.count == 0) {
+      continue;
+    }
+    std::uint64_t registerSize =
+        (range.width == MrfMemoryCache::RegisterWidth::uInt16) ? 2 : 4;
+    std::uint64_t end = range.address + range.count * registerSize;
+    if (!coalescedRanges.empty() && coalescedRanges.back().width == range.width
+        && range.address <= currentEnd) {
+      if (end > currentEnd) {
+        coalescedRanges.back().count += (end - currentEnd) / registerSize;
+        currentEnd = end;
+      }
+    } else {
+      coalescedRanges.push_back(range);
+      currentEnd = end;
+    }
+  }
+  return coalescedRanges;
+}
+
+void preheatDeviceCaches(::DBBASE *database) {
+  std::vector<std::thread> threads;
+  for (auto &deviceAndRanges : collectPreheatRanges(database)) {
+    auto cache = MrfDeviceRegistry::getInstance().getDeviceCache(
+        deviceAndRanges.first);
+    // If the device does not exist, the records report this when they are
+    // initialized.
+    if (!cache) {
+      continue;
+    }
+    std::string deviceId = deviceAndRanges.first;
+    auto ranges = std::make_shared<std::vector<MrfMemoryCache::PreheatRange>>(
+        std::move(deviceAndRanges.second));
+    // Each device is preheated by its own thread, so that a slow device does
+    // not delay the other ones.
+    threads.emplace_back([cache, deviceId, ranges]() {
+      auto result = cache->preheat(*ranges);
+      std::printf(
+          "Preheated cache for device %s: %zu of %zu registers read in %.3f s.\n",
+          deviceId.c_str(), result.registersCached, result.registersRequested,
+          std::chrono::duration<double>(result.duration).count());
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+}
+}
+}
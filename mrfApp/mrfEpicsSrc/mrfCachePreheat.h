@@ -0,0 +1,82 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_EPICS_CACHE_PREHEAT_H
+#define ANKA_MRF_EPICS_CACHE_PREHEAT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dbStaticLib.h>
+
+#include "MrfMemoryCache.h"
+
+namespace anka {
+namespace mrf {
+namespace epics {
+
+/**
+ * Collects the registers that are read by output records when they are
+ * initialized. The records are found in the specified database, so this
+ * function can be used after the database has been loaded, but before the
+ * records are initialized. Records that use an invalid address are skipped
+ * (the error is reported when the record is initialized). The returned map
+ * uses device IDs as keys. The ranges for each device have been coalesced by
+ * {@link coalescePreheatRanges}.
+ */
+std::map<std::string, std::vector<MrfMemoryCache::PreheatRange>> collectPreheatRanges(
+    ::DBBASE *database);
+
+/**
+ * Merges register ranges that overlap or directly follow each other. Only
+ * ranges of the same register width are merged. The returned ranges are
+ * sorted by register width and address. Registers that are not part of any
+ * of the specified ranges are never added, because reading some of the
+ * device's registers has side effects.
+ */
+std::vector<MrfMemoryCache::PreheatRange> coalescePreheatRanges(
+    std::vector<MrfMemoryCache::PreheatRange> ranges);
+
+/**
+ * Preheats the caches of all devices that are used by output records in the
+ * specified database. The ranges returned by {@link collectPreheatRanges} are
+ * read for all devices in parallel, and this function blocks until all of
+ * them have been read. A message with the number of registers that have been
+ * read and the time this took is printed for each device. Errors are not
+ * reported, because the respective records report them when they are
+ * initialized.
+ */
+void preheatDeviceCaches(::DBBASE *database);
+
+}
+}
+}
+
+#endif // ANKA_MRF_EPICS_CACHE_PREHEAT_H
@@ -47,6 +47,7 @@
 #include "MrfMbboDirectRecord.h"
 #include "MrfMbbiRecord.h"
 #include "MrfMbboRecord.h"
+#include "MrfStatisticsRecord.h"
 #include "MrfStringinRecord.h"
 #include "MrfWaveformInRecord.h"
 #include "MrfWaveformOutRecord.h"
@@ -142,6 +143,15 @@ long processRecord(typename RecordDeviceSupportType::RecordType *record) {
   return 0;
 }
 
+template<typename RecordDeviceSupportType>
+long processRecordWithoutConversion(
+    typename RecordDeviceSupportType::RecordType *record) {
+  long status = processRecord<RecordDeviceSupportType>(record);
+  // A return value of two tells the ai record that the device support has
+  // written to the VAL field directly and no conversion shall be applied.
+  return (status == 0) ? 2 : status;
+}
+
 }
 
 extern "C" {
@@ -176,6 +186,22 @@ aidset devAiMrf = {
 };
 epicsExportAddress(dset, devAiMrf);
 
+/**
+ * ai record type. Special version for providing runtime statistics.
+ */
+aidset devAiStatisticsMrf = {
+  {
+    6,
+    nullptr,
+    nullptr,
+    initRecord<MrfAiStatisticsRecord>,
+    nullptr,
+  },
+  processRecordWithoutConversion<MrfAiStatisticsRecord>,
+  nullptr,
+};
+epicsExportAddress(dset, devAiStatisticsMrf);
+
 /**
  * ao record type.
  */
@@ -292,6 +318,21 @@ longindset devLonginInterruptMrf = {
 };
 epicsExportAddress(dset, devLonginInterruptMrf);
 
+/**
+ * longin record type. Special version for providing runtime statistics.
+ */
+longindset devLonginStatisticsMrf = {
+  {
+    5,
+    nullptr,
+    nullptr,
+    initRecord<MrfLonginStatisticsRecord>,
+    nullptr,
+  },
+  processRecord<MrfLonginStatisticsRecord>,
+};
+epicsExportAddress(dset, devLonginStatisticsMrf);
+
 /**
  * longout record type.
  */
@@ -484,4 +525,19 @@ wfdset devWaveformOutMrf = {
 };
 epicsExportAddress(dset, devWaveformOutMrf);
 
+/**
+ * waveform record type. Special version for providing runtime statistics.
+ */
+wfdset devWaveformStatisticsMrf = {
+  {
+    5,
+    nullptr,
+    nullptr,
+    initRecord<MrfWaveformStatisticsRecord>,
+    nullptr,
+  },
+  processRecord<MrfWaveformStatisticsRecord>,
+};
+epicsExportAddress(dset, devWaveformStatisticsMrf);
+
 } // extern "C"
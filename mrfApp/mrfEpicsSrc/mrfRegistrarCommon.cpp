@@ -27,24 +27,37 @@
  * of the GNU LGPL version 3 or newer.
  */
 
+#include <chrono>
 #include <climits>
 #include <cinttypes>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <dbAccess.h>
 #include <dbScan.h>
 #include <epicsExport.h>
+#include <epicsExit.h>
 #include <epicsVersion.h>
+#include <initHooks.h>
 #include <iocsh.h>
 
+#include <MrfConsistentAsynchronousMemoryAccess.h>
 #include <MrfMemoryAccess.h>
+#include <MrfStatistics.h>
+#include <MrfTraceRing.h>
 
+#include "MrfCacheSnapshot.h"
 #include "MrfDeviceRegistry.h"
+#include "mrfCachePreheat.h"
 #include "mrfEpicsError.h"
 
 using namespace anka::mrf;
@@ -86,6 +99,10 @@ private:
 std::mutex mutex;
 std::vector<std::shared_ptr<InterruptListenerImpl>> interruptListeners;
 
+// The trace rings are kept in a map, so that they can be dumped later. Like
+// the vector of interrupt listeners, the map is protected by the mutex.
+std::map<std::string, std::shared_ptr<MrfTraceRing>> traceRings;
+
 void mapInterruptToEvent(const std::string &deviceId, int eventNumber,
     std::uint32_t interruptFlagsMask) {
   std::shared_ptr<MrfMemoryAccess> device =
@@ -109,6 +126,276 @@ void mapInterruptToEvent(const std::string &deviceId, int eventNumber,
   }
 }
 
+void enableTracing(const std::string &deviceId, std::size_t capacity) {
+  std::shared_ptr<MrfMemoryAccess> device =
+      MrfDeviceRegistry::getInstance().getDevice(deviceId);
+  if (!device) {
+    throw std::runtime_error(
+        std::string("Could not find device ") + deviceId + ".");
+  }
+  if (!device->supportsTracing()) {
+    throw std::runtime_error(
+        std::string("The device ") + deviceId + " does not support tracing.");
+  }
+  std::shared_ptr<MrfTraceRing> traceRing;
+  if (capacity != 0) {
+    traceRing = std::make_shared<MrfTraceRing>(capacity);
+  }
+  // We hold the mutex while changing the ring used by the device, so that the
+  // map always contains the ring that is actually used.
+  std::lock_guard<std::mutex> lock(mutex);
+  device->setTraceRing(traceRing);
+  if (traceRing) {
+    traceRings[deviceId] = traceRing;
+  } else {
+    traceRings.erase(deviceId);
+  }
+}
+
+void dumpTrace(const std::string &deviceId, const std::string &fileName) {
+  std::shared_ptr<MrfTraceRing> traceRing;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto traceRingIterator = traceRings.find(deviceId);
+    if (traceRingIterator == traceRings.end()) {
+      throw std::runtime_error(
+          std::string("Tracing is not enabled for device ") + deviceId + ".");
+    }
+    traceRing = traceRingIterator->second;
+  }
+  std::ofstream stream(fileName);
+  if (!stream) {
+    throw std::runtime_error(
+        std::string("Could not open file ") + fileName + ".");
+  }
+  traceRing->writeChromeTrace(stream, deviceId);
+  stream.close();
+  if (!stream) {
+    throw std::runtime_error(
+        std::string("Could not write file ") + fileName + ".");
+  }
+}
+
+/**
+ * Configuration of the cache snapshot for a device. If a snapshot has been
+ * loaded into the device's cache, it is kept, so that it can be verified in
+ * the background.
+ */
+struct CacheSnapshotConfiguration {
+  std::string fileName;
+  std::vector<std::uint32_t> identityAddresses;
+  std::shared_ptr<MrfCacheSnapshot> loadedSnapshot;
+};
+
+// Cache snapshot configurations (protected by the mutex). The exit handler
+// that saves the snapshots is registered when the first snapshot is configured.
+std::map<std::string, CacheSnapshotConfiguration> cacheSnapshots;
+bool cacheSnapshotExitHandlerRegistered = false;
+
+/**
+ * Parses a list of register addresses that are separated by commas or white
+ * space. Throws an exception if one of the addresses is invalid.
+ */
+std::vector<std::uint32_t> parseAddressList(const std::string &addressList) {
+  const std::string delimiters(", \t");
+  std::vector<std::uint32_t> addresses;
+  std::size_t tokenStart = addressList.find_first_not_of(delimiters);
+  while (tokenStart != std::string::npos) {
+    std::size_t tokenEnd = addressList.find_first_of(delimiters, tokenStart);
+    std::string token = addressList.substr(tokenStart,
+        tokenEnd == std::string::npos ? tokenEnd : tokenEnd - tokenStart);
+    std::size_t numberLength = 0;
+    unsigned long address = 0;
+    try {
+      address = std::stoul(token, &numberLength, 0);
+    } catch (std::exception &) {
+      numberLength = 0;
+    }
+    if (numberLength != token.size() || address > UINT32_MAX) {
+      throw std::invalid_argument(
+          std::string("Invalid register address: ") + token);
+    }
+    addresses.push_back(static_cast<std::uint32_t>(address));
+    tokenStart = addressList.find_first_not_of(delimiters, tokenEnd);
+  }
+  return addresses;
+}
+
+void saveCacheSnapshot(const std::string &deviceId) {
+  CacheSnapshotConfiguration configuration;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto configurationIterator = cacheSnapshots.find(deviceId);
+    if (configurationIterator == cacheSnapshots.end()) {
+      throw std::runtime_error(
+          std::string("No cache snapshot has been configured for device ")
+              + deviceId + ".");
+    }
+    configuration = configurationIterator->second;
+  }
+  auto device = MrfDeviceRegistry::getInstance().getDevice(deviceId);
+  auto cache = MrfDeviceRegistry::getInstance().getDeviceCache(deviceId);
+  if (!device || !cache) {
+    throw std::runtime_error(
+        std::string("Could not find device with ID ") + deviceId + ".");
+  }
+  auto snapshot = MrfCacheSnapshot::capture(*device, *cache,
+      configuration.identityAddresses);
+  snapshot.writeFile(configuration.fileName);
+  std::printf("Saved %zu registers of device %s to cache snapshot %s.\n",
+      snapshot.size(), deviceId.c_str(), configuration.fileName.c_str());
+}
+
+void saveCacheSnapshotsAtExit(void *) noexcept {
+  std::vector<std::string> deviceIds;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &deviceIdAndConfiguration : cacheSnapshots) {
+      deviceIds.push_back(deviceIdAndConfiguration.first);
+    }
+  }
+  for (auto &deviceId : deviceIds) {
+    try {
+      saveCacheSnapshot(deviceId);
+    } catch (std::exception &e) {
+      errorPrintf("Could not save cache snapshot for device %s: %s",
+          deviceId.c_str(), e.what());
+    } catch (...) {
+      errorPrintf("Could not save cache snapshot for device %s: Unknown error.",
+          deviceId.c_str());
+    }
+  }
+}
+
+void configureCacheSnapshot(const std::string &deviceId,
+    const std::string &fileName,
+    const std::vector<std::uint32_t> &identityAddresses) {
+  auto device = MrfDeviceRegistry::getInstance().getDevice(deviceId);
+  auto cache = MrfDeviceRegistry::getInstance().getDeviceCache(deviceId);
+  if (!device || !cache) {
+    throw std::runtime_error(
+        std::string("Could not find device with ID ") + deviceId + ".");
+  }
+  CacheSnapshotConfiguration configuration;
+  configuration.fileName = fileName;
+  configuration.identityAddresses = identityAddresses;
+  // A missing or invalid snapshot is not an error. In this case, the
+  // registers are simply read from the device.
+  if (!std::ifstream(fileName)) {
+    std::printf("No cache snapshot found for device %s.\n", deviceId.c_str());
+  } else {
+    try {
+      auto snapshot = std::make_shared<MrfCacheSnapshot>(
+          MrfCacheSnapshot::readFile(fileName));
+      if (snapshot->matches(*device)) {
+        snapshot->loadInto(*cache);
+        configuration.loadedSnapshot = snapshot;
+        std::printf(
+            "Loaded %zu registers of device %s from cache snapshot %s.\n",
+            snapshot->size(), deviceId.c_str(), fileName.c_str());
+      } else {
+        std::printf(
+            "Cache snapshot %s does not match the identity registers of device %s and is not used.\n",
+            fileName.c_str(), deviceId.c_str());
+      }
+    } catch (std::exception &e) {
+      errorPrintf("Could not load cache snapshot for device %s: %s",
+          deviceId.c_str(), e.what());
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  cacheSnapshots[deviceId] = configuration;
+  if (!cacheSnapshotExitHandlerRegistered) {
+    ::epicsAtExit(saveCacheSnapshotsAtExit, nullptr);
+    cacheSnapshotExitHandlerRegistered = true;
+  }
+}
+
+/**
+ * Starts verifying the snapshots that have been loaded into the device caches.
+ * The verification runs in the background (one thread for each device), so
+ * that it delays neither the initialization of the records nor the IOC.
+ * Registers that have changed since the snapshot was saved are corrected in
+ * the cache and marked as out of date, so that output records that have been
+ * initialized with the old value do not write it back to the device. Output
+ * records that are processed before the verification has finished wait for
+ * it before writing their initial value.
+ */
+void startCacheSnapshotVerification() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto &deviceIdAndConfiguration : cacheSnapshots) {
+    auto snapshot = deviceIdAndConfiguration.second.loadedSnapshot;
+    auto device = MrfDeviceRegistry::getInstance().getDevice(
+        deviceIdAndConfiguration.first);
+    auto cache = MrfDeviceRegistry::getInstance().getDeviceCache(
+        deviceIdAndConfiguration.first);
+    if (!snapshot || !device || !cache) {
+      continue;
+    }
+    std::string deviceId = deviceIdAndConfiguration.first;
+    cache->beginVerification();
+    try {
+      std::thread verifyThread([cache, device, deviceId, snapshot]() {
+        try {
+          auto mismatches = snapshot->verify(*device, *cache);
+          if (!mismatches.empty()) {
+            errorPrintf(
+                "Cache snapshot for device %s was out of date: %zu registers "
+                "(the first one at address 0x%08" PRIx32 ") have changed "
+                "since it was saved. The cache has been updated. Output "
+                "records that have been initialized with the old values do "
+                "not write them when they are processed for the first time "
+                "and are put into an INVALID alarm state instead.",
+                deviceId.c_str(), mismatches.size(), mismatches.front());
+          }
+        } catch (std::exception &e) {
+          errorPrintf("Could not verify cache snapshot for device %s: %s",
+              deviceId.c_str(), e.what());
+        } catch (...) {
+          errorPrintf(
+              "Could not verify cache snapshot for device %s: Unknown error.",
+              deviceId.c_str());
+        }
+        // Records that have been processed in the meantime are waiting for
+        // the verification, so we have to finish it even if it failed.
+        cache->finishVerification();
+      });
+      verifyThread.detach();
+    } catch (...) {
+      cache->finishVerification();
+      throw;
+    }
+  }
+}
+
+/**
+ * Hook that is called by iocInit. Before the records are initialized, we
+ * preheat the caches of all devices with the registers that are read by the
+ * records during their initialization. This way, the registers of all devices
+ * are read in parallel, while the record initialization itself is not
+ * parallelized and would have to wait for each I/O request to finish before it
+ * could continue. Right after preheating, we start verifying the cache
+ * snapshots that have been loaded in the background.
+ */
+void mrfInitHook(::initHookState state) noexcept {
+  if (state == initHookAfterInitDevSup) {
+    try {
+      preheatDeviceCaches(pdbbase);
+    } catch (std::exception &e) {
+      errorPrintf("Error while preheating device caches: %s", e.what());
+    } catch (...) {
+      errorPrintf("Error while preheating device caches: Unknown error.");
+    }
+    try {
+      startCacheSnapshotVerification();
+    } catch (std::exception &e) {
+      errorPrintf("Error while verifying cache snapshots: %s", e.what());
+    } catch (...) {
+      errorPrintf("Error while verifying cache snapshots: Unknown error.");
+    }
+  }
+}
+
 }
 
 extern "C" {
@@ -125,7 +412,9 @@ static const iocshFuncDef iocshMrfDumpCacheFuncDef = {
   "Dump the memory cache for a device.\n\n"
   "The memory cache is only used for initializing output records during IOC "
   "startup\nand thus will only contain entries for memory locations referenced "
-  "by such\nrecords.\n",
+  "by such\nrecords. After the cached values, the number of cache hits, "
+  "cache misses, and\nreads that were suppressed because another thread was "
+  "already reading the same\nregister is printed.\n",
 #endif // IOCSHFUNCDEF_HAS_USAGE
 };
 
@@ -162,6 +451,15 @@ static int iocshMrfDumpCacheFuncInternal(const iocshArgBuf *args) noexcept {
         addressAndValue.first,
         addressAndValue.second);
     }
+    MrfStatistics statistics;
+    cache->collectStatistics(statistics);
+    std::printf("\n\nstatistics:\n\n");
+    for (auto &nameAndValue : statistics.getCounters()) {
+      std::printf(
+        "%s: %" PRIu64 "\n",
+        nameAndValue.first.c_str(),
+        nameAndValue.second);
+    }
   } catch (std::exception &e) {
     errorPrintf("Error while accessing device cache: %s", e.what());
     return 1;
@@ -175,8 +473,7 @@ static int iocshMrfDumpCacheFuncInternal(const iocshArgBuf *args) noexcept {
 /**
  * Implementation of the iocsh mrfDumpCache function. This function prints the
  * contents of the memory cache for a device. It is mainly intended for
- * diagnostics when developing this device support. In particular, it is used to
- * get a list of addresses for which the cache is used.
+ * diagnostics when developing this device support.
  */
 static void iocshMrfDumpCacheFunc(const iocshArgBuf *args) noexcept {
 #if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
@@ -297,13 +594,575 @@ static void iocshMrfMapInterruptToEventFunc(const iocshArgBuf *args) noexcept {
 #endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
 }
 
+// Data structures needed for the iocsh mrfSetWriteCombining function.
+static const iocshArg iocshMrfSetWriteCombiningArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfSetWriteCombiningArg1 = {
+    "enable (1) or disable (0)", iocshArgInt };
+static const iocshArg * const iocshMrfSetWriteCombiningArgs[] = {
+    &iocshMrfSetWriteCombiningArg0, &iocshMrfSetWriteCombiningArg1 };
+static const iocshFuncDef iocshMrfSetWriteCombiningFuncDef = {
+  "mrfSetWriteCombining",
+  2,
+  iocshMrfSetWriteCombiningArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Enable or disable write combining for a device.\n\n"
+  "When enabled, a write to a register that is still waiting for an earlier "
+  "write to\nthe same register replaces the value of that write, so that only "
+  "the most recent\nvalue is written. Masked writes to a register that are "
+  "waiting for the same\nregister are merged, so that the register is only "
+  "read and written once. Write\ncombining is disabled by default.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfSetWriteCombiningFuncInternal(const iocshArgBuf *args)
+    noexcept {
+  char *deviceId = args[0].sval;
+  int enable = args[1].ival;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfConsistentAsynchronousMemoryAccess> device =
+        std::dynamic_pointer_cast<MrfConsistentAsynchronousMemoryAccess>(
+            MrfDeviceRegistry::getInstance().getDevice(deviceId));
+    if (!device) {
+      errorPrintf(
+          "Could not find device with ID \"%s\" or the device does not "
+          "support write combining.", deviceId);
+      return 1;
+    }
+    device->setWriteCombining(enable != 0);
+  } catch (std::exception &e) {
+    errorPrintf("Could not set write combining: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not set write combining: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfSetWriteCombining function.
+ */
+static void iocshMrfSetWriteCombiningFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfSetWriteCombiningFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfSetWriteCombiningFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfSetShadowMirror function.
+static const iocshArg iocshMrfSetShadowMirrorArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfSetShadowMirrorArg1 = {
+    "enable (1) or disable (0)", iocshArgInt };
+static const iocshArg iocshMrfSetShadowMirrorArg2 = {
+    "re-validation interval (seconds)", iocshArgDouble };
+static const iocshArg * const iocshMrfSetShadowMirrorArgs[] = {
+    &iocshMrfSetShadowMirrorArg0, &iocshMrfSetShadowMirrorArg1,
+    &iocshMrfSetShadowMirrorArg2 };
+static const iocshFuncDef iocshMrfSetShadowMirrorFuncDef = {
+  "mrfSetShadowMirror",
+  3,
+  iocshMrfSetShadowMirrorArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Enable or disable the shadow mirror for a device.\n\n"
+  "When enabled, the last value read from or written to each register is "
+  "remembered,\nso that masked writes do not have to read the register "
+  "first. If the\nre-validation interval is greater than zero, the "
+  "remembered values are\ncompared with the device's registers at this "
+  "interval. Registers that are\nchanged by the device itself have to be "
+  "excluded with\nmrfExcludeFromShadowMirror. The shadow mirror is disabled "
+  "by default.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfSetShadowMirrorFuncInternal(const iocshArgBuf *args)
+    noexcept {
+  char *deviceId = args[0].sval;
+  int enable = args[1].ival;
+  double revalidationInterval = args[2].dval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  // We have to set an upper limit because the value has to be converted to an
+  // integer. Longer intervals would not make sense anyway.
+  if (!std::isfinite(revalidationInterval) || revalidationInterval < 0.0
+      || revalidationInterval > 86400.0) {
+    errorPrintf(
+        "The re-validation interval must be between 0 and 86400 seconds.");
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfConsistentAsynchronousMemoryAccess> device =
+        std::dynamic_pointer_cast<MrfConsistentAsynchronousMemoryAccess>(
+            MrfDeviceRegistry::getInstance().getDevice(deviceId));
+    if (!device) {
+      errorPrintf(
+          "Could not find device with ID \"%s\" or the device does not "
+          "support a shadow mirror.", deviceId);
+      return 1;
+    }
+    device->setShadowMirror(enable != 0);
+    device->setShadowRevalidationInterval(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(
+                enable ? revalidationInterval : 0.0)));
+  } catch (std::exception &e) {
+    errorPrintf("Could not configure the shadow mirror: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not configure the shadow mirror: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfSetShadowMirror function.
+ */
+static void iocshMrfSetShadowMirrorFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfSetShadowMirrorFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfSetShadowMirrorFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfExcludeFromShadowMirror function.
+static const iocshArg iocshMrfExcludeFromShadowMirrorArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfExcludeFromShadowMirrorArg1 = {
+    "register addresses", iocshArgString };
+static const iocshArg * const iocshMrfExcludeFromShadowMirrorArgs[] = {
+    &iocshMrfExcludeFromShadowMirrorArg0,
+    &iocshMrfExcludeFromShadowMirrorArg1 };
+static const iocshFuncDef iocshMrfExcludeFromShadowMirrorFuncDef = {
+  "mrfExcludeFromShadowMirror",
+  2,
+  iocshMrfExcludeFromShadowMirrorArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Exclude registers from the shadow mirror of a device.\n\n"
+  "The addresses are separated by commas or spaces. Masked writes to these\n"
+  "registers always read the register first. This should be used for "
+  "registers\nthat are changed by the device itself (e.g. registers with "
+  "self-clearing bits).\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfExcludeFromShadowMirrorFuncInternal(
+    const iocshArgBuf *args) noexcept {
+  char *deviceId = args[0].sval;
+  char *addresses = args[1].sval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  if (!addresses) {
+    errorPrintf("Register addresses must be specified.");
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfConsistentAsynchronousMemoryAccess> device =
+        std::dynamic_pointer_cast<MrfConsistentAsynchronousMemoryAccess>(
+            MrfDeviceRegistry::getInstance().getDevice(deviceId));
+    if (!device) {
+      errorPrintf(
+          "Could not find device with ID \"%s\" or the device does not "
+          "support a shadow mirror.", deviceId);
+      return 1;
+    }
+    for (auto address : parseAddressList(addresses)) {
+      device->excludeFromShadowMirror(address);
+    }
+  } catch (std::exception &e) {
+    errorPrintf("Could not exclude registers from the shadow mirror: %s",
+        e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf(
+        "Could not exclude registers from the shadow mirror: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfExcludeFromShadowMirror function.
+ */
+static void iocshMrfExcludeFromShadowMirrorFunc(const iocshArgBuf *args)
+    noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfExcludeFromShadowMirrorFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfExcludeFromShadowMirrorFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfStats function.
+static const iocshArg iocshMrfStatsArg0 = { "device ID", iocshArgString };
+static const iocshArg * const iocshMrfStatsArgs[] = { &iocshMrfStatsArg0 };
+static const iocshFuncDef iocshMrfStatsFuncDef = {
+  "mrfStats",
+  1,
+  iocshMrfStatsArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Print the runtime statistics for a device.\n\n"
+  "The statistics consist of counters and latency histograms. Bucket n of a\n"
+  "histogram counts the operations that took less than 2^n microseconds (and "
+  "at\nleast 2^(n-1) microseconds). Only buckets that are not empty are "
+  "printed. The\nsame statistics are available through records using the "
+  "\"MRF Statistics\" device\nsupport.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfStatsFuncInternal(const iocshArgBuf *args) noexcept {
+  char *deviceId = args[0].sval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  try {
+    auto device = MrfDeviceRegistry::getInstance().getDevice(deviceId);
+    if (!device) {
+      errorPrintf("Could not find device with ID \"%s\".", deviceId);
+      return 1;
+    }
+    MrfStatistics statistics;
+    device->collectStatistics(statistics);
+    for (auto &counter : statistics.getCounters()) {
+      std::printf("%s: %" PRIu64 "\n", counter.first.c_str(), counter.second);
+    }
+    for (auto &histogram : statistics.getHistograms()) {
+      std::printf("\n%s:\n", histogram.first.c_str());
+      auto &buckets = histogram.second;
+      for (std::size_t i = 0; i < buckets.size(); ++i) {
+        if (buckets[i] == 0) {
+          continue;
+        }
+        if (i + 1 < buckets.size()) {
+          std::printf("  < %" PRIu64 " us: %" PRIu64 "\n",
+              static_cast<std::uint64_t>(1) << i, buckets[i]);
+        } else {
+          std::printf("  >= %" PRIu64 " us: %" PRIu64 "\n",
+              static_cast<std::uint64_t>(1) << (i - 1), buckets[i]);
+        }
+      }
+    }
+  } catch (std::exception &e) {
+    errorPrintf("Error while collecting statistics: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Error while collecting statistics: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfStats function. This function prints the
+ * runtime statistics of a device.
+ */
+static void iocshMrfStatsFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfStatsFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfStatsFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfTraceEnable function.
+static const iocshArg iocshMrfTraceEnableArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfTraceEnableArg1 = {
+    "number of entries (0 to disable)", iocshArgInt };
+static const iocshArg * const iocshMrfTraceEnableArgs[] = {
+    &iocshMrfTraceEnableArg0, &iocshMrfTraceEnableArg1 };
+static const iocshFuncDef iocshMrfTraceEnableFuncDef = {
+  "mrfTraceEnable",
+  2,
+  iocshMrfTraceEnableArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Enable or disable tracing of the operations of a device.\n\n"
+  "When tracing is enabled, the device records when each operation was "
+  "queued, sent,\nand answered, and when its callback returned. Only the "
+  "specified number of\nentries is kept, older entries are overwritten. "
+  "Calling this function again\ndiscards the entries that have been recorded "
+  "so far. The trace can be written\nto a file with mrfTraceDump.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfTraceEnableFuncInternal(const iocshArgBuf *args) noexcept {
+  char *deviceId = args[0].sval;
+  int capacity = args[1].ival;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  if (capacity < 0) {
+    errorPrintf("The number of entries must not be negative.");
+    return 1;
+  }
+  try {
+    enableTracing(deviceId, static_cast<std::size_t>(capacity));
+  } catch (std::exception &e) {
+    errorPrintf("Could not enable tracing: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not enable tracing: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfTraceEnable function.
+ */
+static void iocshMrfTraceEnableFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfTraceEnableFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfTraceEnableFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfTraceDump function.
+static const iocshArg iocshMrfTraceDumpArg0 = { "device ID", iocshArgString };
+static const iocshArg iocshMrfTraceDumpArg1 = { "file name", iocshArgString };
+static const iocshArg * const iocshMrfTraceDumpArgs[] = {
+    &iocshMrfTraceDumpArg0, &iocshMrfTraceDumpArg1 };
+static const iocshFuncDef iocshMrfTraceDumpFuncDef = {
+  "mrfTraceDump",
+  2,
+  iocshMrfTraceDumpArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Write the trace of a device to a file.\n\n"
+  "The file uses the JSON trace-event format, so it can be opened with\n"
+  "chrome://tracing or https://ui.perfetto.dev. Tracing has to be enabled "
+  "with\nmrfTraceEnable first.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfTraceDumpFuncInternal(const iocshArgBuf *args) noexcept {
+  char *deviceId = args[0].sval;
+  char *fileName = args[1].sval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  if (!fileName || !std::strlen(fileName)) {
+    errorPrintf("File name must be specified.");
+    return 1;
+  }
+  try {
+    dumpTrace(deviceId, fileName);
+  } catch (std::exception &e) {
+    errorPrintf("Could not dump trace: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not dump trace: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfTraceDump function.
+ */
+static void iocshMrfTraceDumpFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfTraceDumpFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfTraceDumpFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfCacheSnapshot function.
+static const iocshArg iocshMrfCacheSnapshotArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfCacheSnapshotArg1 = { "file name",
+    iocshArgString };
+static const iocshArg iocshMrfCacheSnapshotArg2 = {
+    "identity register addresses", iocshArgString };
+static const iocshArg * const iocshMrfCacheSnapshotArgs[] = {
+    &iocshMrfCacheSnapshotArg0, &iocshMrfCacheSnapshotArg1,
+    &iocshMrfCacheSnapshotArg2 };
+static const iocshFuncDef iocshMrfCacheSnapshotFuncDef = {
+  "mrfCacheSnapshot",
+  3,
+  iocshMrfCacheSnapshotArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Use a snapshot file for initializing the memory cache for a device.\n\n"
+  "If the file exists and the identity registers (uint32 registers separated "
+  "by\ncommas or spaces, 0x002c (the firmware version) when empty) have the "
+  "same values\nas when the snapshot was saved, the snapshot is loaded into "
+  "the cache, so that the\noutput records do not have to read their registers "
+  "from the device when they are\ninitialized. The snapshot is verified in the "
+  "background while the IOC starts.\nOutput records that are processed before "
+  "the verification has finished wait\nfor it, and records that have been "
+  "initialized with out-of-date values are put\ninto an INVALID alarm state "
+  "instead of writing them. The snapshot is saved when\nthe IOC exits and can "
+  "be saved explicitly with mrfSaveCacheSnapshot. This\ncommand must be called "
+  "before iocInit.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfCacheSnapshotFuncInternal(const iocshArgBuf *args) noexcept {
+  char *deviceId = args[0].sval;
+  char *fileName = args[1].sval;
+  char *identityAddressesString = args[2].sval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  if (!fileName || !std::strlen(fileName)) {
+    errorPrintf("File name must be specified.");
+    return 1;
+  }
+  try {
+    std::vector<std::uint32_t> identityAddresses;
+    if (identityAddressesString) {
+      identityAddresses = parseAddressList(identityAddressesString);
+    }
+    if (identityAddresses.empty()) {
+      // The firmware version register is at the same address for the EVG and
+      // the EVR.
+      identityAddresses.push_back(0x002c);
+    }
+    configureCacheSnapshot(deviceId, fileName, identityAddresses);
+  } catch (std::exception &e) {
+    errorPrintf("Could not configure cache snapshot: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not configure cache snapshot: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfCacheSnapshot function.
+ */
+static void iocshMrfCacheSnapshotFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfCacheSnapshotFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfCacheSnapshotFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfSaveCacheSnapshot function.
+static const iocshArg iocshMrfSaveCacheSnapshotArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg * const iocshMrfSaveCacheSnapshotArgs[] = {
+    &iocshMrfSaveCacheSnapshotArg0 };
+static const iocshFuncDef iocshMrfSaveCacheSnapshotFuncDef = {
+  "mrfSaveCacheSnapshot",
+  1,
+  iocshMrfSaveCacheSnapshotArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Save the cache snapshot for a device.\n\n"
+  "The registers that are in the device's memory cache are read from the "
+  "device and\nsaved to the file that has been specified with "
+  "mrfCacheSnapshot. This happens\nautomatically when the IOC exits.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfSaveCacheSnapshotFuncInternal(
+    const iocshArgBuf *args) noexcept {
+  char *deviceId = args[0].sval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  try {
+    saveCacheSnapshot(deviceId);
+  } catch (std::exception &e) {
+    errorPrintf("Could not save cache snapshot: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not save cache snapshot: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfSaveCacheSnapshot function.
+ */
+static void iocshMrfSaveCacheSnapshotFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfSaveCacheSnapshotFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfSaveCacheSnapshotFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
 /**
  * Registrar that registers the iocsh commands.
  */
 static void mrfRegistrarCommon() {
+  ::initHookRegister(mrfInitHook);
+  ::iocshRegister(&iocshMrfCacheSnapshotFuncDef, iocshMrfCacheSnapshotFunc);
   ::iocshRegister(&iocshMrfDumpCacheFuncDef, iocshMrfDumpCacheFunc);
+  ::iocshRegister(&iocshMrfExcludeFromShadowMirrorFuncDef,
+      iocshMrfExcludeFromShadowMirrorFunc);
   ::iocshRegister(&iocshMrfMapInterruptToEventFuncDef,
       iocshMrfMapInterruptToEventFunc);
+  ::iocshRegister(&iocshMrfSetShadowMirrorFuncDef,
+      iocshMrfSetShadowMirrorFunc);
+  ::iocshRegister(&iocshMrfSetWriteCombiningFuncDef,
+      iocshMrfSetWriteCombiningFunc);
+  ::iocshRegister(&iocshMrfSaveCacheSnapshotFuncDef,
+      iocshMrfSaveCacheSnapshotFunc);
+  ::iocshRegister(&iocshMrfStatsFuncDef, iocshMrfStatsFunc);
+  ::iocshRegister(&iocshMrfTraceEnableFuncDef, iocshMrfTraceEnableFunc);
+  ::iocshRegister(&iocshMrfTraceDumpFuncDef, iocshMrfTraceDumpFunc);
 }
 
 epicsExportRegistrar(mrfRegistrarCommon);
@@ -27,11 +27,15 @@
  * of the GNU LGPL version 3 or newer.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
-#include <functional>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 #include <epicsExport.h>
 #include <epicsVersion.h>
@@ -49,167 +53,101 @@ using namespace anka::mrf::epics;
 namespace {
 
 /**
- * Preheats the cache for a VME-EVG-230. This helps reduce the initialization
- * time of the IOC because preheating can happen for several devices in
- * parallel, while the record initialization itself is not parallelized and
- * would that have to wait for each I/O request to finish before it could
- * continue. There is no error checking here. If there is an error, the memory
- * location simply won't be cached, and the respective error will be presented
- * to the user when the second I/O attempt that is made after checking the cache
- * fails (unless the underlying problem has been resolved by then).
+ * Parameters that are used when creating a UDP/IP device.
  */
-void preheatCacheVmeEvg230(std::shared_ptr<MrfMemoryCache> cache) {
-  // This code has been generated by preheat-cache-codegen.py using the output
-  // of mrfDumpCache(...). If outuput records are added to the record file, this
-  // code section needs to be updated.
-  for (std::uint32_t address = 0x00000400; address < 0x00000408; address += 2) {
-      cache->tryCacheUInt16(address);
-  }
-  for (std::uint32_t address = 0x00000440; address < 0x00000448; address += 2) {
-      cache->tryCacheUInt16(address);
-  }
-  cache->tryCacheUInt32(0x00000004);
-  for (std::uint32_t address = 0x0000000c; address < 0x0000001c; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000020; address < 0x0000002c; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  cache->tryCacheUInt32(0x0000004c);
-  cache->tryCacheUInt32(0x00000050);
-  cache->tryCacheUInt32(0x00000060);
-  cache->tryCacheUInt32(0x00000070);
-  cache->tryCacheUInt32(0x00000074);
-  cache->tryCacheUInt32(0x00000080);
-  for (std::uint32_t address = 0x00000100; address < 0x00000120; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000180; address < 0x000001c0; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  cache->tryCacheUInt32(0x00000500);
-  cache->tryCacheUInt32(0x00000504);
-  for (std::uint32_t address = 0x00000540; address < 0x00000550; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000600; address < 0x00000640; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000800; address < 0x00001000; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00008000; address < 0x00010000; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
+struct UdpIpDeviceParameters {
+  MrfTime delayBetweenPackets;
+  MrfTime udpTimeout;
+  int maximumNumberOfTries;
+  int maximumPacketsInFlight;
+  // The adaptive UDP timeout is only used when the minimum timeout is
+  // positive.
+  MrfTime minimumUdpTimeout;
+  MrfTime maximumUdpTimeout;
+};
+
+/**
+ * Mutex protecting the map of UDP/IP devices.
+ */
+std::mutex udpIpDevicesMutex;
+
+/**
+ * UDP/IP devices by device ID. The device registry only stores the consistent
+ * memory access that wraps the UDP/IP memory access, so we have to keep track
+ * of the latter ourselves, in order to provide diagnostics.
+ */
+std::unordered_map<std::string, std::shared_ptr<MrfUdpIpMemoryAccess>> udpIpDevices;
+
+/**
+ * Returns the UDP/IP device with the specified ID. Returns null if there is no
+ * such device.
+ */
+std::shared_ptr<MrfUdpIpMemoryAccess> findUdpIpDevice(
+    const std::string &deviceId) {
+  std::lock_guard<std::mutex> lock(udpIpDevicesMutex);
+  auto deviceIterator = udpIpDevices.find(deviceId);
+  if (deviceIterator == udpIpDevices.end()) {
+    return std::shared_ptr<MrfUdpIpMemoryAccess>();
+  }
+  return deviceIterator->second;
 }
 
 /**
- * Preheats the cache for a VME-EVR-230RF. This helps reduce the initialization
- * time of the IOC because preheating can happen for several devices in
- * parallel, while the record initialization itself is not parallelized and
- * would that have to wait for each I/O request to finish before it could
- * continue. There is no error checking here. If there is an error, the memory
- * location simply won't be cached, and the respective error will be presented
- * to the user when the second I/O attempt that is made after checking the cache
- * fails (unless the underlying problem has been resolved by then).
+ * Mutex protecting the list of reactors.
  */
-void preheatCacheVmeEvr230Rf(std::shared_ptr<MrfMemoryCache> cache) {
-  // This code has been generated by preheat-cache-codegen.py using the output
-  // of mrfDumpCache(...). If outuput records are added to the record file, this
-  // code section needs to be updated.
-  for (std::uint32_t address = 0x00000400; address < 0x0000040e; address += 2) {
-      cache->tryCacheUInt16(address);
-  }
-  for (std::uint32_t address = 0x00000440; address < 0x00000448; address += 2) {
-      cache->tryCacheUInt16(address);
-  }
-  for (std::uint32_t address = 0x00000480; address < 0x000004a0; address += 2) {
-      cache->tryCacheUInt16(address);
-  }
-  cache->tryCacheUInt16(0x00000614);
-  cache->tryCacheUInt16(0x00000616);
-  cache->tryCacheUInt16(0x00000634);
-  cache->tryCacheUInt16(0x00000636);
-  cache->tryCacheUInt16(0x00000654);
-  cache->tryCacheUInt16(0x00000656);
-  cache->tryCacheUInt32(0x00000004);
-  cache->tryCacheUInt32(0x0000000c);
-  cache->tryCacheUInt32(0x00000010);
-  cache->tryCacheUInt32(0x00000020);
-  cache->tryCacheUInt32(0x00000024);
-  cache->tryCacheUInt32(0x00000040);
-  cache->tryCacheUInt32(0x0000004c);
-  cache->tryCacheUInt32(0x00000080);
-  for (std::uint32_t address = 0x00000100; address < 0x0000010c; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000200; address < 0x00000244; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000248; address < 0x00000254; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000258; address < 0x00000264; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000268; address < 0x00000274; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000278; address < 0x00000284; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000288; address < 0x00000294; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00000298; address < 0x000002a4; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x000002a8; address < 0x000002b4; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x000002b8; address < 0x000002c4; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x000002c8; address < 0x000002d4; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x000002d8; address < 0x000002e4; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x000002e8; address < 0x000002f4; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  cache->tryCacheUInt32(0x000002f8);
-  cache->tryCacheUInt32(0x000002fc);
-  cache->tryCacheUInt32(0x00000500);
-  cache->tryCacheUInt32(0x00000504);
-  for (std::uint32_t address = 0x00000600; address < 0x00000614; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  cache->tryCacheUInt32(0x00000618);
-  for (std::uint32_t address = 0x00000620; address < 0x00000634; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  cache->tryCacheUInt32(0x00000638);
-  for (std::uint32_t address = 0x00000640; address < 0x00000654; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  cache->tryCacheUInt32(0x00000658);
-  for (std::uint32_t address = 0x00001800; address < 0x00002000; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00004000; address < 0x00006000; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00020000; address < 0x00022000; address += 4) {
-      cache->tryCacheUInt32(address);
-  }
-  for (std::uint32_t address = 0x00024000; address < 0x00026000; address += 4) {
-      cache->tryCacheUInt32(address);
+std::mutex reactorsMutex;
+
+/**
+ * Reactors that are shared by the UDP/IP devices. If empty, each device uses
+ * its own threads.
+ */
+std::vector<std::shared_ptr<MrfUdpIpReactor>> reactors;
+
+/**
+ * Index of the reactor that is used for the next device that is created.
+ */
+std::size_t nextReactorIndex = 0;
+
+/**
+ * Returns the reactor that shall be used for the next device. The reactors
+ * are assigned to devices in a round-robin fashion. Returns null if no shared
+ * reactors have been configured.
+ */
+std::shared_ptr<MrfUdpIpReactor> getNextReactor() {
+  std::lock_guard<std::mutex> lock(reactorsMutex);
+  if (reactors.empty()) {
+    return std::shared_ptr<MrfUdpIpReactor>();
+  }
+  std::shared_ptr<MrfUdpIpReactor> reactor = reactors[nextReactorIndex];
+  nextReactorIndex = (nextReactorIndex + 1) % reactors.size();
+  return reactor;
+}
+
+/**
+ * Creates the specified number of shared reactors. Throws an exception if
+ * shared reactors have already been created or if one of the reactors cannot
+ * be created.
+ */
+void createReactors(int numberOfThreads) {
+  std::lock_guard<std::mutex> lock(reactorsMutex);
+  if (!reactors.empty()) {
+    throw std::runtime_error("The shared reactors have already been created.");
   }
-  for (std::uint32_t address = 0x00028000; address < 0x0002a000; address += 4) {
-      cache->tryCacheUInt32(address);
+  std::vector<std::shared_ptr<MrfUdpIpReactor>> newReactors;
+  for (int i = 0; i < numberOfThreads; ++i) {
+    newReactors.push_back(std::make_shared<MrfUdpIpReactor>());
   }
+  reactors = std::move(newReactors);
+}
+
+/**
+ * Converts a time interval specified in seconds to an {@link MrfTime}.
+ */
+MrfTime secondsToTime(double seconds) {
+  double fullSeconds = std::floor(seconds);
+  return MrfTime(static_cast<std::int_fast64_t>(fullSeconds),
+      static_cast<std::int_fast32_t>(std::min(
+          std::round((seconds - fullSeconds) * 1000000000.0), 999999999.0)));
 }
 
 /**
@@ -218,26 +156,24 @@ void preheatCacheVmeEvr230Rf(std::shared_ptr<MrfMemoryCache> cache) {
  */
 void createUdpIpDevice(const std::string& deviceId,
     const std::string &hostName, std::uint32_t baseAddress,
-    const MrfTime &delayBetweenPackets, const MrfTime &udpTimeout,
-    int maximumNumberOfTries,
-    std::function<void(std::shared_ptr<MrfMemoryCache>)> preheatFunction) {
+    const UdpIpDeviceParameters &parameters) {
   std::shared_ptr<MrfUdpIpMemoryAccess> rawDevice = std::make_shared<
-      MrfUdpIpMemoryAccess>(hostName, baseAddress, delayBetweenPackets,
-      udpTimeout, maximumNumberOfTries);
+      MrfUdpIpMemoryAccess>(hostName, baseAddress,
+      parameters.delayBetweenPackets, parameters.udpTimeout,
+      parameters.maximumNumberOfTries, getNextReactor());
+  rawDevice->setMaximumPacketsInFlight(parameters.maximumPacketsInFlight);
+  if (parameters.minimumUdpTimeout > MrfTime()) {
+    rawDevice->enableAdaptiveUdpTimeout(parameters.minimumUdpTimeout,
+        parameters.maximumUdpTimeout);
+  }
   std::shared_ptr<MrfConsistentAsynchronousMemoryAccess> consistentDevice =
       std::make_shared<MrfConsistentAsynchronousMemoryAccess>(rawDevice);
   MrfDeviceRegistry::getInstance().registerDevice(std::string(deviceId),
       consistentDevice);
-  // We want to preheat the cache. We do not have to check whether the returned
-  // pointer is null, because it won't be null if registerDevice did not throw
-  // an exception.
-  auto cache = MrfDeviceRegistry::getInstance().getDeviceCache(deviceId);
-  std::thread preheatThread([cache, preheatFunction]() {
-    preheatFunction(cache);
-  });
-  // We want to continue the preheating in the background, so we detach the
-  // thread.
-  preheatThread.detach();
+  {
+    std::lock_guard<std::mutex> lock(udpIpDevicesMutex);
+    udpIpDevices[deviceId] = rawDevice;
+  }
 }
 
 /**
@@ -246,11 +182,9 @@ void createUdpIpDevice(const std::string& deviceId,
  * (e.g. because the device ID is already in use).
  */
 void createUdpIpEvgDevice(const std::string& deviceId,
-    const std::string &hostName, const MrfTime &delayBetweenPackets,
-    const MrfTime &udpTimeout, int maximumNumberOfTries) {
+    const std::string &hostName, const UdpIpDeviceParameters &parameters) {
   createUdpIpDevice(deviceId, hostName,
-      MrfUdpIpMemoryAccess::baseAddressVmeEvgRegister, delayBetweenPackets,
-      udpTimeout, maximumNumberOfTries, preheatCacheVmeEvg230);
+      MrfUdpIpMemoryAccess::baseAddressVmeEvgRegister, parameters);
 }
 
 /**
@@ -259,11 +193,9 @@ void createUdpIpEvgDevice(const std::string& deviceId,
  * (e.g. because the device ID is already in use).
  */
 void createUdpIpEvrDevice(const std::string& deviceId,
-    const std::string &hostName, const MrfTime &delayBetweenPackets,
-    const MrfTime &udpTimeout, int maximumNumberOfTries) {
+    const std::string &hostName, const UdpIpDeviceParameters &parameters) {
   createUdpIpDevice(deviceId, hostName,
-      MrfUdpIpMemoryAccess::baseAddressVmeEvrRegister, delayBetweenPackets,
-      udpTimeout, maximumNumberOfTries, preheatCacheVmeEvr230Rf);
+      MrfUdpIpMemoryAccess::baseAddressVmeEvrRegister, parameters);
 }
 
 } // anonymous namespace
@@ -280,13 +212,21 @@ static const iocshArg iocshMrfUdpIpDeviceArg3 = { "UDP timeout (seconds)",
     iocshArgDouble };
 static const iocshArg iocshMrfUdpIpDeviceArg4 = { "max. number of tries",
     iocshArgInt };
+static const iocshArg iocshMrfUdpIpDeviceArg5 = {
+    "max. number of packets in flight (0 = use fixed delay)", iocshArgInt };
+static const iocshArg iocshMrfUdpIpDeviceArg6 = {
+    "min. adaptive UDP timeout (seconds, 0 = use fixed timeout)",
+    iocshArgDouble };
+static const iocshArg iocshMrfUdpIpDeviceArg7 = {
+    "max. adaptive UDP timeout (seconds)", iocshArgDouble };
 static const iocshArg * const iocshMrfUdpIpDeviceArgs[] =
     { &iocshMrfUdpIpDeviceArg0, &iocshMrfUdpIpDeviceArg1,
         &iocshMrfUdpIpDeviceArg2, &iocshMrfUdpIpDeviceArg3,
-        &iocshMrfUdpIpDeviceArg4 };
+        &iocshMrfUdpIpDeviceArg4, &iocshMrfUdpIpDeviceArg5,
+        &iocshMrfUdpIpDeviceArg6, &iocshMrfUdpIpDeviceArg7 };
 static const iocshFuncDef iocshMrfUdpIpEvgDeviceFuncDef = {
   "mrfUdpIpEvgDevice",
-  5,
+  8,
   iocshMrfUdpIpDeviceArgs,
 #ifdef IOCSHFUNCDEF_HAS_USAGE
   "Define a UDP/IP connection to a VME-EVG-230.\n",
@@ -294,7 +234,7 @@ static const iocshFuncDef iocshMrfUdpIpEvgDeviceFuncDef = {
 };
 static const iocshFuncDef iocshMrfUdpIpEvrDeviceFuncDef = {
   "mrfUdpIpEvrDevice",
-  5,
+  8,
   iocshMrfUdpIpDeviceArgs,
 #ifdef IOCSHFUNCDEF_HAS_USAGE
   "Define a UDP/IP connection to a VME-EVR-230RF.\n",
@@ -312,6 +252,9 @@ static int iocshMrfUdpIpDeviceFunc(const iocshArgBuf *args, bool evr)
   double delayBetweenPacketsDouble = args[2].dval;
   double udpTimeoutDouble = args[3].dval;
   int maxNumberOfTries = args[4].ival;
+  int maxPacketsInFlight = args[5].ival;
+  double minUdpTimeoutDouble = args[6].dval;
+  double maxUdpTimeoutDouble = args[7].dval;
   // Verify and convert the parameters.
   if (!deviceId) {
     errorPrintf("Could not create device: Device ID must be specified.");
@@ -368,16 +311,42 @@ static int iocshMrfUdpIpDeviceFunc(const iocshArgBuf *args, bool evr)
       // situations where a packet is lost because of network congestion.
       maxNumberOfTries = 5;
     }
-    MrfTime delayBetweenPackets(std::floor(delayBetweenPacketsDouble),
-        std::remainder(delayBetweenPacketsDouble * 1000000000.0, 1000000000.0));
-    MrfTime udpTimeout(std::floor(udpTimeoutDouble),
-        std::remainder(udpTimeoutDouble * 1000000000.0, 1000000000.0));
+    if (maxPacketsInFlight < 0) {
+      throw std::invalid_argument(
+          "Max. number of packets in flight must not be negative.");
+    }
+    if (!std::isfinite(minUdpTimeoutDouble)
+        || !std::isfinite(maxUdpTimeoutDouble)) {
+      throw std::invalid_argument(
+          "Min. and max. adaptive UDP timeout must be finite values.");
+    }
+    if (minUdpTimeoutDouble < 0.0) {
+      minUdpTimeoutDouble = 0.0;
+    }
+    if (maxUdpTimeoutDouble <= 0.0) {
+      // By default, the adaptive timeout never gets greater than the fixed
+      // timeout (unless the minimum is greater than the fixed timeout).
+      maxUdpTimeoutDouble = std::max(udpTimeoutDouble, minUdpTimeoutDouble);
+    }
+    if (maxUdpTimeoutDouble > 3600.0) {
+      throw std::invalid_argument(
+          "Max. adaptive UDP timeout must not be greater than 3600 seconds.");
+    }
+    if (maxUdpTimeoutDouble < minUdpTimeoutDouble) {
+      throw std::invalid_argument(
+          "Max. adaptive UDP timeout must not be less than the min. adaptive UDP timeout.");
+    }
+    UdpIpDeviceParameters parameters;
+    parameters.delayBetweenPackets = secondsToTime(delayBetweenPacketsDouble);
+    parameters.udpTimeout = secondsToTime(udpTimeoutDouble);
+    parameters.maximumNumberOfTries = maxNumberOfTries;
+    parameters.maximumPacketsInFlight = maxPacketsInFlight;
+    parameters.minimumUdpTimeout = secondsToTime(minUdpTimeoutDouble);
+    parameters.maximumUdpTimeout = secondsToTime(maxUdpTimeoutDouble);
     if (evr) {
-      createUdpIpEvrDevice(deviceId, hostAddress, delayBetweenPackets,
-          udpTimeout, maxNumberOfTries);
+      createUdpIpEvrDevice(deviceId, hostAddress, parameters);
     } else {
-      createUdpIpEvgDevice(deviceId, hostAddress, delayBetweenPackets,
-          udpTimeout, maxNumberOfTries);
+      createUdpIpEvgDevice(deviceId, hostAddress, parameters);
     }
   } catch (std::exception &e) {
     anka::mrf::epics::errorPrintf("Could not create device %s: %s", deviceId,
@@ -413,12 +382,286 @@ static void iocshMrfUdpIpEvrDeviceFunc(const iocshArgBuf *args) noexcept {
 #endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
 }
 
+// Data structures needed for the iocsh mrfUdpIpSharedReactor function.
+static const iocshArg iocshMrfUdpIpSharedReactorArg0 = { "number of threads",
+    iocshArgInt };
+static const iocshArg * const iocshMrfUdpIpSharedReactorArgs[] = {
+    &iocshMrfUdpIpSharedReactorArg0 };
+static const iocshFuncDef iocshMrfUdpIpSharedReactorFuncDef = {
+  "mrfUdpIpSharedReactor",
+  1,
+  iocshMrfUdpIpSharedReactorArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Use shared I/O threads for all UDP/IP devices.\n\n"
+  "By default, each UDP/IP device uses its own send and receive thread. After "
+  "calling\nthis function, devices that are created use the specified number of "
+  "shared\nthreads instead (at least one, devices are distributed evenly). "
+  "This is only\nsupported on Linux.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfUdpIpSharedReactorFuncInternal(const iocshArgBuf *args)
+    noexcept {
+  int numberOfThreads = args[0].ival;
+  if (numberOfThreads <= 0) {
+    numberOfThreads = 1;
+  }
+  try {
+    createReactors(numberOfThreads);
+  } catch (std::exception &e) {
+    errorPrintf("Could not create shared reactor: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not create shared reactor: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfUdpIpSharedReactor function.
+ */
+static void iocshMrfUdpIpSharedReactorFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfUdpIpSharedReactorFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfUdpIpSharedReactorFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfUdpIpDeviceStatus function.
+static const iocshArg iocshMrfUdpIpDeviceStatusArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg * const iocshMrfUdpIpDeviceStatusArgs[] = {
+    &iocshMrfUdpIpDeviceStatusArg0 };
+static const iocshFuncDef iocshMrfUdpIpDeviceStatusFuncDef = {
+  "mrfUdpIpDeviceStatus",
+  1,
+  iocshMrfUdpIpDeviceStatusArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Print the transport status of a UDP/IP device.\n\n"
+  "This includes the current estimate of the round-trip time, the UDP timeout "
+  "that\nis currently used, and the state of the congestion window.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+/**
+ * Prints a time interval in microseconds.
+ */
+static void printMicroseconds(const char *label, const MrfTime &time) {
+  std::printf("%s: %.1f us\n", label,
+      static_cast<double>(time.getSeconds()) * 1000000.0
+          + static_cast<double>(time.getNanoseconds()) / 1000.0);
+}
+
+static int iocshMrfUdpIpDeviceStatusFuncInternal(const iocshArgBuf *args)
+    noexcept {
+  char *deviceId = args[0].sval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfUdpIpMemoryAccess> device = findUdpIpDevice(deviceId);
+    if (!device) {
+      errorPrintf("Could not find UDP/IP device with ID \"%s\".", deviceId);
+      return 1;
+    }
+    MrfUdpIpMemoryAccess::TransportStatus status = device->getTransportStatus();
+    if (status.adaptiveUdpTimeout) {
+      if (status.haveRoundTripTimeSample) {
+        printMicroseconds("Smoothed round-trip time",
+            status.smoothedRoundTripTime);
+        printMicroseconds("Round-trip time variation",
+            status.roundTripTimeVariation);
+      } else {
+        std::printf("Round-trip time: not measured yet\n");
+      }
+      printMicroseconds("UDP timeout (adaptive)", status.udpTimeout);
+    } else {
+      printMicroseconds("UDP timeout (fixed)", status.udpTimeout);
+    }
+    if (status.maximumPacketsInFlight > 0) {
+      std::printf("Congestion window: %.2f (max. %d) packets\n",
+          status.congestionWindow, status.maximumPacketsInFlight);
+    } else {
+      std::printf("Congestion window: not used (fixed delay)\n");
+    }
+    std::printf("Pending requests: %zu\n", status.numberOfPendingRequests);
+    std::printf("Queued requests: %zu (%zu bulk)\n",
+        status.numberOfQueuedRequests, status.numberOfQueuedBulkRequests);
+    std::printf("Bulk share: %.2f\n", status.bulkShare);
+    std::printf("Coalesced reads: %llu\n",
+        static_cast<unsigned long long>(status.numberOfCoalescedReads));
+    std::printf("Pipelined 32-bit writes: %s\n",
+        status.pipelinedWrites ? "yes" : "no");
+  } catch (std::exception &e) {
+    errorPrintf("Error while getting device status: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Error while getting device status: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfUdpIpDeviceStatus function.
+ */
+static void iocshMrfUdpIpDeviceStatusFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfUdpIpDeviceStatusFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfUdpIpDeviceStatusFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfUdpIpSetBulkShare function.
+static const iocshArg iocshMrfUdpIpSetBulkShareArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfUdpIpSetBulkShareArg1 = {
+    "share of packets used for bulk requests (0 to 1)", iocshArgDouble };
+static const iocshArg * const iocshMrfUdpIpSetBulkShareArgs[] = {
+    &iocshMrfUdpIpSetBulkShareArg0, &iocshMrfUdpIpSetBulkShareArg1 };
+static const iocshFuncDef iocshMrfUdpIpSetBulkShareFuncDef = {
+  "mrfUdpIpSetBulkShare",
+  2,
+  iocshMrfUdpIpSetBulkShareArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Set the share of packets used for bulk requests by a UDP/IP device.\n\n"
+  "Bulk requests (e.g. from waveform records or from preheating the cache) are "
+  "queued\nseparately from other requests. While both kinds of requests are "
+  "waiting, only\nthe specified share of packets is used for bulk requests. "
+  "The default is 0.2.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfUdpIpSetBulkShareFuncInternal(const iocshArgBuf *args)
+    noexcept {
+  char *deviceId = args[0].sval;
+  double bulkShare = args[1].dval;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  if (!(bulkShare >= 0.0 && bulkShare <= 1.0)) {
+    errorPrintf("The bulk share must be between zero and one.");
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfUdpIpMemoryAccess> device = findUdpIpDevice(deviceId);
+    if (!device) {
+      errorPrintf("Could not find UDP/IP device with ID \"%s\".", deviceId);
+      return 1;
+    }
+    device->setBulkShare(bulkShare);
+  } catch (std::exception &e) {
+    errorPrintf("Could not set bulk share: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not set bulk share: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfUdpIpSetBulkShare function.
+ */
+static void iocshMrfUdpIpSetBulkShareFunc(const iocshArgBuf *args) noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfUdpIpSetBulkShareFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfUdpIpSetBulkShareFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
+// Data structures needed for the iocsh mrfUdpIpSetPipelinedWrites function.
+static const iocshArg iocshMrfUdpIpSetPipelinedWritesArg0 = { "device ID",
+    iocshArgString };
+static const iocshArg iocshMrfUdpIpSetPipelinedWritesArg1 = {
+    "enable (1) or disable (0)", iocshArgInt };
+static const iocshArg * const iocshMrfUdpIpSetPipelinedWritesArgs[] = {
+    &iocshMrfUdpIpSetPipelinedWritesArg0,
+    &iocshMrfUdpIpSetPipelinedWritesArg1 };
+static const iocshFuncDef iocshMrfUdpIpSetPipelinedWritesFuncDef = {
+  "mrfUdpIpSetPipelinedWrites",
+  2,
+  iocshMrfUdpIpSetPipelinedWritesArgs,
+#ifdef IOCSHFUNCDEF_HAS_USAGE
+  "Enable or disable pipelined 32-bit writes for a UDP/IP device.\n\n"
+  "When enabled, the requests for both halves of a 32-bit register are sent "
+  "without\nwaiting for the response to the first one. Pipelined writes are "
+  "disabled by\ndefault.\n",
+#endif // IOCSHFUNCDEF_HAS_USAGE
+};
+
+static int iocshMrfUdpIpSetPipelinedWritesFuncInternal(
+    const iocshArgBuf *args) noexcept {
+  char *deviceId = args[0].sval;
+  int enable = args[1].ival;
+  // Verify and convert the parameters.
+  if (!deviceId) {
+    errorPrintf("Device ID must be specified.");
+    return 1;
+  }
+  if (!std::strlen(deviceId)) {
+    errorPrintf("Device ID must not be empty.");
+    return 1;
+  }
+  try {
+    std::shared_ptr<MrfUdpIpMemoryAccess> device = findUdpIpDevice(deviceId);
+    if (!device) {
+      errorPrintf("Could not find UDP/IP device with ID \"%s\".", deviceId);
+      return 1;
+    }
+    device->setPipelinedWrites(enable != 0);
+  } catch (std::exception &e) {
+    errorPrintf("Could not set pipelined writes: %s", e.what());
+    return 1;
+  } catch (...) {
+    errorPrintf("Could not set pipelined writes: Unknown error.");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Implementation of the iocsh mrfUdpIpSetPipelinedWrites function.
+ */
+static void iocshMrfUdpIpSetPipelinedWritesFunc(const iocshArgBuf *args)
+    noexcept {
+#if EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshSetError(iocshMrfUdpIpSetPipelinedWritesFuncInternal(args));
+#else // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+  iocshMrfUdpIpSetPipelinedWritesFuncInternal(args);
+#endif // EPICS_VERSION_INT >= VERSION_INT(7,0,3,1)
+}
+
 /*
  * Registrar that registers the iocsh commands.
  */
 static void mrfRegistrarUdpIp() {
   iocshRegister(&iocshMrfUdpIpEvgDeviceFuncDef, iocshMrfUdpIpEvgDeviceFunc);
   iocshRegister(&iocshMrfUdpIpEvrDeviceFuncDef, iocshMrfUdpIpEvrDeviceFunc);
+  iocshRegister(&iocshMrfUdpIpDeviceStatusFuncDef,
+      iocshMrfUdpIpDeviceStatusFunc);
+  iocshRegister(&iocshMrfUdpIpSharedReactorFuncDef,
+      iocshMrfUdpIpSharedReactorFunc);
+  iocshRegister(&iocshMrfUdpIpSetBulkShareFuncDef,
+      iocshMrfUdpIpSetBulkShareFunc);
+  iocshRegister(&iocshMrfUdpIpSetPipelinedWritesFuncDef,
+      iocshMrfUdpIpSetPipelinedWritesFunc);
 }
 
 epicsExportRegistrar(mrfRegistrarUdpIp);
@@ -30,6 +30,7 @@
 #include <atomic>
 #include <mutex>
 #include <system_error>
+#include <thread>
 
 extern "C" {
 #include <arpa/inet.h>
@@ -53,9 +54,28 @@ extern "C" {
 namespace anka {
 namespace mrf {
 
+// We use an anonymous namespace for the variables that are only used in this
+// compilation unit.
+namespace {
+
+// Number of requests that can be queued for the I/O thread. This only limits
+// the number of requests that are queued at the same time, so it does not
+// have to be large. If the queue is full, the threads adding requests simply
+// have to wait until the I/O thread has caught up.
+const std::size_t ioQueueCapacity = 1024;
+
+// Memory access that is served by the current thread. This pointer is only
+// set for I/O threads and allows us to detect that a request is queued by the
+// I/O thread itself.
+thread_local MrfMmapMemoryAccess *currentIoThreadMemoryAccess = nullptr;
+
+} // anonymous namespace
+
 MrfMmapMemoryAccess::MrfMmapMemoryAccess(const std::string &devicePath,
-    std::uint32_t memorySize) :
-    devicePath(devicePath), memorySize(memorySize), shutdown(false) {
+    std::uint32_t memorySize, bool useInterrupts) :
+    devicePath(devicePath), memorySize(memorySize), useInterrupts(
+        useInterrupts), shutdown(false), ioQueue(
+        ioQueueCapacity), ioThreadParked(false), queueLength(0), tracingEnabled(false) {
   // Create the background thread.
   this->ioThread = std::thread([this]() {runIoThread();});
 }
@@ -64,16 +84,16 @@ MrfMmapMemoryAccess::~MrfMmapMemoryAccess() {
   // We want to terminate the background thread. We do this by setting the
   // shutdown flag and then waiting for the thread to finish.
   try {
-    {
-      // We have to hold the mutex when setting the shutdown flag.
-      std::lock_guard<std::mutex> lock(mutex);
-      shutdown = true;
-    }
+    shutdown.store(true, std::memory_order_seq_cst);
     // We have to wake up the I/O thread if it is sleeping.
     ioThreadFdSelector.wakeUp();
     if (ioThread.joinable()) {
       ioThread.join();
     }
+    // A request might have been added after the I/O thread checked the queue
+    // for the last time. Now that the I/O thread has terminated, we are the
+    // only consumer, so we can safely fail such requests.
+    failQueuedIoRequests();
   } catch (...) {
     // A destructor should never throw.
   }
@@ -141,8 +161,81 @@ void MrfMmapMemoryAccess::writeUInt32(std::uint32_t address,
   queueIoRequest(std::move(request));
 }
 
+/**
+ * Verifies the address range of a block request. If the block is empty, the
+ * callback is notified of success and false is returned. If the block is
+ * invalid, the callback is notified of the failure and false is returned.
+ */
+template<typename T>
+static bool verifyBlock(std::uint32_t address, std::size_t count,
+    std::uint32_t stride, std::uint32_t memorySize,
+    std::shared_ptr<MrfMemoryAccess::BlockCallback<T>> callback) {
+  if (count == 0) {
+    callback->success(address, std::vector<T>());
+    return false;
+  }
+  // Every element must be within the accessible memory and we also make sure
+  // that it is aligned to the size of the element that is accessed. We use a
+  // 64-bit integer for calculating the end address so that we do not have to
+  // worry about overflows.
+  std::uint64_t endAddress = address
+      + static_cast<std::uint64_t>(count - 1) * stride + sizeof(T);
+  if (address % sizeof(T) != 0 || stride < sizeof(T)
+      || stride % sizeof(T) != 0 || endAddress > memorySize) {
+    callback->failure(address, MrfMemoryAccess::ErrorCode::invalidAddress,
+        std::string());
+    return false;
+  } else {
+    return true;
+  }
+}
+
+void MrfMmapMemoryAccess::readUInt16Block(std::uint32_t address,
+    std::size_t count, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt16> callback) {
+  if (!verifyBlock(address, count, stride, memorySize, callback)) {
+    return;
+  }
+  MrfIoRequest request(MrfIoRequestType::readUInt16Block, address,
+      std::vector<std::uint16_t>(count), stride, callback);
+  queueIoRequest(std::move(request));
+}
+
+void MrfMmapMemoryAccess::writeUInt16Block(std::uint32_t address,
+    std::vector<std::uint16_t> values, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt16> callback) {
+  if (!verifyBlock(address, values.size(), stride, memorySize, callback)) {
+    return;
+  }
+  MrfIoRequest request(MrfIoRequestType::writeUInt16Block, address,
+      std::move(values), stride, callback);
+  queueIoRequest(std::move(request));
+}
+
+void MrfMmapMemoryAccess::readUInt32Block(std::uint32_t address,
+    std::size_t count, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt32> callback) {
+  if (!verifyBlock(address, count, stride, memorySize, callback)) {
+    return;
+  }
+  MrfIoRequest request(MrfIoRequestType::readUInt32Block, address,
+      std::vector<std::uint32_t>(count), stride, callback);
+  queueIoRequest(std::move(request));
+}
+
+void MrfMmapMemoryAccess::writeUInt32Block(std::uint32_t address,
+    std::vector<std::uint32_t> values, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt32> callback) {
+  if (!verifyBlock(address, values.size(), stride, memorySize, callback)) {
+    return;
+  }
+  MrfIoRequest request(MrfIoRequestType::writeUInt32Block, address,
+      std::move(values), stride, callback);
+  queueIoRequest(std::move(request));
+}
+
 bool MrfMmapMemoryAccess::supportsInterrupts() const {
-  return true;
+  return useInterrupts;
 }
 
 void MrfMmapMemoryAccess::addInterruptListener(
@@ -192,6 +285,30 @@ void MrfMmapMemoryAccess::removeInterruptListener(
   }
 }
 
+void MrfMmapMemoryAccess::collectStatistics(MrfStatistics &statistics) {
+  statistics.addCounter("mmap.reads", readCounter.get());
+  statistics.addCounter("mmap.writes", writeCounter.get());
+  statistics.addCounter("mmap.blockReads", blockReadCounter.get());
+  statistics.addCounter("mmap.blockWrites", blockWriteCounter.get());
+  statistics.addCounter("mmap.failures", failureCounter.get());
+  statistics.addCounter("mmap.busErrors", busErrorCounter.get());
+  statistics.addCounter("mmap.interrupts", interruptCounter.get());
+  statistics.addCounter("mmap.queueLength",
+      queueLength.load(std::memory_order_relaxed));
+  statistics.addCounter("mmap.queueHighWater", queueHighWater.get());
+  statistics.addHistogram("mmap.latency", latencyHistogram);
+}
+
+bool MrfMmapMemoryAccess::supportsTracing() const {
+  return true;
+}
+
+void MrfMmapMemoryAccess::setTraceRing(
+    std::shared_ptr<MrfTraceRing> traceRing) {
+  std::atomic_store(&this->traceRing, traceRing);
+  tracingEnabled.store(traceRing != nullptr, std::memory_order_relaxed);
+}
+
 // We need a helper class and a few static variables and functions for handling
 // error's (in the form of SIGBUS signals) that might occur while reading from
 // or writing to mmaped memory. We place this data structures in an anonymous
@@ -200,10 +317,11 @@ namespace {
 
 struct MrfIoInfo {
   constexpr MrfIoInfo() :
-      active(false), address(nullptr), jumpBuffer { } {
+      active(false), address(nullptr), length(0), jumpBuffer { } {
   }
   bool active;
   void *address;
+  std::size_t length;
   ::sigjmp_buf jumpBuffer;
 };
 
@@ -236,8 +354,13 @@ std::atomic<MrfOldSignalHandlerInfo *> oldSignalHandlerInfo;
 extern "C" {
 
 void signalHandler(int signalNumber, ::siginfo_t *signalInfo, void *context) {
+  // A burst operation accesses a whole range of addresses, so we check whether
+  // the faulting address is within the range that is currently being accessed.
+  char *faultAddress = reinterpret_cast<char *>(signalInfo->si_addr);
+  char *ioStartAddress = reinterpret_cast<char *>(threadLocalIoInfo.address);
   if (signalInfo->si_signo != SIGBUS || !threadLocalIoInfo.active
-      || signalInfo->si_addr != threadLocalIoInfo.address) {
+      || faultAddress < ioStartAddress
+      || faultAddress >= ioStartAddress + threadLocalIoInfo.length) {
     // If the signal has not been caused by our code, we delegate to a
     // previously registered signal handler, if there is any. If there is not,
     // we take the default action (terminate the program).
@@ -345,40 +468,144 @@ void MrfMmapMemoryAccess::MrfIoRequest::fail(ErrorCode errorCode,
       // code.
     }
     break;
+  case MrfIoRequestType::readUInt16Block:
+  case MrfIoRequestType::writeUInt16Block:
+    try {
+      if (blockCallback16) {
+        blockCallback16->failure(address, errorCode, details);
+      }
+    } catch (...) {
+      // We do not want an exception in a callback to bubble up into the calling
+      // code.
+    }
+    break;
+  case MrfIoRequestType::readUInt32Block:
+  case MrfIoRequestType::writeUInt32Block:
+    try {
+      if (blockCallback32) {
+        blockCallback32->failure(address, errorCode, details);
+      }
+    } catch (...) {
+      // We do not want an exception in a callback to bubble up into the calling
+      // code.
+    }
+    break;
   }
 
 } // anonymous namespace
 
 void MrfMmapMemoryAccess::queueIoRequest(MrfIoRequest &&request) {
-  try {
-    {
-      // We have to hold the mutex while accessing the queue.
-      std::lock_guard<std::mutex> lock(mutex);
-      if (shutdown) {
-        throw std::runtime_error("This device has been shutdown.");
-      }
-      ioQueue.emplace_back(request);
-    }
-  } catch (std::exception &e) {
-    // This block is only triggered when the emplace (or code before the
-    // emplace) failed, so our request should still be valid.
-    request.fail(ErrorCode::unknown,
-        std::string("The request could not be queued: ") + e.what());
-  } catch (...) {
-    // This block is only triggered when the emplace (or code before the
-    // emplace) failed, so our request should still be valid.
+  if (shutdown.load(std::memory_order_acquire)) {
     request.fail(ErrorCode::unknown,
-        std::string("The request could not be queued."));
+        "The request could not be queued: This device has been shutdown.");
     return;
   }
-  // The I/O thread might be sleeping, waiting for a new request, so we have
-  // to wake it up now.
-  try {
-    ioThreadFdSelector.wakeUp();
-  } catch (...) {
-    // When the request has been queued, we cannot fail it any longer because it
-    // is going to be processed eventually. For this reason, we ignore an error
-    // that occurs while trying to wake up the I/O thread.
+  switch (request.type) {
+  case MrfIoRequestType::readUInt16:
+  case MrfIoRequestType::readUInt32:
+    readCounter.increment();
+    break;
+  case MrfIoRequestType::writeUInt16:
+  case MrfIoRequestType::writeUInt32:
+    writeCounter.increment();
+    break;
+  case MrfIoRequestType::readUInt16Block:
+  case MrfIoRequestType::readUInt32Block:
+    blockReadCounter.increment();
+    break;
+  case MrfIoRequestType::writeUInt16Block:
+  case MrfIoRequestType::writeUInt32Block:
+    blockWriteCounter.increment();
+    break;
+  default:
+    break;
+  }
+  request.queueTime = std::chrono::steady_clock::now();
+  // If the request is queued by the I/O thread, we use the separate queue that
+  // is only accessed by the I/O thread. The I/O thread is going to process
+  // that queue before sleeping, so there is no need to wake it up.
+  if (currentIoThreadMemoryAccess == this) {
+    try {
+      ioThreadQueue.push_back(std::move(request));
+      queueHighWater.updateMaximum(
+          queueLength.fetch_add(1, std::memory_order_relaxed) + 1);
+    } catch (std::exception &e) {
+      // This block is only triggered when the push_back failed, so our request
+      // should still be valid.
+      request.fail(ErrorCode::unknown,
+          std::string("The request could not be queued: ") + e.what());
+    } catch (...) {
+      // This block is only triggered when the push_back failed, so our request
+      // should still be valid.
+      request.fail(ErrorCode::unknown,
+          std::string("The request could not be queued."));
+    }
+    return;
+  }
+  // If the queue is full, we have to wait for the I/O thread to process some
+  // requests. The I/O thread cannot be parked while the queue is not empty, so
+  // we do not have to wake it up.
+  while (!ioQueue.tryPush(std::move(request))) {
+    if (shutdown.load(std::memory_order_acquire)) {
+      // The request has not been moved because it could not be added to the
+      // queue, so it is still valid.
+      request.fail(ErrorCode::unknown,
+          "The request could not be queued: This device has been shutdown.");
+      return;
+    }
+    std::this_thread::yield();
+  }
+  queueHighWater.updateMaximum(
+      queueLength.fetch_add(1, std::memory_order_relaxed) + 1);
+  // The I/O thread might be sleeping, waiting for a new request. This fence
+  // pairs with the fence in the I/O thread: Either the I/O thread sees our
+  // request before going to sleep or we see the parked flag and wake it up.
+  // This way, we only need the (expensive) system call for waking up the
+  // thread when it is actually sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ioThreadParked.load(std::memory_order_relaxed)) {
+    try {
+      ioThreadFdSelector.wakeUp();
+    } catch (...) {
+      // When the request has been queued, we cannot fail it any longer because
+      // it is going to be processed eventually. For this reason, we ignore an
+      // error that occurs while trying to wake up the I/O thread.
+    }
+  }
+}
+
+MrfTraceRing::OperationType MrfMmapMemoryAccess::traceOperationType(
+    MrfIoRequestType type) {
+  switch (type) {
+  case MrfIoRequestType::writeUInt16:
+    return MrfTraceRing::OperationType::writeUInt16;
+  case MrfIoRequestType::readUInt32:
+    return MrfTraceRing::OperationType::readUInt32;
+  case MrfIoRequestType::writeUInt32:
+    return MrfTraceRing::OperationType::writeUInt32;
+  case MrfIoRequestType::readUInt16Block:
+    return MrfTraceRing::OperationType::readUInt16Block;
+  case MrfIoRequestType::writeUInt16Block:
+    return MrfTraceRing::OperationType::writeUInt16Block;
+  case MrfIoRequestType::readUInt32Block:
+    return MrfTraceRing::OperationType::readUInt32Block;
+  case MrfIoRequestType::writeUInt32Block:
+    return MrfTraceRing::OperationType::writeUInt32Block;
+  default:
+    return MrfTraceRing::OperationType::readUInt16;
+  }
+}
+
+void MrfMmapMemoryAccess::failQueuedIoRequests() {
+  MrfIoRequest request;
+  while (!ioThreadQueue.empty()) {
+    ioThreadQueue.front().fail(ErrorCode::unknown,
+        "The device has been shutdown before the request could be processed.");
+    ioThreadQueue.pop_front();
+  }
+  while (ioQueue.tryPop(request)) {
+    request.fail(ErrorCode::unknown,
+        "The device has been shutdown before the request could be processed.");
   }
 }
 
@@ -423,11 +650,13 @@ static void enableInterrupt(int fileDescriptor) {
   }
 }
 
-inline static void prepareIo(void *targetAddress) noexcept {
+inline static void prepareIo(void *targetAddress, std::size_t length)
+    noexcept {
   // When the I/O operation fails with a SIGBUS, our signal handler ensures
   // that the execution jumps back to the point where we called sigsetjmp and
   // that this function returns a non-zero value.
   threadLocalIoInfo.address = targetAddress;
+  threadLocalIoInfo.length = length;
   // We have to use two fences: One before setting active and one after. The
   // first one is so that active is not going to be set before initializing
   // address and jumpBuffer. This ensures that when the signal handler is
@@ -470,7 +699,7 @@ inline static bool ioReadUInt16(void *targetAddress, std::uint16_t &value)
     finishIo();
     return false;
   }
-  prepareIo(targetAddress);
+  prepareIo(targetAddress, sizeof(std::uint16_t));
   // The MRF devices use big endian internally, so we have to convert when we
   // are running on a little endian system. htonl, htons, ntohl, and ntohs can
   // be preprocessor macros, so we cannot qualify them explicitly with "::".
@@ -487,7 +716,7 @@ inline static bool ioReadUInt32(void *targetAddress, std::uint32_t &value)
     finishIo();
     return false;
   }
-  prepareIo(targetAddress);
+  prepareIo(targetAddress, sizeof(std::uint32_t));
   // The MRF devices use big endian internally, so we have to convert when we
   // are running on a little endian system. htonl, htons, ntohl, and ntohs can
   // be preprocessor macros, so we cannot qualify them explicitly with "::".
@@ -504,7 +733,7 @@ inline static bool ioReadWriteBackUInt32(void *targetAddress, std::uint32_t &val
     finishIo();
     return false;
   }
-  prepareIo(targetAddress);
+  prepareIo(targetAddress, sizeof(std::uint32_t));
   // The MRF devices use big endian internally, so we have to convert when we
   // are running on a little endian system. htonl, htons, ntohl, and ntohs can
   // be preprocessor macros, so we cannot qualify them explicitly with "::".
@@ -522,7 +751,7 @@ inline static bool ioWriteReadUInt16(void *targetAddress, std::uint16_t &value)
     finishIo();
     return false;
   }
-  prepareIo(targetAddress);
+  prepareIo(targetAddress, sizeof(std::uint16_t));
   // The MRF devices use big endian internally, so we have to convert when we
   // are running on a little endian system. htonl, htons, ntohl, and ntohs can
   // be preprocessor macros, so we cannot qualify them explicitly with "::".
@@ -540,7 +769,7 @@ inline static bool ioWriteReadUInt32(void *targetAddress, std::uint32_t &value)
     finishIo();
     return false;
   }
-  prepareIo(targetAddress);
+  prepareIo(targetAddress, sizeof(std::uint32_t));
   // The MRF devices use big endian internally, so we have to convert when we
   // are running on a little endian system. htonl, htons, ntohl, and ntohs can
   // be preprocessor macros, so we cannot qualify them explicitly with "::".
@@ -550,7 +779,118 @@ inline static bool ioWriteReadUInt32(void *targetAddress, std::uint32_t &value)
   return true;
 }
 
+// The burst functions access a whole block of registers while only entering
+// the SIGBUS guard once. The conversion between the byte order of the device and
+// the host is done in separate loops that do not touch the device memory. Unlike
+// the loops accessing the device memory through volatile pointers, these loops
+// can be vectorized by the compiler. The only variable that changes after
+// sigsetjmp is the volatile index, so that siglongjmp cannot clobber any of
+// the other variables.
+
+inline static bool ioReadBlockUInt16(void *targetAddress, std::uint32_t stride,
+    std::size_t count, std::uint16_t *values) noexcept {
+  char *const baseAddress = reinterpret_cast<char *>(targetAddress);
+  // If sigsetjmp returns a non-zero value, siglongjmp was called by the signal
+  // handler which means that an error occurred.
+  if (::sigsetjmp(threadLocalIoInfo.jumpBuffer, 1)) {
+    finishIo();
+    return false;
+  }
+  prepareIo(baseAddress, (count - 1) * stride + sizeof(std::uint16_t));
+  for (volatile std::size_t index = 0; index < count; ++index) {
+    values[index] = *(reinterpret_cast<volatile std::uint16_t *>(baseAddress
+        + index * stride));
+  }
+  finishIo();
+  for (std::size_t index = 0; index < count; ++index) {
+    values[index] = ntohs(values[index]);
+  }
+  return true;
+}
+
+inline static bool ioReadBlockUInt32(void *targetAddress, std::uint32_t stride,
+    std::size_t count, std::uint32_t *values) noexcept {
+  char *const baseAddress = reinterpret_cast<char *>(targetAddress);
+  // If sigsetjmp returns a non-zero value, siglongjmp was called by the signal
+  // handler which means that an error occurred.
+  if (::sigsetjmp(threadLocalIoInfo.jumpBuffer, 1)) {
+    finishIo();
+    return false;
+  }
+  prepareIo(baseAddress, (count - 1) * stride + sizeof(std::uint32_t));
+  for (volatile std::size_t index = 0; index < count; ++index) {
+    values[index] = *(reinterpret_cast<volatile std::uint32_t *>(baseAddress
+        + index * stride));
+  }
+  finishIo();
+  for (std::size_t index = 0; index < count; ++index) {
+    values[index] = ntohl(values[index]);
+  }
+  return true;
+}
+
+inline static bool ioWriteReadBlockUInt16(void *targetAddress,
+    std::uint32_t stride, std::size_t count, std::uint16_t *values) noexcept {
+  for (std::size_t index = 0; index < count; ++index) {
+    values[index] = htons(values[index]);
+  }
+  char *const baseAddress = reinterpret_cast<char *>(targetAddress);
+  // If sigsetjmp returns a non-zero value, siglongjmp was called by the signal
+  // handler which means that an error occurred.
+  if (::sigsetjmp(threadLocalIoInfo.jumpBuffer, 1)) {
+    finishIo();
+    return false;
+  }
+  prepareIo(baseAddress, (count - 1) * stride + sizeof(std::uint16_t));
+  // Like for a single write, we read each register back right after writing
+  // it.
+  for (volatile std::size_t index = 0; index < count; ++index) {
+    volatile std::uint16_t *elementAddress =
+        reinterpret_cast<volatile std::uint16_t *>(baseAddress
+            + index * stride);
+    *elementAddress = values[index];
+    values[index] = *elementAddress;
+  }
+  finishIo();
+  for (std::size_t index = 0; index < count; ++index) {
+    values[index] = ntohs(values[index]);
+  }
+  return true;
+}
+
+inline static bool ioWriteReadBlockUInt32(void *targetAddress,
+    std::uint32_t stride, std::size_t count, std::uint32_t *values) noexcept {
+  for (std::size_t index = 0; index < count; ++index) {
+    values[index] = htonl(values[index]);
+  }
+  char *const baseAddress = reinterpret_cast<char *>(targetAddress);
+  // If sigsetjmp returns a non-zero value, siglongjmp was called by the signal
+  // handler which means that an error occurred.
+  if (::sigsetjmp(threadLocalIoInfo.jumpBuffer, 1)) {
+    finishIo();
+    return false;
+  }
+  prepareIo(baseAddress, (count - 1) * stride + sizeof(std::uint32_t));
+  // Like for a single write, we read each register back right after writing
+  // it.
+  for (volatile std::size_t index = 0; index < count; ++index) {
+    volatile std::uint32_t *elementAddress =
+        reinterpret_cast<volatile std::uint32_t *>(baseAddress
+            + index * stride);
+    *elementAddress = values[index];
+    values[index] = *elementAddress;
+  }
+  finishIo();
+  for (std::size_t index = 0; index < count; ++index) {
+    values[index] = ntohl(values[index]);
+  }
+  return true;
+}
+
 void MrfMmapMemoryAccess::runIoThread() {
+  // We remember that this thread is the I/O thread for this memory access, so
+  // that requests queued from within callbacks can be detected.
+  currentIoThreadMemoryAccess = this;
   // We block the SIGIO signal for this thread. We want to read this signal from
   // our signal file descriptor and so we do not want a signal handler (if there
   // is one) to intercept it.
@@ -570,8 +910,8 @@ void MrfMmapMemoryAccess::runIoThread() {
   int signalFd = -1;
   int deviceFd = -1;
   void *deviceMemory = nullptr;
-  // We do not check the shutdown flag in the loop condition because we have to
-  // acquire the mutex when checking the flag.
+  // We do not check the shutdown flag in the loop condition because we check it
+  // after consuming a pending signal.
   while (true) {
     std::string deviceErrorDetails;
     // We create a signal file-descriptor (if we do not have one already) so
@@ -602,8 +942,10 @@ void MrfMmapMemoryAccess::runIoThread() {
             deviceFd, 0);
         if (deviceMemory != MAP_FAILED) {
           try {
-            prepareInterrupt(deviceFd);
-            enableInterrupt(deviceFd);
+            if (useInterrupts) {
+              prepareInterrupt(deviceFd);
+              enableInterrupt(deviceFd);
+            }
           } catch (std::exception &e) {
             ::munmap(deviceMemory, memorySize);
             deviceMemory = nullptr;
@@ -658,48 +1000,43 @@ void MrfMmapMemoryAccess::runIoThread() {
     }
     MrfIoRequest request;
     bool haveRequest = false;
+    // If the device is being shutdown, we exit the loop. We also check this
+    // flag when we have an interrupt so that the loop quits even if interrupts
+    // happen very frequently.
+    if (shutdown.load(std::memory_order_acquire)) {
+      break;
+    }
     // If we have an interrupt, we handle this interrupt before trying to get
-    // the next request. However, we still check the shutdown flag so that the
-    // loop quits even if interrupts happen very frequently.
-    if (haveInterrupt) {
-      // We have to hold the mutex while accessing the shutdown flag.
-      std::unique_lock<std::mutex> lock(mutex);
-      // If the device is being shutdown, we exit the loop.
-      if (shutdown) {
-        break;
-      }
-    } else {
-      // We have to hold the mutex while accessing the queue and the shutdown
-      // flag.
-      std::unique_lock<std::mutex> lock(mutex);
-      // If the device is being shutdown, we exit the loop.
-      if (shutdown) {
-        break;
-      }
-      // If the queue is empty, we later wait for an element to be queued and
-      // then try again. The thread might wake up spuriously, so we cannot
-      // expect that the queue will always have an element when we wake up.
-      if (!ioQueue.empty()) {
-        request = std::move(ioQueue.front());
+    // the next request. Requests that have been queued by this thread are
+    // processed first. If both queues are empty, we later wait for an element
+    // to be queued and then try again. The thread might wake up spuriously, so
+    // we cannot expect that the queue will always have an element when we
+    // wake up.
+    if (!haveInterrupt) {
+      if (!ioThreadQueue.empty()) {
+        request = std::move(ioThreadQueue.front());
+        ioThreadQueue.pop_front();
         haveRequest = true;
-        ioQueue.pop_front();
       } else {
-        haveRequest = false;
+        haveRequest = ioQueue.tryPop(request);
+      }
+      if (haveRequest) {
+        queueLength.fetch_sub(1, std::memory_order_relaxed);
       }
     }
-    // We do not need the mutex for the rest of the operations and in fact we
-    // should not hold it because we might sleep when calling select(...).
     bool ioSuccessful = true;
     if (haveRequest) {
       // If we could not open and mmap the device sucessfully, we have to report
       // an error.
       if (deviceMemory == nullptr) {
+        failureCounter.increment();
         request.fail(ErrorCode::unknown, deviceErrorDetails);
         continue;
       }
       void *targetAddress =
           reinterpret_cast<void *>(reinterpret_cast<char*>(deviceMemory)
               + request.address);
+      auto ioStartTime = std::chrono::steady_clock::now();
       switch (request.type) {
       case MrfIoRequestType::notSpecified:
         // This should never happen. We cannot fail the request because most
@@ -719,7 +1056,24 @@ void MrfMmapMemoryAccess::runIoThread() {
       case MrfIoRequestType::writeUInt32:
         ioSuccessful = ioWriteReadUInt32(targetAddress, request.value32);
         break;
+      case MrfIoRequestType::readUInt16Block:
+        ioSuccessful = ioReadBlockUInt16(targetAddress, request.stride,
+            request.values16.size(), request.values16.data());
+        break;
+      case MrfIoRequestType::writeUInt16Block:
+        ioSuccessful = ioWriteReadBlockUInt16(targetAddress, request.stride,
+            request.values16.size(), request.values16.data());
+        break;
+      case MrfIoRequestType::readUInt32Block:
+        ioSuccessful = ioReadBlockUInt32(targetAddress, request.stride,
+            request.values32.size(), request.values32.data());
+        break;
+      case MrfIoRequestType::writeUInt32Block:
+        ioSuccessful = ioWriteReadBlockUInt32(targetAddress, request.stride,
+            request.values32.size(), request.values32.data());
+        break;
       }
+      auto ioEndTime = std::chrono::steady_clock::now();
       // We have to notify the callback of the result of the operation.
       if (ioSuccessful) {
         switch (request.type) {
@@ -750,12 +1104,57 @@ void MrfMmapMemoryAccess::runIoThread() {
             // code.
           }
           break;
+        case MrfIoRequestType::readUInt16Block:
+        case MrfIoRequestType::writeUInt16Block:
+          try {
+            if (request.blockCallback16) {
+              request.blockCallback16->success(request.address,
+                  request.values16);
+            }
+          } catch (...) {
+            // We do not want an exception in a callback to bubble up into the calling
+            // code.
+          }
+          break;
+        case MrfIoRequestType::readUInt32Block:
+        case MrfIoRequestType::writeUInt32Block:
+          try {
+            if (request.blockCallback32) {
+              request.blockCallback32->success(request.address,
+                  request.values32);
+            }
+          } catch (...) {
+            // We do not want an exception in a callback to bubble up into the calling
+            // code.
+          }
+          break;
         }
       } else {
+        failureCounter.increment();
+        busErrorCounter.increment();
         request.fail(ErrorCode::unknown,
             std::string("Received a SIGBUS while trying to access the device ")
                 + devicePath + ". This indicates an I/O error.");
       }
+      auto completionTime = std::chrono::steady_clock::now();
+      latencyHistogram.record(completionTime - request.queueTime);
+      if (tracingEnabled.load(std::memory_order_relaxed)) {
+        std::shared_ptr<MrfTraceRing> traceRing = std::atomic_load(
+            &this->traceRing);
+        if (traceRing) {
+          MrfTraceRing::Entry entry;
+          entry.type = traceOperationType(request.type);
+          entry.address = request.address;
+          entry.success = ioSuccessful;
+          entry.numberOfTries = 1;
+          entry.queueTime = MrfTraceRing::toTimestamp(request.queueTime);
+          entry.firstSendTime = MrfTraceRing::toTimestamp(ioStartTime);
+          entry.lastSendTime = entry.firstSendTime;
+          entry.responseTime = MrfTraceRing::toTimestamp(ioEndTime);
+          entry.completionTime = MrfTraceRing::toTimestamp(completionTime);
+          traceRing->add(entry);
+        }
+      }
     } else if (haveInterrupt) {
       // If we cannot access the hardware, there is no way how we can handle the
       // interrupt, so we simply ignore it. Interrupts will be enabled again
@@ -763,6 +1162,7 @@ void MrfMmapMemoryAccess::runIoThread() {
       if (deviceMemory == nullptr) {
         continue;
       }
+      interruptCounter.increment();
       // The interrupt flag register is stored at address 0x08.
       void *interruptFlagRegisterAddress =
           reinterpret_cast<void *>(reinterpret_cast<char*>(deviceMemory) + 0x08);
@@ -851,8 +1251,16 @@ void MrfMmapMemoryAccess::runIoThread() {
         struct ::timeval waitTime;
         waitTime.tv_sec = 5;
         waitTime.tv_usec = 0;
-        ioThreadFdSelector.select(&readFds, nullptr, nullptr, signalFd,
-            &waitTime);
+        // Threads adding a request only wake us up when we are parked, so we
+        // have to set the flag before checking the queue for the last time.
+        // The fence pairs with the one in queueIoRequest(...).
+        ioThreadParked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ioQueue.isEmpty() && !shutdown.load(std::memory_order_relaxed)) {
+          ioThreadFdSelector.select(&readFds, nullptr, nullptr, signalFd,
+              &waitTime);
+        }
+        ioThreadParked.store(false, std::memory_order_relaxed);
         // After waking up, the event will be handled in the next iteration.
       } catch (std::system_error &e) {
         if (e.code().value() == EINTR) {
@@ -915,13 +1323,9 @@ void MrfMmapMemoryAccess::runIoThread() {
     ::close(signalFd);
     signalFd = -1;
   }
-  // When we are here, we can access the queue without acquiring the mutex
-  // because no requests are added after setting the shutdown flag and this is
-  // the only thread that processes the queue.
-  for (MrfIoRequest &request : ioQueue) {
-    request.fail(ErrorCode::unknown,
-        "The device has been shutdown before the request could be processed.");
-  }
+  // No requests are processed after setting the shutdown flag, so we fail
+  // the requests that are still queued.
+  failQueuedIoRequests();
 }
 
 } // namespace mrf
@@ -31,8 +31,9 @@
 #define ANKA_MRF_MMAP_MEMORY_ACCESS_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <list>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -41,6 +42,7 @@
 
 #include <MrfFdSelector.h>
 #include <MrfMemoryAccess.h>
+#include <MrfMpscQueue.h>
 
 namespace anka {
 namespace mrf {
@@ -68,12 +70,17 @@ public:
    * accessing the device. Specifying a value that is too small will result in
    * parts of the device's memory not being accessible.
    *
+   * When useInterrupts is false, the device is not configured for generating
+   * interrupts and {@link supportsInterrupts()} returns {@code false}. This
+   * makes it possible to map a file that is not provided by the MRF kernel
+   * module (e.g. a memory-backed file that is used for benchmarks).
+   *
    * The constructor creates a background thread that takes
    * care of communicating with the device. Throws an exception if the
    * background thread cannot be created.
    */
   MrfMmapMemoryAccess(const std::string &devicePath,
-      const std::uint32_t memorySize);
+      const std::uint32_t memorySize, bool useInterrupts = true);
 
   /**
    * Destructor. Closes the connection to the device and terminates the
@@ -125,17 +132,59 @@ public:
   virtual void writeUInt32(std::uint32_t address, std::uint32_t value,
       std::shared_ptr<CallbackUInt32>);
 
+  /**
+   * Reads from a block of unsigned 16-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. All registers
+   * of the block are read in a single burst by the I/O thread. When the
+   * operation finishes, the specified callback is called.
+   */
+  virtual void readUInt16Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt16> callback);
+
+  /**
+   * Writes to a block of unsigned 16-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. All registers
+   * of the block are written in a single burst by the I/O thread. When the
+   * operation finishes, the specified callback is called.
+   */
+  virtual void writeUInt16Block(std::uint32_t address,
+      std::vector<std::uint16_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt16> callback);
+
+  /**
+   * Reads from a block of unsigned 32-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. All registers
+   * of the block are read in a single burst by the I/O thread. When the
+   * operation finishes, the specified callback is called.
+   */
+  virtual void readUInt32Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt32> callback);
+
+  /**
+   * Writes to a block of unsigned 32-bit registers. This method does not
+   * block. The operation is queued and executed asynchronously. All registers
+   * of the block are written in a single burst by the I/O thread. When the
+   * operation finishes, the specified callback is called.
+   */
+  virtual void writeUInt32Block(std::uint32_t address,
+      std::vector<std::uint32_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt32> callback);
+
   // We want the methods from the base class to participate in overload
   // resolution.
   using MrfMemoryAccess::readUInt16;
+  using MrfMemoryAccess::readUInt16Block;
   using MrfMemoryAccess::readUInt32;
+  using MrfMemoryAccess::readUInt32Block;
   using MrfMemoryAccess::writeUInt16;
+  using MrfMemoryAccess::writeUInt16Block;
   using MrfMemoryAccess::writeUInt32;
+  using MrfMemoryAccess::writeUInt32Block;
 
   /**
    * Tells whether this memory access supports interrupts. The mmap memory
-   * access always supports interrupts, so this method always returns
-   * {@code true}.
+   * access supports interrupts unless it has been created with
+   * {@code useInterrupts} set to {@code false}.
    */
   virtual bool supportsInterrupts() const;
 
@@ -159,13 +208,43 @@ public:
   virtual void removeInterruptListener(
       std::shared_ptr<InterruptListener> interruptListener);
 
+  /**
+   * Adds the runtime statistics of this memory access to the specified
+   * statistics object. The names of the statistics start with "mmap.". This
+   * method is thread safe.
+   */
+  virtual void collectStatistics(MrfStatistics &statistics);
+
+  /**
+   * Tells whether this memory access can record a trace of its operations.
+   * Always returns {@code true}.
+   */
+  virtual bool supportsTracing() const;
+
+  /**
+   * Sets the ring buffer to which this memory access adds an entry for each
+   * request that finishes. The entry records when the request was queued,
+   * when the I/O thread started and finished accessing the device, and when
+   * the callback returned. Passing a null pointer disables tracing. This
+   * method is thread safe.
+   */
+  virtual void setTraceRing(std::shared_ptr<MrfTraceRing> traceRing);
+
 private:
 
   /**
    * Type of a queued request.
    */
   enum class MrfIoRequestType {
-    notSpecified, readUInt16, writeUInt16, readUInt32, writeUInt32
+    notSpecified,
+    readUInt16,
+    writeUInt16,
+    readUInt32,
+    writeUInt32,
+    readUInt16Block,
+    writeUInt16Block,
+    readUInt32Block,
+    writeUInt32Block
   };
 
   /**
@@ -174,33 +253,56 @@ private:
    * and 32-bit requests instead of using unions. If we used a union of shared
    * pointers, we would need to handle the construction and destruction
    * explicitly and this seems like an awful lot of work (with a high risk for
-   * nasty bugs) just to save a few bytes of memory.
+   * nasty bugs) just to save a few bytes of memory. Block requests use the
+   * vectors for passing the values and the stride for calculating the address
+   * of each element.
    */
   struct MrfIoRequest {
 
     MrfIoRequestType type;
     std::uint32_t address;
+    std::uint32_t stride;
     std::uint16_t value16;
     std::uint32_t value32;
+    std::vector<std::uint16_t> values16;
+    std::vector<std::uint32_t> values32;
     std::shared_ptr<CallbackUInt16> callback16;
     std::shared_ptr<CallbackUInt32> callback32;
+    std::shared_ptr<BlockCallbackUInt16> blockCallback16;
+    std::shared_ptr<BlockCallbackUInt32> blockCallback32;
+    std::chrono::steady_clock::time_point queueTime;
 
     MrfIoRequest() :
-        type(MrfIoRequestType::notSpecified), address(0), value16(0), value32(0) {
+        type(MrfIoRequestType::notSpecified), address(0), stride(0), value16(
+            0), value32(0) {
     }
 
     MrfIoRequest(MrfIoRequestType type, std::uint32_t address,
         std::uint16_t value, std::shared_ptr<CallbackUInt16> callback) :
-        type(type), address(address), value16(value), value32(0), callback16(
+        type(type), address(address), stride(0), value16(value), value32(0), callback16(
             callback), callback32(nullptr) {
     }
 
     MrfIoRequest(MrfIoRequestType type, std::uint32_t address,
         std::uint32_t value, std::shared_ptr<CallbackUInt32> callback) :
-        type(type), address(address), value16(0), value32(value), callback16(
+        type(type), address(address), stride(0), value16(0), value32(value), callback16(
             nullptr), callback32(callback) {
     }
 
+    MrfIoRequest(MrfIoRequestType type, std::uint32_t address,
+        std::vector<std::uint16_t> &&values, std::uint32_t stride,
+        std::shared_ptr<BlockCallbackUInt16> callback) :
+        type(type), address(address), stride(stride), value16(0), value32(0), values16(
+            std::move(values)), blockCallback16(callback) {
+    }
+
+    MrfIoRequest(MrfIoRequestType type, std::uint32_t address,
+        std::vector<std::uint32_t> &&values, std::uint32_t stride,
+        std::shared_ptr<BlockCallbackUInt32> callback) :
+        type(type), address(address), stride(stride), value16(0), value32(0), values32(
+            std::move(values)), blockCallback32(callback) {
+    }
+
     void fail(ErrorCode errorCode, const std::string& details);
 
   };
@@ -213,9 +315,65 @@ private:
 
   const std::string devicePath;
   const std::uint32_t memorySize;
-  bool shutdown = false;
+  const bool useInterrupts;
+  std::atomic<bool> shutdown;
+
+  /**
+   * Mutex protecting the list of interrupt listeners. The I/O queue does not
+   * need a mutex.
+   */
   std::mutex mutex;
-  std::list<MrfIoRequest> ioQueue;
+
+  /**
+   * Queue holding the requests that have been added by threads other than the
+   * I/O thread.
+   */
+  MrfMpscQueue<MrfIoRequest> ioQueue;
+
+  /**
+   * Queue holding the requests that have been added by the I/O thread itself
+   * (typically from within a callback). This queue is only accessed by the I/O
+   * thread, so it does not need any synchronization. We need it because the
+   * I/O thread must never wait for space in the shared queue: It is the only
+   * thread that can make such space available.
+   */
+  std::deque<MrfIoRequest> ioThreadQueue;
+
+  /**
+   * Flag indicating whether the I/O thread is sleeping (or about to sleep)
+   * because there are no requests. Threads adding requests only have to wake
+   * up the I/O thread when this flag is set.
+   */
+  std::atomic<bool> ioThreadParked;
+
+  /**
+   * Number of requests that have been queued, but have not been taken from
+   * the queue by the I/O thread yet. This number is only used for the
+   * statistics.
+   */
+  std::atomic<std::size_t> queueLength;
+
+  // Runtime statistics. The counters and histograms can be updated and read
+  // without holding the mutex.
+  MrfStatisticsCounter readCounter;
+  MrfStatisticsCounter writeCounter;
+  MrfStatisticsCounter blockReadCounter;
+  MrfStatisticsCounter blockWriteCounter;
+  MrfStatisticsCounter failureCounter;
+  MrfStatisticsCounter busErrorCounter;
+  MrfStatisticsCounter interruptCounter;
+  MrfStatisticsCounter queueHighWater;
+  MrfLatencyHistogram latencyHistogram;
+
+  /**
+   * Ring to which finished requests are added when tracing is enabled. The
+   * pointer is accessed through the atomic functions for shared pointers, so
+   * that it can be read without holding the mutex. As the flag can be read
+   * much more cheaply, it is checked first.
+   */
+  std::atomic<bool> tracingEnabled;
+  std::shared_ptr<MrfTraceRing> traceRing;
+
   std::thread ioThread;
   MrfFdSelector ioThreadFdSelector;
   std::vector<std::weak_ptr<InterruptListener>> interruptListeners;
@@ -223,12 +381,27 @@ private:
   /**
    * Adds an I/O request to the queue. This method takes care of waking up the
    * I/O thread if necessary. The added request fails immediately if this device
-   * has been shutdown. This method uses move semantics in order to avoid
-   * copying when adding the request. This means that the specified request
-   * object will possibly be invalid after calling this method.
+   * has been shutdown. If the queue is full, this method waits until the I/O
+   * thread has processed some of the queued requests. This method uses move
+   * semantics in order to avoid copying when adding the request. This means
+   * that the specified request object will possibly be invalid after calling
+   * this method.
    */
   void queueIoRequest(MrfIoRequest &&request);
 
+  /**
+   * Returns the operation type that is used in the trace for the specified
+   * request type.
+   */
+  static MrfTraceRing::OperationType traceOperationType(MrfIoRequestType type);
+
+  /**
+   * Fails all requests that are still queued. This is used when the device is
+   * shutdown and must only be called by the I/O thread or after the I/O thread
+   * has terminated.
+   */
+  void failQueuedIoRequests();
+
   /**
    * Main function of the I/O thread.
    */
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "MrfSimulatedMemoryAccess.h"
+
+namespace anka {
+namespace mrf {
+
+// We use an anonymous namespace for the functions that are only used in this
+// compilation unit.
+namespace {
+
+/**
+ * Converts an {@link MrfTime} that represents a time interval to a duration.
+ */
+std::chrono::steady_clock::duration timeToDuration(const MrfTime &time) {
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::seconds(time.getSeconds())
+          + std::chrono::nanoseconds(time.getNanoseconds()));
+}
+
+} // anonymous namespace
+
+constexpr std::uint32_t MrfSimulatedMemoryAccess::interruptFlagRegister;
+constexpr std::uint32_t MrfSimulatedMemoryAccess::interruptEnableRegister;
+constexpr std::uint32_t MrfSimulatedMemoryAccess::memorySizeVmeEvg230;
+constexpr std::uint32_t MrfSimulatedMemoryAccess::memorySizeVmeEvr230Rf;
+
+MrfSimulatedMemoryAccess::MrfSimulatedMemoryAccess(std::uint32_t memorySize) :
+    memorySize(memorySize), memory(memorySize / 2), lastDueTime(Clock::now()),
+    latency(Clock::duration::zero()), jitter(Clock::duration::zero()),
+    fpgaTimeoutProbability(0.0), invalidAddressProbability(0.0),
+    randomGenerator(std::random_device()()), shutdown(false) {
+  // Create the background thread.
+  this->processingThread = std::thread([this]() {runProcessingThread();});
+}
+
+MrfSimulatedMemoryAccess::~MrfSimulatedMemoryAccess() {
+  // We want to terminate the background thread. We do this by setting the
+  // shutdown flag and then waiting for the thread to finish.
+  try {
+    std::deque<Operation> remainingOperations;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      shutdown = true;
+      condition.notify_all();
+    }
+    if (processingThread.joinable()) {
+      processingThread.join();
+    }
+    // The background thread has terminated, so we are the only one accessing
+    // the queue now.
+    remainingOperations.swap(queue);
+    for (auto &operation : remainingOperations) {
+      std::string errorMessage(
+          "The device has been shutdown before the request could be processed.");
+      if (operation.callbackUInt16) {
+        operation.callbackUInt16->failure(operation.address,
+            ErrorCode::unknown, errorMessage);
+      } else if (operation.callbackUInt32) {
+        operation.callbackUInt32->failure(operation.address,
+            ErrorCode::unknown, errorMessage);
+      }
+    }
+  } catch (...) {
+    // A destructor should never throw.
+  }
+}
+
+void MrfSimulatedMemoryAccess::readUInt16(std::uint32_t address,
+    std::shared_ptr<CallbackUInt16> callback) {
+  if (memorySize < 2 || address > memorySize - 2 || address % 2 != 0) {
+    callback->failure(address, ErrorCode::invalidAddress, std::string());
+    return;
+  }
+  queueOperation(
+      Operation { OperationType::readUInt16, address, 0, Clock::time_point(),
+          callback, nullptr });
+}
+
+void MrfSimulatedMemoryAccess::writeUInt16(std::uint32_t address,
+    std::uint16_t value, std::shared_ptr<CallbackUInt16> callback) {
+  if (memorySize < 2 || address > memorySize - 2 || address % 2 != 0) {
+    callback->failure(address, ErrorCode::invalidAddress, std::string());
+    return;
+  }
+  queueOperation(
+      Operation { OperationType::writeUInt16, address, value,
+          Clock::time_point(), callback, nullptr });
+}
+
+void MrfSimulatedMemoryAccess::readUInt32(std::uint32_t address,
+    std::shared_ptr<CallbackUInt32> callback) {
+  if (memorySize < 4 || address > memorySize - 4 || address % 4 != 0) {
+    callback->failure(address, ErrorCode::invalidAddress, std::string());
+    return;
+  }
+  queueOperation(
+      Operation { OperationType::readUInt32, address, 0, Clock::time_point(),
+          nullptr, callback });
+}
+
+void MrfSimulatedMemoryAccess::writeUInt32(std::uint32_t address,
+    std::uint32_t value, std::shared_ptr<CallbackUInt32> callback) {
+  if (memorySize < 4 || address > memorySize - 4 || address % 4 != 0) {
+    callback->failure(address, ErrorCode::invalidAddress, std::string());
+    return;
+  }
+  queueOperation(
+      Operation { OperationType::writeUInt32, address, value,
+          Clock::time_point(), nullptr, callback });
+}
+
+bool MrfSimulatedMemoryAccess::supportsInterrupts() const {
+  return true;
+}
+
+void MrfSimulatedMemoryAccess::addInterruptListener(
+    std::shared_ptr<InterruptListener> interruptListener) {
+  // We have to hold the mutex while accessing the list of listeners.
+  std::lock_guard<std::mutex> lock(mutex);
+  bool listenerMissing = true;
+  // We do not increment the iterator in the header of the for loop because we
+  // should not increment it when we replace it after deleting an element.
+  for (auto listenerIterator = interruptListeners.begin();
+      listenerIterator != interruptListeners.end();) {
+    if (listenerIterator->expired()) {
+      listenerIterator = interruptListeners.erase(listenerIterator);
+    } else {
+      if (listenerIterator->lock() == interruptListener) {
+        listenerMissing = false;
+      }
+      ++listenerIterator;
+    }
+  }
+  if (listenerMissing) {
+    interruptListeners.emplace_back(interruptListener);
+  }
+}
+
+void MrfSimulatedMemoryAccess::removeInterruptListener(
+    std::shared_ptr<InterruptListener> interruptListener) {
+  // We have to hold the mutex while accessing the list of listeners.
+  std::lock_guard<std::mutex> lock(mutex);
+  // We do not increment the iterator in the header of the for loop because we
+  // should not increment it when we replace it after deleting an element.
+  for (auto listenerIterator = interruptListeners.begin();
+      listenerIterator != interruptListeners.end();) {
+    std::shared_ptr<InterruptListener> foundListener = listenerIterator->lock();
+    if (!foundListener || foundListener == interruptListener) {
+      listenerIterator = interruptListeners.erase(listenerIterator);
+    } else {
+      ++listenerIterator;
+    }
+  }
+}
+
+void MrfSimulatedMemoryAccess::setLatency(const MrfTime &latency,
+    const MrfTime &jitter) {
+  if (latency < MrfTime() || jitter < MrfTime()) {
+    throw std::invalid_argument("Latency and jitter must not be negative.");
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  this->latency = timeToDuration(latency);
+  this->jitter = timeToDuration(jitter);
+}
+
+void MrfSimulatedMemoryAccess::setInjectedFailureProbability(
+    ErrorCode errorCode, double probability) {
+  // This check also catches NaN.
+  if (!(probability >= 0.0 && probability <= 1.0)) {
+    throw std::invalid_argument(
+        "The failure probability must be between zero and one.");
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  switch (errorCode) {
+  case ErrorCode::fpgaTimeout:
+    if (probability + invalidAddressProbability > 1.0) {
+      throw std::invalid_argument(
+          "The sum of the failure probabilities must not be greater than one.");
+    }
+    fpgaTimeoutProbability = probability;
+    break;
+  case ErrorCode::invalidAddress:
+    if (probability + fpgaTimeoutProbability > 1.0) {
+      throw std::invalid_argument(
+          "The sum of the failure probabilities must not be greater than one.");
+    }
+    invalidAddressProbability = probability;
+    break;
+  default:
+    throw std::invalid_argument(
+        "Only FPGA timeouts and invalid addresses can be injected.");
+  }
+}
+
+void MrfSimulatedMemoryAccess::triggerInterrupt(std::uint32_t flags) {
+  queueOperation(
+      Operation { OperationType::interrupt, interruptFlagRegister, flags,
+          Clock::time_point(), nullptr, nullptr });
+}
+
+void MrfSimulatedMemoryAccess::queueOperation(Operation &&operation) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Clock::duration delay = latency;
+  if (jitter > Clock::duration::zero()) {
+    std::uniform_int_distribution<Clock::rep> distribution(0, jitter.count());
+    delay += Clock::duration(distribution(randomGenerator));
+  }
+  // Operations have to finish in the order in which they were queued, so an
+  // operation is never due before the operation that was queued before it.
+  operation.dueTime = std::max(Clock::now() + delay, lastDueTime);
+  lastDueTime = operation.dueTime;
+  queue.push_back(std::move(operation));
+  condition.notify_all();
+}
+
+std::function<void()> MrfSimulatedMemoryAccess::processOperation(
+    Operation &operation) {
+  std::uint32_t address = operation.address;
+  std::size_t wordIndex = address / 2;
+  if (operation.type == OperationType::interrupt) {
+    std::uint32_t flagWordIndex = interruptFlagRegister / 2;
+    std::uint32_t enableWordIndex = interruptEnableRegister / 2;
+    std::uint32_t enabledFlags = 0;
+    if (memorySize >= interruptEnableRegister + 4) {
+      memory[flagWordIndex] |= static_cast<std::uint16_t>(operation.value >> 16);
+      memory[flagWordIndex + 1] |= static_cast<std::uint16_t>(operation.value);
+      enabledFlags = operation.value
+          & ((static_cast<std::uint32_t>(memory[enableWordIndex]) << 16)
+              | memory[enableWordIndex + 1]);
+    }
+    if (!enabledFlags) {
+      return std::function<void()>();
+    }
+    std::vector<std::shared_ptr<InterruptListener>> foundListeners;
+    // We do not increment the iterator in the header of the for loop because
+    // we should not increment it when we replace it after deleting an element.
+    for (auto listenerIterator = interruptListeners.begin();
+        listenerIterator != interruptListeners.end();) {
+      std::shared_ptr<InterruptListener> foundListener =
+          listenerIterator->lock();
+      if (!foundListener) {
+        listenerIterator = interruptListeners.erase(listenerIterator);
+      } else {
+        foundListeners.push_back(std::move(foundListener));
+        ++listenerIterator;
+      }
+    }
+    return [foundListeners, enabledFlags]() {
+      for (auto &listener : foundListeners) {
+        try {
+          (*listener)(enabledFlags);
+        } catch (...) {
+          // We ignore any exception thrown by a listener, so that the other
+          // listeners are still notified.
+        }
+      }
+    };
+  }
+  // We decide whether the operation shall fail before modifying the memory,
+  // because a failed write operation must not have any effect.
+  double randomNumber = std::uniform_real_distribution<double>(0.0, 1.0)(
+      randomGenerator);
+  bool injectFailure = false;
+  ErrorCode errorCode = ErrorCode::unknown;
+  if (randomNumber < fpgaTimeoutProbability) {
+    injectFailure = true;
+    errorCode = ErrorCode::fpgaTimeout;
+  } else if (randomNumber
+      < fpgaTimeoutProbability + invalidAddressProbability) {
+    injectFailure = true;
+    errorCode = ErrorCode::invalidAddress;
+  }
+  // Like on the real hardware, bits in the interrupt flag register are cleared
+  // by writing a one to them.
+  auto writeWord = [this](std::size_t index, std::uint16_t value) {
+    if (index == interruptFlagRegister / 2
+        || index == interruptFlagRegister / 2 + 1) {
+      memory[index] &= ~value;
+    } else {
+      memory[index] = value;
+    }
+  };
+  if (operation.callbackUInt16) {
+    std::shared_ptr<CallbackUInt16> callback = operation.callbackUInt16;
+    if (injectFailure) {
+      return [callback, address, errorCode]() {
+        callback->failure(address, errorCode,
+            "The failure has been injected by the simulation.");
+      };
+    }
+    if (operation.type == OperationType::writeUInt16) {
+      writeWord(wordIndex, static_cast<std::uint16_t>(operation.value));
+    }
+    std::uint16_t value = memory[wordIndex];
+    return [callback, address, value]() {
+      callback->success(address, value);
+    };
+  } else {
+    std::shared_ptr<CallbackUInt32> callback = operation.callbackUInt32;
+    if (injectFailure) {
+      return [callback, address, errorCode]() {
+        callback->failure(address, errorCode,
+            "The failure has been injected by the simulation.");
+      };
+    }
+    if (operation.type == OperationType::writeUInt32) {
+      writeWord(wordIndex, static_cast<std::uint16_t>(operation.value >> 16));
+      writeWord(wordIndex + 1, static_cast<std::uint16_t>(operation.value));
+    }
+    std::uint32_t value = (static_cast<std::uint32_t>(memory[wordIndex]) << 16)
+        | memory[wordIndex + 1];
+    return [callback, address, value]() {
+      callback->success(address, value);
+    };
+  }
+}
+
+void MrfSimulatedMemoryAccess::runProcessingThread() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!shutdown) {
+    if (queue.empty()) {
+      condition.wait(lock);
+      continue;
+    }
+    if (queue.front().dueTime > Clock::now()) {
+      condition.wait_until(lock, queue.front().dueTime);
+      continue;
+    }
+    Operation operation = std::move(queue.front());
+    queue.pop_front();
+    std::function<void()> notification = processOperation(operation);
+    // We call the callbacks after releasing the mutex. This ensures that a
+    // callback cannot cause a dead lock and also means that we do not need a
+    // recursive mutex.
+    lock.unlock();
+    if (notification) {
+      try {
+        notification();
+      } catch (...) {
+        // We ignore any exception thrown by a callback, so that the processing
+        // thread keeps running.
+      }
+    }
+    lock.lock();
+  }
+}
+
+} // namespace mrf
+} // namespace anka
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_SIMULATED_MEMORY_ACCESS_H
+#define ANKA_MRF_SIMULATED_MEMORY_ACCESS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <MrfMemoryAccess.h>
+#include <MrfTime.h>
+
+namespace anka {
+namespace mrf {
+
+/**
+ * Memory access for a simulated MRF device. Instead of talking to hardware,
+ * this class keeps the device's registers in memory. It is intended for
+ * testing the device support (and IOCs using it) when no hardware is
+ * available.
+ *
+ * Operations are processed by a background thread in the order in which they
+ * are queued. Each operation can be delayed by a configurable latency and a
+ * random jitter, and operations can be made to fail randomly, so that the
+ * behavior of a real device that is connected through a network can be
+ * approximated.
+ *
+ * The simulated device also supports interrupts. The interrupt flag register
+ * is expected at offset 0x08 and the interrupt enable register at offset 0x0c
+ * (like on the VME-EVG-230 and VME-EVR-230RF). Interrupts are raised by calling
+ * {@link triggerInterrupt(std::uint32_t)}.
+ */
+class MrfSimulatedMemoryAccess: public MrfMemoryAccess {
+
+public:
+
+  /**
+   * Offset of the interrupt flag register.
+   */
+  static constexpr std::uint32_t interruptFlagRegister = 0x08;
+
+  /**
+   * Offset of the interrupt enable register.
+   */
+  static constexpr std::uint32_t interruptEnableRegister = 0x0c;
+
+  /**
+   * Memory size of a simulated VME-EVG-230.
+   */
+  static constexpr std::uint32_t memorySizeVmeEvg230 = 0x10000;
+
+  /**
+   * Memory size of a simulated VME-EVR-230RF.
+   */
+  static constexpr std::uint32_t memorySizeVmeEvr230Rf = 0x40000;
+
+  /**
+   * Creates a simulated device with the specified memory size (in bytes). All
+   * registers are initialized with zero. Initially, operations are processed
+   * without any delay and never fail.
+   *
+   * The constructor creates a background thread that processes the queued
+   * operations. Throws an exception if the background thread cannot be
+   * created.
+   */
+  MrfSimulatedMemoryAccess(std::uint32_t memorySize);
+
+  /**
+   * Destructor. Terminates the background thread. Operations that have not
+   * been processed yet fail.
+   */
+  virtual ~MrfSimulatedMemoryAccess();
+
+  /**
+   * Reads from an unsigned 16-bit register. This method does not block. The
+   * operation is queued and executed asynchronously. When the operation
+   * finishes, the specified callback is called.
+   */
+  virtual void readUInt16(std::uint32_t address,
+      std::shared_ptr<CallbackUInt16> callback);
+
+  /**
+   * Writes to an unsigned 16-bit register. This method does not block. The
+   * operation is queued and executed asynchronously. When the operation
+   * finishes, the specified callback is called.
+   */
+  virtual void writeUInt16(std::uint32_t address, std::uint16_t value,
+      std::shared_ptr<CallbackUInt16> callback);
+
+  /**
+   * Reads from an unsigned 32-bit register. This method does not block. The
+   * operation is queued and executed asynchronously. When the operation
+   * finishes, the specified callback is called.
+   */
+  virtual void readUInt32(std::uint32_t address,
+      std::shared_ptr<CallbackUInt32> callback);
+
+  /**
+   * Writes to an unsigned 32-bit register. This method does not block. The
+   * operation is queued and executed asynchronously. When the operation
+   * finishes, the specified callback is called.
+   */
+  virtual void writeUInt32(std::uint32_t address, std::uint32_t value,
+      std::shared_ptr<CallbackUInt32> callback);
+
+  // We want the methods from the base class to participate in overload
+  // resolution.
+  using MrfMemoryAccess::readUInt16;
+  using MrfMemoryAccess::writeUInt16;
+  using MrfMemoryAccess::readUInt32;
+  using MrfMemoryAccess::writeUInt32;
+
+  /**
+   * Tells whether this memory access supports interrupts. Always returns
+   * {@code true}.
+   */
+  virtual bool supportsInterrupts() const;
+
+  /**
+   * Registers an interrupt listener. The listener is notified when an
+   * interrupt is triggered for an interrupt flag that is enabled in the
+   * interrupt enable register. The listener is only stored as a weak
+   * reference, so the calling code has to keep the listener alive.
+   */
+  virtual void addInterruptListener(
+      std::shared_ptr<InterruptListener> interruptListener);
+
+  /**
+   * Removes an interrupt listener that was previously registered.
+   */
+  virtual void removeInterruptListener(
+      std::shared_ptr<InterruptListener> interruptListener);
+
+  /**
+   * Sets the latency of operations. Each operation completes after the
+   * specified latency plus a random delay that is uniformly distributed
+   * between zero and the specified jitter. Operations always complete in the
+   * order in which they were queued, so the jitter of an operation may be
+   * absorbed by the delay of the preceding operation. The new setting only
+   * applies to operations that are queued after calling this method.
+   */
+  void setLatency(const MrfTime &latency, const MrfTime &jitter);
+
+  /**
+   * Sets the probability with which an operation fails with the specified
+   * error code. Only {@code ErrorCode::fpgaTimeout} and
+   * {@code ErrorCode::invalidAddress} are supported. The probability must be
+   * between zero and one and the sum of all probabilities must not be greater
+   * than one. Throws {@code std::invalid_argument} if the error code is not
+   * supported or the probability is out of range. A failed write operation
+   * does not modify the register.
+   */
+  void setInjectedFailureProbability(ErrorCode errorCode, double probability);
+
+  /**
+   * Triggers an interrupt. The specified flags are set in the interrupt flag
+   * register and the interrupt listeners are notified with those flags that
+   * are also set in the interrupt enable register. If none of the flags are
+   * enabled, the listeners are not notified. The interrupt is processed in
+   * order with the operations that have been queued before, and it is
+   * subject to the same latency.
+   */
+  void triggerInterrupt(std::uint32_t flags);
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  MrfSimulatedMemoryAccess(const MrfSimulatedMemoryAccess &) = delete;
+  MrfSimulatedMemoryAccess(MrfSimulatedMemoryAccess &&) = delete;
+  MrfSimulatedMemoryAccess &operator=(const MrfSimulatedMemoryAccess &) =
+      delete;
+  MrfSimulatedMemoryAccess &operator=(MrfSimulatedMemoryAccess &&) = delete;
+
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Type of an operation.
+   */
+  enum class OperationType {
+    readUInt16, writeUInt16, readUInt32, writeUInt32, interrupt
+  };
+
+  /**
+   * Operation that is queued for processing by the background thread.
+   */
+  struct Operation {
+    OperationType type;
+    std::uint32_t address;
+    std::uint32_t value;
+    Clock::time_point dueTime;
+    std::shared_ptr<CallbackUInt16> callbackUInt16;
+    std::shared_ptr<CallbackUInt32> callbackUInt32;
+  };
+
+  /**
+   * Size of the simulated memory (in bytes).
+   */
+  std::uint32_t memorySize;
+
+  /**
+   * Mutex protecting all the data structures that are shared between the
+   * background thread and other threads (including the simulated memory).
+   */
+  std::mutex mutex;
+
+  /**
+   * Condition variable that is used to wake up the background thread when an
+   * operation is queued or the device is destroyed.
+   */
+  std::condition_variable condition;
+
+  /**
+   * Simulated memory. Each element represents a 16-bit register.
+   */
+  std::vector<std::uint16_t> memory;
+
+  /**
+   * Operations that have not been processed yet.
+   */
+  std::deque<Operation> queue;
+
+  /**
+   * Due time of the operation that was queued last. The due time of an
+   * operation is never before this time, so that operations finish in order.
+   */
+  Clock::time_point lastDueTime;
+
+  /**
+   * Fixed delay of each operation.
+   */
+  Clock::duration latency;
+
+  /**
+   * Maximum random delay of each operation (in addition to the fixed delay).
+   */
+  Clock::duration jitter;
+
+  /**
+   * Probability that an operation fails with an FPGA timeout.
+   */
+  double fpgaTimeoutProbability;
+
+  /**
+   * Probability that an operation fails with an invalid address.
+   */
+  double invalidAddressProbability;
+
+  /**
+   * Random number generator used for the jitter and the injected failures.
+   */
+  std::mt19937 randomGenerator;
+
+  /**
+   * Interrupt listeners.
+   */
+  std::vector<std::weak_ptr<InterruptListener>> interruptListeners;
+
+  /**
+   * Flag indicating that the device is being destroyed and the background
+   * thread should terminate.
+   */
+  bool shutdown;
+
+  /**
+   * Background thread that processes the queued operations.
+   */
+  std::thread processingThread;
+
+  /**
+   * Queues an operation. The due time of the operation is calculated from the
+   * current latency and jitter.
+   */
+  void queueOperation(Operation &&operation);
+
+  /**
+   * Processes an operation. Must be called with the mutex held. Memory
+   * modifications are applied immediately, while the callbacks (or interrupt
+   * listeners) are called by the returned function, which must be invoked
+   * after releasing the mutex.
+   */
+  std::function<void()> processOperation(Operation &operation);
+
+  /**
+   * Main function of the background thread.
+   */
+  void runProcessingThread();
+
+};
+
+} // namespace mrf
+} // namespace anka
+
+#endif // ANKA_MRF_SIMULATED_MEMORY_ACCESS_H
@@ -27,8 +27,10 @@
  * of the GNU LGPL version 3 or newer.
  */
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
 #include <system_error>
 
 extern "C" {
@@ -37,6 +39,7 @@ extern "C" {
 #include <fcntl.h>
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 }
@@ -55,6 +58,57 @@ constexpr std::uint32_t MrfUdpIpMemoryAccess::baseAddressVmeEvgCrCsr;
 constexpr std::uint32_t MrfUdpIpMemoryAccess::baseAddressVmeEvgRegister;
 constexpr std::uint32_t MrfUdpIpMemoryAccess::baseAddressVmeEvrCrCsr;
 constexpr std::uint32_t MrfUdpIpMemoryAccess::baseAddressVmeEvrRegister;
+constexpr std::size_t MrfUdpIpMemoryAccess::maximumPacketsPerBatch;
+constexpr std::size_t MrfUdpIpMemoryAccess::operationChunkSize;
+constexpr unsigned int MrfUdpIpMemoryAccess::requestIndexBits;
+constexpr std::size_t MrfUdpIpMemoryAccess::readTableSize;
+
+static std::int64_t timeToNanoseconds(const MrfTime &time) {
+  return static_cast<std::int64_t>(time.getSeconds()) * 1000000000
+      + time.getNanoseconds();
+}
+
+static MrfTime nanosecondsToTime(std::int64_t nanoseconds) {
+  return MrfTime(nanoseconds / 1000000000, nanoseconds % 1000000000);
+}
+
+// Memory access whose block operation is currently being queued by the
+// calling thread. Requests queued while this points to a memory access are put
+// into the bulk lane of that memory access.
+static thread_local const MrfUdpIpMemoryAccess *bulkRequestMemoryAccess =
+    nullptr;
+
+namespace {
+
+/**
+ * Marks all requests queued by the current thread while an instance of this
+ * class exists as bulk requests. This class is used by the block operations in
+ * order to route the individual requests into the bulk lane.
+ */
+struct BulkRequestScope {
+
+  BulkRequestScope(const MrfUdpIpMemoryAccess *memoryAccess) :
+      previous(bulkRequestMemoryAccess) {
+    bulkRequestMemoryAccess = memoryAccess;
+  }
+
+  ~BulkRequestScope() {
+    bulkRequestMemoryAccess = previous;
+  }
+
+  // We do not want to allow copy or move construction or assignment.
+  BulkRequestScope(const BulkRequestScope &) = delete;
+  BulkRequestScope(BulkRequestScope &&) = delete;
+  BulkRequestScope &operator=(const BulkRequestScope &) = delete;
+  BulkRequestScope &operator=(BulkRequestScope &&) = delete;
+
+private:
+
+  const MrfUdpIpMemoryAccess *previous;
+
+};
+
+} // anonymous namespace
 
 MrfUdpIpMemoryAccess::MrfUdpIpMemoryAccess(const std::string &hostName,
     std::uint32_t baseAddress) :
@@ -65,9 +119,19 @@ MrfUdpIpMemoryAccess::MrfUdpIpMemoryAccess(const std::string &hostName,
 MrfUdpIpMemoryAccess::MrfUdpIpMemoryAccess(const std::string &hostName,
     std::uint32_t baseAddress, const MrfTime &delayBetweenPackets,
     const MrfTime &udpTimeout, int maximumNumberOfTries) :
-    hostName(hostName), baseAddress(baseAddress), shutdown(false), delayBetweenPackets(
+    MrfUdpIpMemoryAccess(hostName, baseAddress, delayBetweenPackets,
+        udpTimeout, maximumNumberOfTries, nullptr) {
+}
+
+MrfUdpIpMemoryAccess::MrfUdpIpMemoryAccess(const std::string &hostName,
+    std::uint32_t baseAddress, const MrfTime &delayBetweenPackets,
+    const MrfTime &udpTimeout, int maximumNumberOfTries,
+    std::shared_ptr<MrfUdpIpReactor> reactor) :
+    hostName(hostName), baseAddress(baseAddress), shutdown(false), reactor(
+        reactor), reactorHandler(*this), delayBetweenPackets(
         delayBetweenPackets), udpTimeout(udpTimeout), maximumNumberOfTries(
-        maximumNumberOfTries) {
+        maximumNumberOfTries), tracingEnabled(false), currentUdpTimeout(
+        udpTimeout) {
   if (delayBetweenPackets.getSeconds() < 0) {
     throw std::invalid_argument(
         "The delay between packets must not be negative.");
@@ -130,10 +194,20 @@ MrfUdpIpMemoryAccess::MrfUdpIpMemoryAccess(const std::string &hostName,
         "Could not connect UDP socket for communication with " + hostName,
         savedErrorNumber);
   }
-  // Create background threads.
+  readTable.resize(readTableSize, nullptr);
+  receivedPackets.reserve(maximumPacketsPerBatch);
+  receiveCompletions.reserve(maximumPacketsPerBatch);
+  sendBatchRequests.reserve(maximumPacketsPerBatch);
+  sendBatchPackets.reserve(maximumPacketsPerBatch);
+  // Register with the reactor or create background threads.
   try {
-    this->receiveThread = std::thread([this]() {runReceiveThread();});
-    this->sendThread = std::thread([this]() {runSendThread();});
+    if (this->reactor) {
+      this->reactor->registerHandler(this->socketDescriptor,
+          &this->reactorHandler);
+    } else {
+      this->receiveThread = std::thread([this]() {runReceiveThread();});
+      this->sendThread = std::thread([this]() {runSendThread();});
+    }
   } catch (...) {
     close(this->socketDescriptor);
     this->socketDescriptor = -1;
@@ -144,6 +218,11 @@ MrfUdpIpMemoryAccess::MrfUdpIpMemoryAccess(const std::string &hostName,
 MrfUdpIpMemoryAccess::~MrfUdpIpMemoryAccess() {
   // Close the connection and terminate the background threads.
   try {
+    if (reactor) {
+      // When this method returns, the reactor does not use the handler any
+      // longer.
+      reactor->unregisterHandler(&reactorHandler);
+    }
     {
       std::unique_lock<std::recursive_mutex> lock;
       shutdown.store(true, std::memory_order_release);
@@ -166,6 +245,183 @@ MrfUdpIpMemoryAccess::~MrfUdpIpMemoryAccess() {
   socketDescriptor = -1;
 }
 
+void MrfUdpIpMemoryAccess::setMaximumPacketsInFlight(
+    int maximumPacketsInFlight) {
+  if (maximumPacketsInFlight < 0) {
+    throw std::invalid_argument(
+        "The maximum number of packets in flight must not be negative.");
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  this->maximumPacketsInFlight = maximumPacketsInFlight;
+  // We start with the smallest possible window so that we do not flood a
+  // device that cannot keep up.
+  congestionWindow = 1.0;
+  // The sender might be waiting for the window to open or for the delay
+  // between packets to pass, so we wake it up in order to apply the new mode.
+  wakeUpSender();
+}
+
+void MrfUdpIpMemoryAccess::setBulkShare(double bulkShare) {
+  // We use a negated comparison so that NaN is rejected as well.
+  if (!(bulkShare >= 0.0 && bulkShare <= 1.0)) {
+    throw std::invalid_argument(
+        "The bulk share must be between zero and one.");
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  this->bulkShare = bulkShare;
+  bulkCredit = 0.0;
+  // The sender might be waiting, so we wake it up in order to apply the new
+  // share.
+  wakeUpSender();
+}
+
+void MrfUdpIpMemoryAccess::setPipelinedWrites(bool enabled) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  this->pipelinedWrites = enabled;
+}
+
+void MrfUdpIpMemoryAccess::enableAdaptiveUdpTimeout(
+    const MrfTime &minimumUdpTimeout, const MrfTime &maximumUdpTimeout) {
+  if (minimumUdpTimeout <= MrfTime()) {
+    throw std::invalid_argument("The minimum UDP timeout must be positive.");
+  }
+  if (maximumUdpTimeout < minimumUdpTimeout) {
+    throw std::invalid_argument(
+        "The maximum UDP timeout must not be less than the minimum UDP timeout.");
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  this->adaptiveUdpTimeout = true;
+  this->minimumUdpTimeout = minimumUdpTimeout;
+  this->maximumUdpTimeout = maximumUdpTimeout;
+  haveRoundTripTimeSample = false;
+  // Until we have the first sample, we use the fixed timeout, limited to the
+  // configured interval.
+  currentUdpTimeout = std::min(std::max(udpTimeout, minimumUdpTimeout),
+      maximumUdpTimeout);
+}
+
+MrfUdpIpMemoryAccess::TransportStatus MrfUdpIpMemoryAccess::getTransportStatus() {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  TransportStatus status;
+  status.adaptiveUdpTimeout = adaptiveUdpTimeout;
+  status.haveRoundTripTimeSample = haveRoundTripTimeSample;
+  status.smoothedRoundTripTime = nanosecondsToTime(smoothedRoundTripTime);
+  status.roundTripTimeVariation = nanosecondsToTime(roundTripTimeVariation);
+  status.udpTimeout = currentUdpTimeout;
+  status.maximumPacketsInFlight = maximumPacketsInFlight;
+  status.congestionWindow = congestionWindow;
+  status.numberOfPendingRequests = numberOfPendingRequests;
+  status.numberOfQueuedRequests = requestQueue.size + bulkRequestQueue.size;
+  status.numberOfQueuedBulkRequests = bulkRequestQueue.size;
+  status.bulkShare = bulkShare;
+  status.numberOfCoalescedReads = numberOfCoalescedReads;
+  status.pipelinedWrites = pipelinedWrites;
+  return status;
+}
+
+bool MrfUdpIpMemoryAccess::supportsTracing() const {
+  return true;
+}
+
+void MrfUdpIpMemoryAccess::setTraceRing(
+    std::shared_ptr<MrfTraceRing> traceRing) {
+  std::atomic_store(&this->traceRing, traceRing);
+  tracingEnabled.store(traceRing != nullptr, std::memory_order_relaxed);
+}
+
+void MrfUdpIpMemoryAccess::collectStatistics(MrfStatistics &statistics) {
+  std::uint64_t coalescedReads;
+  std::size_t queueLength;
+  std::size_t pendingRequests;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    coalescedReads = numberOfCoalescedReads;
+    queueLength = requestQueue.size + bulkRequestQueue.size;
+    pendingRequests = numberOfPendingRequests;
+  }
+  statistics.addCounter("udp.reads", readCounter.get());
+  statistics.addCounter("udp.writes", writeCounter.get());
+  statistics.addCounter("udp.coalescedReads", coalescedReads);
+  statistics.addCounter("udp.packetsSent", packetsSentCounter.get());
+  statistics.addCounter("udp.packetsReceived", packetsReceivedCounter.get());
+  statistics.addCounter("udp.retries", retryCounter.get());
+  statistics.addCounter("udp.timeouts", timeoutCounter.get());
+  statistics.addCounter("udp.failures", failureCounter.get());
+  statistics.addCounter("udp.lateResponses", lateResponseCounter.get());
+  statistics.addCounter("udp.queueLength", queueLength);
+  statistics.addCounter("udp.queueHighWater", queueHighWater.get());
+  statistics.addCounter("udp.pendingRequests", pendingRequests);
+  statistics.addHistogram("udp.latency", latencyHistogram);
+  statistics.addHistogram("udp.roundTripTime", roundTripTimeHistogram);
+}
+
+void MrfUdpIpMemoryAccess::updateRoundTripTime(const MrfTime &roundTripTime) {
+  std::int64_t sample = timeToNanoseconds(roundTripTime);
+  if (sample < 0) {
+    // The system clock has been changed while the request was in flight, so
+    // the sample is meaningless.
+    return;
+  }
+  // We use the same algorithm and gains as TCP does (see RFC 6298). We use
+  // integer arithmetic because a precision of one nanosecond is more than
+  // sufficient.
+  if (!haveRoundTripTimeSample) {
+    smoothedRoundTripTime = sample;
+    roundTripTimeVariation = sample / 2;
+    haveRoundTripTimeSample = true;
+  } else {
+    std::int64_t deviation = smoothedRoundTripTime - sample;
+    if (deviation < 0) {
+      deviation = -deviation;
+    }
+    roundTripTimeVariation = (3 * roundTripTimeVariation + deviation) / 4;
+    smoothedRoundTripTime = (7 * smoothedRoundTripTime + sample) / 8;
+  }
+  currentUdpTimeout = std::min(
+      std::max(
+          nanosecondsToTime(
+              smoothedRoundTripTime + 4 * roundTripTimeVariation),
+          minimumUdpTimeout), maximumUdpTimeout);
+}
+
+MrfUdpIpMemoryAccess::RequestQueue *MrfUdpIpMemoryAccess::selectQueue() {
+  if (requestQueue.empty()) {
+    return bulkRequestQueue.empty() ? nullptr : &bulkRequestQueue;
+  }
+  if (bulkRequestQueue.empty()) {
+    return &requestQueue;
+  }
+  // When there are requests in both lanes, the bulk lane gets its share of
+  // the packets. We accumulate the share as a credit, so that fractional
+  // shares work as expected. We only do this while both lanes are busy, so
+  // that the bulk lane cannot save up credit while it is idle.
+  bulkCredit += bulkShare;
+  if (bulkCredit >= 1.0) {
+    bulkCredit -= 1.0;
+    return &bulkRequestQueue;
+  }
+  return &requestQueue;
+}
+
+bool MrfUdpIpMemoryAccess::isCongestionWindowFull() {
+  return maximumPacketsInFlight > 0
+      && numberOfPendingRequests
+          >= static_cast<std::size_t>(congestionWindow);
+}
+
+MrfUdpIpMemoryAccess::ReactorHandler::ReactorHandler(
+    MrfUdpIpMemoryAccess &memoryAccess) :
+    memoryAccess(memoryAccess) {
+}
+
+bool MrfUdpIpMemoryAccess::ReactorHandler::handleReadable() {
+  return memoryAccess.processReceivedPackets();
+}
+
+MrfUdpIpReactor::SendStatus MrfUdpIpMemoryAccess::ReactorHandler::handleSend() {
+  return memoryAccess.processSendQueue();
+}
+
 static MrfMemoryAccess::ErrorCode statusToErrorCode(std::int8_t status) {
   switch (status) {
   case -1:
@@ -179,524 +435,755 @@ static MrfMemoryAccess::ErrorCode statusToErrorCode(std::int8_t status) {
   }
 }
 
-MrfUdpIpMemoryAccess::UInt16Callback::UInt16Callback(std::uint32_t address,
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt16> callback) :
-    address(address), callback(callback) {
-}
-
-void MrfUdpIpMemoryAccess::UInt16Callback::operator()(
-    std::uint16_t receivedData, std::int8_t status, bool timeout) {
-  if (callback) {
-    if (timeout) {
-      callback->failure(this->address, ErrorCode::networkTimeout,
-          std::string());
-    } else if (status != 0) {
-      callback->failure(this->address, statusToErrorCode(status),
-          std::string());
-    } else {
-      callback->success(this->address, receivedData);
-    }
+void MrfUdpIpMemoryAccess::readUInt16(std::uint32_t address,
+    std::shared_ptr<CallbackUInt16> callback) {
+  bool bulk = isBulkRequest();
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  MrfOperation *operation = allocateOperation(address, bulk);
+  operation->type = OperationType::readUInt16;
+  readCounter.increment();
+  operation->callbackUInt16 = std::move(callback);
+  if (attachToReadInProgress(*operation)) {
+    return;
   }
+  queueRequest(operation->requests[0], RequestRole::uint16, 1, address, 0);
+  addReadInProgress(*operation);
 }
 
-MrfUdpIpMemoryAccess::UInt32ReadShared::UInt32ReadShared(
-    MrfUdpIpMemoryAccess &memoryAccess, std::uint32_t address,
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback) :
-    memoryAccess(memoryAccess), address(address), callback(callback) {
+void MrfUdpIpMemoryAccess::writeUInt16(std::uint32_t address,
+    std::uint16_t value, std::shared_ptr<CallbackUInt16> callback) {
+  bool bulk = isBulkRequest();
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  MrfOperation *operation = allocateOperation(address, bulk);
+  operation->type = OperationType::writeUInt16;
+  writeCounter.increment();
+  operation->callbackUInt16 = std::move(callback);
+  invalidateReadsInProgress(address, 2);
+  queueRequest(operation->requests[0], RequestRole::uint16, 2, address, value);
 }
 
-void MrfUdpIpMemoryAccess::UInt32ReadShared::receivedLow(std::uint16_t data) {
-  bool sendHighAgain;
-  // We have to lock the mutex in order to avoid a race condition (most
-  // actions are processed by the receive thread, but timeouts are processed
-  // by the send thread).
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    if (failed) {
-      // The request has already failed, thus we discard the result.
-      return;
-    }
-    if (gotLow) {
-      // Ignore a duplicate response.
-      return;
-    }
-    gotLow = true;
-    this->data = static_cast<std::uint32_t>(data);
-    // The high word should always be read after the low word. Therefore, we
-    // have to send the request for the high word again, if we received it
-    // before the low word. There is still a slim chance that a read might
-    // happen out of order, because the request for the high word might arrive
-    // before the request for the low word but the response might be delayed
-    // in the opposite order. However, this seems very unlikely.
-    sendHighAgain = gotHigh;
-    gotHigh = false;
-  }
-  if (sendHighAgain) {
-    // Send request for high word again.
-    memoryAccess.queueReadRequest(address,
-        std::make_shared<UInt32ReadHighCallback>(this->shared_from_this()));
-  }
-}
-
-void MrfUdpIpMemoryAccess::UInt32ReadShared::receivedHigh(std::uint16_t data) {
-  bool complete;
-  // We have to lock the mutex in order to avoid a race condition (most
-  // actions are processed by the receive thread, but timeouts are processed
-  // by the send thread).
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    if (failed) {
-      // The request has already failed, thus we discard the result.
-      return;
-    }
-    if (gotHigh) {
-      // Ignore a duplicate response.
-      return;
-    }
-    gotHigh = true;
-    this->data |= static_cast<std::uint32_t>(data) << 16;
-    complete = gotLow;
+void MrfUdpIpMemoryAccess::readUInt32(std::uint32_t address,
+    std::shared_ptr<CallbackUInt32> callback) {
+  bool bulk = isBulkRequest();
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  MrfOperation *operation = allocateOperation(address, bulk);
+  operation->type = OperationType::readUInt32;
+  readCounter.increment();
+  operation->callbackUInt32 = std::move(callback);
+  if (attachToReadInProgress(*operation)) {
+    return;
   }
-  if (complete) {
-    if (callback) {
-      callback->success(address, this->data);
-    }
+  // The low word should be read first, but we queue the request for the high
+  // word right away, so that both requests can be in flight at the same time.
+  // If the response for the high word arrives first, the high word is read
+  // again (see completeRequest).
+  queueRequest(operation->requests[0], RequestRole::uint32ReadLow, 1,
+      address + 2, 0);
+  queueRequest(operation->requests[1], RequestRole::uint32ReadHigh, 1,
+      address, 0);
+  addReadInProgress(*operation);
+}
+
+void MrfUdpIpMemoryAccess::writeUInt32(std::uint32_t address,
+    std::uint32_t value, std::shared_ptr<CallbackUInt32> callback) {
+  std::uint16_t highWord = static_cast<std::uint16_t>(value >> 16);
+  // We have to write the high word first. Once it has been written, we can
+  // write the low word. Unless pipelined writes are enabled, we do not queue
+  // both, because unlike a read request, a write request where the low word
+  // is processed first could cause inconsistent data in the device.
+  bool bulk = isBulkRequest();
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  MrfOperation *operation = allocateOperation(address, bulk);
+  operation->type = OperationType::writeUInt32;
+  writeCounter.increment();
+  operation->callbackUInt32 = std::move(callback);
+  operation->data = value;
+  operation->writeValue = value;
+  operation->pipelined = pipelinedWrites;
+  invalidateReadsInProgress(address, 4);
+  queueRequest(operation->requests[0], RequestRole::uint32WriteHigh, 2,
+      address, highWord);
+  // Both requests are added to the same queue, so the request for the low word
+  // is always sent after the one for the high word. If the low word is still
+  // processed first (because the request for the high word is lost), it is
+  // written again (see completePipelinedWriteRequest).
+  if (operation->pipelined) {
+    queueRequest(operation->requests[1], RequestRole::uint32WriteLow, 2,
+        address + 2, static_cast<std::uint16_t>(value));
   }
 }
 
-void MrfUdpIpMemoryAccess::UInt32ReadShared::failure(
-    MrfMemoryAccess::ErrorCode errorCode, const std::string &details) {
-  // We have to lock the mutex in order to avoid a race condition (most
-  // actions are processed by the receive thread, but timeouts are processed
-  // by the send thread).
-  {
-    std::lock_guard<std::mutex> lock(mutex);
-    if (failed) {
-      // Notification of failure was already made.
-      return;
+void MrfUdpIpMemoryAccess::readUInt16Block(std::uint32_t address,
+    std::size_t count, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt16> callback) {
+  // The base class queues the individual requests from the calling thread, so
+  // we can use a thread-local flag to tell our methods that these requests are
+  // bulk requests.
+  BulkRequestScope scope(this);
+  MrfMemoryAccess::readUInt16Block(address, count, stride, callback);
+}
+
+void MrfUdpIpMemoryAccess::writeUInt16Block(std::uint32_t address,
+    std::vector<std::uint16_t> values, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt16> callback) {
+  BulkRequestScope scope(this);
+  MrfMemoryAccess::writeUInt16Block(address, std::move(values), stride,
+      callback);
+}
+
+void MrfUdpIpMemoryAccess::readUInt32Block(std::uint32_t address,
+    std::size_t count, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt32> callback) {
+  BulkRequestScope scope(this);
+  MrfMemoryAccess::readUInt32Block(address, count, stride, callback);
+}
+
+void MrfUdpIpMemoryAccess::writeUInt32Block(std::uint32_t address,
+    std::vector<std::uint32_t> values, std::uint32_t stride,
+    std::shared_ptr<BlockCallbackUInt32> callback) {
+  BulkRequestScope scope(this);
+  MrfMemoryAccess::writeUInt32Block(address, std::move(values), stride,
+      callback);
+}
+
+bool MrfUdpIpMemoryAccess::isBulkRequest() {
+  return bulkRequestMemoryAccess == this;
+}
+
+MrfUdpIpMemoryAccess::MrfOperation *MrfUdpIpMemoryAccess::allocateOperation(
+    std::uint32_t address, bool bulk) {
+  if (!firstFreeOperation) {
+    // The pool is exhausted, so we have to add another chunk of operations.
+    std::size_t numberOfOperations = operationChunks.size()
+        * operationChunkSize;
+    if (numberOfOperations + operationChunkSize
+        > (static_cast<std::size_t>(1) << (requestIndexBits - 1))) {
+      throw std::runtime_error(
+          "The maximum number of queued operations has been reached.");
     }
-    failed = true;
-    if (gotLow && gotHigh) {
-      // Data was already received completely.
-      return;
+    std::unique_ptr<MrfOperation[]> chunk(new MrfOperation[operationChunkSize]);
+    for (std::size_t i = 0; i < operationChunkSize; ++i) {
+      MrfOperation &operation = chunk[i];
+      operation.index = static_cast<std::uint32_t>(numberOfOperations + i);
+      operation.requests[0].operation = &operation;
+      operation.requests[1].operation = &operation;
+      operation.nextFree =
+          (i + 1 < operationChunkSize) ? &chunk[i + 1] : nullptr;
     }
+    firstFreeOperation = &chunk[0];
+    lastFreeOperation = &chunk[operationChunkSize - 1];
+    operationChunks.push_back(std::move(chunk));
   }
-  if (callback) {
-    callback->failure(address, errorCode, details);
+  MrfOperation *operation = firstFreeOperation;
+  firstFreeOperation = operation->nextFree;
+  if (!firstFreeOperation) {
+    lastFreeOperation = nullptr;
   }
+  operation->nextFree = nullptr;
+  operation->address = address;
+  operation->data = 0;
+  operation->writeValue = 0;
+  operation->startTime = MrfTime::now();
+  operation->firstSendTime = MrfTime();
+  operation->lastSendTime = MrfTime();
+  operation->responseTime = MrfTime();
+  operation->numberOfTries = 0;
+  operation->bulk = bulk;
+  operation->pipelined = false;
+  operation->failed = false;
+  operation->gotLow = false;
+  operation->gotHigh = false;
+  operation->numberOfReferences = 0;
+  operation->inReadTable = false;
+  operation->nextInReadTable = nullptr;
+  operation->firstAttached = nullptr;
+  operation->nextAttached = nullptr;
+  return operation;
 }
 
-MrfUdpIpMemoryAccess::UInt32ReadLowCallback::UInt32ReadLowCallback(
-    std::shared_ptr<UInt32ReadShared> sharedData) :
-    sharedData(sharedData) {
-}
-void MrfUdpIpMemoryAccess::UInt32ReadLowCallback::operator()(
-    std::uint16_t receivedData, std::int8_t status, bool timeout) {
-  if (timeout) {
-    sharedData->failure(ErrorCode::networkTimeout, std::string());
-  } else if (status != 0) {
-    sharedData->failure(statusToErrorCode(status), std::string());
+void MrfUdpIpMemoryAccess::releaseOperation(MrfOperation &operation) {
+  --operation.numberOfReferences;
+  if (operation.numberOfReferences > 0) {
+    return;
+  }
+  // We add the operation at the end of the list, so that it is reused as late
+  // as possible. Together with the generation counter, this makes it very
+  // unlikely that a late response is taken for the response to a later
+  // request.
+  if (lastFreeOperation) {
+    lastFreeOperation->nextFree = &operation;
   } else {
-    sharedData->receivedLow(receivedData);
+    firstFreeOperation = &operation;
   }
+  lastFreeOperation = &operation;
 }
 
-MrfUdpIpMemoryAccess::UInt32ReadHighCallback::UInt32ReadHighCallback(
-    std::shared_ptr<UInt32ReadShared> sharedData) :
-    sharedData(sharedData) {
+bool MrfUdpIpMemoryAccess::attachToReadInProgress(MrfOperation &operation) {
+  MrfOperation *readInProgress = readTable[(operation.address >> 2)
+      & (readTableSize - 1)];
+  while (readInProgress) {
+    if (readInProgress->type == operation.type
+        && readInProgress->address == operation.address
+        && (operation.bulk || !readInProgress->bulk)) {
+      break;
+    }
+    readInProgress = readInProgress->nextInReadTable;
+  }
+  if (!readInProgress) {
+    return false;
+  }
+  operation.nextAttached = readInProgress->firstAttached;
+  readInProgress->firstAttached = &operation;
+  // The attached operation is kept alive until the read in progress
+  // completes.
+  ++operation.numberOfReferences;
+  ++numberOfCoalescedReads;
+  return true;
 }
 
-void MrfUdpIpMemoryAccess::UInt32ReadHighCallback::operator()(
-    std::uint16_t receivedData, std::int8_t status, bool timeout) {
-  if (timeout) {
-    sharedData->failure(ErrorCode::networkTimeout, std::string());
-  } else if (status != 0) {
-    sharedData->failure(statusToErrorCode(status), std::string());
-  } else {
-    sharedData->receivedHigh(receivedData);
-  }
+void MrfUdpIpMemoryAccess::addReadInProgress(MrfOperation &operation) {
+  // We add the operation at the head of the bucket, so that an interactive
+  // read that is added after a bulk read of the same register is found
+  // first.
+  MrfOperation *&head = readTable[(operation.address >> 2)
+      & (readTableSize - 1)];
+  operation.nextInReadTable = head;
+  operation.inReadTable = true;
+  head = &operation;
 }
 
-MrfUdpIpMemoryAccess::UInt32WriteLowCallback::UInt32WriteLowCallback(
-    std::uint32_t address, std::uint16_t highData,
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback) :
-    address(address), highData(highData), callback(callback) {
+void MrfUdpIpMemoryAccess::removeReadInProgress(MrfOperation &operation) {
+  MrfOperation **link = &readTable[(operation.address >> 2)
+      & (readTableSize - 1)];
+  while (*link) {
+    if (*link == &operation) {
+      *link = operation.nextInReadTable;
+      break;
+    }
+    link = &(*link)->nextInReadTable;
+  }
+  operation.nextInReadTable = nullptr;
+  operation.inReadTable = false;
 }
 
-void MrfUdpIpMemoryAccess::UInt32WriteLowCallback::operator()(
-    std::uint16_t receivedData, std::int8_t status, bool timeout) {
-  if (callback) {
-    if (timeout) {
-      callback->failure(address, ErrorCode::networkTimeout, std::string());
-    } else if (status != 0) {
-      callback->failure(address, statusToErrorCode(status), std::string());
-    } else {
-      std::uint32_t data = static_cast<std::uint32_t>(highData) << 16;
-      data |= static_cast<std::uint32_t>(receivedData);
-      callback->success(address, data);
+void MrfUdpIpMemoryAccess::invalidateReadsInProgress(std::uint32_t address,
+    std::uint32_t size) {
+  // A read that overlaps the specified range starts at most two bytes before
+  // it (a 32-bit register), so we have to look at the buckets for the first
+  // and the last address that might be affected.
+  std::size_t firstBucket = ((address - 2) >> 2) & (readTableSize - 1);
+  std::size_t lastBucket = ((address + size - 1) >> 2) & (readTableSize - 1);
+  for (std::size_t bucket = firstBucket;; bucket = (bucket + 1)
+      & (readTableSize - 1)) {
+    MrfOperation **link = &readTable[bucket];
+    while (*link) {
+      MrfOperation &operation = **link;
+      std::uint32_t readSize =
+          (operation.type == OperationType::readUInt32) ? 4 : 2;
+      if (operation.address < address + size
+          && address < operation.address + readSize) {
+        *link = operation.nextInReadTable;
+        operation.nextInReadTable = nullptr;
+        operation.inReadTable = false;
+      } else {
+        link = &operation.nextInReadTable;
+      }
+    }
+    if (bucket == lastBucket) {
+      break;
     }
   }
 }
 
-MrfUdpIpMemoryAccess::UInt32WriteHighCallback::UInt32WriteHighCallback(
-    MrfUdpIpMemoryAccess &memoryAccess, std::uint32_t address,
-    std::uint16_t lowData,
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback) :
-    memoryAccess(memoryAccess), address(address), lowData(lowData), callback(
-        callback) {
+void MrfUdpIpMemoryAccess::queueRequest(MrfRequest &request, RequestRole role,
+    std::uint8_t accessType, std::uint32_t address, std::uint16_t data) {
+  MrfOperation &operation = *request.operation;
+  std::uint32_t requestIndex = (operation.index << 1)
+      | static_cast<std::uint32_t>(&request - operation.requests);
+  ++request.generation;
+  request.role = role;
+  request.state = RequestState::queued;
+  request.numberOfTries = 0;
+  request.packet.accessType = accessType;
+  request.packet.status = 0;
+  request.packet.data = htons(data);
+  request.packet.address = htonl(baseAddress + address);
+  // We do not have to convert the byte order of the reference because this
+  // field is not touched by the server but simply mirrored back.
+  request.packet.ref = (request.generation << requestIndexBits) | requestIndex;
+  ++operation.numberOfReferences;
+  getQueue(request).pushBack(&request);
+  queueHighWater.updateMaximum(requestQueue.size + bulkRequestQueue.size);
+  wakeUpSender();
+}
+
+MrfUdpIpMemoryAccess::MrfRequest *MrfUdpIpMemoryAccess::findPendingRequest(
+    std::uint32_t ref) {
+  std::uint32_t requestIndex = ref
+      & ((static_cast<std::uint32_t>(1) << requestIndexBits) - 1);
+  std::size_t operationIndex = requestIndex >> 1;
+  if (operationIndex >= operationChunks.size() * operationChunkSize) {
+    return nullptr;
+  }
+  MrfOperation &operation = operationChunks[operationIndex
+      / operationChunkSize][operationIndex % operationChunkSize];
+  MrfRequest &request = operation.requests[requestIndex & 1];
+  if (request.state != RequestState::pending || request.packet.ref != ref) {
+    return nullptr;
+  }
+  return &request;
 }
 
-void MrfUdpIpMemoryAccess::UInt32WriteHighCallback::operator()(
-    std::uint16_t receivedData, std::int8_t status, bool timeout) {
-  if (timeout) {
-    if (callback) {
-      callback->failure(address, ErrorCode::networkTimeout, std::string());
+void MrfUdpIpMemoryAccess::completeRequest(MrfRequest &request,
+    std::uint16_t data, std::int8_t status, bool timeout,
+    std::vector<MrfCompletion> &completions) {
+  MrfOperation &operation = *request.operation;
+  request.state = RequestState::idle;
+  bool success = !timeout && status == 0;
+  MrfCompletion completion;
+  completion.operation = &operation;
+  completion.success = success;
+  completion.errorCode =
+      timeout ? ErrorCode::networkTimeout : statusToErrorCode(status);
+  completion.data = data;
+  bool complete = false;
+  switch (request.role) {
+  case RequestRole::uint16:
+    complete = true;
+    break;
+  case RequestRole::uint32ReadLow:
+  case RequestRole::uint32ReadHigh:
+    if (operation.failed) {
+      // The operation has already failed, thus we discard the result.
+      break;
     }
-  } else if (status != 0) {
-    if (callback) {
-      callback->failure(address, statusToErrorCode(status), std::string());
+    if (!success) {
+      operation.failed = true;
+      complete = true;
+      break;
     }
-  } else {
-    try {
-      std::shared_ptr<UInt32WriteLowCallback> internalCallback =
-          std::make_shared<UInt32WriteLowCallback>(address, receivedData,
-              callback);
-      memoryAccess.queueWriteRequest(address + 2, lowData, internalCallback);
-    } catch (std::exception &e) {
-      callback->failure(address, ErrorCode::unknown,
-          std::string("The write request could not be queued: ") + e.what());
-    } catch (...) {
-      callback->failure(address, ErrorCode::unknown,
-          std::string("The write request could not be queued."));
+    if (request.role == RequestRole::uint32ReadLow) {
+      operation.gotLow = true;
+      operation.data = (operation.data & 0xffff0000)
+          | static_cast<std::uint32_t>(data);
+      // The high word should always be read after the low word. Therefore, we
+      // have to send the request for the high word again, if we received it
+      // before the low word. There is still a slim chance that a read might
+      // happen out of order, because the request for the high word might
+      // arrive before the request for the low word but the response might be
+      // delayed in the opposite order. However, this seems very unlikely.
+      if (operation.gotHigh) {
+        operation.gotHigh = false;
+        queueRequest(operation.requests[1], RequestRole::uint32ReadHigh, 1,
+            operation.address, 0);
+      }
+    } else {
+      operation.gotHigh = true;
+      operation.data = (static_cast<std::uint32_t>(data) << 16)
+          | (operation.data & 0xffff);
+      if (operation.gotLow) {
+        completion.data = operation.data;
+        complete = true;
+      }
     }
+    break;
+  case RequestRole::uint32WriteHigh:
+    if (operation.pipelined) {
+      complete = completePipelinedWriteRequest(request, data, success,
+          completion);
+      break;
+    }
+    if (!success) {
+      complete = true;
+      break;
+    }
+    // We remember the high word that has been read back, so that we can
+    // report the complete value once the low word has been written.
+    operation.data = (static_cast<std::uint32_t>(data) << 16)
+        | (operation.data & 0xffff);
+    queueRequest(operation.requests[1], RequestRole::uint32WriteLow, 2,
+        operation.address + 2, static_cast<std::uint16_t>(operation.data));
+    break;
+  case RequestRole::uint32WriteLow:
+    if (operation.pipelined) {
+      complete = completePipelinedWriteRequest(request, data, success,
+          completion);
+      break;
+    }
+    completion.data = (operation.data & 0xffff0000)
+        | static_cast<std::uint32_t>(data);
+    complete = true;
+    break;
   }
+  if (complete) {
+    // The completion keeps the operation alive until it has been delivered.
+    ++operation.numberOfReferences;
+    completions.push_back(completion);
+    // Reads that have been attached to this operation complete with the same
+    // result.
+    if (operation.inReadTable) {
+      removeReadInProgress(operation);
+    }
+    MrfOperation *attached = operation.firstAttached;
+    operation.firstAttached = nullptr;
+    while (attached) {
+      MrfOperation *nextAttached = attached->nextAttached;
+      attached->nextAttached = nullptr;
+      completion.operation = attached;
+      // The reference that was added when attaching the operation is now held
+      // by the completion.
+      completions.push_back(completion);
+      attached = nextAttached;
+    }
+  }
+  releaseOperation(operation);
 }
 
-void MrfUdpIpMemoryAccess::readUInt16(std::uint32_t address,
-    std::shared_ptr<CallbackUInt16> callback) {
-  std::shared_ptr<UInt16Callback> internalCallback = std::make_shared<
-      UInt16Callback>(address, callback);
-  queueReadRequest(address, internalCallback);
-}
-
-void MrfUdpIpMemoryAccess::writeUInt16(std::uint32_t address,
-    std::uint16_t value, std::shared_ptr<CallbackUInt16> callback) {
-  std::shared_ptr<UInt16Callback> internalCallback = std::make_shared<
-      UInt16Callback>(address, callback);
-  queueWriteRequest(address, value, internalCallback);
+bool MrfUdpIpMemoryAccess::completePipelinedWriteRequest(MrfRequest &request,
+    std::uint16_t data, bool success, MrfCompletion &completion) {
+  MrfOperation &operation = *request.operation;
+  if (!success) {
+    operation.failed = true;
+  } else if (request.role == RequestRole::uint32WriteHigh) {
+    operation.gotHigh = true;
+    operation.data = (static_cast<std::uint32_t>(data) << 16)
+        | (operation.data & 0xffff);
+    // If the low word has been written before we received the response for
+    // the high word, the request for the high word might have been lost, so
+    // the device might have processed the low word first. Therefore, we write
+    // the low word again. Like for a read, there is a slim chance that the
+    // requests are processed in the wrong order even though the responses
+    // arrive in the right order, but this seems very unlikely.
+    if (operation.gotLow && !operation.failed) {
+      operation.gotLow = false;
+      queueRequest(operation.requests[1], RequestRole::uint32WriteLow, 2,
+          operation.address + 2,
+          static_cast<std::uint16_t>(operation.writeValue));
+    }
+  } else {
+    operation.gotLow = true;
+    operation.data = (operation.data & 0xffff0000)
+        | static_cast<std::uint32_t>(data);
+  }
+  // We can only make a decision when neither half is queued or in flight any
+  // longer.
+  if (operation.requests[0].state != RequestState::idle
+      || operation.requests[1].state != RequestState::idle) {
+    return false;
+  }
+  if (operation.failed) {
+    // If one of the halves failed, we do not know which of them have been
+    // written, so we write the whole register again, this time without
+    // pipelining. If this fails as well, the operation fails.
+    operation.pipelined = false;
+    operation.failed = false;
+    operation.gotHigh = false;
+    operation.gotLow = false;
+    operation.data = operation.writeValue;
+    queueRequest(operation.requests[0], RequestRole::uint32WriteHigh, 2,
+        operation.address,
+        static_cast<std::uint16_t>(operation.writeValue >> 16));
+    return false;
+  }
+  completion.data = operation.data;
+  return true;
 }
 
-void MrfUdpIpMemoryAccess::readUInt32(std::uint32_t address,
-    std::shared_ptr<CallbackUInt32> callback) {
-  std::shared_ptr<UInt32ReadShared> sharedData = std::make_shared<
-      UInt32ReadShared>(*this, address, callback);
-  // The low word should be read first.
-  std::shared_ptr<UInt32ReadLowCallback> lowCallback = std::make_shared<
-      UInt32ReadLowCallback>(sharedData);
-  queueReadRequest(address + 2, lowCallback);
-  // The high word should be read second. If we cannot queue the second read
-  // request, we do not throw but call the failure method on the callback
-  // shared data object instead. Otherwise, the callback might be called if the
-  // request to read the lower word fails but the calling code will not expect
-  // the callback to be called because from its perspective, the attempt to
-  // queue the request failed.
-  try {
-    std::shared_ptr<UInt32ReadHighCallback> highCallback = std::make_shared<
-        UInt32ReadHighCallback>(sharedData);
-    queueReadRequest(address, highCallback);
-  } catch (std::exception &e) {
-    try {
-      callback->failure(address, ErrorCode::unknown,
-          std::string("The read request could not be queued: ") + e.what());
-    } catch (...) {
-      // We do not want an exception in the callback to bubble up to the calling
-      // code.
+void MrfUdpIpMemoryAccess::deliverCompletions(
+    std::vector<MrfCompletion> &completions) {
+  if (completions.empty()) {
+    return;
+  }
+  // The callback of an operation is only used for its single completion, so
+  // we can access it without holding the mutex.
+  MrfTime completionTime = MrfTime::now();
+  std::shared_ptr<MrfTraceRing> traceRing;
+  if (tracingEnabled.load(std::memory_order_relaxed)) {
+    traceRing = std::atomic_load(&this->traceRing);
+  }
+  for (auto &completion : completions) {
+    MrfOperation &operation = *completion.operation;
+    latencyHistogram.record(completionTime - operation.startTime);
+    if (!completion.success) {
+      failureCounter.increment();
     }
-  } catch (...) {
     try {
-      callback->failure(address, ErrorCode::unknown,
-          std::string("The read request could not be queued."));
+      if (operation.callbackUInt16) {
+        if (completion.success) {
+          operation.callbackUInt16->success(operation.address,
+              static_cast<std::uint16_t>(completion.data));
+        } else {
+          operation.callbackUInt16->failure(operation.address,
+              completion.errorCode, std::string());
+        }
+      } else if (operation.callbackUInt32) {
+        if (completion.success) {
+          operation.callbackUInt32->success(operation.address,
+              completion.data);
+        } else {
+          operation.callbackUInt32->failure(operation.address,
+              completion.errorCode, std::string());
+        }
+      }
     } catch (...) {
-      // We do not want an exception in the callback to bubble up to the calling
-      // code.
+      // We catch all errors so that an exception that is thrown by a
+      // callback does not stop the send or receive thread.
     }
+    if (traceRing) {
+      addTraceEntry(*traceRing, operation, completion.success);
+    }
+    // We release the callbacks before returning the operation to the pool, so
+    // that they are not destroyed while the mutex is held.
+    operation.callbackUInt16.reset();
+    operation.callbackUInt32.reset();
   }
-}
-
-void MrfUdpIpMemoryAccess::writeUInt32(std::uint32_t address,
-    std::uint32_t value, std::shared_ptr<CallbackUInt32> callback) {
-  std::uint16_t lowWord = static_cast<std::uint16_t>(value);
-  std::uint16_t highWord = static_cast<std::uint16_t>(value >> 16);
-  // We have to write the high word first. Once it has been written, we can
-  // write the low word. We do not queue both, because unlike a read request,
-  // a write request where the low word is processed first could cause
-  // inconsistent data in the device.
-  std::shared_ptr<UInt32WriteHighCallback> internalCallback = std::make_shared<
-      UInt32WriteHighCallback>(*this, address, lowWord, callback);
-  queueWriteRequest(address, highWord, internalCallback);
-}
-
-void MrfUdpIpMemoryAccess::queueReadRequest(std::uint32_t address,
-    std::shared_ptr<MrfRequestCallback> callback) {
-  MrfRequest request;
-  request.packet.accessType = 1;
-  request.packet.address = htonl(baseAddress + address);
-  request.packet.data = 0;
-  request.packet.status = 0;
-  request.callback = callback;
-  request.numberOfTries = 0;
-  // We have to hold the mutex while incrementing the counter and modifying the
-  // request queue.
   {
     std::lock_guard<std::recursive_mutex> lock(mutex);
-    // We do not have to convert the byte order of the counter because this
-    // field is not touched by the server but simply mirrored back.
-    request.packet.ref = nextRequestCounter;
-    ++nextRequestCounter;
-    requestQueue.push_back(request);
-    sendSelector.wakeUp();
+    for (auto &completion : completions) {
+      releaseOperation(*completion.operation);
+    }
   }
+  completions.clear();
 }
 
-void MrfUdpIpMemoryAccess::queueWriteRequest(std::uint32_t address,
-    std::uint16_t data, std::shared_ptr<MrfRequestCallback> callback) {
-  MrfRequest request;
-  request.packet.accessType = 2;
-  request.packet.address = htonl(baseAddress + address);
-  request.packet.data = htons(data);
-  request.packet.status = 0;
-  request.callback = callback;
-  request.numberOfTries = 0;
-  // We have to hold the mutex while incrementing the counter and modifying the
-  // request queue.
-  {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    // We do not have to convert the byte order of the counter because this
-    // field is not touched by the server but simply mirrored back.
-    request.packet.ref = nextRequestCounter;
-    ++nextRequestCounter;
-    requestQueue.push_back(request);
-    sendSelector.wakeUp();
+void MrfUdpIpMemoryAccess::addTraceEntry(MrfTraceRing &traceRing,
+    const MrfOperation &operation, bool success) {
+  MrfTraceRing::Entry entry;
+  switch (operation.type) {
+  case OperationType::readUInt16:
+    entry.type = MrfTraceRing::OperationType::readUInt16;
+    break;
+  case OperationType::writeUInt16:
+    entry.type = MrfTraceRing::OperationType::writeUInt16;
+    break;
+  case OperationType::readUInt32:
+    entry.type = MrfTraceRing::OperationType::readUInt32;
+    break;
+  case OperationType::writeUInt32:
+    entry.type = MrfTraceRing::OperationType::writeUInt32;
+    break;
   }
+  entry.address = operation.address;
+  entry.success = success;
+  entry.numberOfTries = static_cast<std::uint16_t>(operation.numberOfTries);
+  // Times that have not been set (because the operation did not send a
+  // request or did not receive a response) are stored as zero.
+  auto toTimestamp = [](const MrfTime &time) -> std::int64_t {
+    return (time == MrfTime()) ? 0 : MrfTraceRing::toTimestamp(time);
+  };
+  entry.queueTime = toTimestamp(operation.startTime);
+  entry.firstSendTime = toTimestamp(operation.firstSendTime);
+  entry.lastSendTime = toTimestamp(operation.lastSendTime);
+  entry.responseTime = toTimestamp(operation.responseTime);
+  entry.completionTime = MrfTraceRing::toTimestamp(MrfTime::now());
+  traceRing.add(entry);
 }
 
 void MrfUdpIpMemoryAccess::runReceiveThread() {
-  int numberOfConsecutiveReadFailures = 0;
   while (!shutdown.load(std::memory_order_acquire)) {
     ::fd_set readFds;
     FD_ZERO(&readFds);
     FD_SET(socketDescriptor, &readFds);
     receiveSelector.select(&readFds, nullptr, nullptr, socketDescriptor,
         nullptr);
-    // We use a buffer that is slightly larger than needed so that we can detect
-    // too large packets.
-    char buffer[sizeof(MrfUdpPacket) + 4];
-    int numberOfBytesRead = ::read(socketDescriptor, buffer, sizeof(buffer));
-    if (numberOfBytesRead == -1) {
-      // A EAGAIN error is not considered an error. The next select operation
-      // should block until reading is possible again. We also ignore a
-      // connection refused error because this simply means that the peer is
-      // temporarily unavailable.
-      if (errno != EAGAIN && errno != ECONNREFUSED) {
-        // We count the number of consecutive errors. If this number gets too
-        // high, it is very likely that we have a non-recoverable problem and
-        // we better stop the receive thread. We do not stop the send thread
-        // because we want requests to be processed and result in a timeout.
-        ++numberOfConsecutiveReadFailures;
-        if (numberOfConsecutiveReadFailures >= 50) {
-          break;
-        }
+    if (!processReceivedPackets()) {
+      break;
+    }
+  }
+}
+
+void MrfUdpIpMemoryAccess::wakeUpSender() {
+  if (reactor) {
+    reactor->wakeUp(&reactorHandler);
+  } else {
+    sendSelector.wakeUp();
+  }
+}
+
+bool MrfUdpIpMemoryAccess::processReceivedPackets() {
+  // We drain as many packets as are available (up to the batch size), so
+  // that we only have to acquire the mutex once for all of them.
+  int errorNumber = receivePackets(receivedPackets);
+  if (errorNumber) {
+    // A EAGAIN error is not considered an error. The next select operation
+    // should block until reading is possible again. We also ignore a
+    // connection refused error because this simply means that the peer is
+    // temporarily unavailable.
+    if (errorNumber != EAGAIN && errorNumber != ECONNREFUSED) {
+      // We count the number of consecutive errors. If this number gets too
+      // high, it is very likely that we have a non-recoverable problem and
+      // we better stop the receive thread. We do not stop the send thread
+      // because we want requests to be processed and result in a timeout.
+      ++numberOfConsecutiveReadFailures;
+      if (numberOfConsecutiveReadFailures >= 50) {
+        return false;
       }
-      continue;
-    }
-    // Reset the error counter.
-    numberOfConsecutiveReadFailures = 0;
-    if (numberOfBytesRead != sizeof(MrfUdpPacket)) {
-      // Ignore packets with an odd size.
-      continue;
-    }
-    MrfUdpPacket *packet = reinterpret_cast<MrfUdpPacket *>(buffer);
-    packet->data = ntohs(packet->data);
-    packet->address = ntohl(packet->address);
-    // We do not swap the reference field because it contains the same sequence
-    // of bytes that was sent by us.
-    MrfRequest request;
-    {
-      // We have to hold the mutex while modifying the pendingRequests
-      // structure.
-      std::lock_guard<std::recursive_mutex> lock(mutex);
-      auto elementIterator = pendingRequests.find(packet->ref);
-      if (elementIterator != pendingRequests.end()) {
-        request = elementIterator->second;
-        pendingRequests.erase(elementIterator);
-      } else {
+    }
+    return true;
+  }
+  // Reset the error counter.
+  numberOfConsecutiveReadFailures = 0;
+  MrfTime receiveTime = MrfTime::now();
+  packetsReceivedCounter.increment(receivedPackets.size());
+  {
+    // We have to hold the mutex while modifying the requests.
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    bool windowWasFull = isCongestionWindowFull();
+    bool gotResponse = false;
+    for (auto &packet : receivedPackets) {
+      packet.data = ntohs(packet.data);
+      packet.address = ntohl(packet.address);
+      // We do not swap the reference field because it contains the same
+      // sequence of bytes that was sent by us.
+      MrfRequest *pendingRequest = findPendingRequest(packet.ref);
+      if (!pendingRequest) {
         // If we cannot find the request it probably timed out, so we simply
         // ignore the packet that we just received.
+        lateResponseCounter.increment();
         continue;
       }
-    }
-    // We call the callback without holding the mutex in order to avoid a dead
-    // lock.
-    if (request.callback) {
-      try {
-        (*request.callback)(packet->data, packet->status, false);
-      } catch (...) {
-        // We catch all errors so that an exception that is thrown by a callback
-        // does not stop the receive thread.
+      MrfRequest &request = *pendingRequest;
+      gotResponse = true;
+      request.operation->responseTime = receiveTime;
+      // If a request has been sent more than once, we cannot tell which
+      // transmission the response belongs to, so we only take samples from
+      // requests that were answered on their first try (Karn's algorithm).
+      if (request.numberOfTries == 1) {
+        MrfTime roundTripTime = receiveTime - request.sendTime;
+        roundTripTimeHistogram.record(roundTripTime);
+        if (adaptiveUdpTimeout) {
+          updateRoundTripTime(roundTripTime);
+        }
+      }
+      if (maximumPacketsInFlight > 0) {
+        // Each response grows the window by the inverse of its size, so that
+        // it grows by about one packet per round trip (additive increase).
+        congestionWindow += 1.0 / congestionWindow;
+        if (congestionWindow > maximumPacketsInFlight) {
+          congestionWindow = maximumPacketsInFlight;
+        }
       }
+      --numberOfPendingRequests;
+      completeRequest(request, packet.data, packet.status, false,
+          receiveCompletions);
+    }
+    // If the send thread is waiting for the window to open, we have to wake
+    // it up.
+    if (windowWasFull && gotResponse
+        && (!requestQueue.empty() || !bulkRequestQueue.empty())) {
+      wakeUpSender();
     }
   }
+  // We call the callbacks without holding the mutex in order to avoid a dead
+  // lock.
+  deliverCompletions(receiveCompletions);
+  return true;
 }
 
-void MrfUdpIpMemoryAccess::runSendThread() {
-  MrfTime nextSendTime;
-  bool needTimeoutCheck = false;
-  MrfTime nextTimeoutCheckTime;
-  while (!shutdown.load(std::memory_order_acquire)) {
-    // We get the current time here so that we can avoid unnecessary system
-    // calls and the current time used is consistent among the whole code.
-    MrfTime now = MrfTime::now();
-    // Check whether any pending requests have timed out. Checking all pending
-    // requests is not the most sufficient way to do this, however it frees us
-    // from the burden to maintain a second data structure and usually the
-    // number of pending requests should be small.
-    if (needTimeoutCheck) {
-      if (nextTimeoutCheckTime <= now) {
-        // We need to hold the mutex while modifying pendingRequests and
-        // requestQueue.
-        std::lock_guard<std::recursive_mutex> lock(mutex);
-        needTimeoutCheck = false;
-        for (auto pendingRequestIterator = pendingRequests.begin();
-            pendingRequestIterator != pendingRequests.end();) {
-          MrfRequest &request = pendingRequestIterator->second;
-          // If a request timed out, we add it back to the queue. Otherwise, we
-          // schedule a timeout check that should be run when the request times
-          // out. We do not check whether the maximum number of tries has been
-          // reached. We will do this later when processing the request. This
-          // way, we can avoid to hold the mutex when calling the callback.
-          if (request.timeout <= now) {
-            requestQueue.push_back(request);
-            pendingRequestIterator = pendingRequests.erase(
-                pendingRequestIterator);
-          } else {
-            if (!needTimeoutCheck) {
-              needTimeoutCheck = true;
-              nextTimeoutCheckTime = request.timeout;
-            } else {
-              if (nextTimeoutCheckTime > request.timeout) {
-                nextTimeoutCheckTime = request.timeout;
-              }
-            }
-            // We increment the iterator here instead of doing this in the for
-            // header because we do not want to increment the iterator if it
-            // has been incremented by removing the current element.
-            pendingRequestIterator++;
-          }
-        }
-      }
+int MrfUdpIpMemoryAccess::receivePackets(
+    std::vector<MrfUdpPacket> &packets) {
+  packets.clear();
+  // We use buffers that are slightly larger than needed so that we can detect
+  // too large packets.
+  char buffers[maximumPacketsPerBatch][sizeof(MrfUdpPacket) + 4];
+#ifdef __linux__
+  // On Linux, we can receive all available packets with a single system call.
+  ::iovec ioVectors[maximumPacketsPerBatch];
+  ::mmsghdr messages[maximumPacketsPerBatch];
+  std::memset(messages, 0, sizeof(messages));
+  for (std::size_t i = 0; i < maximumPacketsPerBatch; ++i) {
+    ioVectors[i].iov_base = buffers[i];
+    ioVectors[i].iov_len = sizeof(buffers[i]);
+    messages[i].msg_hdr.msg_iov = &ioVectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  int numberOfMessages = ::recvmmsg(socketDescriptor, messages,
+      maximumPacketsPerBatch, MSG_DONTWAIT, nullptr);
+  if (numberOfMessages == -1) {
+    return errno;
+  }
+  for (int i = 0; i < numberOfMessages; ++i) {
+    // Ignore packets with an odd size.
+    if (messages[i].msg_len == sizeof(MrfUdpPacket)) {
+      packets.push_back(*reinterpret_cast<MrfUdpPacket *>(buffers[i]));
     }
-    bool queueEmpty;
-    bool haveRequest;
-    MrfRequest request;
-    {
-      std::lock_guard<std::recursive_mutex> lock(mutex);
-      queueEmpty = requestQueue.empty();
-      if (!queueEmpty) {
-        request = requestQueue.front();
-        haveRequest = true;
-      } else {
-        haveRequest = false;
+  }
+#else // __linux__
+  for (std::size_t i = 0; i < maximumPacketsPerBatch; ++i) {
+    int numberOfBytesRead = ::read(socketDescriptor, buffers[i],
+        sizeof(buffers[i]));
+    if (numberOfBytesRead == -1) {
+      // If we already received a packet, we process it and only report the
+      // error when it happens again on the next call.
+      if (i == 0) {
+        return errno;
       }
+      break;
     }
-    bool delayNextSend = (nextSendTime > now);
-    if (haveRequest && request.numberOfTries >= maximumNumberOfTries) {
-      // We remove the request from the queue and notify the callback.
-      {
-        std::lock_guard<std::recursive_mutex> lock(mutex);
-        requestQueue.pop_front();
-        queueEmpty = requestQueue.empty();
-      }
-      // We call the callback without holding the mutex in order to avoid a dead
-      // lock.
-      if (request.callback) {
-        try {
-          (*request.callback)(0, 0, true);
-        } catch (...) {
-          // We catch all errors so that an exception that is thrown by a
-          // callback does not stop the receive thread.
-        }
-      }
-    } else if (haveRequest && !delayNextSend) {
-      int bytesSent = ::send(socketDescriptor, &request.packet,
-          sizeof(MrfUdpPacket), 0);
-      if (bytesSent == -1) {
-        // An error code of EAGAIN is not considered an error. It just means
-        // that the packet could not be sent immediately, so we keep it in the
-        // queue and try again after the next select operation. For other error
-        // codes we treat the request like it had been sent (incrementing the
-        // try counter). This means that eventually, the request will time out
-        // and be tried again until the maximum number of tries is reached.
-        if (errno != EAGAIN) {
-          request.numberOfTries += 1;
-          request.timeout = MrfTime::now() + udpTimeout;
-          if (!needTimeoutCheck) {
-            needTimeoutCheck = true;
-            nextTimeoutCheckTime = request.timeout;
-          }
-          // Remove request from queue and add it to the list of pending
-          // requests.
-          {
-            std::lock_guard<std::recursive_mutex> lock(mutex);
-            pendingRequests.insert(std::make_pair(request.packet.ref, request));
-            requestQueue.pop_front();
-            queueEmpty = requestQueue.empty();
-          }
-        }
-      } else {
-        MrfTime newNow = MrfTime::now();
-        request.numberOfTries += 1;
-        request.timeout = newNow + udpTimeout;
-        if (!needTimeoutCheck) {
-          needTimeoutCheck = true;
-          nextTimeoutCheckTime = request.timeout;
-        }
-        nextSendTime = newNow + delayBetweenPackets;
-        // Remove request from queue and add it to the list of pending requests.
-        {
-          std::lock_guard<std::recursive_mutex> lock(mutex);
-          pendingRequests.insert(std::make_pair(request.packet.ref, request));
-          requestQueue.pop_front();
-          queueEmpty = requestQueue.empty();
-        }
-      }
+    // Ignore packets with an odd size.
+    if (numberOfBytesRead == sizeof(MrfUdpPacket)) {
+      packets.push_back(*reinterpret_cast<MrfUdpPacket *>(buffers[i]));
     }
-    // We want the select operation to be cancelled when we have to take care of
-    // another action (sending the next packet or checking for timeouts).
-    bool needAction;
-    MrfTime nextActionTime;
-    if (delayNextSend && !queueEmpty && needTimeoutCheck) {
-      if (nextSendTime < nextTimeoutCheckTime) {
-        nextActionTime = nextSendTime;
-      } else {
-        nextActionTime = nextTimeoutCheckTime;
+  }
+#endif // __linux__
+  return 0;
+}
+
+std::size_t MrfUdpIpMemoryAccess::sendPackets(
+    std::vector<MrfUdpPacket> &packets) {
+  std::size_t numberOfPacketsSent = 0;
+#ifdef __linux__
+  // On Linux, we can send all packets with a single system call.
+  ::iovec ioVectors[maximumPacketsPerBatch];
+  ::mmsghdr messages[maximumPacketsPerBatch];
+  std::size_t numberOfMessages = std::min(packets.size(),
+      maximumPacketsPerBatch);
+  std::memset(messages, 0, sizeof(messages));
+  for (std::size_t i = 0; i < numberOfMessages; ++i) {
+    ioVectors[i].iov_base = &packets[i];
+    ioVectors[i].iov_len = sizeof(MrfUdpPacket);
+    messages[i].msg_hdr.msg_iov = &ioVectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  while (numberOfPacketsSent < numberOfMessages) {
+    int result = ::sendmmsg(socketDescriptor, messages + numberOfPacketsSent,
+        numberOfMessages - numberOfPacketsSent, 0);
+    if (result == -1) {
+      if (errno == EAGAIN) {
+        break;
       }
-      needAction = true;
-    } else if (delayNextSend && !queueEmpty) {
-      nextActionTime = nextSendTime;
-      needAction = true;
-    } else if (needTimeoutCheck) {
-      nextActionTime = nextTimeoutCheckTime;
-      needAction = true;
+      // We skip the packet that caused the error and treat it like it had
+      // been sent.
+      ++numberOfPacketsSent;
     } else {
-      needAction = false;
+      numberOfPacketsSent += result;
     }
+  }
+#else // __linux__
+  while (numberOfPacketsSent < packets.size()) {
+    int bytesSent = ::send(socketDescriptor, &packets[numberOfPacketsSent],
+        sizeof(MrfUdpPacket), 0);
+    if (bytesSent == -1 && errno == EAGAIN) {
+      break;
+    }
+    // If there was an error other than EAGAIN, we treat the packet like it
+    // had been sent.
+    ++numberOfPacketsSent;
+  }
+#endif // __linux__
+  return numberOfPacketsSent;
+}
+
+void MrfUdpIpMemoryAccess::runSendThread() {
+  while (!shutdown.load(std::memory_order_acquire)) {
+    MrfUdpIpReactor::SendStatus status = processSendQueue();
     ::timeval waitTime;
-    if (needAction) {
+    if (status.needAction) {
       // We use the current time for the check because some time might have
-      // passed since now was initialized.
-      MrfTime newNow = MrfTime::now();
-      if (nextActionTime > newNow) {
-        waitTime = nextActionTime - newNow;
+      // passed since the send queue was processed.
+      MrfTime now = MrfTime::now();
+      if (status.nextActionTime > now) {
+        waitTime = status.nextActionTime - now;
       } else {
         // If we need immediate action, we can skip the select call and continue
         // right away.
@@ -705,12 +1192,214 @@ void MrfUdpIpMemoryAccess::runSendThread() {
     }
     ::fd_set writeFds;
     FD_ZERO(&writeFds);
-    if (!queueEmpty && !delayNextSend) {
+    if (status.waitForWritable) {
       FD_SET(socketDescriptor, &writeFds);
     }
     sendSelector.select(nullptr, &writeFds, nullptr, socketDescriptor,
-        needAction ? &waitTime : nullptr);
+        status.needAction ? &waitTime : nullptr);
+  }
+}
+
+MrfUdpIpReactor::SendStatus MrfUdpIpMemoryAccess::processSendQueue() {
+  // We get the current time here so that we can avoid unnecessary system
+  // calls and the current time used is consistent among the whole code.
+  MrfTime now = MrfTime::now();
+  // Check whether any pending requests have timed out. The timeouts are
+  // ordered in a heap, so we only have to look at the ones that have
+  // actually expired.
+  if (needTimeoutCheck) {
+    if (nextTimeoutCheckTime <= now) {
+      // We need to hold the mutex while modifying the requests and the
+      // queues.
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      bool haveTimedOutRequest = false;
+      while (!pendingRequestTimeouts.empty()
+          && pendingRequestTimeouts.top().first <= now) {
+        std::uint32_t ref = pendingRequestTimeouts.top().second;
+        MrfTime timeout = pendingRequestTimeouts.top().first;
+        pendingRequestTimeouts.pop();
+        // Entries are not removed from the heap when a response is received
+        // or when a request is sent again, so we have to check that the
+        // entry still refers to the current try of a pending request.
+        MrfRequest *request = findPendingRequest(ref);
+        if (!request || request->timeout != timeout) {
+          continue;
+        }
+        // If a request timed out, we add it back to the queue. We do not
+        // check whether the maximum number of tries has been reached. We
+        // will do this later when processing the request. This way, we can
+        // avoid to hold the mutex when calling the callback.
+        haveTimedOutRequest = true;
+        timeoutCounter.increment();
+        request->state = RequestState::queued;
+        --numberOfPendingRequests;
+        getQueue(*request).pushBack(request);
+      }
+      needTimeoutCheck = !pendingRequestTimeouts.empty();
+      if (needTimeoutCheck) {
+        nextTimeoutCheckTime = pendingRequestTimeouts.top().first;
+      }
+      // A timeout is taken as a sign of congestion, so we halve the window
+      // (multiplicative decrease). We only do this once per check, so that a
+      // burst of requests that were lost together does not collapse the
+      // window completely.
+      if (haveTimedOutRequest && maximumPacketsInFlight > 0) {
+        congestionWindow /= 2.0;
+        if (congestionWindow < 1.0) {
+          congestionWindow = 1.0;
+        }
+      }
+      // The timeout might have been too short, so we back off exponentially
+      // until the next sample of the round-trip time is taken.
+      if (haveTimedOutRequest && adaptiveUdpTimeout) {
+        currentUdpTimeout = std::min(currentUdpTimeout + currentUdpTimeout,
+            maximumUdpTimeout);
+      }
+    }
+  }
+  bool queueEmpty;
+  bool useCongestionWindow;
+  bool windowFull;
+  bool delayNextSend;
+  MrfTime batchTimeout;
+  sendBatchRequests.clear();
+  sendBatchPackets.clear();
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    useCongestionWindow = maximumPacketsInFlight > 0;
+    // When the congestion window is used, it limits the rate at which
+    // packets are sent, so we do not apply the fixed delay between packets.
+    delayNextSend = !useCongestionWindow && (nextSendTime > now);
+    // If there is a delay between packets, we can only send a single packet
+    // at a time. Otherwise, we send as many packets as the congestion window
+    // allows with a single system call.
+    std::size_t maximumBatchSize =
+        (useCongestionWindow || delayBetweenPackets <= MrfTime()) ?
+            maximumPacketsPerBatch : 1;
+    MrfTime sendTime = MrfTime::now();
+    batchTimeout = sendTime + currentUdpTimeout;
+    while (true) {
+      // We remove requests that have reached the maximum number of tries
+      // from the queues and notify their callbacks later, because we do not
+      // want to hold the mutex while calling them.
+      bool removedFailedRequest = false;
+      for (auto queue : {&requestQueue, &bulkRequestQueue}) {
+        if (!queue->empty()
+            && queue->front()->numberOfTries >= maximumNumberOfTries) {
+          completeRequest(*queue->popFront(), 0, 0, true, sendCompletions);
+          removedFailedRequest = true;
+        }
+      }
+      if (removedFailedRequest) {
+        continue;
+      }
+      if (delayNextSend || isCongestionWindowFull()
+          || sendBatchRequests.size() >= maximumBatchSize) {
+        break;
+      }
+      RequestQueue *queue = selectQueue();
+      if (!queue) {
+        break;
+      }
+      MrfRequest &request = *queue->popFront();
+      // We mark the request as pending before actually sending it.
+      // Otherwise, the response might arrive before the request has been
+      // marked, and the receive thread would discard it. For the same
+      // reason, we send a copy of the packet, so that the request can be
+      // reused as soon as it has been answered.
+      if (request.numberOfTries > 0) {
+        retryCounter.increment();
+      }
+      request.numberOfTries += 1;
+      request.sendTime = sendTime;
+      if (request.operation->numberOfTries == 0) {
+        request.operation->firstSendTime = sendTime;
+      }
+      request.operation->lastSendTime = sendTime;
+      request.operation->numberOfTries += 1;
+      request.timeout = batchTimeout;
+      request.state = RequestState::pending;
+      ++numberOfPendingRequests;
+      pendingRequestTimeouts.push(
+          std::make_pair(request.timeout, request.packet.ref));
+      sendBatchRequests.push_back(&request);
+      sendBatchPackets.push_back(request.packet);
+    }
+    queueEmpty = requestQueue.empty() && bulkRequestQueue.empty();
+    windowFull = isCongestionWindowFull();
+  }
+  // We call the callbacks without holding the mutex in order to avoid a dead
+  // lock.
+  deliverCompletions(sendCompletions);
+  if (!sendBatchRequests.empty()) {
+    std::size_t numberOfPacketsSent = sendPackets(sendBatchPackets);
+    packetsSentCounter.increment(numberOfPacketsSent);
+    if (numberOfPacketsSent < sendBatchRequests.size()) {
+      // The remaining packets could not be sent because the send buffer of
+      // the socket is full. This is not considered an error, so we put the
+      // requests back at the front of the queue (preserving their order)
+      // and try again after the next select operation. A request that has
+      // been sent before might have been answered by a late response to an
+      // earlier try in the meantime, so we only put back requests that are
+      // still pending for this try.
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      for (std::size_t i = sendBatchRequests.size(); i > numberOfPacketsSent;
+          --i) {
+        MrfRequest &request = *sendBatchRequests[i - 1];
+        if (request.state != RequestState::pending
+            || request.packet.ref != sendBatchPackets[i - 1].ref
+            || request.timeout != batchTimeout) {
+          continue;
+        }
+        request.state = RequestState::queued;
+        --numberOfPendingRequests;
+        request.numberOfTries -= 1;
+        request.operation->numberOfTries -= 1;
+        getQueue(request).pushFront(&request);
+      }
+      queueEmpty = false;
+      windowFull = isCongestionWindowFull();
+    }
+    // Requests for which the send operation failed with an error other than
+    // EAGAIN are treated like they had been sent. This means that
+    // eventually, they will time out and be tried again until the maximum
+    // number of tries is reached.
+    if (numberOfPacketsSent > 0) {
+      if (!needTimeoutCheck || nextTimeoutCheckTime > batchTimeout) {
+        needTimeoutCheck = true;
+        nextTimeoutCheckTime = batchTimeout;
+      }
+      nextSendTime = MrfTime::now() + delayBetweenPackets;
+      // If there is a delay between packets, we know that we have to wait
+      // before sending the next packet.
+      delayNextSend = !useCongestionWindow
+          && delayBetweenPackets > MrfTime();
+    }
+  }
+  // We want to be called again when we have to take care of another action
+  // (sending the next packet or checking for timeouts).
+  MrfUdpIpReactor::SendStatus status;
+  if (delayNextSend && !queueEmpty && needTimeoutCheck) {
+    if (nextSendTime < nextTimeoutCheckTime) {
+      status.nextActionTime = nextSendTime;
+    } else {
+      status.nextActionTime = nextTimeoutCheckTime;
+    }
+    status.needAction = true;
+  } else if (delayNextSend && !queueEmpty) {
+    status.nextActionTime = nextSendTime;
+    status.needAction = true;
+  } else if (needTimeoutCheck) {
+    status.nextActionTime = nextTimeoutCheckTime;
+    status.needAction = true;
+  } else {
+    status.needAction = false;
   }
+  // If the congestion window is full, we wait for the receive thread to wake
+  // us up instead of waiting for the socket to become writable (which would
+  // happen immediately).
+  status.waitForWritable = !queueEmpty && !delayNextSend && !windowFull;
+  return status;
 }
 
 }
@@ -31,11 +31,16 @@
 #define ANKA_MRF_UDP_IP_MEMORY_ACCESS_H
 
 #include <atomic>
-#include <list>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <queue>
 #include <string>
 #include <thread>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 extern "C" {
 #include <sys/select.h>
@@ -45,6 +50,8 @@ extern "C" {
 #include <MrfMemoryAccess.h>
 #include <MrfTime.h>
 
+#include "MrfUdpIpReactor.h"
+
 namespace anka {
 namespace mrf {
 
@@ -77,6 +84,88 @@ public:
    */
   static constexpr std::uint32_t baseAddressVmeEvrRegister = 0x7a000000;
 
+  /**
+   * Snapshot of the state of the flow control and of the timeout handling of
+   * a memory-access object. This information is intended for diagnostics.
+   */
+  struct TransportStatus {
+
+    /**
+     * Tells whether the UDP timeout is derived from the measured round-trip
+     * time. If {@code false}, the fixed UDP timeout is used.
+     */
+    bool adaptiveUdpTimeout;
+
+    /**
+     * Tells whether at least one round-trip time has been measured. If
+     * {@code false}, the smoothed round-trip time and the round-trip time
+     * variation do not carry any meaning.
+     */
+    bool haveRoundTripTimeSample;
+
+    /**
+     * Smoothed round-trip time.
+     */
+    MrfTime smoothedRoundTripTime;
+
+    /**
+     * Smoothed mean deviation of the round-trip time.
+     */
+    MrfTime roundTripTimeVariation;
+
+    /**
+     * UDP timeout that is used for the next request that is sent.
+     */
+    MrfTime udpTimeout;
+
+    /**
+     * Maximum number of packets in flight. Zero if the fixed delay between
+     * packets is used instead of the congestion window.
+     */
+    int maximumPacketsInFlight;
+
+    /**
+     * Current size of the congestion window (in packets).
+     */
+    double congestionWindow;
+
+    /**
+     * Number of requests that have been sent, but not answered yet.
+     */
+    std::size_t numberOfPendingRequests;
+
+    /**
+     * Number of requests (including bulk requests) that are waiting to be
+     * sent.
+     */
+    std::size_t numberOfQueuedRequests;
+
+    /**
+     * Number of bulk requests that are waiting to be sent.
+     */
+    std::size_t numberOfQueuedBulkRequests;
+
+    /**
+     * Share of the packets that is used for bulk requests while there are
+     * interactive requests waiting.
+     */
+    double bulkShare;
+
+    /**
+     * Number of read operations that have been attached to a read of the same
+     * register that was already in progress, instead of sending their own
+     * requests.
+     */
+    std::uint64_t numberOfCoalescedReads;
+
+    /**
+     * Tells whether both halves of a 32-bit write are sent without waiting
+     * for the response to the first half.
+     */
+    bool pipelinedWrites;
+
+  };
+
   /**
    * Creates a memory-access object for an MRF device that can be controlled
    * via UDP/IP. The specified host name can either be a DNS name or an IP
@@ -115,16 +204,123 @@ public:
       const MrfTime &delayBetweenPackets, const MrfTime &udpTimeout,
       int maximumNumberOfTries);
 
+  /**
+   * Creates a memory-access object for an MRF device that can be controlled
+   * via UDP/IP. This constructor is like the one taking the delay between
+   * packets, the UDP timeout, and the maximum number of tries, but it does not
+   * create background threads if a reactor is specified. Instead, the
+   * communication with the device is handled by the reactor's thread, which
+   * can be shared by many devices. If the specified reactor is null, two
+   * background threads are created, just like with the other constructors.
+   */
+  MrfUdpIpMemoryAccess(const std::string &hostName, std::uint32_t baseAddress,
+      const MrfTime &delayBetweenPackets, const MrfTime &udpTimeout,
+      int maximumNumberOfTries, std::shared_ptr<MrfUdpIpReactor> reactor);
+
   /**
    * Destructor. Closes the connection to the device and terminates the
    * background thread.
    */
   virtual ~MrfUdpIpMemoryAccess();
 
+  /**
+   * Selects how the sending of packets is paced. If the specified number is
+   * zero (the default), the fixed delay between packets that has been passed
+   * to the constructor is used and there is no limit on the number of packets
+   * in flight. If the number is positive, the delay between packets is not
+   * used. Instead, the number of requests that have been sent but not answered
+   * yet is limited by a congestion window. This window starts with a size of
+   * one, grows additively (by about one packet per round trip) when responses
+   * are received and is halved when requests time out. The specified number is
+   * the upper limit for the size of this window. This method may be called at
+   * any time and is thread safe. Throws an exception if the specified number is
+   * negative.
+   */
+  void setMaximumPacketsInFlight(int maximumPacketsInFlight);
+
+  /**
+   * Sets the share of packets that is used for bulk requests while there are
+   * interactive requests waiting to be sent. Requests that are part of a block
+   * operation are bulk requests and are queued separately from all other
+   * (interactive) requests, so that a large transfer (e.g. updating a
+   * waveform) does not delay other operations for a long time. When both kinds
+   * of requests are waiting, a bulk request is sent instead of an interactive
+   * one for the specified share of packets. When only one kind of request is
+   * waiting, it uses all packets. The share must be between zero and one. The
+   * default is 0.2. This method may be called at any time and is thread safe.
+   * Throws an exception if the specified share is not within the allowed
+   * range.
+   */
+  void setBulkShare(double bulkShare);
+
+  /**
+   * Enables or disables pipelined 32-bit writes. The protocol only allows
+   * writing 16 bits at a time and the high word of a register has to be
+   * written before the low word. By default, the low word is only sent after
+   * the response for the high word has been received, so each 32-bit write
+   * takes two round trips. When pipelined writes are enabled, the request for
+   * the low word is queued right after the one for the high word, so that both
+   * can be in flight at the same time. If the response for the low word
+   * arrives first, the low word is written again once the high word has been
+   * written. If writing either half fails, the whole write is retried without
+   * pipelining. This method may be called at any time and is thread safe. It
+   * only affects writes that are queued after it has been called.
+   */
+  void setPipelinedWrites(bool enabled);
+
+  /**
+   * Enables the adaptive UDP timeout. When enabled, the UDP timeout is not
+   * fixed, but derived from the round-trip times measured for requests that
+   * were answered on their first try. The timeout is the smoothed round-trip
+   * time plus four times its smoothed mean deviation (like for TCP, see RFC
+   * 6298), and it is doubled each time requests time out until the next
+   * measurement is made. The resulting timeout is limited to the interval
+   * specified by the minimum and maximum timeout. Until the first measurement
+   * has been made, the fixed UDP timeout (limited to the same interval) is
+   * used. This method may be called at any time and is thread safe. Throws an
+   * exception if the minimum timeout is not positive or the maximum timeout is
+   * less than the minimum timeout.
+   */
+  void enableAdaptiveUdpTimeout(const MrfTime &minimumUdpTimeout,
+      const MrfTime &maximumUdpTimeout);
+
+  /**
+   * Returns a snapshot of the state of the flow control and of the timeout
+   * handling. This method is thread safe.
+   */
+  TransportStatus getTransportStatus();
+
+  /**
+   * Adds the runtime statistics of this memory access to the specified
+   * statistics object. The names of the statistics start with "udp.". This
+   * method is thread safe.
+   */
+  virtual void collectStatistics(MrfStatistics &statistics);
+
+  /**
+   * Tells whether this memory access can record a trace of its operations.
+   * Always returns {@code true}.
+   */
+  virtual bool supportsTracing() const;
+
+  /**
+   * Sets the ring buffer to which this memory access adds an entry for each
+   * operation that finishes. The entry records when the operation was queued,
+   * when its first and last request were sent, when the last response was
+   * received, and when the callback returned. A read that has been combined
+   * with a read that was already in progress does not send any requests, so
+   * only the queue and completion times are recorded for it. Passing a null
+   * pointer disables tracing. This method is thread safe.
+   */
+  virtual void setTraceRing(std::shared_ptr<MrfTraceRing> traceRing);
+
   /**
    * Reads from an unsigned 16-bit register. This method does not block. The
    * operation is queued and executed asynchronously. When the operation
-   * finishes, the specified callback is called.
+   * finishes, the specified callback is called. If a read of the same register
+   * is already queued or in flight (and no write to that register has been
+   * queued since), no additional request is sent. Instead, the operation
+   * completes with the response to the read that is already in progress.
    */
   virtual void readUInt16(std::uint32_t address,
       std::shared_ptr<CallbackUInt16> callback);
@@ -140,7 +336,10 @@ public:
   /**
    * Reads from an unsigned 32-bit register. This method does not block. The
    * operation is queued and executed asynchronously. When the operation
-   * finishes, the specified callback is called.
+   * finishes, the specified callback is called. If a read of the same register
+   * is already queued or in flight (and no write to that register has been
+   * queued since), no additional request is sent. Instead, the operation
+   * completes with the response to the read that is already in progress.
    */
   virtual void readUInt32(std::uint32_t address,
       std::shared_ptr<CallbackUInt32> callback);
@@ -148,17 +347,57 @@ public:
   /**
    * Writes to an unsigned 32-bit register. This method does not block. The
    * operation is queued and executed asynchronously. When the operation
-   * finishes, the specified callback is called.
+   * finishes, the specified callback is called. The two halves of the
+   * register are written one after the other, unless pipelined writes have
+   * been enabled (see {@link setPipelinedWrites(bool)}).
    */
   virtual void writeUInt32(std::uint32_t address, std::uint32_t value,
       std::shared_ptr<CallbackUInt32>);
 
+  /**
+   * Reads from a block of unsigned 16-bit registers. This method does not
+   * block. The requests for the individual registers are queued as bulk
+   * requests (see {@link setBulkShare(double)}).
+   */
+  virtual void readUInt16Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt16> callback);
+
+  /**
+   * Writes to a block of unsigned 16-bit registers. This method does not
+   * block. The requests for the individual registers are queued as bulk
+   * requests (see {@link setBulkShare(double)}).
+   */
+  virtual void writeUInt16Block(std::uint32_t address,
+      std::vector<std::uint16_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt16> callback);
+
+  /**
+   * Reads from a block of unsigned 32-bit registers. This method does not
+   * block. The requests for the individual registers are queued as bulk
+   * requests (see {@link setBulkShare(double)}).
+   */
+  virtual void readUInt32Block(std::uint32_t address, std::size_t count,
+      std::uint32_t stride, std::shared_ptr<BlockCallbackUInt32> callback);
+
+  /**
+   * Writes to a block of unsigned 32-bit registers. This method does not
+   * block. The requests for the individual registers are queued as bulk
+   * requests (see {@link setBulkShare(double)}).
+   */
+  virtual void writeUInt32Block(std::uint32_t address,
+      std::vector<std::uint32_t> values, std::uint32_t stride,
+      std::shared_ptr<BlockCallbackUInt32> callback);
+
   // We want the methods from the base class to participate in overload
   // resolution.
   using MrfMemoryAccess::readUInt16;
+  using MrfMemoryAccess::readUInt16Block;
   using MrfMemoryAccess::readUInt32;
+  using MrfMemoryAccess::readUInt32Block;
   using MrfMemoryAccess::writeUInt16;
+  using MrfMemoryAccess::writeUInt16Block;
   using MrfMemoryAccess::writeUInt32;
+  using MrfMemoryAccess::writeUInt32Block;
 
 private:
 
@@ -177,118 +416,202 @@ private:
   };
 #pragma pack(pop)
 
+  struct MrfOperation;
+
   /**
-   * Data structure that is used for the internal request callbacks.
+   * Role that a request plays in the operation it belongs to. A 16-bit
+   * operation consists of a single request. A 32-bit operation consists of
+   * one request for each half of the register.
    */
-  struct MrfRequestCallback {
-    virtual ~MrfRequestCallback() {}
-
-    virtual void operator()(std::uint16_t receivedData, std::int8_t status,
-        bool timeout) = 0;
+  enum class RequestRole : std::uint8_t {
+    uint16, uint32ReadLow, uint32ReadHigh, uint32WriteHigh, uint32WriteLow
   };
 
   /**
-   * Internal callback for a uint16 read or write request.
+   * Type of an operation.
    */
-  struct UInt16Callback: MrfRequestCallback {
-    std::uint32_t address;
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt16> callback;
+  enum class OperationType : std::uint8_t {
+    readUInt16, writeUInt16, readUInt32, writeUInt32
+  };
 
-    UInt16Callback(std::uint32_t address,
-        std::shared_ptr<MrfMemoryAccess::CallbackUInt16> callback);
+  /**
+   * State of a request. A request that is idle is neither queued nor waiting
+   * for a response.
+   */
+  enum class RequestState : std::uint8_t {
+    idle, queued, pending
+  };
 
-    void operator()(std::uint16_t receivedData, std::int8_t status,
-        bool timeout);
+  /**
+   * Data structure storing all data associated with the request for sending a
+   * UDP packet. Requests are embedded in the operation they belong to, so they
+   * never have to be allocated separately. A request is in at most one queue
+   * at a time, so the queues link the requests directly through the
+   * {@code next} field.
+   */
+  struct MrfRequest {
+    MrfUdpPacket packet;
+    MrfOperation *operation = nullptr;
+    MrfRequest *next = nullptr;
+    RequestRole role = RequestRole::uint16;
+    RequestState state = RequestState::idle;
+    // The generation is incremented each time the request is queued, so that
+    // a late response cannot be mistaken for the response to a later use of
+    // the same request.
+    std::uint32_t generation = 0;
+    int numberOfTries = 0;
+    MrfTime sendTime;
+    MrfTime timeout;
   };
 
   /**
-   * Data structure that is shared by the callbacks for a uint32 read request.
+   * Data structure storing all data associated with a read or write operation
+   * that has been requested by the user of this memory access. Operations are
+   * taken from a pool and returned to it when they are not used any longer, so
+   * that queuing an operation does not allocate memory once the pool has grown
+   * to the size that is needed.
    */
-  struct UInt32ReadShared: std::enable_shared_from_this<UInt32ReadShared> {
-    MrfUdpIpMemoryAccess &memoryAccess;
-    std::mutex mutex;
-    std::uint32_t address;
+  struct MrfOperation {
+    std::uint32_t index = 0;
+    OperationType type = OperationType::readUInt16;
+    std::uint32_t address = 0;
+    // For a 32-bit read, the data is assembled from the two halves. For a
+    // 32-bit write, it is the value to be written, and the high word is
+    // replaced with the value read back once it has been written. For a
+    // pipelined 32-bit write, both halves are replaced with the values read
+    // back, and the value to be written is kept separately, so that it is
+    // still available when a half has to be written again.
     std::uint32_t data = 0;
+    std::uint32_t writeValue = 0;
+    // Time when the operation was requested. It is used for the latency
+    // statistics. The other times and the number of tries (for all requests
+    // of the operation) are only used for the trace.
+    MrfTime startTime;
+    MrfTime firstSendTime;
+    MrfTime lastSendTime;
+    MrfTime responseTime;
+    int numberOfTries = 0;
+    bool bulk = false;
+    bool pipelined = false;
     bool failed = false;
     bool gotLow = false;
     bool gotHigh = false;
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback;
-
-    UInt32ReadShared(MrfUdpIpMemoryAccess &memoryAccess, std::uint32_t address,
-        std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback);
-
-    void receivedLow(std::uint16_t data);
-    void receivedHigh(std::uint16_t data);
-    void failure(MrfMemoryAccess::ErrorCode errorCode,
-        const std::string &details);
+    // Number of requests that are queued or pending plus the number of
+    // completions that have not been delivered yet. The operation is returned
+    // to the pool when this number drops to zero.
+    int numberOfReferences = 0;
+    // Only one of the two callbacks is set, depending on the type of the
+    // operation.
+    std::shared_ptr<MrfMemoryAccess::CallbackUInt16> callbackUInt16;
+    std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callbackUInt32;
+    MrfRequest requests[2];
+    MrfOperation *nextFree = nullptr;
+    // A read operation that is in progress is added to the table of reads in
+    // progress. Subsequent reads of the same register are attached to it
+    // instead of sending their own requests, and complete together with it.
+    bool inReadTable = false;
+    MrfOperation *nextInReadTable = nullptr;
+    MrfOperation *firstAttached = nullptr;
+    MrfOperation *nextAttached = nullptr;
   };
 
   /**
-   * Internal callback for reading the low word of a uint32 register.
+   * Queue of requests. The requests are linked through their {@code next}
+   * field, so adding and removing requests never allocates memory.
    */
-  struct UInt32ReadLowCallback: MrfRequestCallback {
-    std::shared_ptr<UInt32ReadShared> sharedData;
-
-    UInt32ReadLowCallback(std::shared_ptr<UInt32ReadShared> sharedData);
-
-    void operator()(std::uint16_t receivedData, std::int8_t status,
-        bool timeout);
+  struct RequestQueue {
+    MrfRequest *head = nullptr;
+    MrfRequest *tail = nullptr;
+    std::size_t size = 0;
+
+    bool empty() const {
+      return head == nullptr;
+    }
+
+    MrfRequest *front() const {
+      return head;
+    }
+
+    void pushBack(MrfRequest *request) {
+      request->next = nullptr;
+      if (tail) {
+        tail->next = request;
+      } else {
+        head = request;
+      }
+      tail = request;
+      ++size;
+    }
+
+    void pushFront(MrfRequest *request) {
+      request->next = head;
+      head = request;
+      if (!tail) {
+        tail = request;
+      }
+      ++size;
+    }
+
+    MrfRequest *popFront() {
+      MrfRequest *request = head;
+      head = request->next;
+      if (!head) {
+        tail = nullptr;
+      }
+      request->next = nullptr;
+      --size;
+      return request;
+    }
   };
 
   /**
-   * Internal callback for reading the high word of a uint32 register.
+   * Result of an operation that still has to be reported to the callback of
+   * the operation.
    */
-  struct UInt32ReadHighCallback: MrfRequestCallback {
-    std::shared_ptr<UInt32ReadShared> sharedData;
-
-    UInt32ReadHighCallback(std::shared_ptr<UInt32ReadShared> sharedData);
-
-    void operator()(std::uint16_t receivedData, std::int8_t status,
-        bool timeout);
+  struct MrfCompletion {
+    MrfOperation *operation;
+    bool success;
+    ErrorCode errorCode;
+    std::uint32_t data;
   };
 
   /**
-   * Internal callback for writing the low word of a uint32 register.
+   * Handler that connects the memory access to a reactor.
    */
-  struct UInt32WriteLowCallback: MrfRequestCallback {
-    std::uint32_t address;
-    std::uint16_t highData;
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback;
+  struct ReactorHandler: MrfUdpIpReactor::Handler {
+    MrfUdpIpMemoryAccess &memoryAccess;
 
-    UInt32WriteLowCallback(std::uint32_t address, std::uint16_t highData,
-        std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback);
+    ReactorHandler(MrfUdpIpMemoryAccess &memoryAccess);
 
-    void operator()(std::uint16_t receivedData, std::int8_t status,
-        bool timeout);
+    bool handleReadable();
+
+    MrfUdpIpReactor::SendStatus handleSend();
   };
 
   /**
-   * Internal callback for writing the high word of a uint32 register.
+   * Maximum number of packets that are sent or received with a single system
+   * call.
    */
-  struct UInt32WriteHighCallback: MrfRequestCallback {
-    MrfUdpIpMemoryAccess &memoryAccess;
-    std::uint32_t address;
-    std::uint16_t lowData;
-    std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback;
+  static constexpr std::size_t maximumPacketsPerBatch = 32;
 
-    UInt32WriteHighCallback(MrfUdpIpMemoryAccess &memoryAccess,
-        std::uint32_t address, std::uint16_t lowData,
-        std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callback);
+  /**
+   * Number of operations that are added to the pool at once when it has to
+   * grow.
+   */
+  static constexpr std::size_t operationChunkSize = 256;
 
-    void operator()(std::uint16_t receivedData, std::int8_t status,
-        bool timeout);
-  };
+  /**
+   * Number of bits of a request reference that identify the request. The
+   * remaining bits store the generation of the request. Two requests belong
+   * to each operation, so this also limits the number of operations.
+   */
+  static constexpr unsigned int requestIndexBits = 20;
 
   /**
-   * Data structure storing all data associated with the request for sending a
-   * UDP packet.
+   * Number of buckets in the table of reads in progress. This must be a power
+   * of two.
    */
-  struct MrfRequest {
-    MrfUdpPacket packet;
-    std::shared_ptr<MrfRequestCallback> callback;
-    int numberOfTries;
-    MrfTime timeout;
-  };
+  static constexpr std::size_t readTableSize = 1024;
 
   // We do not want to allow copy or move construction or assignment.
   MrfUdpIpMemoryAccess(const MrfUdpIpMemoryAccess &) = delete;
@@ -303,6 +626,10 @@ private:
   std::thread sendThread;
   std::atomic<bool> shutdown;
 
+  // If the reactor is set, it is used instead of the send and receive threads.
+  std::shared_ptr<MrfUdpIpReactor> reactor;
+  ReactorHandler reactorHandler;
+
   // Experiments have shown that the MRF VME-EVG can process packets at a rate
   // of roughly one packet every 400 microseconds without losing packets.
   MrfTime delayBetweenPackets;
@@ -321,21 +648,233 @@ private:
   MrfFdSelector receiveSelector;
   MrfFdSelector sendSelector;
 
-  std::list<MrfRequest> requestQueue;
-  std::unordered_map<std::uint32_t, MrfRequest> pendingRequests;
-  std::uint32_t nextRequestCounter = 0;
+  // Interactive and bulk requests are queued separately. When both queues
+  // contain requests, the bulk share determines how many packets are used for
+  // bulk requests. The bulk credit is increased by the bulk share for each
+  // packet and a bulk request is sent each time it reaches one. All these
+  // fields are protected by the mutex.
+  RequestQueue requestQueue;
+  RequestQueue bulkRequestQueue;
+  double bulkShare = 0.2;
+  double bulkCredit = 0.0;
+
+  // Pool of operations. The operations are allocated in chunks that are only
+  // freed when this memory access is destroyed, so pointers to operations (and
+  // the requests embedded in them) stay valid, even when the mutex is not
+  // held. Operations that are not used are kept in a FIFO list, so that an
+  // operation is reused as late as possible. Pending requests are found
+  // through the index stored in their reference, so we only have to count
+  // them. All these fields are protected by the mutex.
+  std::vector<std::unique_ptr<MrfOperation[]>> operationChunks;
+  MrfOperation *firstFreeOperation = nullptr;
+  MrfOperation *lastFreeOperation = nullptr;
+  std::size_t numberOfPendingRequests = 0;
+
+  // Read operations that are in progress, hashed by their address (see
+  // MrfOperation). The buckets are allocated once, so adding an operation to
+  // the table does not allocate memory. The table and the counter are
+  // protected by the mutex.
+  std::vector<MrfOperation *> readTable;
+  std::uint64_t numberOfCoalescedReads = 0;
+
+  // Runtime statistics. The counters and histograms can be updated and read
+  // without holding the mutex.
+  MrfStatisticsCounter readCounter;
+  MrfStatisticsCounter writeCounter;
+  MrfStatisticsCounter packetsSentCounter;
+  MrfStatisticsCounter packetsReceivedCounter;
+  MrfStatisticsCounter retryCounter;
+  MrfStatisticsCounter timeoutCounter;
+  MrfStatisticsCounter failureCounter;
+  MrfStatisticsCounter lateResponseCounter;
+  MrfStatisticsCounter queueHighWater;
+  MrfLatencyHistogram latencyHistogram;
+  MrfLatencyHistogram roundTripTimeHistogram;
+
+  // Ring to which finished operations are added when tracing is enabled. The
+  // pointer is accessed through the atomic functions for shared pointers, so
+  // that it can be read without holding the mutex. As the flag can be read
+  // much more cheaply, it is checked first.
+  std::atomic<bool> tracingEnabled;
+  std::shared_ptr<MrfTraceRing> traceRing;
+
+  // Timeouts of pending requests (together with the request reference), so
+  // that the send thread can find expired requests without scanning all
+  // pending requests. Entries are not removed when a request is answered or
+  // sent again, so an entry is only valid if its timeout matches the timeout
+  // of the pending request. This heap is only used by the send thread.
+  std::priority_queue<std::pair<MrfTime, std::uint32_t>,
+      std::vector<std::pair<MrfTime, std::uint32_t>>,
+      std::greater<std::pair<MrfTime, std::uint32_t>>> pendingRequestTimeouts;
+
+  // Requests that are sent by the send thread with a single system call
+  // (together with copies of their packets) and completions of requests that
+  // failed because the maximum number of tries has been reached. We keep
+  // these vectors so that their memory can be reused. They are only used by
+  // the send thread.
+  std::vector<MrfRequest *> sendBatchRequests;
+  std::vector<MrfUdpPacket> sendBatchPackets;
+  std::vector<MrfCompletion> sendCompletions;
+
+  // State of the sender. These fields are only used by the send thread (or by
+  // the reactor thread if a reactor is used).
+  MrfTime nextSendTime;
+  bool needTimeoutCheck = false;
+  MrfTime nextTimeoutCheckTime;
+
+  // State of the receiver. These fields are only used by the receive thread
+  // (or by the reactor thread if a reactor is used).
+  int numberOfConsecutiveReadFailures = 0;
+  std::vector<MrfUdpPacket> receivedPackets;
+  std::vector<MrfCompletion> receiveCompletions;
+
+  // When the maximum number of packets in flight is zero, packets are paced by
+  // using the fixed delay between packets. Otherwise, the congestion window
+  // limits the number of pending requests. Both fields are protected by the
+  // mutex.
+  int maximumPacketsInFlight = 0;
+  double congestionWindow = 1.0;
+
+  // Tells whether both halves of a 32-bit write are queued at once. This field
+  // is protected by the mutex.
+  bool pipelinedWrites = false;
+
+  /**
+   * Tells whether the congestion window is used and the number of pending
+   * requests has reached its size, so that no further request may be sent
+   * right now. The caller must hold the mutex.
+   */
+  bool isCongestionWindowFull();
+
+  // When the adaptive UDP timeout is enabled, the current UDP timeout is
+  // derived from the smoothed round-trip time and its mean deviation (both in
+  // nanoseconds). Otherwise, it is the fixed UDP timeout. All these fields are
+  // protected by the mutex.
+  bool adaptiveUdpTimeout = false;
+  MrfTime minimumUdpTimeout;
+  MrfTime maximumUdpTimeout;
+  bool haveRoundTripTimeSample = false;
+  std::int64_t smoothedRoundTripTime = 0;
+  std::int64_t roundTripTimeVariation = 0;
+  MrfTime currentUdpTimeout;
+
+  /**
+   * Updates the round-trip time estimate with a new sample and recalculates
+   * the current UDP timeout. The caller must hold the mutex.
+   */
+  void updateRoundTripTime(const MrfTime &roundTripTime);
+
+  /**
+   * Tells whether requests from the calling thread shall be queued as bulk
+   * requests. This is the case while a block operation is being queued.
+   */
+  bool isBulkRequest();
+
+  /**
+   * Takes an operation from the pool, growing the pool if necessary. The
+   * caller must hold the mutex and has to queue at least one request of the
+   * operation.
+   */
+  MrfOperation *allocateOperation(std::uint32_t address, bool bulk);
+
+  /**
+   * Removes a reference from an operation and returns it to the pool if there
+   * is no reference left. The caller must hold the mutex.
+   */
+  void releaseOperation(MrfOperation &operation);
+
+  /**
+   * Attaches a read operation to a read operation of the same type and for
+   * the same address that is already in progress, so that both complete with
+   * the same response. An interactive read is never attached to a bulk read,
+   * because it would have to wait for the bulk lane. Returns {@code false} if
+   * there is no suitable read in progress. The caller must hold the mutex.
+   */
+  bool attachToReadInProgress(MrfOperation &operation);
+
+  /**
+   * Adds a read operation to the table of reads in progress. The caller must
+   * hold the mutex.
+   */
+  void addReadInProgress(MrfOperation &operation);
+
+  /**
+   * Removes a read operation from the table of reads in progress. The caller
+   * must hold the mutex.
+   */
+  void removeReadInProgress(MrfOperation &operation);
+
+  /**
+   * Removes all reads that overlap the specified memory range from the table
+   * of reads in progress. This is called when a write operation is queued, so
+   * that a read that is queued after the write operation does not complete
+   * with a value that was read before the write. The caller must hold the
+   * mutex.
+   */
+  void invalidateReadsInProgress(std::uint32_t address, std::uint32_t size);
+
+  /**
+   * Queues a request for reading (access type 1) or writing (access type 2) a
+   * word. The request is added to the queue of the lane that is used by its
+   * operation. The caller must hold the mutex.
+   */
+  void queueRequest(MrfRequest &request, RequestRole role,
+      std::uint8_t accessType, std::uint32_t address, std::uint16_t data);
+
+  /**
+   * Returns the pending request with the specified reference or null if there
+   * is no such request. The caller must hold the mutex.
+   */
+  MrfRequest *findPendingRequest(std::uint32_t ref);
+
+  /**
+   * Processes the response for a request (or its failure). Depending on the
+   * role of the request, this might queue the next request of the same
+   * operation or add a completion for the operation to the specified vector.
+   * The caller must hold the mutex and must have removed the request from the
+   * queue or from the pending requests.
+   */
+  void completeRequest(MrfRequest &request, std::uint16_t data,
+      std::int8_t status, bool timeout,
+      std::vector<MrfCompletion> &completions);
+
+  /**
+   * Processes the response for one of the halves of a pipelined 32-bit write
+   * (or its failure). Returns {@code true} if the operation is complete. In
+   * this case, the result is stored in the specified completion. The caller
+   * must hold the mutex.
+   */
+  bool completePipelinedWriteRequest(MrfRequest &request, std::uint16_t data,
+      bool success, MrfCompletion &completion);
+
+  /**
+   * Calls the callbacks for the specified completions and clears the vector.
+   * The caller must not hold the mutex.
+   */
+  void deliverCompletions(std::vector<MrfCompletion> &completions);
 
   /**
-   * Queues a request for reading a word from a memory address.
+   * Adds an entry for the specified operation to the trace ring. This method
+   * must be called after the operation's callback has returned, because that
+   * time is recorded as the completion time.
    */
-  void queueReadRequest(std::uint32_t address,
-      std::shared_ptr<MrfRequestCallback> callback);
+  void addTraceEntry(MrfTraceRing &traceRing, const MrfOperation &operation,
+      bool success);
 
   /**
-   * Queues a request for writing a word to a memory address.
+   * Returns the queue to which a request belongs. The caller must hold the
+   * mutex.
    */
-  void queueWriteRequest(std::uint32_t address, std::uint16_t data,
-      std::shared_ptr<MrfRequestCallback> callback);
+  RequestQueue &getQueue(const MrfRequest &request) {
+    return request.operation->bulk ? bulkRequestQueue : requestQueue;
+  }
+
+  /**
+   * Returns the queue from which the next request shall be sent or null if
+   * both queues are empty. This takes the bulk share into account. The caller
+   * must hold the mutex.
+   */
+  RequestQueue *selectQueue();
 
   /**
    * Main function of the receive thread.
@@ -347,6 +886,45 @@ private:
    */
   void runSendThread();
 
+  /**
+   * Wakes the sender (the send thread or the reactor thread) up, so that it
+   * processes the request queue.
+   */
+  void wakeUpSender();
+
+  /**
+   * Receives the packets that are available from the socket and calls the
+   * callbacks of the requests they belong to. Returns {@code false} if
+   * receiving failed so often that it should not be tried again.
+   */
+  bool processReceivedPackets();
+
+  /**
+   * Handles requests that timed out, sends as many queued requests as the
+   * pacing allows and fails requests that have reached the maximum number of
+   * tries. Returns when the sender should be called again.
+   */
+  MrfUdpIpReactor::SendStatus processSendQueue();
+
+  /**
+   * Receives the packets that are available from the socket (up to
+   * {@link maximumPacketsPerBatch} packets). Packets that do not have the
+   * expected size are discarded. Returns zero on success and the error number
+   * if receiving failed. On Linux, all packets are received with a single
+   * {@code recvmmsg} call.
+   */
+  int receivePackets(std::vector<MrfUdpPacket> &packets);
+
+  /**
+   * Sends the specified packets (at most {@link maximumPacketsPerBatch}
+   * packets) in order. Returns the number of packets that have been sent. This
+   * number is less than the number of packets if the socket's send buffer is
+   * full. A packet that cannot be sent because of a different error is treated
+   * like it had been sent. On Linux, all packets are sent with a single
+   * {@code sendmmsg} call.
+   */
+  std::size_t sendPackets(std::vector<MrfUdpPacket> &packets);
+
 };
 
 }
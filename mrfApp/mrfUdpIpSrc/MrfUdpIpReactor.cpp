@@ -0,0 +1,339 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+
+extern "C" {
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif // __linux__
+}
+
+#include <mrfErrorUtil.h>
+
+#include "MrfUdpIpReactor.h"
+
+namespace anka {
+namespace mrf {
+
+#ifdef __linux__
+
+namespace {
+
+// Maximum number of events that are retrieved with a single epoll_wait call.
+constexpr int maximumNumberOfEvents = 64;
+
+} // anonymous namespace
+
+MrfUdpIpReactor::MrfUdpIpReactor() :
+    shutdown(false) {
+  epollDescriptor = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epollDescriptor == -1) {
+    throw systemErrorFromErrNo("Could not create epoll instance");
+  }
+  eventDescriptor = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (eventDescriptor == -1) {
+    int savedErrorNumber = errno;
+    closeDescriptors();
+    throw systemErrorForErrNo("Could not create eventfd", savedErrorNumber);
+  }
+  timerDescriptor = ::timerfd_create(CLOCK_REALTIME,
+      TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timerDescriptor == -1) {
+    int savedErrorNumber = errno;
+    closeDescriptors();
+    throw systemErrorForErrNo("Could not create timerfd", savedErrorNumber);
+  }
+  // We use the addresses of the fields storing the file descriptors in order
+  // to distinguish the event and timer descriptors from the handlers.
+  ::epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = &eventDescriptor;
+  if (::epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, eventDescriptor, &event)) {
+    int savedErrorNumber = errno;
+    closeDescriptors();
+    throw systemErrorForErrNo("Could not add eventfd to epoll instance",
+        savedErrorNumber);
+  }
+  event.events = EPOLLIN;
+  event.data.ptr = &timerDescriptor;
+  if (::epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, timerDescriptor, &event)) {
+    int savedErrorNumber = errno;
+    closeDescriptors();
+    throw systemErrorForErrNo("Could not add timerfd to epoll instance",
+        savedErrorNumber);
+  }
+  try {
+    thread = std::thread([this]() {run();});
+  } catch (...) {
+    closeDescriptors();
+    throw;
+  }
+}
+
+MrfUdpIpReactor::~MrfUdpIpReactor() {
+  try {
+    shutdown.store(true, std::memory_order_release);
+    signalEvent();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  } catch (...) {
+    // A destructor should never throw and we also want to make sure that the
+    // file descriptors are closed.
+  }
+  closeDescriptors();
+}
+
+void MrfUdpIpReactor::registerHandler(int fileDescriptor, Handler *handler) {
+  std::lock_guard<std::mutex> lock(mutex);
+  handler->fileDescriptor = fileDescriptor;
+  handler->readable = true;
+  handler->waitForWritable = false;
+  handler->needAction = false;
+  updateRegistration(handler, EPOLL_CTL_ADD);
+  handlers.insert(handler);
+  // The handler might already have requests that it wants to send.
+  handler->wakeUpPending.store(true);
+  signalEvent();
+}
+
+void MrfUdpIpReactor::unregisterHandler(Handler *handler) {
+  // While we hold the mutex, the reactor thread cannot be dispatching an event
+  // to the handler. Events that have already been retrieved by the reactor
+  // thread but not dispatched yet are discarded, because the handler is not
+  // in the set of handlers any longer.
+  std::lock_guard<std::mutex> lock(mutex);
+  if (handlers.erase(handler)) {
+    ::epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, handler->fileDescriptor,
+        nullptr);
+  }
+}
+
+void MrfUdpIpReactor::wakeUp(Handler *handler) {
+  // If a wake-up is already pending, we do not have to signal the reactor
+  // thread again.
+  if (!handler->wakeUpPending.exchange(true)) {
+    signalEvent();
+  }
+}
+
+void MrfUdpIpReactor::closeDescriptors() {
+  if (timerDescriptor != -1) {
+    ::close(timerDescriptor);
+    timerDescriptor = -1;
+  }
+  if (eventDescriptor != -1) {
+    ::close(eventDescriptor);
+    eventDescriptor = -1;
+  }
+  if (epollDescriptor != -1) {
+    ::close(epollDescriptor);
+    epollDescriptor = -1;
+  }
+}
+
+void MrfUdpIpReactor::run() {
+  ::epoll_event events[maximumNumberOfEvents];
+  while (!shutdown.load(std::memory_order_acquire)) {
+    int numberOfEvents = ::epoll_wait(epollDescriptor, events,
+        maximumNumberOfEvents, -1);
+    if (numberOfEvents == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Any other error means that the epoll instance is not usable, so there
+      // is nothing we can do but stop.
+      break;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    bool checkWakeUps = false;
+    bool checkTimers = false;
+    for (int i = 0; i < numberOfEvents; ++i) {
+      void *eventData = events[i].data.ptr;
+      if (eventData == &eventDescriptor || eventData == &timerDescriptor) {
+        // We have to read from the descriptor in order to reset its state.
+        std::uint64_t counter;
+        if (::read(*static_cast<int *>(eventData), &counter, sizeof(counter))
+            == -1) {
+          // EAGAIN simply means that there was a spurious wake-up.
+        }
+        if (eventData == &eventDescriptor) {
+          checkWakeUps = true;
+        } else {
+          checkTimers = true;
+        }
+        continue;
+      }
+      Handler *handler = static_cast<Handler *>(eventData);
+      if (!handlers.count(handler)) {
+        // The handler has been unregistered in the meantime.
+        continue;
+      }
+      try {
+        if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            && handler->readable) {
+          if (!handler->handleReadable()) {
+            handler->readable = false;
+            updateRegistration(handler, EPOLL_CTL_MOD);
+          }
+        }
+        if ((events[i].events & EPOLLOUT) && handler->waitForWritable) {
+          send(handler);
+        }
+      } catch (...) {
+        // We catch all errors so that a problem with a single handler does
+        // not stop the reactor thread.
+      }
+    }
+    if (checkWakeUps || checkTimers) {
+      MrfTime now = MrfTime::now();
+      for (auto handler : handlers) {
+        bool wakeUpPending = checkWakeUps && handler->wakeUpPending.exchange(
+            false);
+        bool actionDue = checkTimers && handler->needAction
+            && handler->nextActionTime <= now;
+        if (wakeUpPending || actionDue) {
+          try {
+            send(handler);
+          } catch (...) {
+            // We catch all errors so that a problem with a single handler does
+            // not stop the reactor thread.
+          }
+        }
+      }
+    }
+    try {
+      updateTimer();
+    } catch (...) {
+      // If we cannot set the timer, there is nothing we can do but try again
+      // after the next event.
+    }
+  }
+}
+
+void MrfUdpIpReactor::send(Handler *handler) {
+  SendStatus status = handler->handleSend();
+  handler->needAction = status.needAction;
+  handler->nextActionTime = status.nextActionTime;
+  if (status.waitForWritable != handler->waitForWritable) {
+    handler->waitForWritable = status.waitForWritable;
+    updateRegistration(handler, EPOLL_CTL_MOD);
+  }
+}
+
+void MrfUdpIpReactor::signalEvent() {
+  std::uint64_t increment = 1;
+  if (::write(eventDescriptor, &increment, sizeof(increment)) == -1) {
+    // The write can only fail because the counter would overflow. In this
+    // case, the reactor thread is going to wake up anyway.
+  }
+}
+
+void MrfUdpIpReactor::updateRegistration(Handler *handler, int operation) {
+  ::epoll_event event;
+  event.events = 0;
+  if (handler->readable) {
+    event.events |= EPOLLIN;
+  }
+  if (handler->waitForWritable) {
+    event.events |= EPOLLOUT;
+  }
+  event.data.ptr = handler;
+  if (::epoll_ctl(epollDescriptor, operation, handler->fileDescriptor,
+      &event)) {
+    throw systemErrorFromErrNo("Could not update epoll registration");
+  }
+}
+
+void MrfUdpIpReactor::updateTimer() {
+  bool needTimer = false;
+  MrfTime expirationTime;
+  for (auto handler : handlers) {
+    if (handler->needAction
+        && (!needTimer || handler->nextActionTime < expirationTime)) {
+      needTimer = true;
+      expirationTime = handler->nextActionTime;
+    }
+  }
+  // We avoid the system call if the timer is already set correctly.
+  if (needTimer == timerArmed
+      && (!needTimer || expirationTime == timerExpirationTime)) {
+    return;
+  }
+  // A zero expiration time would disarm the timer, so we use the smallest
+  // possible time instead (which has passed already, so that the timer expires
+  // immediately).
+  ::itimerspec timerSpec = {};
+  if (needTimer) {
+    timerSpec.it_value = expirationTime;
+    if (timerSpec.it_value.tv_sec == 0 && timerSpec.it_value.tv_nsec == 0) {
+      timerSpec.it_value.tv_nsec = 1;
+    }
+  }
+  if (::timerfd_settime(timerDescriptor, TFD_TIMER_ABSTIME, &timerSpec,
+      nullptr)) {
+    throw systemErrorFromErrNo("Could not set timerfd");
+  }
+  timerArmed = needTimer;
+  timerExpirationTime = expirationTime;
+}
+
+#else // __linux__
+
+MrfUdpIpReactor::MrfUdpIpReactor() :
+    shutdown(false) {
+  throw std::runtime_error(
+      "The UDP/IP reactor is only supported on Linux.");
+}
+
+MrfUdpIpReactor::~MrfUdpIpReactor() {
+}
+
+void MrfUdpIpReactor::registerHandler(int, Handler *) {
+  throw std::runtime_error(
+      "The UDP/IP reactor is only supported on Linux.");
+}
+
+void MrfUdpIpReactor::unregisterHandler(Handler *) {
+}
+
+void MrfUdpIpReactor::wakeUp(Handler *) {
+}
+
+#endif // __linux__
+
+}
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#ifndef ANKA_MRF_UDP_IP_REACTOR_H
+#define ANKA_MRF_UDP_IP_REACTOR_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include <MrfTime.h>
+
+namespace anka {
+namespace mrf {
+
+/**
+ * I/O reactor that can be shared by several {@link MrfUdpIpMemoryAccess}
+ * instances. Without a reactor, each memory access uses its own send and
+ * receive thread. With a reactor, a single thread waits for events on the
+ * sockets of all memory accesses that use it (using {@code epoll}) and
+ * dispatches these events to the respective memory access. Timers (for the
+ * delay between packets and for timeouts) are handled through a
+ * {@code timerfd}. Pacing and timeouts are still handled separately for each
+ * memory access.
+ *
+ * This class is only supported on Linux. On other platforms, the constructor
+ * throws an exception.
+ */
+class MrfUdpIpReactor {
+
+public:
+
+  /**
+   * Information returned by a handler after it has processed its send queue.
+   */
+  struct SendStatus {
+
+    /**
+     * Tells whether the handler wants to be called again at a certain time
+     * (e.g. because the next packet may only be sent after a delay or because
+     * a request might time out).
+     */
+    bool needAction;
+
+    /**
+     * Time at which the handler wants to be called again. Only meaningful if
+     * {@link needAction} is {@code true}.
+     */
+    MrfTime nextActionTime;
+
+    /**
+     * Tells whether the handler wants to be called again as soon as its socket
+     * is ready for writing.
+     */
+    bool waitForWritable;
+
+  };
+
+  /**
+   * Interface that has to be implemented by the objects that want to use the
+   * reactor. All methods are called from the reactor thread.
+   */
+  class Handler {
+
+  public:
+
+    /**
+     * Constructor.
+     */
+    Handler() : wakeUpPending(false) {
+    }
+
+    /**
+     * Destructor.
+     */
+    virtual ~Handler() {
+    }
+
+    /**
+     * Called when the handler's socket is ready for reading. Returns
+     * {@code false} if the handler does not want to be notified about this
+     * condition any longer (e.g. because of a non-recoverable error).
+     */
+    virtual bool handleReadable() = 0;
+
+    /**
+     * Called when the handler has been woken up, when its socket is ready for
+     * writing (if it asked for this), or when the next action time that it
+     * specified has been reached.
+     */
+    virtual SendStatus handleSend() = 0;
+
+  private:
+
+    friend class MrfUdpIpReactor;
+
+    // We do not want to allow copy or move construction or assignment.
+    Handler(const Handler &) = delete;
+    Handler(Handler &&) = delete;
+    Handler &operator=(const Handler &) = delete;
+    Handler &operator=(Handler &&) = delete;
+
+    // Set when wakeUp(...) has been called, cleared by the reactor thread.
+    std::atomic<bool> wakeUpPending;
+
+    // The following fields are protected by the reactor's mutex.
+    int fileDescriptor = -1;
+    bool readable = true;
+    bool waitForWritable = false;
+    bool needAction = false;
+    MrfTime nextActionTime;
+
+  };
+
+  /**
+   * Creates a reactor and starts its thread. Throws an exception if the
+   * reactor cannot be initialized or if the platform is not supported.
+   */
+  MrfUdpIpReactor();
+
+  /**
+   * Destructor. Stops the reactor thread. All handlers must have been
+   * unregistered before the reactor is destroyed.
+   */
+  ~MrfUdpIpReactor();
+
+  /**
+   * Registers a handler for the specified file descriptor. The handler will be
+   * notified when the file descriptor is ready for reading and its
+   * {@code handleSend()} method is called right away. Throws an exception if
+   * the handler cannot be registered.
+   */
+  void registerHandler(int fileDescriptor, Handler *handler);
+
+  /**
+   * Unregisters a handler. When this method returns, the handler is not called
+   * any longer, so it may be destroyed. This method must not be called from
+   * the reactor thread.
+   */
+  void unregisterHandler(Handler *handler);
+
+  /**
+   * Requests that the {@code handleSend()} method of the specified handler is
+   * called as soon as possible. This method is thread safe and does not block,
+   * so it may also be called by a callback that is running in the reactor
+   * thread.
+   */
+  void wakeUp(Handler *handler);
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  MrfUdpIpReactor(const MrfUdpIpReactor &) = delete;
+  MrfUdpIpReactor(MrfUdpIpReactor &&) = delete;
+  MrfUdpIpReactor &operator=(const MrfUdpIpReactor &) = delete;
+  MrfUdpIpReactor &operator=(MrfUdpIpReactor &&) = delete;
+
+  int epollDescriptor = -1;
+  int eventDescriptor = -1;
+  int timerDescriptor = -1;
+  std::atomic<bool> shutdown;
+  std::mutex mutex;
+  std::unordered_set<Handler *> handlers;
+  bool timerArmed = false;
+  MrfTime timerExpirationTime;
+  std::thread thread;
+
+  /**
+   * Writes to the event file descriptor, so that the reactor thread wakes up.
+   */
+  void signalEvent();
+
+  /**
+   * Closes all file descriptors.
+   */
+  void closeDescriptors();
+
+  /**
+   * Main function of the reactor thread.
+   */
+  void run();
+
+  /**
+   * Calls the handler's {@code handleSend()} method and updates the epoll
+   * registration of its file descriptor if necessary. The caller must hold the
+   * mutex.
+   */
+  void send(Handler *handler);
+
+  /**
+   * Updates the epoll registration of the handler's file descriptor. The
+   * caller must hold the mutex.
+   */
+  void updateRegistration(Handler *handler, int operation);
+
+  /**
+   * Sets the timer so that it expires at the earliest next action time of all
+   * handlers. The caller must hold the mutex.
+   */
+  void updateTimer();
+
+};
+
+}
+}
+
+#endif // ANKA_MRF_UDP_IP_REACTOR_H
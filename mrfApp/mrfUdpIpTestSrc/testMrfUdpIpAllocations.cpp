@@ -0,0 +1,381 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+}
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <MrfUdpIpMemoryAccess.h>
+
+// This test checks that the UDP/IP memory access does not allocate memory for
+// read and write operations once its pool of operations has grown. It replaces
+// the global allocation functions with versions that count the allocations,
+// and runs the memory access against a fake device that answers the requests
+// on the loopback interface.
+
+namespace {
+
+// Allocations are only counted while the flag is set.
+std::atomic<bool> countAllocations(false);
+std::atomic<unsigned long> numberOfAllocations(0);
+
+void *allocate(std::size_t size) {
+  if (countAllocations.load(std::memory_order_relaxed)) {
+    numberOfAllocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void *memory = std::malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+}
+
+void *operator new(std::size_t size) {
+  return allocate(size);
+}
+
+void *operator new[](std::size_t size) {
+  return allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void operator delete(void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+namespace {
+
+using namespace anka::mrf;
+
+/**
+ * Loopback address used by the fake device. We do not use 127.0.0.1 so that
+ * the test does not collide with an instance of mrfUdpSim that might be
+ * running on the same host.
+ */
+const char *const deviceHostName = "127.0.0.42";
+
+/**
+ * Number of registers (16-bit words) simulated by the fake device.
+ */
+constexpr std::uint32_t deviceMemorySize = 0x1000;
+
+/**
+ * Number of operations that are queued before waiting for them to complete.
+ */
+constexpr int operationsPerBatch = 64;
+
+/**
+ * Number of operations for which the allocations are counted.
+ */
+constexpr int numberOfOperations = 8192;
+
+/**
+ * Data structure for a UDP packet sent to or received from the MRF VME
+ * modules. This has to match the structure used by the UDP/IP memory access.
+ */
+// We have to pack the structure so that it matches the network representation.
+#pragma pack(push, 1)
+struct MrfUdpPacket {
+  std::uint8_t accessType;
+  std::int8_t status;
+  std::uint16_t data;
+  std::uint32_t address;
+  std::uint32_t ref;
+};
+#pragma pack(pop)
+
+/**
+ * Fake device that answers the requests sent by the UDP/IP memory access from
+ * a register file kept in memory. The fake device does not allocate memory
+ * while processing requests, so it does not affect the allocation count.
+ */
+class FakeDevice {
+
+public:
+
+  FakeDevice() : memory() {
+    socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (socketDescriptor == -1) {
+      throw std::runtime_error("Could not create the socket.");
+    }
+    ::sockaddr_in socketAddress;
+    std::memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_port = htons(2000);
+    if (::inet_pton(AF_INET, deviceHostName, &socketAddress.sin_addr) != 1
+        || ::bind(socketDescriptor,
+            reinterpret_cast<::sockaddr *>(&socketAddress),
+            sizeof(socketAddress))) {
+      ::close(socketDescriptor);
+      throw std::runtime_error(
+          std::string("Could not bind the socket to ") + deviceHostName
+              + ":2000.");
+    }
+    thread = std::thread([this]() {run();});
+  }
+
+  ~FakeDevice() {
+    shutdown = true;
+    thread.join();
+    ::close(socketDescriptor);
+  }
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  FakeDevice(const FakeDevice &) = delete;
+  FakeDevice(FakeDevice &&) = delete;
+  FakeDevice &operator=(const FakeDevice &) = delete;
+  FakeDevice &operator=(FakeDevice &&) = delete;
+
+  std::uint16_t memory[deviceMemorySize];
+  std::atomic<bool> shutdown {false};
+  int socketDescriptor;
+  std::thread thread;
+
+  void run() {
+    while (!shutdown) {
+      // We use a timeout, so that we notice when the device shall shut down.
+      ::fd_set readDescriptors;
+      FD_ZERO(&readDescriptors);
+      FD_SET(socketDescriptor, &readDescriptors);
+      ::timeval timeout;
+      timeout.tv_sec = 0;
+      timeout.tv_usec = 10000;
+      if (::select(socketDescriptor + 1, &readDescriptors, nullptr, nullptr,
+          &timeout) <= 0) {
+        continue;
+      }
+      MrfUdpPacket packet;
+      ::sockaddr_in peerAddress;
+      ::socklen_t peerAddressLength = sizeof(peerAddress);
+      if (::recvfrom(socketDescriptor, &packet, sizeof(packet), 0,
+          reinterpret_cast<::sockaddr *>(&peerAddress), &peerAddressLength)
+          != sizeof(packet)) {
+        continue;
+      }
+      std::uint32_t offset = ntohl(packet.address)
+          - MrfUdpIpMemoryAccess::baseAddressVmeEvgRegister;
+      if (offset >= deviceMemorySize * 2 || offset % 2) {
+        packet.status = -1;
+      } else {
+        // Access type 2 is a write, access type 1 is a read.
+        if (packet.accessType == 2) {
+          memory[offset / 2] = ntohs(packet.data);
+        }
+        packet.status = 0;
+        packet.data = htons(memory[offset / 2]);
+      }
+      ::sendto(socketDescriptor, &packet, sizeof(packet), 0,
+          reinterpret_cast<::sockaddr *>(&peerAddress), peerAddressLength);
+    }
+  }
+
+};
+
+/**
+ * Callback that is shared by all operations of a batch. It counts the
+ * completed and failed operations, so that the test can wait for all of them.
+ */
+class BatchCallback: public MrfMemoryAccess::CallbackUInt16,
+    public MrfMemoryAccess::CallbackUInt32 {
+
+public:
+
+  void success(std::uint32_t, std::uint16_t) {
+    finish(false);
+  }
+
+  void failure(std::uint32_t, MrfMemoryAccess::ErrorCode,
+      const std::string &) {
+    finish(true);
+  }
+
+  void success(std::uint32_t, std::uint32_t) {
+    finish(false);
+  }
+
+  /**
+   * Waits until the specified number of operations has completed since the
+   * last call to this method. Returns false if this takes longer than ten
+   * seconds.
+   */
+  bool waitFor(int count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    bool finished = condition.wait_for(lock, std::chrono::seconds(10),
+        [this, count]() {return completed >= count;});
+    completed = 0;
+    return finished;
+  }
+
+  int getFailures() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failures;
+  }
+
+private:
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  int completed = 0;
+  int failures = 0;
+
+  void finish(bool failed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++completed;
+    if (failed) {
+      ++failures;
+    }
+    condition.notify_all();
+  }
+
+};
+
+/**
+ * Runs the specified number of operations, mixing 16-bit and 32-bit reads and
+ * writes. Each read is queued twice, so that the second one is combined with
+ * the first one. Returns false if the operations do not complete in time.
+ */
+bool runOperations(MrfUdpIpMemoryAccess &memoryAccess,
+    std::shared_ptr<BatchCallback> callback, int count) {
+  std::shared_ptr<MrfMemoryAccess::CallbackUInt16> callbackUInt16 = callback;
+  std::shared_ptr<MrfMemoryAccess::CallbackUInt32> callbackUInt32 = callback;
+  int queued = 0;
+  for (int i = 0; i < count; ++i) {
+    std::uint32_t address = (i * 4) % (deviceMemorySize * 2);
+    switch (i % 6) {
+    case 0:
+    case 1:
+      memoryAccess.readUInt16(address, callbackUInt16);
+      break;
+    case 2:
+      memoryAccess.writeUInt16(address, static_cast<std::uint16_t>(i),
+          callbackUInt16);
+      break;
+    case 3:
+    case 4:
+      memoryAccess.readUInt32(address, callbackUInt32);
+      break;
+    case 5:
+      memoryAccess.writeUInt32(address, static_cast<std::uint32_t>(i) << 8,
+          callbackUInt32);
+      break;
+    }
+    ++queued;
+    if (queued == operationsPerBatch || i + 1 == count) {
+      if (!callback->waitFor(queued)) {
+        return false;
+      }
+      queued = 0;
+    }
+  }
+  return true;
+}
+
+}
+
+MAIN(testMrfUdpIpAllocations) {
+  testPlan(4);
+  try {
+    FakeDevice device;
+    MrfUdpIpMemoryAccess memoryAccess(deviceHostName,
+        MrfUdpIpMemoryAccess::baseAddressVmeEvgRegister, MrfTime(0, 0),
+        MrfTime(0, 100000000), 5);
+    // We enable the code paths that have been added for higher throughput,
+    // so that they are covered as well.
+    memoryAccess.setMaximumPacketsInFlight(16);
+    memoryAccess.setPipelinedWrites(true);
+    std::shared_ptr<BatchCallback> callback = std::make_shared<BatchCallback>();
+    // The first round lets the pool and the internal buffers grow to the size
+    // needed for this load.
+    testOk(runOperations(memoryAccess, callback, numberOfOperations),
+        "Warm-up operations completed");
+    countAllocations = true;
+    bool completed = runOperations(memoryAccess, callback, numberOfOperations);
+    countAllocations = false;
+    testOk(completed, "%d operations completed", numberOfOperations);
+    testOk(numberOfAllocations == 0,
+        "No allocations after warm-up (%lu allocations)",
+        numberOfAllocations.load());
+    testOk(callback->getFailures() == 0, "No operation failed (%d failures)",
+        callback->getFailures());
+  } catch (std::exception &e) {
+    testAbort("Could not run the test: %s", e.what());
+  }
+  return testDone();
+}
@@ -0,0 +1,634 @@
+/*
+ * Copyright 2026 aquenos GmbH.
+ * Copyright 2026 Karlsruhe Institute of Technology.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This software has been developed by aquenos GmbH on behalf of the
+ * Karlsruhe Institute of Technology's Institute for Beam Physics and
+ * Technology.
+ *
+ * This software contains code originally developed by aquenos GmbH for
+ * the s7nodave EPICS device support. aquenos GmbH has relicensed the
+ * affected poritions of code from the s7nodave EPICS device support
+ * (originally licensed under the terms of the GNU GPL) under the terms
+ * of the GNU LGPL version 3 or newer.
+ */
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+}
+
+// This program is a stand-in for the UDP/IP interface of an MRF VME-EVG-230 or
+// VME-EVR-230RF. It answers the same requests as the real device from a
+// register file that is kept in memory and can emulate the limited processing
+// speed of the device as well as several kinds of network problems. It is
+// intended for testing the UDP/IP memory access (and IOCs using it) on the
+// loopback interface.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * UDP port used by the MRF devices. The port is fixed, so if more than one
+ * stand-in server shall run on the same host, they have to use different
+ * addresses (e.g. 127.0.0.1 and 127.0.0.2).
+ */
+constexpr std::uint16_t mrfUdpPort = 2000;
+
+/**
+ * Access type of a read request.
+ */
+constexpr std::uint8_t accessTypeRead = 1;
+
+/**
+ * Access type of a write request.
+ */
+constexpr std::uint8_t accessTypeWrite = 2;
+
+/**
+ * Status code sent for a request that refers to an invalid address.
+ */
+constexpr std::int8_t statusInvalidAddress = -1;
+
+/**
+ * Status code sent for a request that has an invalid access type.
+ */
+constexpr std::int8_t statusInvalidCommand = -3;
+
+/**
+ * Data structure for a UDP packet sent to or received from the MRF VME
+ * modules. This has to match the structure used by the UDP/IP memory access.
+ */
+// We have to pack the structure so that it matches the network representation.
+#pragma pack(push, 1)
+struct MrfUdpPacket {
+  std::uint8_t accessType;
+  std::int8_t status;
+  std::uint16_t data;
+  std::uint32_t address;
+  std::uint32_t ref;
+};
+#pragma pack(pop)
+
+/**
+ * Packet together with the address of the peer that sent it (or that it shall
+ * be sent to).
+ */
+struct AddressedPacket {
+  MrfUdpPacket packet;
+  ::sockaddr_in peerAddress;
+};
+
+/**
+ * Request that has been accepted by the simulated device and is waiting to be
+ * processed.
+ */
+struct ProcessingRequest {
+  Clock::time_point doneTime;
+  AddressedPacket request;
+};
+
+/**
+ * Response that has been scheduled to be sent at a later point in time. The
+ * sequence number makes sure that responses that are scheduled for the same
+ * time are sent in the order in which they were scheduled.
+ */
+struct ScheduledResponse {
+  Clock::time_point sendTime;
+  std::uint64_t sequenceNumber;
+  AddressedPacket response;
+
+  bool operator>(const ScheduledResponse &other) const {
+    return std::tie(sendTime, sequenceNumber)
+        > std::tie(other.sendTime, other.sequenceNumber);
+  }
+};
+
+/**
+ * Settings of the stand-in server.
+ */
+struct Settings {
+  std::string bindAddress = "127.0.0.1";
+  std::uint32_t baseAddress = 0x80000000;
+  std::uint32_t memorySize = 0x10000;
+  std::chrono::microseconds processingTime = std::chrono::microseconds(400);
+  std::size_t queueLength = 1;
+  double lossProbability = 0.0;
+  double reorderProbability = 0.0;
+  std::chrono::microseconds reorderDelay = std::chrono::microseconds(-1);
+  double duplicateProbability = 0.0;
+  std::chrono::microseconds duplicateDelay = std::chrono::microseconds(
+      10000);
+  unsigned long seed = 0;
+  bool seedSpecified = false;
+};
+
+/**
+ * Counters that are printed when the server terminates.
+ */
+struct Statistics {
+  unsigned long long received = 0;
+  unsigned long long droppedBusy = 0;
+  unsigned long long lostRequests = 0;
+  unsigned long long lostResponses = 0;
+  unsigned long long reads = 0;
+  unsigned long long writes = 0;
+  unsigned long long errors = 0;
+  unsigned long long reordered = 0;
+  unsigned long long duplicated = 0;
+};
+
+/**
+ * Flag that is set by the signal handler when the server shall terminate.
+ */
+volatile ::sig_atomic_t terminateRequested = 0;
+
+extern "C" void handleTerminationSignal(int) {
+  terminateRequested = 1;
+}
+
+void printUsage(const char *programName) {
+  std::fprintf(stderr,
+      "Usage: %s [options]\n"
+      "\n"
+      "Stand-in for the UDP/IP interface of an MRF VME-EVG-230 or "
+      "VME-EVR-230RF.\n"
+      "\n"
+      "Options:\n"
+      "  -a, --address ADDRESS        address to listen on (default "
+      "127.0.0.1)\n"
+      "  -t, --type evg|evr           type of the simulated device (default "
+      "evg)\n"
+      "  -p, --processing-time US     time needed for processing a packet\n"
+      "                               (microseconds, default 400)\n"
+      "  -q, --queue-length N         number of packets that can wait while "
+      "another\n"
+      "                               packet is processed (default 1)\n"
+      "  -l, --loss P                 probability of losing a request or a "
+      "response\n"
+      "  -r, --reorder P              probability of delaying a response, so "
+      "that it is\n"
+      "                               overtaken by later responses\n"
+      "      --reorder-delay US       delay of a reordered response "
+      "(microseconds,\n"
+      "                               default twice the processing time)\n"
+      "  -d, --duplicate P            probability of sending a response a "
+      "second time\n"
+      "      --duplicate-delay US     delay of the duplicate response "
+      "(microseconds,\n"
+      "                               default 10000)\n"
+      "  -s, --seed N                 seed for the random number generator\n"
+      "  -h, --help                   show this help\n",
+      programName);
+}
+
+double parseProbability(const char *optionName, const char *value) {
+  char *endPtr;
+  errno = 0;
+  double probability = std::strtod(value, &endPtr);
+  if (errno || *endPtr || !(probability >= 0.0 && probability <= 1.0)) {
+    throw std::invalid_argument(
+        std::string("The value of ") + optionName
+            + " must be a number between 0 and 1.");
+  }
+  return probability;
+}
+
+unsigned long parseUnsigned(const char *optionName, const char *value) {
+  char *endPtr;
+  errno = 0;
+  unsigned long number = std::strtoul(value, &endPtr, 0);
+  if (errno || *endPtr || !*value || *value == '-') {
+    throw std::invalid_argument(
+        std::string("The value of ") + optionName
+            + " must be a non-negative integer.");
+  }
+  return number;
+}
+
+/**
+ * Parses the command-line arguments. Returns false if the program shall
+ * terminate without starting the server (because the usage information has
+ * been requested). Throws an exception if the arguments are invalid.
+ */
+bool parseArguments(int argc, char **argv, Settings &settings) {
+  enum {
+    reorderDelayOption = 256, duplicateDelayOption
+  };
+  static const ::option longOptions[] = {
+    { "address", required_argument, nullptr, 'a' },
+    { "type", required_argument, nullptr, 't' },
+    { "processing-time", required_argument, nullptr, 'p' },
+    { "queue-length", required_argument, nullptr, 'q' },
+    { "loss", required_argument, nullptr, 'l' },
+    { "reorder", required_argument, nullptr, 'r' },
+    { "reorder-delay", required_argument, nullptr, reorderDelayOption },
+    { "duplicate", required_argument, nullptr, 'd' },
+    { "duplicate-delay", required_argument, nullptr, duplicateDelayOption },
+    { "seed", required_argument, nullptr, 's' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 }
+  };
+  int option;
+  while ((option = ::getopt_long(argc, argv, "a:t:p:q:l:r:d:s:h", longOptions,
+      nullptr)) != -1) {
+    switch (option) {
+    case 'a':
+      settings.bindAddress = optarg;
+      break;
+    case 't':
+      if (std::strcmp(optarg, "evg") == 0) {
+        settings.baseAddress = 0x80000000;
+        settings.memorySize = 0x10000;
+      } else if (std::strcmp(optarg, "evr") == 0) {
+        settings.baseAddress = 0x7a000000;
+        settings.memorySize = 0x40000;
+      } else {
+        throw std::invalid_argument(
+            "The device type must be either \"evg\" or \"evr\".");
+      }
+      break;
+    case 'p':
+      settings.processingTime = std::chrono::microseconds(
+          parseUnsigned("--processing-time", optarg));
+      break;
+    case 'q':
+      settings.queueLength = parseUnsigned("--queue-length", optarg);
+      break;
+    case 'l':
+      settings.lossProbability = parseProbability("--loss", optarg);
+      break;
+    case 'r':
+      settings.reorderProbability = parseProbability("--reorder", optarg);
+      break;
+    case reorderDelayOption:
+      settings.reorderDelay = std::chrono::microseconds(
+          parseUnsigned("--reorder-delay", optarg));
+      break;
+    case 'd':
+      settings.duplicateProbability = parseProbability("--duplicate", optarg);
+      break;
+    case duplicateDelayOption:
+      settings.duplicateDelay = std::chrono::microseconds(
+          parseUnsigned("--duplicate-delay", optarg));
+      break;
+    case 's':
+      settings.seed = parseUnsigned("--seed", optarg);
+      settings.seedSpecified = true;
+      break;
+    case 'h':
+      printUsage(argv[0]);
+      return false;
+    default:
+      throw std::invalid_argument("Invalid command-line arguments.");
+    }
+  }
+  if (optind < argc) {
+    throw std::invalid_argument("Unexpected command-line argument.");
+  }
+  if (settings.reorderDelay.count() < 0) {
+    settings.reorderDelay = 2 * settings.processingTime;
+  }
+  return true;
+}
+
+/**
+ * Simulated device. This class contains the register file and the logic for
+ * processing requests. All methods are called from the main thread, so there
+ * is no need for synchronization.
+ */
+class SimulatedDevice {
+
+public:
+
+  SimulatedDevice(const Settings &settings) :
+      settings(settings), memory(settings.memorySize / 2), socketDescriptor(
+          -1), nextSequenceNumber(0) {
+    if (settings.seedSpecified) {
+      randomGenerator.seed(settings.seed);
+    } else {
+      randomGenerator.seed(std::random_device()());
+    }
+    ::sockaddr_in socketAddress;
+    std::memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_port = htons(mrfUdpPort);
+    if (::inet_pton(AF_INET, settings.bindAddress.c_str(),
+        &socketAddress.sin_addr) != 1) {
+      throw std::invalid_argument(
+          "Invalid address: " + settings.bindAddress);
+    }
+    socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (socketDescriptor == -1) {
+      throw std::runtime_error(
+          std::string("Could not create socket: ") + std::strerror(errno));
+    }
+    if (::bind(socketDescriptor,
+        reinterpret_cast<::sockaddr *>(&socketAddress),
+        sizeof(socketAddress))) {
+      int errorNumber = errno;
+      ::close(socketDescriptor);
+      throw std::runtime_error(
+          "Could not bind socket to " + settings.bindAddress + ":"
+              + std::to_string(mrfUdpPort) + ": "
+              + std::strerror(errorNumber));
+    }
+    int flags = ::fcntl(socketDescriptor, F_GETFL, 0);
+    ::fcntl(socketDescriptor, F_SETFL, flags | O_NONBLOCK);
+  }
+
+  ~SimulatedDevice() {
+    ::close(socketDescriptor);
+  }
+
+  /**
+   * Runs the server until a termination signal is received.
+   */
+  void run() {
+    while (!terminateRequested) {
+      Clock::time_point now = Clock::now();
+      processDueEvents(now);
+      // We wait until the next event is due or a packet arrives.
+      ::timeval timeout;
+      ::timeval *timeoutPtr = nullptr;
+      Clock::time_point nextEventTime;
+      if (nextEvent(nextEventTime)) {
+        auto waitTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            nextEventTime - now);
+        if (waitTime.count() < 0) {
+          waitTime = std::chrono::microseconds(0);
+        }
+        timeout.tv_sec = waitTime.count() / 1000000;
+        timeout.tv_usec = waitTime.count() % 1000000;
+        timeoutPtr = &timeout;
+      }
+      ::fd_set readFds;
+      FD_ZERO(&readFds);
+      FD_SET(socketDescriptor, &readFds);
+      int result = ::select(socketDescriptor + 1, &readFds, nullptr, nullptr,
+          timeoutPtr);
+      if (result == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error(
+            std::string("select failed: ") + std::strerror(errno));
+      }
+      if (result > 0) {
+        receivePackets();
+      }
+    }
+  }
+
+  /**
+   * Prints the statistics to the standard output.
+   */
+  void printStatistics() const {
+    std::printf("Requests received:            %llu\n", statistics.received);
+    std::printf("Requests dropped (busy):      %llu\n",
+        statistics.droppedBusy);
+    std::printf("Requests lost:                %llu\n",
+        statistics.lostRequests);
+    std::printf("Responses lost:               %llu\n",
+        statistics.lostResponses);
+    std::printf("Reads:                        %llu\n", statistics.reads);
+    std::printf("Writes:                       %llu\n", statistics.writes);
+    std::printf("Error responses:              %llu\n", statistics.errors);
+    std::printf("Responses reordered:          %llu\n", statistics.reordered);
+    std::printf("Responses duplicated:         %llu\n",
+        statistics.duplicated);
+  }
+
+private:
+
+  // We do not want to allow copy or move construction or assignment.
+  SimulatedDevice(const SimulatedDevice &) = delete;
+  SimulatedDevice(SimulatedDevice &&) = delete;
+  SimulatedDevice &operator=(const SimulatedDevice &) = delete;
+  SimulatedDevice &operator=(SimulatedDevice &&) = delete;
+
+  const Settings &settings;
+  std::vector<std::uint16_t> memory;
+  int socketDescriptor;
+  std::mt19937 randomGenerator;
+  std::uniform_real_distribution<double> uniformDistribution;
+  Statistics statistics;
+
+  /**
+   * Requests that have been accepted and are processed one after the other.
+   * The first request is the one that is currently being processed.
+   */
+  std::deque<ProcessingRequest> processingQueue;
+
+  /**
+   * Responses that are sent later (because they are reordered or duplicated).
+   */
+  std::priority_queue<ScheduledResponse, std::vector<ScheduledResponse>,
+      std::greater<ScheduledResponse>> scheduledResponses;
+
+  std::uint64_t nextSequenceNumber;
+
+  bool randomEvent(double probability) {
+    return probability > 0.0
+        && uniformDistribution(randomGenerator) < probability;
+  }
+
+  bool nextEvent(Clock::time_point &eventTime) const {
+    bool found = false;
+    if (!processingQueue.empty()) {
+      eventTime = processingQueue.front().doneTime;
+      found = true;
+    }
+    if (!scheduledResponses.empty()
+        && (!found || scheduledResponses.top().sendTime < eventTime)) {
+      eventTime = scheduledResponses.top().sendTime;
+      found = true;
+    }
+    return found;
+  }
+
+  void receivePackets() {
+    for (;;) {
+      // We use a buffer that is slightly larger than needed so that we can
+      // detect too large packets.
+      char buffer[sizeof(MrfUdpPacket) + 4];
+      AddressedPacket request;
+      ::socklen_t peerAddressLength = sizeof(request.peerAddress);
+      ::ssize_t length = ::recvfrom(socketDescriptor, buffer, sizeof(buffer),
+          0, reinterpret_cast<::sockaddr *>(&request.peerAddress),
+          &peerAddressLength);
+      if (length == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          std::fprintf(stderr, "Error while receiving packet: %s\n",
+              std::strerror(errno));
+        }
+        return;
+      }
+      // Like the real device, we ignore packets that have the wrong size.
+      if (length != sizeof(MrfUdpPacket)) {
+        continue;
+      }
+      ++statistics.received;
+      std::memcpy(&request.packet, buffer, sizeof(MrfUdpPacket));
+      if (randomEvent(settings.lossProbability)) {
+        ++statistics.lostRequests;
+        continue;
+      }
+      // Requests that have been finished in the meantime must not count as
+      // waiting, so we process them first.
+      Clock::time_point now = Clock::now();
+      processDueEvents(now);
+      // The device processes one request at a time and can only buffer a
+      // limited number of requests. When this buffer is full, the request is
+      // lost.
+      if (processingQueue.size() > settings.queueLength) {
+        ++statistics.droppedBusy;
+        continue;
+      }
+      Clock::time_point startTime = now;
+      if (!processingQueue.empty()
+          && processingQueue.back().doneTime > startTime) {
+        startTime = processingQueue.back().doneTime;
+      }
+      processingQueue.push_back(
+          ProcessingRequest { startTime + settings.processingTime, request });
+    }
+  }
+
+  void processDueEvents(Clock::time_point now) {
+    while (!processingQueue.empty() && processingQueue.front().doneTime <= now) {
+      AddressedPacket response = processRequest(processingQueue.front().request);
+      processingQueue.pop_front();
+      if (randomEvent(settings.lossProbability)) {
+        ++statistics.lostResponses;
+        continue;
+      }
+      if (randomEvent(settings.duplicateProbability)) {
+        ++statistics.duplicated;
+        scheduleResponse(now + settings.duplicateDelay, response);
+      }
+      if (randomEvent(settings.reorderProbability)) {
+        ++statistics.reordered;
+        scheduleResponse(now + settings.reorderDelay, response);
+      } else {
+        sendResponse(response);
+      }
+    }
+    while (!scheduledResponses.empty()
+        && scheduledResponses.top().sendTime <= now) {
+      sendResponse(scheduledResponses.top().response);
+      scheduledResponses.pop();
+    }
+  }
+
+  AddressedPacket processRequest(const AddressedPacket &request) {
+    AddressedPacket response = request;
+    MrfUdpPacket &packet = response.packet;
+    // The reference is mirrored back unchanged and so is the address.
+    std::uint32_t address = ntohl(packet.address);
+    std::uint32_t offset = address - settings.baseAddress;
+    if (packet.accessType != accessTypeRead
+        && packet.accessType != accessTypeWrite) {
+      packet.status = statusInvalidCommand;
+      ++statistics.errors;
+    } else if (address < settings.baseAddress
+        || offset >= settings.memorySize - 1 || offset % 2 != 0) {
+      packet.status = statusInvalidAddress;
+      ++statistics.errors;
+    } else {
+      if (packet.accessType == accessTypeWrite) {
+        memory[offset / 2] = ntohs(packet.data);
+        ++statistics.writes;
+      } else {
+        ++statistics.reads;
+      }
+      packet.status = 0;
+      packet.data = htons(memory[offset / 2]);
+    }
+    return response;
+  }
+
+  void scheduleResponse(Clock::time_point sendTime,
+      const AddressedPacket &response) {
+    scheduledResponses.push(
+        ScheduledResponse { sendTime, nextSequenceNumber++, response });
+  }
+
+  void sendResponse(const AddressedPacket &response) {
+    if (::sendto(socketDescriptor, &response.packet, sizeof(MrfUdpPacket), 0,
+        reinterpret_cast<const ::sockaddr *>(&response.peerAddress),
+        sizeof(response.peerAddress)) == -1) {
+      std::fprintf(stderr, "Error while sending packet: %s\n",
+          std::strerror(errno));
+    }
+  }
+
+};
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  Settings settings;
+  try {
+    if (!parseArguments(argc, argv, settings)) {
+      return 0;
+    }
+  } catch (std::exception &e) {
+    std::fprintf(stderr, "%s\n\n", e.what());
+    printUsage(argv[0]);
+    return 2;
+  }
+  struct ::sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = handleTerminationSignal;
+  ::sigemptyset(&action.sa_mask);
+  ::sigaction(SIGINT, &action, nullptr);
+  ::sigaction(SIGTERM, &action, nullptr);
+  try {
+    SimulatedDevice device(settings);
+    std::printf("Listening on %s:%u.\n", settings.bindAddress.c_str(),
+        static_cast<unsigned>(mrfUdpPort));
+    std::fflush(stdout);
+    device.run();
+    device.printStatistics();
+  } catch (std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}